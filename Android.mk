@@ -49,6 +49,18 @@ LOCAL_SRC_FILES := \
     im2d_api/src/im2d_debugger.cpp \
     im2d_api/src/im2d_context.cpp \
     im2d_api/src/im2d_job.cpp \
+    im2d_api/src/im2d_fence.cpp \
+    im2d_api/src/im2d_tile.cpp \
+    im2d_api/src/im2d_scheduler.cpp \
+    im2d_api/src/im2d_import_cache.cpp \
+    im2d_api/src/im2d_frame_pool.cpp \
+    im2d_api/src/im2d_cpu_kernel.cpp \
+    im2d_api/src/im2d_cpu_backend.cpp \
+    im2d_api/src/im2d_cpu_csc.cpp \
+    im2d_api/src/im2d_cpu_blend.cpp \
+    im2d_api/src/im2d_cpu_scale.cpp \
+    im2d_api/src/im2d_cpu_rotate.cpp \
+    im2d_api/src/im2d_cpu_fbc.cpp \
     im2d_api/src/im2d_impl.cpp \
     im2d_api/src/im2d.cpp
 
@@ -26,6 +26,7 @@
 #include <poll.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -61,6 +62,15 @@ struct sync_legacy_merge_data {
 #define SYNC_IOC_LEGACY_MERGE   _IOWR(SYNC_IOC_MAGIC, 1, \
     struct sync_legacy_merge_data)
 
+struct sync_legacy_fence_info_data {
+ uint32_t len;
+ char name[32];
+ int32_t status;
+};
+
+#define SYNC_IOC_LEGACY_FENCE_INFO  _IOWR(SYNC_IOC_MAGIC, 2, \
+    struct sync_legacy_fence_info_data)
+
 // ---------------------------------------------------------------------------
 // Support for caching the sync uapi version.
 //
@@ -120,6 +130,102 @@ int rga_sync_wait(int fd, int timeout)
     return ret;
 }
 
+static int64_t rga_sync_get_time_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int rga_sync_wait_many(const int *fds, int count, int need, int timeout, int *signaled)
+{
+    struct pollfd *pfds;
+    int *index;
+    int i, ret, pending, done = 0;
+    int64_t deadline = 0, now;
+
+    if (fds == NULL || count <= 0 || need <= 0 || need > count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pfds = (struct pollfd *)malloc(count * (sizeof(*pfds) + sizeof(*index)));
+    if (pfds == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    index = (int *)(pfds + count);
+
+    for (i = 0; i < count; i++) {
+        if (fds[i] < 0) {
+            free(pfds);
+            errno = EINVAL;
+            return -1;
+        }
+
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+        index[i] = i;
+
+        if (signaled)
+            signaled[i] = 0;
+    }
+    pending = count;
+
+    if (timeout > 0)
+        deadline = rga_sync_get_time_ms() + timeout;
+
+    while (done < need) {
+        ret = poll(pfds, pending, timeout);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                goto update_timeout;
+
+            break;
+        } else if (ret == 0) {
+            errno = ETIME;
+            ret = -1;
+            break;
+        }
+
+        /* Move the signaled fds out of the polled range. */
+        for (i = 0; i < pending;) {
+            if (pfds[i].revents == 0) {
+                i++;
+                continue;
+            }
+
+            if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                errno = EINVAL;
+                ret = -1;
+                goto out;
+            }
+
+            if (signaled)
+                signaled[index[i]] = 1;
+            done++;
+
+            pending--;
+            pfds[i] = pfds[pending];
+            index[i] = index[pending];
+        }
+
+update_timeout:
+        if (timeout > 0) {
+            now = rga_sync_get_time_ms();
+            timeout = now >= deadline ? 0 : (int)(deadline - now);
+        }
+    }
+
+out:
+    free(pfds);
+
+    return done >= need ? done : -1;
+}
+
 /* sync merge */
 static int legacy_sync_merge(const char *name, int fd1, int fd2)
 {
@@ -176,13 +282,39 @@ int rga_sync_merge(const char *name, int fd1, int fd2)
     return ret;
 }
 
+/* sync file check, the other fds (eventfd, pipe) do not know the ioctls */
+int rga_sync_is_sync_file(int fd)
+{
+    struct sync_file_info info;
+    struct sync_legacy_fence_info_data legacy_info;
+
+    memset(&info, 0, sizeof(info));
+    if (ioctl(fd, SYNC_IOC_FILE_INFO, &info) == 0)
+        return 1;
+
+    memset(&legacy_info, 0, sizeof(legacy_info));
+    legacy_info.len = sizeof(legacy_info);
+    if (ioctl(fd, SYNC_IOC_LEGACY_FENCE_INFO, &legacy_info) == 0 || errno != ENOTTY)
+        return 1;
+
+    return 0;
+}
+
 #else
 int rga_sync_wait(int fd, int timeout) {
     return -1;
 }
 
+int rga_sync_wait_many(const int *fds, int count, int need, int timeout, int *signaled) {
+    return -1;
+}
+
 int32_t rga_sync_merge(const char* name, int32_t fd1, int32_t fd2) {
     return -1;
 }
+
+int rga_sync_is_sync_file(int fd) {
+    return 0;
+}
 #endif /* #ifndef RGA_SYNC_DISABLE */
 
@@ -22,6 +22,17 @@
 /* timeout in msecs */
 int rga_sync_wait(int fd, int timeout);
 
+/**
+ * Wait until at least 'need' of the 'count' fds are signaled, with one
+ * poll() per wake up. timeout in msecs, -1 means infinite.
+ *
+ * signaled[i] (optional) is set to 1 for each fd that is signaled.
+ *
+ * Returns the number of signaled fds, or -1 with errno set to ETIME on
+ * timeout or EINVAL if one of the fds is in error.
+ */
+int rga_sync_wait_many(const int *fds, int count, int need, int timeout, int *signaled);
+
 /**
  * Merge two sync files.
  *
@@ -39,4 +50,9 @@ int rga_sync_wait(int fd, int timeout);
  */
 int32_t rga_sync_merge(const char* name, int32_t fd1, int32_t fd2);
 
+/**
+ * Returns 1 if fd is a sync file (modern or legacy uapi), 0 otherwise.
+ */
+int rga_sync_is_sync_file(int fd);
+
 #endif
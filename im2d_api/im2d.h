@@ -28,5 +28,7 @@
 #include "im2d_single.h"
 #include "im2d_task.h"
 #include "im2d_mpi.h"
+#include "im2d_plan.h"
+#include "im2d_fence.h"
 
 #endif /* #ifndef _im2d_h_ */
@@ -70,6 +70,28 @@ IM_EXPORT_API rga_buffer_handle_t importbuffer_fd(int fd, im_handle_param_t *par
 IM_EXPORT_API rga_buffer_handle_t importbuffer_virtualaddr(void *va, im_handle_param_t *param);
 IM_EXPORT_API rga_buffer_handle_t importbuffer_physicaladdr(uint64_t pa, im_handle_param_t *param);
 
+/**
+ * Import an array of external buffers into RGA driver with one ioctl.
+ *
+ * @param fds/vas/pas
+ *      Array of dma_fd/virtual_address/physical_address
+ * @param params
+ *      Array of buffer parameters
+ * @param count
+ *      Number of buffers
+ * @param handles
+ *      [out] Array of rga_buffer_handle_t, 0 for each buffer that failed
+ *
+ * @return success if all the buffers are imported, or else negative error
+ *         code, the buffers that did not fail are imported anyway.
+ */
+IM_EXPORT_API IM_STATUS importbuffers_fd(const int *fds, const im_handle_param_t *params,
+                                         int count, rga_buffer_handle_t *handles);
+IM_EXPORT_API IM_STATUS importbuffers_virtualaddr(void * const *vas, const im_handle_param_t *params,
+                                                  int count, rga_buffer_handle_t *handles);
+IM_EXPORT_API IM_STATUS importbuffers_physicaladdr(const uint64_t *pas, const im_handle_param_t *params,
+                                                   int count, rga_buffer_handle_t *handles);
+
 /**
  * Import external buffers into RGA driver.
  *
@@ -80,6 +102,78 @@ IM_EXPORT_API rga_buffer_handle_t importbuffer_physicaladdr(uint64_t pa, im_hand
  */
 IM_EXPORT_API IM_STATUS releasebuffer_handle(rga_buffer_handle_t handle);
 
+/**
+ * Release an array of rga buffer handles with one ioctl.
+ *
+ * @param handles
+ *      Array of rga buffer handles
+ * @param count
+ *      Number of handles
+ *
+ * @return success or else negative error code. If a handle is 0 nothing is
+ *         released, if the driver does not know a handle, the handles
+ *         before it are released and the ones after it are not.
+ */
+IM_EXPORT_API IM_STATUS releasebuffer_handles(const rga_buffer_handle_t *handles, int count);
+
+/**
+ * Create a pool of frames, all the frames are allocated and imported
+ * into RGA driver once here.
+ *
+ * @param param
+ *      The size, format and number of frames, and the heap to allocate from.
+ *
+ * @return frame pool, or NULL on failure.
+ */
+IM_EXPORT_API im_frame_pool_t *imframePoolCreate(const im_frame_pool_param_t *param);
+
+/**
+ * Get a free frame from the pool, lock-free.
+ *
+ * @param pool
+ * @param frame
+ *      [out] The frame, wrapped with its handle. vir_addr is mapped for CPU
+ *      access, and fd is the dma-buf fd (-1 for the memfd heap).
+ *
+ * @return success or else negative error code, IM_STATUS_OUT_OF_MEMORY if
+ *         all the frames are in use.
+ */
+IM_EXPORT_API IM_STATUS imframePoolAcquire(im_frame_pool_t *pool, rga_buffer_t *frame);
+
+/**
+ * Return a frame got by imframePoolAcquire() to the pool, lock-free.
+ * The tasks using the frame must be completed.
+ *
+ * @param pool
+ * @param frame
+ *
+ * @return success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imframePoolReturn(im_frame_pool_t *pool, const rga_buffer_t *frame);
+
+/**
+ * Release the handles and free the frames of the pool.
+ *
+ * @param pool
+ *
+ * @return success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imframePoolRelease(im_frame_pool_t *pool);
+
+/**
+ * Release the buffers imported by the import cache, see
+ * IM_CONFIG_IMPORT_CACHE. A virtual address must be released before the
+ * memory is freed, a dma-buf fd may be released to drop the reference
+ * the cache holds on the dma-buf.
+ *
+ * @param fd/va
+ *      The fd or virtual address used in the tasks.
+ *
+ * @return success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS releasebuffer_cache_fd(int fd);
+IM_EXPORT_API IM_STATUS releasebuffer_cache_virtualaddr(void *va);
+
 /**
  * Wrap image Parameters.
  *
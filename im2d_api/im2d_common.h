@@ -123,6 +123,46 @@ IM_API IM_STATUS imcheckHeader(im_api_version_t header_version = RGA_CURRENT_API
     })
 IM_C_API IM_STATUS imcheck_t(const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
                              const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect, const int mode_usage);
+
+/**
+ * Get the statistics of the parameter check cache of the current thread.
+ * Successful checks with the same parameters are cached and skipped.
+ *
+ * @param hit
+ *      Number of checks that were answered by the cache.
+ * @param miss
+ *      Number of checks that ran in full.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imcheckCacheStat(uint64_t *hit, uint64_t *miss);
+
+/**
+ * Get the per-core statistics of the adaptive scheduler, see
+ * IM_CONFIG_ADAPTIVE_SCHEDULER. The statistics are shared by all the threads.
+ *
+ * @param stats
+ *      [out] One entry per IM_SCHEDULER_CORE bit, in bit order.
+ * @param count
+ *      [in/out] Number of entries of stats, set to the number written.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imschedulerStat(im_scheduler_stat_t *stats, int *count);
+
+/**
+ * Get the hit/miss counters of the import cache, see IM_CONFIG_IMPORT_CACHE.
+ * The counters are shared by all the threads.
+ *
+ * @param hit
+ *      [out] Number of buffers found in the cache.
+ * @param miss
+ *      [out] Number of buffers imported.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imimportCacheStat(uint64_t *hit, uint64_t *miss);
+
 /* Compatible with the legacy symbol */
 IM_C_API void rga_check_perpare(rga_buffer_t *src, rga_buffer_t *dst, rga_buffer_t *pat,
                                 im_rect *src_rect, im_rect *dst_rect, im_rect *pat_rect, int mode_usage);
@@ -137,6 +177,46 @@ IM_C_API void rga_check_perpare(rga_buffer_t *src, rga_buffer_t *dst, rga_buffer
  */
 IM_EXPORT_API IM_STATUS imsync(int release_fence_fd);
 
+/**
+ * Wait for a set of release fences with one poll per wake up.
+ * Unlike imsync(), the fences are not closed.
+ *
+ * @param fence_fds
+ *      RGA job release fence fd array.
+ * @param count
+ *      Number of fences in fence_fds.
+ * @param mode
+ *      IM_SYNC_WAIT_ALL/IM_SYNC_WAIT_ANY/IM_SYNC_WAIT_FIRST_K.
+ * @param k
+ *      Number of fences to wait for, only used by IM_SYNC_WAIT_FIRST_K.
+ * @param timeout_ms
+ *      Maximum time to wait in milliseconds, -1 means infinite.
+ * @param signaled
+ *      [optional] Array of count entries, set to 1 for each fence that is
+ *      signaled and 0 otherwise.
+ *
+ * @returns success, IM_STATUS_TIMEOUT if the fences are not signaled
+ *          within timeout_ms, or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imsyncMany(const int *fence_fds, int count, IM_SYNC_WAIT_MODE mode,
+                                   int k, int timeout_ms, int *signaled);
+
+/**
+ * Submit the tasks deferred by IM_CONFIG_DEFERRED_SUBMIT on the current
+ * thread. The fences returned by the deferred calls are signaled when
+ * their batch is done, also when it failed, only imflush() reports the
+ * failure.
+ *
+ * @param release_fence_fd
+ *      [out] One fence for all the tasks deferred since the last imflush(),
+ *      -1 if they are already done, wait for it with imsync().
+ *      NULL to block until they are done.
+ *
+ * @returns success or else negative error code, including the failure of
+ *          a batch submitted before by the deferred calls.
+ */
+IM_EXPORT_API IM_STATUS imflush(int *release_fence_fd);
+
 /**
  * config
  *
@@ -148,4 +228,84 @@ IM_EXPORT_API IM_STATUS imsync(int release_fence_fd);
  */
 IM_EXPORT_API IM_STATUS imconfig(IM_CONFIG_NAME name, uint64_t value);
 
+/**
+ * Create a configuration context, e.g. one per stream. All the configs are
+ * set to their default value.
+ *
+ * @returns context, or NULL on failure.
+ */
+IM_EXPORT_API im_context_t *imcontextCreate(void);
+
+/**
+ * Set a config of a context, the same as imconfig() does for the calling
+ * thread. IM_CONFIG_LOG_REFRESH, IM_CONFIG_THREAD_SESSION and
+ * IM_CONFIG_DEFERRED_SUBMIT only apply to threads.
+ *
+ * @param context
+ * @param name
+ *      enum IM_CONFIG_NAME
+ * @param value
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imcontextConfig(im_context_t *context, IM_CONFIG_NAME name, uint64_t value);
+
+/**
+ * Release a context created by imcontextCreate().
+ *
+ * @param context
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imcontextRelease(im_context_t *context);
+
+/**
+ * Use the configs of a context on the calling thread, until the matching
+ * imcontextPop(). The configs are copied, imconfig() calls made meanwhile
+ * are undone by imcontextPop(). Pushes can be nested.
+ *
+ * @param context
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imcontextPush(const im_context_t *context);
+
+/**
+ * Restore the configs of the calling thread saved by imcontextPush().
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imcontextPop(void);
+
+/**
+ * Process an image with the configs of a context.
+ *
+ * @param context
+ * @param src
+ *      The input source image.
+ * @param dst
+ *      The output destination image.
+ * @param pat
+ *      The foreground image, or a LUT table.
+ * @param srect
+ *      The rectangle on the src channel image that needs to be processed.
+ * @param drect
+ *      The rectangle on the dst channel image that needs to be processed.
+ * @param prect
+ *      The rectangle on the pat channel image that needs to be processed.
+ * @param acquire_fence_fd
+ * @param release_fence_fd
+ * @param opt
+ *      The image processing options configuration.
+ * @param usage
+ *      The image processing usage.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS improcessContext(const im_context_t *context,
+                                         rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                         im_rect srect, im_rect drect, im_rect prect,
+                                         int acquire_fence_fd, int *release_fence_fd,
+                                         im_opt_t *opt, int usage);
+
 #endif /* #ifndef _im2d_common_h_ */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _im2d_fence_h_
+#define _im2d_fence_h_
+
+#include "im2d_type.h"
+
+/**
+ * Watch a release fence, the callback is called once the fence is signaled.
+ *
+ * The callbacks are called from imfencePoll(), or from the reactor thread
+ * started by imfenceReactorStart(). The fence is owned by the reactor from
+ * now on, and is closed after the callback returns.
+ *
+ * @param fence_fd
+ *      The release fence fd, any pollable fd can be used.
+ * @param callback
+ *      Called with the fence fd, IM_STATUS_SUCCESS or IM_STATUS_FAILED
+ *      (fence error), and the userdata.
+ * @param userdata
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceWatch(int fence_fd, im_fence_callback_t callback, void *userdata);
+
+/**
+ * Wait for watched fences and call their callbacks in the calling thread.
+ *
+ * @param timeout_ms
+ *      Maximum time to wait in milliseconds, -1 means infinite, 0 returns
+ *      immediately.
+ *
+ * @returns the number of callbacks called, or else negative error code.
+ */
+IM_EXPORT_API int imfencePoll(int timeout_ms);
+
+/**
+ * Start a reactor thread that calls the callbacks of the watched fences.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceReactorStart(void);
+
+/**
+ * Stop the reactor thread, the fences still watched are kept and can be
+ * handled by imfencePoll(). Must not be called from a callback.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceReactorStop(void);
+
+/**
+ * Process an image asynchronously, the callback is called on completion.
+ *
+ * @param src
+ *      The input source image.
+ * @param dst
+ *      The output destination image.
+ * @param pat
+ *      The foreground image, or a LUT table.
+ * @param srect
+ *      The rectangle on the src channel image that needs to be processed.
+ * @param drect
+ *      The rectangle on the dst channel image that needs to be processed.
+ * @param prect
+ *      The rectangle on the pat channel image that needs to be processed.
+ * @param acquire_fence_fd
+ * @param opt
+ *      The image processing options configuration.
+ * @param usage
+ *      The image processing usage, IM_SYNC is ignored.
+ * @param callback
+ * @param userdata
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS improcessCallback(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                          im_rect srect, im_rect drect, im_rect prect,
+                                          int acquire_fence_fd, im_opt_t *opt, int usage,
+                                          im_fence_callback_t callback, void *userdata);
+
+/**
+ * Submit a job asynchronously, the callback is called on completion.
+ *
+ * @param job_handle
+ *      The job handle created by imbeginJob().
+ * @param acquire_fence_fd
+ * @param callback
+ * @param userdata
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imendJobCallback(im_job_handle_t job_handle, int acquire_fence_fd,
+                                         im_fence_callback_t callback, void *userdata);
+
+/**
+ * Create a fence set, that collects fences and merges them only when
+ * imfenceSetMerge() is called.
+ *
+ * @returns fence set, or NULL on failure.
+ */
+IM_EXPORT_API im_fence_set_t *imfenceSetCreate(void);
+
+/**
+ * Add a fence to the set, the set takes the ownership of the fence.
+ * A fence that is already signaled is closed immediately.
+ *
+ * @param set
+ * @param fence_fd
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceSetAdd(im_fence_set_t *set, int fence_fd);
+
+/**
+ * Merge the pending fences of the set into one fence, the set is empty
+ * afterwards and can be reused.
+ *
+ * @param set
+ * @param fence_fd
+ *      [out] The merged fence, owned by the caller, or -1 if all the fences
+ *      are already signaled.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceSetMerge(im_fence_set_t *set, int *fence_fd);
+
+/**
+ * Release the fence set and close the fences it still holds.
+ *
+ * @param set
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imfenceSetRelease(im_fence_set_t *set);
+
+#endif /* #ifndef _im2d_fence_h_ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _im2d_plan_h_
+#define _im2d_plan_h_
+
+#include "im2d_type.h"
+
+/**
+ * Create a prepared operation plan.
+ *
+ * The buffers are only used as templates: the format, size, stride and the
+ * buffer type (handle/fd/virtual address/physical address) must be the same
+ * on every execution, only the buffer itself may change.
+ * The request is validated and generated once here, improcessPlan() then
+ * only replaces the buffer addresses.
+ *
+ * @param src
+ *      The input source image template.
+ * @param dst
+ *      The output destination image template.
+ * @param pat
+ *      The foreground image template, or a LUT table.
+ * @param srect
+ *      The rectangle on the src channel image that needs to be processed.
+ * @param drect
+ *      The rectangle on the dst channel image that needs to be processed.
+ * @param prect
+ *      The rectangle on the pat channel image that needs to be processed.
+ * @param opt
+ *      The image processing options configuration.
+ * @param usage
+ *      The image processing usage.
+ *
+ * @returns plan, or NULL on failure.
+ */
+IM_EXPORT_API im_plan_t *imcreatePlan(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                      im_rect srect, im_rect drect, im_rect prect,
+                                      im_opt_t *opt, int usage);
+
+/**
+ * Execute a prepared operation plan.
+ *
+ * @param plan
+ *      The plan created by imcreatePlan().
+ * @param src
+ *      The input source image.
+ * @param dst
+ *      The output destination image.
+ * @param pat
+ *      The foreground image, or a LUT table.
+ * @param acquire_fence_fd
+ * @param release_fence_fd
+ *      Only valid when the plan was created with IM_ASYNC usage.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS improcessPlan(im_plan_t *plan,
+                                      rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                      int acquire_fence_fd, int *release_fence_fd);
+
+/**
+ * Add a prepared operation plan to a job.
+ *
+ * @param job_handle
+ *      Insert the task into the job handle.
+ * @param plan
+ *      The plan created by imcreatePlan().
+ * @param src
+ *      The input source image.
+ * @param dst
+ *      The output destination image.
+ * @param pat
+ *      The foreground image, or a LUT table.
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS improcessPlanTask(im_job_handle_t job_handle, im_plan_t *plan,
+                                          rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat);
+
+/**
+ * Release a prepared operation plan.
+ *
+ * @param plan
+ *      The plan created by imcreatePlan().
+ *
+ * @returns success or else negative error code.
+ */
+IM_EXPORT_API IM_STATUS imreleasePlan(im_plan_t *plan);
+
+#endif /* #ifndef _im2d_plan_h_ */
@@ -28,7 +28,9 @@
  * @param flags
  *      Some configuration flags for this job
  *
- * @returns job handle.
+ * @returns job handle, or 0 or a negative IM_STATUS cast to im_job_handle_t
+ *          on failure, IM_STATUS_OUT_OF_MEMORY when no more jobs can be
+ *          allocated.
  */
 IM_API im_job_handle_t imbeginJob(uint64_t flags = 0);
 
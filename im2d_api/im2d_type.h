@@ -43,6 +43,10 @@
 typedef uint32_t im_api_version_t;
 typedef uint32_t im_job_handle_t;
 typedef uint32_t im_ctx_id_t;
+typedef struct im_plan im_plan_t;
+typedef struct im_fence_set im_fence_set_t;
+typedef struct im_context im_context_t;
+typedef struct im_frame_pool im_frame_pool_t;
 typedef uint32_t rga_buffer_handle_t;
 
 typedef enum {
@@ -193,8 +197,50 @@ typedef enum {
     IM_CONFIG_SCHEDULER_CORE,
     IM_CONFIG_PRIORITY,
     IM_CONFIG_CHECK,
+    IM_CONFIG_LOG_REFRESH,      /* re-read the log enable/level property, value is ignored */
+    IM_CONFIG_THREAD_SESSION,   /* use a private device fd for the current thread, value is bool */
+    IM_CONFIG_DEFERRED_SUBMIT,  /* batch async single-task calls of the current thread, their fences
+                                 * are signaled with the batch, value is the longest time in us the
+                                 * batch waits for more calls before it is submitted, 0 to disable */
+    IM_CONFIG_STRIPE_SPLIT,     /* split large tasks of the current thread into stripes run in
+                                 * parallel, value is the IM_SCHEDULER_CORE mask, 0 to disable */
+    IM_CONFIG_ADAPTIVE_SCHEDULER, /* give the single tasks of the current thread to the least loaded
+                                   * core that can run them, value is the IM_SCHEDULER_CORE mask to
+                                   * select from, 0 to disable */
+    IM_CONFIG_IMPORT_CACHE,     /* import the fd buffers of all the threads on first use, value is
+                                 * the max number of buffers | IM_IMPORT_CACHE_FLAG, 0 to disable */
+    IM_CONFIG_BACKEND,          /* run the tasks of the current thread on the IM_BACKEND */
+    IM_CONFIG_TILE_INEXACT,     /* also tile the operations of the current thread whose tile seams
+                                 * may differ from an untiled operation, value is bool */
 } IM_CONFIG_NAME;
 
+/* value of IM_CONFIG_CHECK */
+typedef enum {
+    IM_CHECK_MODE_DEFAULT       = 0,    /* same as IM_CHECK_MODE_FULL */
+    IM_CHECK_MODE_FULL          = 1,    /* feature/format/align/scale/blend/rotate check */
+    IM_CHECK_MODE_CHEAP         = 2,    /* only bounds and format check */
+    IM_CHECK_MODE_OFF           = 3,    /* trusted, re-validate only when the task failed */
+} IM_CHECK_MODE;
+
+/* value of IM_CONFIG_IMPORT_CACHE */
+typedef enum {
+    IM_IMPORT_CACHE_SIZE_MASK       = 0xffff,
+    IM_IMPORT_CACHE_VIRTUAL_ADDR    = 0x1 << 16,    /* also cache the virtual address buffers */
+} IM_IMPORT_CACHE_FLAG;
+
+/* value of IM_CONFIG_BACKEND */
+typedef enum {
+    IM_BACKEND_HARDWARE         = 0,    /* RGA device */
+    IM_BACKEND_CPU              = 1,    /* CPU reference implementation, no device required */
+} IM_BACKEND;
+
+/* mode of imsyncMany() */
+typedef enum {
+    IM_SYNC_WAIT_ALL            = 0,    /* all fences are signaled */
+    IM_SYNC_WAIT_ANY            = 1,    /* at least one fence is signaled */
+    IM_SYNC_WAIT_FIRST_K        = 2,    /* at least k fences are signaled */
+} IM_SYNC_WAIT_MODE;
+
 typedef enum {
     IM_OSD_MODE_STATISTICS      = 0x1 << 0,
     IM_OSD_MODE_AUTO_INVERT     = 0x1 << 1,
@@ -280,6 +326,7 @@ typedef enum {
     IM_ERROR_ILLEGAL_PARAM,
     IM_ERROR_ERROR_VERSION,
     IM_ERROR_NO_SESSION,
+    IM_ERROR_TIMEOUT,
     IM_ERROR_MAX,
 } IM_ERROR_INDEX;
 
@@ -293,9 +340,13 @@ typedef enum {
     IM_STATUS_ILLEGAL_PARAM     = -IM_ERROR_ILLEGAL_PARAM,
     IM_STATUS_ERROR_VERSION     = -IM_ERROR_ERROR_VERSION,
     IM_STATUS_NO_SESSION        = -IM_ERROR_NO_SESSION,
+    IM_STATUS_TIMEOUT           = -IM_ERROR_TIMEOUT,
     IM_STATUS_FAILED            = -IM_ERROR_FAILED,
 } IM_STATUS;
 
+/* Called once the watched fence is signaled, see imfenceWatch() */
+typedef void (*im_fence_callback_t)(int fence_fd, IM_STATUS status, void *userdata);
+
 /* Rectangle definition */
 typedef struct {
     int x;        /* upper-left x */
@@ -495,6 +546,28 @@ typedef struct im_handle_param {
     uint32_t format;
 } im_handle_param_t;
 
+#define IM_FRAME_POOL_HEAP_DEFAULT  "/dev/dma_heap/system-uncached-dma32"
+#define IM_FRAME_POOL_HEAP_MEMFD    "memfd"     /* memfd stand-in heap, imported by virtual address */
+
+typedef struct im_frame_pool_param {
+    int width;
+    int height;
+    int format;
+    int wstride;                    /* 0: same as width */
+    int hstride;                    /* 0: same as height */
+    int count;                      /* number of frames */
+    const char *heap;               /* dma-heap device path, NULL: IM_FRAME_POOL_HEAP_DEFAULT */
+} im_frame_pool_param_t;
+
+typedef struct im_scheduler_stat {
+    IM_SCHEDULER_CORE core;
+    uint64_t task_count;            /* tasks given to the core */
+    uint64_t bytes;                 /* estimated bytes moved by these tasks */
+    uint64_t unsupported_count;     /* tasks the core was a candidate for but cannot run */
+    uint64_t inflight_bytes;        /* estimated bytes of the tasks not completed yet */
+    int inflight_count;             /* tasks not completed yet */
+} im_scheduler_stat_t;
+
 #define IM_INTERP_HORIZ(x) ( ((x) & IM_INTERP_MASK) << IM_INTERP_HORIZ_SHIFT | IM_INTERP_HORIZ_FLAG )
 #define IM_INTERP_VERTI(x) ( ((x) & IM_INTERP_MASK) << IM_INTERP_VERTI_SHIFT | IM_INTERP_VERTI_FLAG )
 #define IM_INTERP(h,v) ( IM_INTERP_HORIZ(h) | IM_INTERP_VERTI(v) )
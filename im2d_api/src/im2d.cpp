@@ -25,9 +25,11 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -84,6 +86,7 @@ IM_API const char* imStrError_t(IM_STATUS status) {
         "Illegal parameters",
         "Version verification failed",
         "No session",
+        "Timed out",
     };
     static RGA_THREAD_LOCAL char error_str[IM_ERR_MSG_LEN] = "The current error message is empty!";
     const char *ptr = NULL;
@@ -123,6 +126,10 @@ IM_API const char* imStrError_t(IM_STATUS status) {
             ptr = error_type[IM_ERROR_NO_SESSION];
             break;
 
+        case IM_STATUS_TIMEOUT :
+            ptr = error_type[IM_ERROR_TIMEOUT];
+            break;
+
         default :
             return "unkown status";
     }
@@ -182,6 +189,49 @@ IM_API IM_STATUS releasebuffer_handle(rga_buffer_handle_t handle) {
     return rga_release_buffer(handle);
 }
 
+IM_API IM_STATUS importbuffers_fd(const int *fds, const im_handle_param_t *params,
+                                  int count, rga_buffer_handle_t *handles) {
+    return rga_import_buffer_array(fds, RGA_DMA_BUFFER, params, count, handles);
+}
+
+IM_API IM_STATUS importbuffers_virtualaddr(void * const *vas, const im_handle_param_t *params,
+                                           int count, rga_buffer_handle_t *handles) {
+    return rga_import_buffer_array(vas, RGA_VIRTUAL_ADDRESS, params, count, handles);
+}
+
+IM_API IM_STATUS importbuffers_physicaladdr(const uint64_t *pas, const im_handle_param_t *params,
+                                            int count, rga_buffer_handle_t *handles) {
+    return rga_import_buffer_array(pas, RGA_PHYSICAL_ADDRESS, params, count, handles);
+}
+
+IM_API IM_STATUS releasebuffer_handles(const rga_buffer_handle_t *handles, int count) {
+    return rga_release_buffer_array(handles, count);
+}
+
+IM_API im_frame_pool_t *imframePoolCreate(const im_frame_pool_param_t *param) {
+    return rga_frame_pool_create(param);
+}
+
+IM_API IM_STATUS imframePoolAcquire(im_frame_pool_t *pool, rga_buffer_t *frame) {
+    return rga_frame_pool_acquire(pool, frame);
+}
+
+IM_API IM_STATUS imframePoolReturn(im_frame_pool_t *pool, const rga_buffer_t *frame) {
+    return rga_frame_pool_release(pool, frame);
+}
+
+IM_API IM_STATUS imframePoolRelease(im_frame_pool_t *pool) {
+    return rga_frame_pool_destroy(pool);
+}
+
+IM_API IM_STATUS releasebuffer_cache_fd(int fd) {
+    return rga_import_cache_release(RGA_DMA_BUFFER, (uint64_t)fd);
+}
+
+IM_API IM_STATUS releasebuffer_cache_virtualaddr(void *va) {
+    return rga_import_cache_release(RGA_VIRTUAL_ADDRESS, ptr_to_u64(va));
+}
+
 static inline void set_default_rga_buffer(rga_buffer_t *buffer,
                                           int width, int height, int format,
                                           int wstride, int hstride) {
@@ -848,6 +898,9 @@ IM_API IM_STATUS imsync(int fence_fd) {
         return IM_STATUS_ILLEGAL_PARAM;
     }
 
+    /* the fence may belong to a batch deferred by this thread */
+    rga_deferred_kick();
+
     ret = rga_sync_wait(fence_fd, -1);
     if (ret) {
         IM_LOGE("Failed to wait for out fence = %d, ret = %d", fence_fd, ret);
@@ -859,41 +912,132 @@ IM_API IM_STATUS imsync(int fence_fd) {
     return IM_STATUS_SUCCESS;
 }
 
-IM_API IM_STATUS imconfig(IM_CONFIG_NAME name, uint64_t value) {
+IM_API IM_STATUS imsyncMany(const int *fence_fds, int count, IM_SYNC_WAIT_MODE mode,
+                            int k, int timeout_ms, int *signaled) {
+    int ret, need;
 
-    switch (name) {
-        case IM_CONFIG_SCHEDULER_CORE :
-            if (value & IM_SCHEDULER_MASK) {
-                g_im2d_context.core = (IM_SCHEDULER_CORE)value;
-            } else {
-                IM_LOGE("IM2D: It's not legal rga_core[0x%lx], it needs to be a 'IM_SCHEDULER_CORE'.", (unsigned long)value);
+    if (fence_fds == NULL || count <= 0) {
+        IM_LOGE("illegal fence array[%p], count = %d", fence_fds, count);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    switch (mode) {
+        case IM_SYNC_WAIT_ALL:
+            need = count;
+            break;
+        case IM_SYNC_WAIT_ANY:
+            need = 1;
+            break;
+        case IM_SYNC_WAIT_FIRST_K:
+            if (k <= 0 || k > count) {
+                IM_LOGE("illegal k[%d], it needs to be in the range of 1~%d", k, count);
                 return IM_STATUS_ILLEGAL_PARAM;
             }
+            need = k;
+            break;
+        default:
+            IM_LOGE("illegal sync wait mode[%d]", mode);
+            return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    rga_deferred_kick();
+
+    ret = rga_sync_wait_many(fence_fds, count, need, timeout_ms, signaled);
+    if (ret < 0 && errno == ETIME) {
+        IM_LOGD("wait for %d/%d fences timed out after %d ms", need, count, timeout_ms);
+        return IM_STATUS_TIMEOUT;
+    } else if (ret < 0) {
+        IM_LOGE("Failed to wait for %d/%d fences, timeout = %d, %s",
+                need, count, timeout_ms, strerror(errno));
+        return IM_STATUS_FAILED;
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_API IM_STATUS imflush(int *release_fence_fd) {
+    return rga_deferred_flush(release_fence_fd);
+}
+
+IM_API IM_STATUS imconfig(IM_CONFIG_NAME name, uint64_t value) {
+
+    switch (name) {
+        case IM_CONFIG_LOG_REFRESH :
+            update_debug_state();
             break;
-        case IM_CONFIG_PRIORITY :
-            if (value <= 6) {
-                g_im2d_context.priority = (int)value;
+        case IM_CONFIG_THREAD_SESSION :
+            if (value == false || value == true) {
+                return (IM_STATUS)rga_thread_session_config((bool)value);
             } else {
-                IM_LOGE("IM2D: It's not legal priority[0x%lx], it needs to be a 'int', and it should be in the range of 0~6.", (unsigned long)value);
+                IM_LOGE("IM2D: It's not legal thread session config[0x%lx], it needs to be a 'bool'.", (unsigned long)value);
                 return IM_STATUS_ILLEGAL_PARAM;
             }
             break;
-        case IM_CONFIG_CHECK :
-            if (value == false || value == true) {
-                g_im2d_context.check_mode = (bool)value;
+        case IM_CONFIG_DEFERRED_SUBMIT :
+            return rga_deferred_config(value);
+        case IM_CONFIG_IMPORT_CACHE :
+            return rga_import_cache_config(value);
+        case IM_CONFIG_BACKEND :
+            if (value == IM_BACKEND_HARDWARE) {
+                return (IM_STATUS)rga_thread_backend_config(RGA_SESSION_BACKEND_HW);
+            } else if (value == IM_BACKEND_CPU) {
+                return (IM_STATUS)rga_thread_backend_config(RGA_SESSION_BACKEND_CPU);
             } else {
-                IM_LOGE("IM2D: It's not legal check config[0x%lx], it needs to be a 'bool'.", (unsigned long)value);
+                IM_LOGE("IM2D: It's not legal backend config[0x%lx], it needs to be a 'IM_BACKEND'.", (unsigned long)value);
                 return IM_STATUS_ILLEGAL_PARAM;
             }
-            break;
         default :
-            IM_LOGE("IM2D: Unsupported config name!");
-            return IM_STATUS_NOT_SUPPORTED;
+            return rga_context_config(&g_im2d_context, name, value);
     }
 
     return IM_STATUS_SUCCESS;
 }
 
+IM_API im_context_t *imcontextCreate(void) {
+    return rga_context_create();
+}
+
+IM_API IM_STATUS imcontextConfig(im_context_t *context, IM_CONFIG_NAME name, uint64_t value) {
+    if (context == NULL) {
+        IM_LOGE("context is NULL!\n");
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    return rga_context_config(context, name, value);
+}
+
+IM_API IM_STATUS imcontextRelease(im_context_t *context) {
+    return rga_context_release(context);
+}
+
+IM_API IM_STATUS imcontextPush(const im_context_t *context) {
+    return rga_context_push(context);
+}
+
+IM_API IM_STATUS imcontextPop(void) {
+    return rga_context_pop();
+}
+
+IM_API IM_STATUS improcessContext(const im_context_t *context,
+                                  rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                  im_rect srect, im_rect drect, im_rect prect,
+                                  int acquire_fence_fd, int *release_fence_fd,
+                                  im_opt_t *opt_ptr, int usage) {
+    IM_STATUS ret;
+
+    ret = rga_context_push(context);
+    if (ret != IM_STATUS_SUCCESS)
+        return ret;
+
+    ret = rga_single_task_submit(src, dst, pat, srect, drect, prect,
+                                 acquire_fence_fd, release_fence_fd,
+                                 opt_ptr, usage);
+
+    rga_context_pop();
+
+    return ret;
+}
+
 /* Start single task api */
 IM_API IM_STATUS imcopy(const rga_buffer_t src, rga_buffer_t dst, int sync, int *release_fence_fd) {
     int usage = 0;
@@ -1288,27 +1432,24 @@ IM_API IM_STATUS immosaic(const rga_buffer_t image, im_rect rect, int mosaic_mod
 }
 
 IM_STATUS immosaicArray(rga_buffer_t dst, im_rect *rect_array, int array_size, int mosaic_mode, int sync, int *release_fence_fd) {
-    IM_STATUS ret;
-    int tmp_fence_fd = -1;
+    int usage = 0;
+    im_opt_t opt = {};
+    rga_buffer_t tmp_image;
 
-    for (int i = 0; i < array_size; i++) {
-        ret = immosaic(dst, rect_array[i], mosaic_mode, sync, release_fence_fd);
-        if (ret != IM_STATUS_SUCCESS)
-            return ret;
+    memset(&tmp_image, 0x0, sizeof(tmp_image));
 
-        if (sync == 0 && release_fence_fd) {
-            if (*release_fence_fd >= 0 && tmp_fence_fd >= 0) {
-                tmp_fence_fd = rga_sync_merge("mosaic_array", tmp_fence_fd, *release_fence_fd);
-            } else if (*release_fence_fd >= 0) {
-                tmp_fence_fd = *release_fence_fd;
-            }
-        }
-    }
+    usage |= IM_MOSAIC;
 
-    if (release_fence_fd)
-        *release_fence_fd = tmp_fence_fd;
+    opt.version = RGA_CURRENT_API_VERSION;
+    opt.mosaic_mode = mosaic_mode;
 
-    return IM_STATUS_SUCCESS;
+    if (sync == 0)
+        usage |= IM_ASYNC;
+    else if (sync == 1)
+        usage |= IM_SYNC;
+
+    return rga_rect_array_submit(dst, dst, tmp_image, rect_array, array_size, true,
+                                 release_fence_fd, &opt, usage);
 }
 
 IM_API IM_STATUS imgaussianBlur(rga_buffer_t src, rga_buffer_t dst,
@@ -1405,67 +1546,78 @@ IM_API IM_STATUS imfill(rga_buffer_t dst, im_rect rect, int color, int sync, int
 }
 
 IM_STATUS imfillArray(rga_buffer_t dst, im_rect *rect_array, int array_size, uint32_t color, int sync, int *release_fence_fd) {
-    IM_STATUS ret;
-    int tmp_fence_fd = -1;
+    int usage = 0;
+    im_opt_t opt = {};
+    rga_buffer_t pat;
+    rga_buffer_t src;
 
-    for (int i = 0; i < array_size; i++) {
-        ret = imfill(dst, rect_array[i], color, sync, release_fence_fd);
-        if (ret != IM_STATUS_SUCCESS)
-            return ret;
+    memset(&pat, 0x0, sizeof(pat));
+    memset(&src, 0x0, sizeof(src));
 
-        if (sync == 0 && release_fence_fd) {
-            if (*release_fence_fd >= 0 && tmp_fence_fd >= 0) {
-                tmp_fence_fd = rga_sync_merge("fill_array", tmp_fence_fd, *release_fence_fd);
-            } else if (*release_fence_fd >= 0) {
-                tmp_fence_fd = *release_fence_fd;
-            }
-        }
-    }
+    usage |= IM_COLOR_FILL;
 
-    if (release_fence_fd)
-        *release_fence_fd = tmp_fence_fd;
+    opt.color = color;
 
-    return IM_STATUS_SUCCESS;
+    if (sync == 0)
+        usage |= IM_ASYNC;
+    else if (sync == 1)
+        usage |= IM_SYNC;
+
+    return rga_rect_array_submit(src, dst, pat, rect_array, array_size, false,
+                                 release_fence_fd, &opt, usage);
 }
 
-IM_STATUS imrectangle(rga_buffer_t dst, im_rect rect, uint32_t color, int thickness, int sync, int *release_fence_fd) {
-    if (thickness < 0)
-        return imfill(dst, rect, color, sync, release_fence_fd);
+/* Split the border of rect into 4 fill rects, returns the number of rects. */
+static int rectangle_to_fill_rects(im_rect rect, int thickness, im_rect *fill_rect) {
+    if (thickness < 0) {
+        fill_rect[0] = rect;
+        return 1;
+    }
 
     int h_length = rect.width;
     int v_length = rect.height - 2 * thickness;
-    im_rect fill_rect[4] = {};
 
     fill_rect[0] = (im_rect){rect.x, rect.y, h_length, thickness};
     fill_rect[1] = (im_rect){rect.x, rect.y + (rect.height - thickness), h_length, thickness};
     fill_rect[2] = (im_rect){rect.x, rect.y + thickness, thickness, v_length};
     fill_rect[3] = (im_rect){rect.x + (rect.width - thickness), rect.y + thickness, thickness, v_length};
 
-    return imfillArray(dst, fill_rect, 4, color, sync, release_fence_fd);
+    return 4;
+}
+
+IM_STATUS imrectangle(rga_buffer_t dst, im_rect rect, uint32_t color, int thickness, int sync, int *release_fence_fd) {
+    int count;
+    im_rect fill_rect[4] = {};
+
+    count = rectangle_to_fill_rects(rect, thickness, fill_rect);
+
+    return imfillArray(dst, fill_rect, count, color, sync, release_fence_fd);
 }
 
 IM_STATUS imrectangleArray(rga_buffer_t dst, im_rect *rect_array, int array_size, uint32_t color, int thickness, int sync, int *release_fence_fd) {
     IM_STATUS ret;
-    int tmp_fence_fd = -1;
+    int count = 0;
+    im_rect *fill_rect;
 
-    for (int i = 0; i < array_size; i++) {
-        ret = imrectangle(dst, rect_array[i], color, thickness, sync, release_fence_fd);
-        if (ret != IM_STATUS_SUCCESS)
-            return ret;
+    if (rect_array == NULL || array_size <= 0) {
+        IM_LOGE("illegal rect array[%p], array_size = %d\n", rect_array, array_size);
+        return IM_STATUS_INVALID_PARAM;
+    }
 
-        if (sync == 0 && release_fence_fd) {
-            if (*release_fence_fd >= 0 && tmp_fence_fd >= 0) {
-                tmp_fence_fd = rga_sync_merge("rectangle_array", tmp_fence_fd, *release_fence_fd);
-            } else if (*release_fence_fd >= 0) {
-                tmp_fence_fd = *release_fence_fd;
-            }
-        }
+    fill_rect = (im_rect *)malloc(array_size * 4 * sizeof(im_rect));
+    if (fill_rect == NULL) {
+        IM_LOGE("alloc fill rect array[%d] failed!\n", array_size * 4);
+        return IM_STATUS_OUT_OF_MEMORY;
     }
 
-    if (release_fence_fd)
-        *release_fence_fd = tmp_fence_fd;
+    for (int i = 0; i < array_size; i++)
+        count += rectangle_to_fill_rects(rect_array[i], thickness, fill_rect + count);
 
-    return IM_STATUS_SUCCESS;
+    ret = imfillArray(dst, fill_rect, count, color, sync, release_fence_fd);
+
+    free(fill_rect);
+
+    return ret;
 }
 
 IM_API IM_STATUS improcess(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
@@ -1531,8 +1683,8 @@ IM_STATUS immakeBorder(rga_buffer_t src, rga_buffer_t dst,
     }
 
     job_handle = imbeginJob();
-    if (job_handle <= 0)
-        return IM_STATUS_FAILED;
+    if ((int)job_handle <= 0)
+        return job_handle ? (IM_STATUS)(int)job_handle : IM_STATUS_FAILED;
 
     /* top */
     border_rect[0] = {left, 0, src.width, top};
@@ -1620,8 +1772,8 @@ IM_STATUS immakeBorder(rga_buffer_t src, rga_buffer_t dst,
 
             job_handle = 0;
             job_handle = imbeginJob();
-            if (job_handle <= 0)
-                return IM_STATUS_FAILED;
+            if ((int)job_handle <= 0)
+                return job_handle ? (IM_STATUS)(int)job_handle : IM_STATUS_FAILED;
         }
 
         /* left */
@@ -1674,6 +1826,9 @@ IM_API IM_STATUS imcancelJob(im_job_handle_t job_handle) {
 }
 
 IM_API IM_STATUS imendJob(im_job_handle_t job_handle, int sync_mode, int acquire_fence_fd, int *release_fence_fd) {
+    /* keep the order with the tasks deferred before */
+    rga_deferred_kick();
+
     return rga_job_submit(job_handle, sync_mode, acquire_fence_fd, release_fence_fd);
 }
 
@@ -2041,6 +2196,91 @@ IM_API IM_STATUS improcessTask(im_job_handle_t job_handle,
 /* End task api */
 #endif /* #ifdef __cplusplus */
 
+/* Start plan api */
+IM_API im_plan_t *imcreatePlan(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                               im_rect srect, im_rect drect, im_rect prect,
+                               im_opt_t *opt, int usage) {
+    return rga_plan_create(src, dst, pat, srect, drect, prect, opt, usage);
+}
+
+IM_API IM_STATUS improcessPlan(im_plan_t *plan,
+                               rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                               int acquire_fence_fd, int *release_fence_fd) {
+    return rga_plan_execute(0, plan, src, dst, pat, acquire_fence_fd, release_fence_fd);
+}
+
+IM_API IM_STATUS improcessPlanTask(im_job_handle_t job_handle, im_plan_t *plan,
+                                   rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat) {
+    if (job_handle <= 0) {
+        IM_LOGE("illegal job_handle[%d]\n", job_handle);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    return rga_plan_execute(job_handle, plan, src, dst, pat, -1, NULL);
+}
+
+IM_API IM_STATUS imreleasePlan(im_plan_t *plan) {
+    if (plan == NULL)
+        return IM_STATUS_INVALID_PARAM;
+
+    rga_plan_release(plan);
+
+    return IM_STATUS_SUCCESS;
+}
+/* End plan api */
+
+/* Start fence api */
+IM_API IM_STATUS imfenceWatch(int fence_fd, im_fence_callback_t callback, void *userdata) {
+    return rga_fence_watch(fence_fd, callback, userdata);
+}
+
+IM_API int imfencePoll(int timeout_ms) {
+    return rga_fence_poll(timeout_ms);
+}
+
+IM_API IM_STATUS imfenceReactorStart(void) {
+    return rga_fence_reactor_start();
+}
+
+IM_API IM_STATUS imfenceReactorStop(void) {
+    return rga_fence_reactor_stop();
+}
+
+IM_API IM_STATUS improcessCallback(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                   im_rect srect, im_rect drect, im_rect prect,
+                                   int acquire_fence_fd, im_opt_t *opt, int usage,
+                                   im_fence_callback_t callback, void *userdata) {
+    return rga_fence_task_submit(src, dst, pat, srect, drect, prect,
+                                 acquire_fence_fd, opt, usage, callback, userdata);
+}
+
+IM_API IM_STATUS imendJobCallback(im_job_handle_t job_handle, int acquire_fence_fd,
+                                  im_fence_callback_t callback, void *userdata) {
+    return rga_fence_job_submit(job_handle, acquire_fence_fd, callback, userdata);
+}
+
+IM_API im_fence_set_t *imfenceSetCreate(void) {
+    return rga_fence_set_create();
+}
+
+IM_API IM_STATUS imfenceSetAdd(im_fence_set_t *set, int fence_fd) {
+    return rga_fence_set_add(set, fence_fd);
+}
+
+IM_API IM_STATUS imfenceSetMerge(im_fence_set_t *set, int *fence_fd) {
+    return rga_fence_set_merge(set, fence_fd);
+}
+
+IM_API IM_STATUS imfenceSetRelease(im_fence_set_t *set) {
+    if (set == NULL)
+        return IM_STATUS_INVALID_PARAM;
+
+    rga_fence_set_release(set);
+
+    return IM_STATUS_SUCCESS;
+}
+/* End fence api */
+
 /* for rockit-ko */
 im_ctx_id_t imbegin(uint32_t flags) {
     return rga_job_create(flags);
@@ -2115,6 +2355,18 @@ IM_API IM_STATUS imcheck_t(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
     return rga_check_external(src, dst, pat, src_rect, dst_rect, pat_rect, mode_usage);
 }
 
+IM_API IM_STATUS imcheckCacheStat(uint64_t *hit, uint64_t *miss) {
+    return rga_check_cache_get_stat(hit, miss);
+}
+
+IM_API IM_STATUS imschedulerStat(im_scheduler_stat_t *stats, int *count) {
+    return rga_scheduler_get_stat(stats, count);
+}
+
+IM_API IM_STATUS imimportCacheStat(uint64_t *hit, uint64_t *miss) {
+    return rga_import_cache_get_stat(hit, miss);
+}
+
 IM_API IM_STATUS imresize_t(const rga_buffer_t src, rga_buffer_t dst, double fx, double fy, int interpolation, int sync) {
     return imresize(src, dst, fx, fy, interpolation, sync, NULL);
 }
@@ -23,9 +23,22 @@
 #include <string.h>
 #include <unistd.h>
 
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+
+#if (defined(ANDROID) || defined(ANDROID_VNDK))
+#include <sys/system_properties.h>
+#endif
+
 #include "im2d_log.h"
 #include "im2d_context.h"
 #include "im2d_impl.h"
+#include "im2d_cpu.h"
 
 #include "utils.h"
 
@@ -38,6 +51,23 @@
 
 rga_session_t g_rga_session;
 
+/*
+ * The hardware_info generations are unique in the process, the per-thread
+ * check caches compare them and must not mix up the results of two sessions.
+ */
+static atomic_uint g_hardware_info_generation;
+
+/*
+ * The session used by the current thread, either &g_rga_session once it has
+ * been initialized, or a private session enabled by IM_CONFIG_THREAD_SESSION.
+ */
+static RGA_THREAD_LOCAL rga_session_t *g_thread_session;
+#if !defined(RT_THREAD) && defined(RGA_THREAD_LOCAL_ENABLE)
+static pthread_key_t g_private_session_key;
+/* IM_CONFIG_THREAD_SESSION is enabled, every backend gets a private session */
+static RGA_THREAD_LOCAL bool g_thread_session_enable;
+#endif
+
 static void set_driver_feature(rga_session_t *session) {
     if (rga_version_compare(session->driver_verison, (struct rga_version_t){ 1, 3, 0, {0} }) >= 0)
         session->driver_feature |= RGA_DRIVER_FEATURE_USER_CLOSE_FENCE;
@@ -176,10 +206,31 @@ static void rga_device_exit(rga_session_t *session) {
 }
 #endif
 
-static int rga_session_init(rga_session_t *session) {
+/* ROCKCHIP_RGA_BACKEND/vendor.rga.backend = cpu runs the global session on the CPU */
+static RGA_SESSION_BACKEND rga_backend_property_get(void) {
+#if (defined(ANDROID) || defined(ANDROID_VNDK))
+    char backend[PROP_VALUE_MAX] = { 0 };
+    __system_property_get("vendor.rga.backend", backend);
+#else
+    char *backend = getenv("ROCKCHIP_RGA_BACKEND");
+    if (backend == NULL)
+        backend = (char *)"hw";
+#endif
+
+    return strcmp(backend, "cpu") == 0 ? RGA_SESSION_BACKEND_CPU : RGA_SESSION_BACKEND_HW;
+}
+
+static inline bool rga_session_is_ready(rga_session_t *session) {
+    return session->backend_priv != NULL || session->rga_dev_fd > 0;
+}
+
+static int rga_session_init(rga_session_t *session, RGA_SESSION_BACKEND backend) {
     int ret;
 
-    ret = rga_device_init(session);
+    if (backend == RGA_SESSION_BACKEND_CPU)
+        ret = rga_cpu_session_init(session);
+    else
+        ret = rga_device_init(session);
     if (ret != IM_STATUS_SUCCESS) {
         return ret;
     }
@@ -190,40 +241,53 @@ static int rga_session_init(rga_session_t *session) {
         return ret;
     }
 
+    session->hardware_info_generation = atomic_fetch_add(&g_hardware_info_generation, 1) + 1;
+
     return IM_STATUS_SUCCESS;
 }
 
 static void rga_session_deinit(rga_session_t *session) {
     memset(&session->hardware_info, 0, sizeof(session->hardware_info));
 
-    rga_device_exit(session);
+    if (session->backend == RGA_SESSION_BACKEND_CPU)
+        rga_cpu_session_exit(session);
+    else
+        rga_device_exit(session);
 }
 
-rga_session_t *get_rga_session() {
+int rga_session_ioctl(rga_session_t *session, unsigned long cmd, void *arg) {
+    if (session->backend == RGA_SESSION_BACKEND_CPU)
+        return rga_cpu_ioctl(session, cmd, arg);
+
+    return ioctl(session->rga_dev_fd, cmd, arg);
+}
+
+static rga_session_t *get_global_rga_session() {
     int ret;
     rga_session_t *session =  &g_rga_session;
 
     /* to fast get session, first using rdlock */
     pthread_rwlock_rdlock(&session->rwlock);
-    if (session->rga_dev_fd > 0) {
+    if (rga_session_is_ready(session)) {
         pthread_rwlock_unlock(&session->rwlock);
         return session;
     }
     pthread_rwlock_unlock(&session->rwlock);
 
     pthread_rwlock_wrlock(&session->rwlock);
-    if (session->rga_dev_fd > 0) {
+    if (rga_session_is_ready(session)) {
         pthread_rwlock_unlock(&session->rwlock);
         return session;
     }
 
-    ret = rga_session_init(session);
+    ret = rga_session_init(session, rga_backend_property_get());
     if (ret != IM_STATUS_SUCCESS) {
         pthread_rwlock_unlock(&session->rwlock);
         return (rga_session_t *)ERR_PTR(IM_STATUS_NO_SESSION);
     }
 
     rga_version_update();
+    update_debug_state();
 
     pthread_rwlock_unlock(&session->rwlock);
 
@@ -232,32 +296,364 @@ rga_session_t *get_rga_session() {
     return session;
 }
 
-int get_debug_state(void) {
+rga_session_t *get_rga_session() {
+    rga_session_t *session = g_thread_session;
+
+    /* fast path, no lock once the thread has got its session */
+    if (session != NULL)
+        return session;
+
+    session = get_global_rga_session();
+    if (!IS_ERR(session))
+        g_thread_session = session;
+
+    return session;
+}
+
+#if !defined(RT_THREAD) && defined(RGA_THREAD_LOCAL_ENABLE)
+static void rga_private_session_destroy(void *arg) {
+    rga_session_t *session = (rga_session_t *)arg;
+
+    if (session == NULL || session == &g_rga_session)
+        return;
+
+    /* the batch deferred by the thread may be on this session */
+    rga_deferred_kick();
+
+    if (session->backend == RGA_SESSION_BACKEND_CPU)
+        rga_cpu_session_exit(session);
+    else if (session->rga_dev_fd >= 0)
+        close(session->rga_dev_fd);
+    pthread_rwlock_destroy(&session->rwlock);
+    free(session);
+}
+
+static void rga_private_session_drop(void) {
+    rga_session_t *session = g_thread_session;
+
+    if (session != NULL && session != &g_rga_session) {
+        pthread_setspecific(g_private_session_key, NULL);
+        rga_private_session_destroy(session);
+    }
+
+    g_thread_session = NULL;
+}
+
+/* Replace the session of the thread, the results cached for the previous one are dropped. */
+static void rga_private_session_set(rga_session_t *session) {
+    rga_private_session_drop();
+
+    session->is_private = true;
+
+    pthread_setspecific(g_private_session_key, session);
+    g_thread_session = session;
+
+    rga_check_cache_reset();
+}
+
+/*
+ * A private hardware session only owns a new device fd, the version and
+ * hardware_info are copied from the global session and never updated.
+ * Buffers imported and jobs created through it are released by the driver
+ * when the fd is closed, that is when the thread exits or disables it.
+ */
+static int rga_private_session_share(rga_session_t *global_session) {
+    int fd;
     rga_session_t *session;
-    bool is_debug;
 
-    session = get_rga_session();
+    fd = open(RGA_DEVICE_NODE_PATH, O_RDWR, 0);
+    if (fd < 0) {
+        IM_LOGE("failed to open %s:%s.", RGA_DEVICE_NODE_PATH, strerror(errno));
+        return IM_STATUS_FAILED;
+    }
 
-    pthread_rwlock_wrlock(&session->rwlock);
-    rga_log_level_update();
-    session->is_debug = rga_log_enable_update();
-    is_debug = session->is_debug;
-    pthread_rwlock_unlock(&session->rwlock);
+    session = (rga_session_t *)malloc(sizeof(*session));
+    if (session == NULL) {
+        IM_LOGE("rga session alloc error!\n");
+        close(fd);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
 
-    return is_debug;
+    pthread_rwlock_rdlock(&global_session->rwlock);
+    memcpy(session, global_session, sizeof(*session));
+    pthread_rwlock_unlock(&global_session->rwlock);
+
+    pthread_rwlock_init(&session->rwlock, NULL);
+    session->rga_dev_fd = fd;
+    rga_private_session_set(session);
+
+    return IM_STATUS_SUCCESS;
 }
 
-int is_debug_en(void) {
+/* A private session of the given backend, initialized on its own. */
+static int rga_private_session_create(RGA_SESSION_BACKEND backend) {
+    int ret;
+    rga_session_t *global_session;
     rga_session_t *session;
-    bool is_debug;
 
-    session = get_rga_session();
+    if (backend == RGA_SESSION_BACKEND_HW) {
+        global_session = get_global_rga_session();
+        if (!IS_ERR(global_session) && global_session->backend == RGA_SESSION_BACKEND_HW)
+            return rga_private_session_share(global_session);
+    }
+
+    session = (rga_session_t *)calloc(1, sizeof(*session));
+    if (session == NULL) {
+        IM_LOGE("rga session alloc error!\n");
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
 
-    pthread_rwlock_rdlock(&session->rwlock);
-    is_debug = session->is_debug;
-    pthread_rwlock_unlock(&session->rwlock);
+    pthread_rwlock_init(&session->rwlock, NULL);
+    session->rga_dev_fd = -1;
+
+    ret = rga_session_init(session, backend);
+    if (ret != IM_STATUS_SUCCESS) {
+        rga_private_session_destroy(session);
+        return ret;
+    }
+
+    rga_private_session_set(session);
+
+    return IM_STATUS_SUCCESS;
+}
+
+/*
+ * Give the calling thread a private session of the backend of the global
+ * session, kept until the thread exits or disables it. A later backend
+ * switch of the thread also gets a private session.
+ */
+int rga_thread_session_config(bool enable) {
+    int ret;
+    rga_session_t *global_session;
+    rga_session_t *session = g_thread_session;
+
+    if (!enable) {
+        g_thread_session_enable = false;
+        rga_private_session_drop();
+
+        return IM_STATUS_SUCCESS;
+    }
+
+    g_thread_session_enable = true;
+
+    if (session != NULL && session->is_private)
+        return IM_STATUS_SUCCESS;
+
+    global_session = get_global_rga_session();
+    if (IS_ERR(global_session)) {
+        g_thread_session_enable = false;
+        return PTR_ERR(global_session);
+    }
+
+    ret = rga_private_session_create(global_session->backend);
+    if (ret != IM_STATUS_SUCCESS)
+        g_thread_session_enable = false;
+
+    return ret;
+}
+
+/*
+ * Run the tasks of the calling thread with the given backend. The thread
+ * uses the global session when it has the same backend and no private
+ * session was asked for, otherwise a new private session of that backend.
+ * The check results and core masks the thread cached for the previous
+ * backend are dropped.
+ */
+int rga_thread_backend_config(RGA_SESSION_BACKEND backend) {
+    rga_session_t *global_session = &g_rga_session;
+    rga_session_t *session = g_thread_session;
+
+    if (session != NULL && session->backend == backend &&
+        (session->is_private || !g_thread_session_enable))
+        return IM_STATUS_SUCCESS;
+
+    if (g_thread_session_enable)
+        return rga_private_session_create(backend);
+
+    /* only the hardware backend initializes the global session to compare with it */
+    if (backend == RGA_SESSION_BACKEND_HW) {
+        global_session = get_global_rga_session();
+        if (!IS_ERR(global_session) && global_session->backend == backend) {
+            rga_private_session_drop();
+            rga_check_cache_reset();
+            return IM_STATUS_SUCCESS;
+        }
+    } else {
+        pthread_rwlock_rdlock(&global_session->rwlock);
+        if (rga_session_is_ready(global_session) && global_session->backend == backend) {
+            pthread_rwlock_unlock(&global_session->rwlock);
+            rga_private_session_drop();
+            rga_check_cache_reset();
+            return IM_STATUS_SUCCESS;
+        }
+        pthread_rwlock_unlock(&global_session->rwlock);
+    }
+
+    return rga_private_session_create(backend);
+}
+#else
+int rga_thread_session_config(bool enable) {
+    if (!enable)
+        return IM_STATUS_SUCCESS;
+
+    IM_LOGW("thread private session is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+int rga_thread_backend_config(RGA_SESSION_BACKEND backend) {
+    if (backend == RGA_SESSION_BACKEND_HW)
+        return IM_STATUS_SUCCESS;
+
+    IM_LOGW("thread private session is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+#endif
+
+/*
+ * Configuration contexts: imconfig() sets the configuration of the calling
+ * thread (g_im2d_context). A context object holds the same configuration for
+ * one stream, imcontextPush() makes it the configuration of the calling
+ * thread until the matching imcontextPop(), which restores the previous one.
+ * The configuration is copied on push, so a context may be pushed by several
+ * threads at the same time, but must not be configured meanwhile.
+ */
+#define RGA_CONTEXT_STACK_MAX 8
+
+extern RGA_THREAD_LOCAL im_context_t g_im2d_context;
 
-    return is_debug;
+static RGA_THREAD_LOCAL im_context_t g_context_stack[RGA_CONTEXT_STACK_MAX];
+static RGA_THREAD_LOCAL int g_context_depth;
+
+IM_STATUS rga_context_config(im_context_t *context, IM_CONFIG_NAME name, uint64_t value) {
+    switch (name) {
+        case IM_CONFIG_SCHEDULER_CORE :
+            if (value & IM_SCHEDULER_MASK) {
+                context->core = (IM_SCHEDULER_CORE)value;
+            } else {
+                IM_LOGE("IM2D: It's not legal rga_core[0x%lx], it needs to be a 'IM_SCHEDULER_CORE'.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            break;
+        case IM_CONFIG_PRIORITY :
+            if (value <= 6) {
+                context->priority = (int)value;
+            } else {
+                IM_LOGE("IM2D: It's not legal priority[0x%lx], it needs to be a 'int', and it should be in the range of 0~6.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            break;
+        case IM_CONFIG_CHECK :
+            if (value <= IM_CHECK_MODE_OFF) {
+                context->check_mode = (int)value;
+            } else {
+                IM_LOGE("IM2D: It's not legal check config[0x%lx], it needs to be a 'IM_CHECK_MODE'.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            break;
+        case IM_CONFIG_STRIPE_SPLIT :
+            if (value & ~(uint64_t)IM_SCHEDULER_MASK) {
+                IM_LOGE("IM2D: It's not legal stripe core mask[0x%lx], it needs to be a mask of 'IM_SCHEDULER_CORE'.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            context->stripe_core = (uint32_t)value;
+            break;
+        case IM_CONFIG_ADAPTIVE_SCHEDULER :
+            if (value & ~(uint64_t)IM_SCHEDULER_MASK) {
+                IM_LOGE("IM2D: It's not legal adaptive scheduler core mask[0x%lx], it needs to be a mask of 'IM_SCHEDULER_CORE'.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            return rga_scheduler_config(context, (uint32_t)value);
+        case IM_CONFIG_TILE_INEXACT :
+            if (value == false || value == true) {
+                context->tile_inexact = (bool)value;
+            } else {
+                IM_LOGE("IM2D: It's not legal tile inexact config[0x%lx], it needs to be a 'bool'.", (unsigned long)value);
+                return IM_STATUS_ILLEGAL_PARAM;
+            }
+            break;
+        case IM_CONFIG_LOG_REFRESH :
+        case IM_CONFIG_THREAD_SESSION :
+        case IM_CONFIG_DEFERRED_SUBMIT :
+        case IM_CONFIG_IMPORT_CACHE :
+        case IM_CONFIG_BACKEND :
+            IM_LOGE("IM2D: config[%d] is not per thread, it cannot be set on a context!", name);
+            return IM_STATUS_NOT_SUPPORTED;
+        default :
+            IM_LOGE("IM2D: Unsupported config name!");
+            return IM_STATUS_NOT_SUPPORTED;
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+im_context_t *rga_context_create(void) {
+    im_context_t *context;
+
+    context = (im_context_t *)calloc(1, sizeof(*context));
+    if (context == NULL) {
+        IM_LOGE("context malloc failed!\n");
+        return NULL;
+    }
+
+    return context;
+}
+
+IM_STATUS rga_context_release(im_context_t *context) {
+    if (context == NULL) {
+        IM_LOGE("context is NULL!\n");
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    free(context);
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_context_push(const im_context_t *context) {
+    if (context == NULL) {
+        IM_LOGE("context is NULL!\n");
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    if (g_context_depth >= RGA_CONTEXT_STACK_MAX) {
+        IM_LOGE("context stack overflow, depth = %d\n", g_context_depth);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    g_context_stack[g_context_depth++] = g_im2d_context;
+    g_im2d_context = *context;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_context_pop(void) {
+    if (g_context_depth <= 0) {
+        IM_LOGE("context stack underflow!\n");
+        return IM_STATUS_FAILED;
+    }
+
+    g_im2d_context = g_context_stack[--g_context_depth];
+
+    return IM_STATUS_SUCCESS;
+}
+
+/*
+ * The log enable/level are cached in atomics by im2d_log, so that the
+ * submit path never takes the session lock or re-reads the property.
+ * Call update_debug_state() (imconfig(IM_CONFIG_LOG_REFRESH, 0)) to
+ * pick up a new ROCKCHIP_RGA_LOG/vendor.rga.log setting at runtime.
+ */
+int update_debug_state(void) {
+    rga_log_level_update();
+    return rga_log_enable_update() > 0;
+}
+
+int get_debug_state(void) {
+    return rga_log_enable_get() > 0;
+}
+
+int is_debug_en(void) {
+    return rga_log_enable_get() > 0;
 }
 
 static int librga_init() {
@@ -266,6 +662,13 @@ static int librga_init() {
         return -1;
     }
 
+#if !defined(RT_THREAD) && defined(RGA_THREAD_LOCAL_ENABLE)
+    if (pthread_key_create(&g_private_session_key, rga_private_session_destroy) != 0) {
+        IM_LOGE("im2d API session key init failed!\n");
+        return -1;
+    }
+#endif
+
 #ifdef RT_THREAD
     g_rga_session.rga_dev_fd = NULL;
 #else
@@ -33,6 +33,7 @@
 #define RGA_THREAD_LOCAL
 #else
 #define RGA_THREAD_LOCAL __thread
+#define RGA_THREAD_LOCAL_ENABLE
 #endif
 
 #define RGA_DEVICE_NODE_PATH "/dev/rga"
@@ -50,6 +51,11 @@ typedef enum {
     RGA_DRIVER_FEATURE_USER_CLOSE_FENCE = 1,
 } RGA_DRIVER_FEATURE;
 
+typedef enum {
+    RGA_SESSION_BACKEND_HW = 0,             /* ioctl to the RGA device */
+    RGA_SESSION_BACKEND_CPU,                /* executed by the CPU, see im2d_cpu.h */
+} RGA_SESSION_BACKEND;
+
 typedef struct rga_session {
 #ifdef RT_THREAD
     rt_device_t rga_dev_fd;
@@ -59,19 +65,27 @@ typedef struct rga_session {
 
     pthread_rwlock_t rwlock;
 
-    bool is_debug;
-
     struct rga_hw_versions_t core_version;
     struct rga_version_t driver_verison;
     RGA_DRIVER_IOC_TYPE driver_type;
     uint32_t driver_feature;
 
     rga_info_table_entry hardware_info;
+    uint32_t hardware_info_generation;      /* unique in the process, renewed with hardware_info */
+
+    bool is_private;                        /* owned by one thread, see IM_CONFIG_THREAD_SESSION */
+
+    RGA_SESSION_BACKEND backend;
+    void *backend_priv;                     /* the state of the CPU backend */
 } rga_session_t;
 
+int update_debug_state();
 int get_debug_state();
 int is_debug_en();
 
 rga_session_t *get_rga_session();
+int rga_thread_session_config(bool enable);
+int rga_thread_backend_config(RGA_SESSION_BACKEND backend);
+int rga_session_ioctl(rga_session_t *session, unsigned long cmd, void *arg);
 
 #endif /* #ifndef _im2d_context_h_ */
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _im2d_cpu_h_
+#define _im2d_cpu_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rga_ioctl.h"
+#include "im2d_type.h"
+#include "im2d_context.h"
+
+#if defined(__linux__) && !defined(RGA_SYNC_DISABLE)
+#define RGA_CPU_BACKEND_ENABLE
+#endif
+
+/*
+ * CPU backend: executes the rga_req generated for the hardware with the CPU.
+ * A session using it has no device fd, rga_session_ioctl() hands the ioctls
+ * of the session to rga_cpu_ioctl() instead.
+ *
+ * The kernels work on rows of 4-channel 8-bit pixels, R/Y, G/Cb, B/Cr, A,
+ * unpacked from and packed to the memory format of each image.
+ */
+#define RGA_CPU_PIXEL_SIZE  4
+
+typedef enum {
+    RGA_CPU_LAYOUT_RGB = 0,         /* packed 24/32 bit rgb */
+    RGA_CPU_LAYOUT_RGB565,          /* packed 16 bit rgb */
+    RGA_CPU_LAYOUT_RGBA5551,        /* packed 16 bit rgb + 1 bit alpha */
+    RGA_CPU_LAYOUT_RGBA4444,        /* packed 16 bit rgba */
+    RGA_CPU_LAYOUT_YUV_PACKED,      /* 2 pixels in 4 bytes, e.g. YUYV */
+    RGA_CPU_LAYOUT_YUV_SP,          /* Y plane + CbCr plane */
+    RGA_CPU_LAYOUT_YUV_P,           /* Y plane + Cb plane + Cr plane */
+    RGA_CPU_LAYOUT_Y400,            /* Y plane only */
+} RGA_CPU_LAYOUT;
+
+struct rga_cpu_format {
+    int format;
+    RGA_CPU_LAYOUT layout;
+    int bpp;                        /* bytes per pixel of the first plane */
+    int hsub;                       /* log2 of the chroma subsampling */
+    int vsub;
+    /*
+     * rgb:         byte of R, G, B, A in a pixel, -1: none
+     * rgb565:      bit shift of R, G, B
+     * rgba5551/4444: bit shift of R, G, B, A
+     * yuv_packed:  byte of Y0, Cb, Y1, Cr in a 2-pixel group
+     * yuv_sp:      byte of Cb, Cr in [1], [2]
+     * yuv_p:       plane of Cb, Cr in [1], [2]
+     */
+    int8_t offset[4];
+};
+
+/*
+ * Color space conversion in Q10, for each output channel c:
+ * out[c] = clamp((coe[c][0] * in[0] + coe[c][1] * in[1] + coe[c][2] * in[2] + bias[c]) >> 10,
+ *                min[c], max[c])
+ * bias holds the input/output offsets and the rounding.
+ */
+typedef struct rga_cpu_csc {
+    int16_t coe[3][3];
+    int32_t bias[3];
+    uint8_t min[3];
+    uint8_t max[3];
+} rga_cpu_csc_t;
+
+/* the memory behind one channel (src/dst/pat) of a rga_req */
+typedef struct rga_cpu_memory {
+    uint8_t *base;
+    size_t size;                /* 0: unknown, e.g. a virtual address */
+} rga_cpu_memory_t;
+
+/* one channel of a rga_req, resolved to CPU addresses */
+typedef struct rga_cpu_image {
+    int format;                 /* RK_FORMAT_* */
+    const struct rga_cpu_format *info;
+
+    uint8_t *plane[3];          /* Y/RGB, CbCr or Cb, Cr */
+    int stride[3];              /* in bytes */
+
+    int x;                      /* active rect in memory, for the dst of a */
+    int y;                      /* 90/270 rotation act_w/act_h are swapped back */
+    int width;
+    int height;
+
+    uint8_t alpha_bit[2];       /* alpha of the alpha bit 0/1 of RGBA5551 */
+} rga_cpu_image_t;
+
+/* the factor of fg (src) or bg (dst) in a Porter-Duff mode */
+typedef enum {
+    RGA_CPU_BLEND_ZERO = 0,
+    RGA_CPU_BLEND_ONE,
+    RGA_CPU_BLEND_SRC_ALPHA,
+    RGA_CPU_BLEND_DST_ALPHA,
+    RGA_CPU_BLEND_INV_SRC_ALPHA,
+    RGA_CPU_BLEND_INV_DST_ALPHA,
+} RGA_CPU_BLEND_FACTOR;
+
+typedef struct rga_cpu_blend {
+    RGA_CPU_BLEND_FACTOR src_factor;
+    RGA_CPU_BLEND_FACTOR dst_factor;
+    uint8_t src_global_alpha;
+    uint8_t dst_global_alpha;
+    bool premultiply;           /* the colors are multiplied by their alpha first */
+} rga_cpu_blend_t;
+
+/*
+ * Rotation and mirror of a plane without resampling, for dst(x, y) of a
+ * width x height dst plane:
+ *   x' = flip_h ? width - 1 - x : x,  y' = flip_v ? height - 1 - y : y
+ *   dst(x, y) = transpose ? src(y', x') : src(x', y')
+ */
+typedef struct rga_cpu_transform {
+    bool transpose;
+    bool flip_h;
+    bool flip_v;
+} rga_cpu_transform_t;
+
+/* elements per side of the tiles a transposition is split into */
+#define RGA_CPU_TRANSFORM_TILE  64
+
+/* FBC/tile layout of a rd_mode, see im2d_cpu_fbc.cpp */
+typedef struct rga_cpu_fbc_layout rga_cpu_fbc_layout_t;
+
+/*
+ * A FBC/tile image of a rga_req and its raster copy. The blocks (FBC
+ * superblocks or tiles) that cover the rect of the image are decoded to
+ * the copy, or encoded from it.
+ */
+typedef struct rga_cpu_fbc {
+    const rga_cpu_fbc_layout_t *layout;
+    uint8_t *base;              /* the FBC/tile buffer */
+    size_t size;                /* 0: unknown */
+    size_t header_size;         /* FBC headers, the body of each block follows them */
+    size_t block_size;          /* the uncompressed body of a block */
+    int blocks_w;               /* blocks per block row */
+    int block_x[2];             /* [begin, end) of the blocks of the rect */
+    int block_y[2];
+    bool partial;               /* the rect covers a part of some blocks */
+
+    rga_cpu_memory_t memory;    /* the raster copy of the whole virtual image */
+    rga_cpu_image_t raster;
+} rga_cpu_fbc_t;
+
+typedef void (*rga_cpu_work_fn)(void *arg, int begin, int end);
+
+/* the filter of one axis of a scaling, shared by all the rows/columns */
+typedef struct rga_cpu_scale_filter rga_cpu_scale_filter_t;
+
+/* row y of the image to scale, 4-channel, buffer can be used to hold it */
+typedef const uint8_t *(*rga_cpu_scale_source_fn)(void *arg, int y, uint8_t *buffer);
+
+/*
+ * Separable scaler of one thread: the source rows are filtered horizontally
+ * once, into a ring of the rows the vertical filter needs.
+ */
+typedef struct rga_cpu_scaler {
+    const rga_cpu_scale_filter_t *x_filter;
+    const rga_cpu_scale_filter_t *y_filter;
+    bool flip_h;
+    bool flip_v;
+
+    rga_cpu_scale_source_fn source;
+    void *arg;
+
+    uint8_t *buffer;
+    uint8_t *line;              /* source row before horizontal filtering */
+    uint8_t **slot;             /* ring of horizontally filtered rows */
+    const uint8_t **ring;       /* content of each slot, may point to the source */
+    const uint8_t **rows;       /* the taps of the current dst row */
+    int *index;                 /* source row of each slot, -1: empty */
+} rga_cpu_scaler_t;
+
+/* im2d_cpu_kernel.cpp */
+int rga_cpu_thread_count(void);
+void rga_cpu_parallel_for(int count, int grain, rga_cpu_work_fn fn, void *arg);
+bool rga_cpu_simd_enable(void);
+
+bool rga_cpu_format_is_supported(int format);
+bool rga_cpu_format_is_yuv(int format);
+int rga_cpu_image_init(rga_cpu_image_t *image, const rga_img_info_t *info,
+                       const rga_cpu_memory_t *memory, bool swap_wh);
+void rga_cpu_unpack_row(const rga_cpu_image_t *image, int row, int x, int count, uint8_t *pixel);
+void rga_cpu_pack_rows(const rga_cpu_image_t *image, int row, uint8_t * const *pixel, int rows,
+                       int x, int count);
+
+int rga_cpu_process(const struct rga_req *req, const uint8_t *lut,
+                    const rga_cpu_memory_t *src, const rga_cpu_memory_t *dst,
+                    const rga_cpu_memory_t *pat);
+int rga_cpu_load_palette(const struct rga_req *req, const rga_cpu_memory_t *pat, uint8_t *lut);
+
+/* im2d_cpu_csc.cpp */
+void rga_cpu_csc_y2r(const struct rga_req *req, rga_cpu_csc_t *csc);
+void rga_cpu_csc_r2y(const struct rga_req *req, rga_cpu_csc_t *csc);
+void rga_cpu_csc_full(const struct rga_req *req, bool src_yuv, rga_cpu_csc_t *csc);
+void rga_cpu_csc_planar(const rga_cpu_csc_t *csc, const uint8_t * const *in, uint8_t * const *out,
+                        int count);
+void rga_cpu_csc_row(const rga_cpu_csc_t *csc, uint8_t *pixel, int count);
+bool rga_cpu_csc_direct_supported(const rga_cpu_image_t *src, const rga_cpu_image_t *dst);
+void rga_cpu_csc_direct_rows(const rga_cpu_csc_t *csc, const rga_cpu_image_t *src,
+                             const rga_cpu_image_t *dst, int row, int rows);
+
+/* im2d_cpu_blend.cpp */
+void rga_cpu_blend_init(const struct rga_req *req, rga_cpu_blend_t *blend);
+void rga_cpu_blend_row(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg, int count);
+
+/* im2d_cpu_rotate.cpp */
+void rga_cpu_transform_plane(const rga_cpu_transform_t *transform, int size,
+                             const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                             int width, int height, int row, int rows);
+bool rga_cpu_transform_direct_supported(const rga_cpu_transform_t *transform,
+                                        const rga_cpu_image_t *src, const rga_cpu_image_t *dst);
+void rga_cpu_transform_direct_rows(const rga_cpu_transform_t *transform, const rga_cpu_image_t *src,
+                                   const rga_cpu_image_t *dst, int row, int rows);
+
+/* im2d_cpu_fbc.cpp */
+bool rga_cpu_fbc_is_raster(const rga_img_info_t *info);
+int rga_cpu_fbc_init(rga_cpu_fbc_t *fbc, const rga_img_info_t *info, const rga_cpu_memory_t *memory,
+                     int x, int y, int width, int height);
+int rga_cpu_fbc_decode(rga_cpu_fbc_t *fbc);
+void rga_cpu_fbc_encode(rga_cpu_fbc_t *fbc);
+void rga_cpu_fbc_exit(rga_cpu_fbc_t *fbc);
+
+/* im2d_cpu_scale.cpp */
+rga_cpu_scale_filter_t *rga_cpu_scale_filter_get(int src_size, int dst_size, int interp);
+void rga_cpu_scale_filter_put(rga_cpu_scale_filter_t *filter);
+int rga_cpu_scaler_init(rga_cpu_scaler_t *scaler,
+                        const rga_cpu_scale_filter_t *x_filter, bool flip_h,
+                        const rga_cpu_scale_filter_t *y_filter, bool flip_v,
+                        rga_cpu_scale_source_fn source, void *arg);
+void rga_cpu_scaler_row(rga_cpu_scaler_t *scaler, int y, uint8_t *out);
+void rga_cpu_scaler_exit(rga_cpu_scaler_t *scaler);
+
+/* im2d_cpu_backend.cpp */
+IM_STATUS rga_cpu_session_init(rga_session_t *session);
+void rga_cpu_session_exit(rga_session_t *session);
+int rga_cpu_ioctl(rga_session_t *session, unsigned long cmd, void *arg);
+
+#endif /* #ifndef _im2d_cpu_h_ */
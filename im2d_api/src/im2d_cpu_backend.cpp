@@ -0,0 +1,847 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_impl.h"
+
+#include "core/rga_sync.h"
+
+/*
+ * The CPU backend stands in for the driver of a session: it implements the
+ * ioctls librga issues (blit, buffer import/release and the request
+ * create/config/submit/cancel), and executes the rga_req with the kernels
+ * of im2d_cpu_kernel.cpp.
+ *
+ * Sync requests run in the calling thread when nothing is queued, async
+ * requests run in order on one executor thread per session. The release
+ * fence of an async request is an eventfd, signaled when it is done, which
+ * rga_sync_wait() and imsync() can poll like a dma-fence.
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+#define RGA_CPU_PALETTE_SIZE    256
+
+/* <linux/dma-buf.h> */
+struct rga_cpu_dma_buf_sync {
+    uint64_t flags;
+};
+
+#define RGA_CPU_DMA_BUF_SYNC_RW     (3 << 0)
+#define RGA_CPU_DMA_BUF_SYNC_START  (0 << 2)
+#define RGA_CPU_DMA_BUF_SYNC_END    (1 << 2)
+#define RGA_CPU_DMA_BUF_IOCTL_SYNC  _IOW('b', 0, struct rga_cpu_dma_buf_sync)
+
+typedef struct rga_cpu_buffer {
+    struct rga_cpu_buffer *next;
+
+    uint32_t handle;
+    int refcount;                   /* imports + running tasks, under the session lock */
+
+    int fd;                         /* dup of the dma-buf, -1: virtual address */
+    dev_t dev;
+    ino_t ino;
+
+    uint8_t *base;
+    size_t size;                    /* 0: unknown */
+} rga_cpu_buffer_t;
+
+typedef struct rga_cpu_job {
+    struct rga_cpu_job *next;
+
+    uint32_t id;
+    struct rga_req *req;
+    int task_count;
+} rga_cpu_job_t;
+
+typedef struct rga_cpu_task {
+    struct rga_cpu_task *next;
+
+    struct rga_req *req;
+    int task_count;
+
+    int acquire_fence_fd;           /* owned, -1: none */
+    int release_fence_fd;           /* owned, signaled when done */
+
+    bool sync;                      /* freed by its waiter */
+    bool done;
+    int result;
+} rga_cpu_task_t;
+
+/* one channel of a request, resolved to memory for its execution */
+typedef struct rga_cpu_channel {
+    rga_cpu_memory_t memory;
+    rga_cpu_buffer_t *buffer;       /* ref held on an imported buffer */
+    int map_fd;                     /* a raw fd mapped for this request */
+} rga_cpu_channel_t;
+
+typedef struct rga_cpu_session {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    rga_cpu_buffer_t *buffers;
+    uint32_t next_handle;
+
+    rga_cpu_job_t *jobs;
+    uint32_t next_job_id;
+
+    rga_cpu_task_t *head;
+    rga_cpu_task_t *tail;
+    bool busy;                      /* a task is running */
+    bool exit;
+    bool executor_created;
+    pthread_t executor;
+
+    uint8_t lut[RGA_CPU_PALETTE_SIZE * RGA_CPU_PIXEL_SIZE];
+} rga_cpu_session_t;
+
+static void rga_cpu_buffer_put_locked(rga_cpu_buffer_t **list, rga_cpu_buffer_t *buffer) {
+    rga_cpu_buffer_t **pos;
+
+    if (--buffer->refcount > 0)
+        return;
+
+    for (pos = list; *pos != NULL; pos = &(*pos)->next) {
+        if (*pos == buffer) {
+            *pos = buffer->next;
+            break;
+        }
+    }
+
+    if (buffer->fd >= 0) {
+        munmap(buffer->base, buffer->size);
+        close(buffer->fd);
+    }
+    free(buffer);
+}
+
+static rga_cpu_buffer_t *rga_cpu_buffer_find_locked(rga_cpu_session_t *priv, uint32_t handle) {
+    rga_cpu_buffer_t *buffer;
+
+    for (buffer = priv->buffers; buffer != NULL; buffer = buffer->next)
+        if (buffer->handle == handle)
+            return buffer;
+
+    return NULL;
+}
+
+static int rga_cpu_map_fd(int fd, uint8_t **base, size_t *size) {
+    off_t end;
+    void *addr;
+
+    end = lseek(fd, 0, SEEK_END);
+    if (end <= 0) {
+        IM_LOGE("failed to get the size of fd[%d], %s\n", fd, strerror(errno));
+        return -EINVAL;
+    }
+
+    addr = mmap(NULL, (size_t)end, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        IM_LOGE("failed to map fd[%d], %s\n", fd, strerror(errno));
+        return -errno;
+    }
+
+    *base = (uint8_t *)addr;
+    *size = (size_t)end;
+
+    return 0;
+}
+
+static int rga_cpu_import_one(rga_cpu_session_t *priv, struct rga_external_buffer *external) {
+    rga_cpu_buffer_t *buffer;
+    struct stat st;
+    int ret;
+
+    switch (external->type) {
+        case RGA_DMA_BUFFER:
+            if (fstat((int)external->memory, &st) < 0) {
+                IM_LOGE("invalid fd[%d], %s\n", (int)external->memory, strerror(errno));
+                return -EINVAL;
+            }
+
+            /* the same dma-buf imported again shares the handle */
+            for (buffer = priv->buffers; buffer != NULL; buffer = buffer->next) {
+                if (buffer->fd >= 0 && buffer->dev == st.st_dev && buffer->ino == st.st_ino) {
+                    buffer->refcount++;
+                    external->handle = buffer->handle;
+                    return 0;
+                }
+            }
+
+            buffer = (rga_cpu_buffer_t *)calloc(1, sizeof(*buffer));
+            if (buffer == NULL)
+                return -ENOMEM;
+
+            buffer->fd = dup((int)external->memory);
+            if (buffer->fd < 0) {
+                free(buffer);
+                return -errno;
+            }
+
+            ret = rga_cpu_map_fd(buffer->fd, &buffer->base, &buffer->size);
+            if (ret < 0) {
+                close(buffer->fd);
+                free(buffer);
+                return ret;
+            }
+            buffer->dev = st.st_dev;
+            buffer->ino = st.st_ino;
+            break;
+        case RGA_VIRTUAL_ADDRESS:
+            buffer = (rga_cpu_buffer_t *)calloc(1, sizeof(*buffer));
+            if (buffer == NULL)
+                return -ENOMEM;
+
+            buffer->fd = -1;
+            buffer->base = (uint8_t *)(uintptr_t)external->memory;
+            buffer->size = external->memory_info.size;
+            break;
+        default:
+            IM_LOGE("CPU backend cannot import memory type[%d].\n", external->type);
+            return -EINVAL;
+    }
+
+    buffer->refcount = 1;
+    buffer->handle = priv->next_handle++;
+    if (priv->next_handle == 0)
+        priv->next_handle = 1;
+    buffer->next = priv->buffers;
+    priv->buffers = buffer;
+
+    external->handle = buffer->handle;
+
+    return 0;
+}
+
+static int rga_cpu_import_buffer(rga_cpu_session_t *priv, struct rga_buffer_pool *pool) {
+    struct rga_external_buffer *external = (struct rga_external_buffer *)(uintptr_t)pool->buffers;
+    rga_cpu_buffer_t *buffer;
+    uint32_t i, j;
+    int ret = 0;
+
+    pthread_mutex_lock(&priv->lock);
+    for (i = 0; i < pool->size; i++) {
+        ret = rga_cpu_import_one(priv, &external[i]);
+        if (ret < 0)
+            break;
+    }
+
+    /* all or nothing */
+    if (ret < 0) {
+        for (j = 0; j < i; j++) {
+            buffer = rga_cpu_buffer_find_locked(priv, external[j].handle);
+            if (buffer != NULL)
+                rga_cpu_buffer_put_locked(&priv->buffers, buffer);
+            external[j].handle = 0;
+        }
+    }
+    pthread_mutex_unlock(&priv->lock);
+
+    return ret;
+}
+
+static int rga_cpu_release_buffer(rga_cpu_session_t *priv, struct rga_buffer_pool *pool) {
+    struct rga_external_buffer *external = (struct rga_external_buffer *)(uintptr_t)pool->buffers;
+    rga_cpu_buffer_t *buffer;
+    uint32_t i;
+    int ret = 0;
+
+    pthread_mutex_lock(&priv->lock);
+    for (i = 0; i < pool->size; i++) {
+        buffer = rga_cpu_buffer_find_locked(priv, external[i].handle);
+        if (buffer == NULL) {
+            IM_LOGE("cannot find handle[%d]\n", external[i].handle);
+            ret = -EINVAL;
+            continue;
+        }
+
+        rga_cpu_buffer_put_locked(&priv->buffers, buffer);
+    }
+    pthread_mutex_unlock(&priv->lock);
+
+    return ret;
+}
+
+static void rga_cpu_dma_buf_sync(int fd, uint64_t flags) {
+    struct rga_cpu_dma_buf_sync sync;
+
+    if (fd < 0)
+        return;
+
+    /* not every exporter implements it, the access is coherent then */
+    sync.flags = RGA_CPU_DMA_BUF_SYNC_RW | flags;
+    ioctl(fd, RGA_CPU_DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+/*
+ * yrgb_addr carries the handle (handle_flag) or the fd, otherwise uv_addr
+ * carries the address, which is virtual when the mmu of the channel is on.
+ */
+static int rga_cpu_channel_get(rga_cpu_session_t *priv, const struct rga_req *req,
+                               const rga_img_info_t *info, uint32_t mmu_bit,
+                               rga_cpu_channel_t *channel) {
+    rga_cpu_buffer_t *buffer;
+    int ret;
+
+    channel->map_fd = -1;
+
+    if (req->handle_flag & 0x1) {
+        pthread_mutex_lock(&priv->lock);
+        buffer = rga_cpu_buffer_find_locked(priv, (uint32_t)info->yrgb_addr);
+        if (buffer != NULL)
+            buffer->refcount++;
+        pthread_mutex_unlock(&priv->lock);
+
+        if (buffer == NULL) {
+            IM_LOGE("cannot find handle[%d]\n", (int)info->yrgb_addr);
+            return -EINVAL;
+        }
+
+        channel->buffer = buffer;
+        channel->memory.base = buffer->base;
+        channel->memory.size = buffer->size;
+        rga_cpu_dma_buf_sync(buffer->fd, RGA_CPU_DMA_BUF_SYNC_START);
+    } else if (info->yrgb_addr > 0) {
+        ret = rga_cpu_map_fd((int)info->yrgb_addr, &channel->memory.base, &channel->memory.size);
+        if (ret < 0)
+            return ret;
+
+        channel->map_fd = (int)info->yrgb_addr;
+        rga_cpu_dma_buf_sync(channel->map_fd, RGA_CPU_DMA_BUF_SYNC_START);
+    } else if (info->uv_addr != 0 && (req->mmu_info.mmu_flag & mmu_bit)) {
+        channel->memory.base = (uint8_t *)(uintptr_t)info->uv_addr;
+        channel->memory.size = 0;
+    } else {
+        IM_LOGE("CPU backend cannot access physical address[0x%lx].\n", (unsigned long)info->uv_addr);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static void rga_cpu_channel_put(rga_cpu_session_t *priv, rga_cpu_channel_t *channel) {
+    if (channel->buffer != NULL) {
+        rga_cpu_dma_buf_sync(channel->buffer->fd, RGA_CPU_DMA_BUF_SYNC_END);
+
+        pthread_mutex_lock(&priv->lock);
+        rga_cpu_buffer_put_locked(&priv->buffers, channel->buffer);
+        pthread_mutex_unlock(&priv->lock);
+    } else if (channel->map_fd >= 0) {
+        rga_cpu_dma_buf_sync(channel->map_fd, RGA_CPU_DMA_BUF_SYNC_END);
+        munmap(channel->memory.base, channel->memory.size);
+    }
+
+    memset(channel, 0x0, sizeof(*channel));
+    channel->map_fd = -1;
+}
+
+static int rga_cpu_run_req(rga_cpu_session_t *priv, const struct rga_req *req) {
+    rga_cpu_channel_t channel[3];
+    bool need_src, need_dst, need_pat;
+    int ret = 0;
+
+    memset(channel, 0x0, sizeof(channel));
+    channel[0].map_fd = channel[1].map_fd = channel[2].map_fd = -1;
+
+    need_src = req->render_mode == bitblt_mode || req->render_mode == color_palette_mode;
+    need_dst = req->render_mode != update_palette_table_mode;
+    need_pat = req->render_mode == update_palette_table_mode ||
+               (req->render_mode == bitblt_mode && req->bsfilter_flag);
+
+    /* src: mmu_flag[8], dst: mmu_flag[10], pat: mmu_flag[11] */
+    if (need_src)
+        ret = rga_cpu_channel_get(priv, req, &req->src, 0x1 << 8, &channel[0]);
+    if (ret == 0 && need_dst)
+        ret = rga_cpu_channel_get(priv, req, &req->dst, 0x1 << 10, &channel[1]);
+    if (ret == 0 && need_pat)
+        ret = rga_cpu_channel_get(priv, req, &req->pat, 0x1 << 11, &channel[2]);
+
+    if (ret == 0) {
+        if (req->render_mode == update_palette_table_mode)
+            ret = rga_cpu_load_palette(req, &channel[2].memory, priv->lut);
+        else
+            ret = rga_cpu_process(req, priv->lut, &channel[0].memory,
+                                  &channel[1].memory, &channel[2].memory);
+    }
+
+    rga_cpu_channel_put(priv, &channel[0]);
+    rga_cpu_channel_put(priv, &channel[1]);
+    rga_cpu_channel_put(priv, &channel[2]);
+
+    return ret;
+}
+
+static int rga_cpu_task_run(rga_cpu_session_t *priv, rga_cpu_task_t *task) {
+    uint64_t value = 1;
+    int i, ret = 0;
+
+    if (task->acquire_fence_fd >= 0) {
+        if (rga_sync_wait(task->acquire_fence_fd, -1) < 0) {
+            IM_LOGE("wait acquire fence[%d] failed\n", task->acquire_fence_fd);
+            ret = -EINVAL;
+        }
+        close(task->acquire_fence_fd);
+        task->acquire_fence_fd = -1;
+    }
+
+    for (i = 0; ret == 0 && i < task->task_count; i++)
+        ret = rga_cpu_run_req(priv, &task->req[i]);
+
+    if (task->release_fence_fd >= 0) {
+        if (ret < 0)
+            IM_LOGE("async task failed, ret = %d\n", ret);
+
+        if (write(task->release_fence_fd, &value, sizeof(value)) != sizeof(value))
+            IM_LOGE("signal release fence failed, %s\n", strerror(errno));
+        close(task->release_fence_fd);
+        task->release_fence_fd = -1;
+    }
+
+    return ret;
+}
+
+static void rga_cpu_task_free(rga_cpu_task_t *task) {
+    if (task->acquire_fence_fd >= 0)
+        close(task->acquire_fence_fd);
+    if (task->release_fence_fd >= 0)
+        close(task->release_fence_fd);
+    free(task->req);
+    free(task);
+}
+
+static void *rga_cpu_executor(void *arg) {
+    rga_cpu_session_t *priv = (rga_cpu_session_t *)arg;
+    rga_cpu_task_t *task;
+
+    pthread_mutex_lock(&priv->lock);
+    while (true) {
+        while (!priv->exit && (priv->head == NULL || priv->busy))
+            pthread_cond_wait(&priv->cond, &priv->lock);
+        /* the queued tasks are finished before exiting */
+        if (priv->head == NULL)
+            break;
+
+        task = priv->head;
+        priv->head = task->next;
+        if (priv->head == NULL)
+            priv->tail = NULL;
+        priv->busy = true;
+        pthread_mutex_unlock(&priv->lock);
+
+        task->result = rga_cpu_task_run(priv, task);
+
+        pthread_mutex_lock(&priv->lock);
+        priv->busy = false;
+        if (task->sync)
+            task->done = true;
+        else
+            rga_cpu_task_free(task);
+        pthread_cond_broadcast(&priv->cond);
+    }
+    pthread_mutex_unlock(&priv->lock);
+
+    return NULL;
+}
+
+/* takes the ownership of task */
+static int rga_cpu_task_submit(rga_cpu_session_t *priv, rga_cpu_task_t *task, bool sync) {
+    int ret;
+
+    pthread_mutex_lock(&priv->lock);
+
+    /* nothing to wait for, run it in the caller */
+    if (sync && priv->head == NULL && !priv->busy) {
+        priv->busy = true;
+        pthread_mutex_unlock(&priv->lock);
+
+        ret = rga_cpu_task_run(priv, task);
+        rga_cpu_task_free(task);
+
+        pthread_mutex_lock(&priv->lock);
+        priv->busy = false;
+        pthread_cond_broadcast(&priv->cond);
+        pthread_mutex_unlock(&priv->lock);
+
+        return ret;
+    }
+
+    if (!priv->executor_created) {
+        if (pthread_create(&priv->executor, NULL, rga_cpu_executor, priv) != 0) {
+            pthread_mutex_unlock(&priv->lock);
+            IM_LOGE("failed to create the CPU executor, %s\n", strerror(errno));
+            rga_cpu_task_free(task);
+            return -ENOMEM;
+        }
+        priv->executor_created = true;
+    }
+
+    task->next = NULL;
+    if (priv->tail != NULL)
+        priv->tail->next = task;
+    else
+        priv->head = task;
+    priv->tail = task;
+    pthread_cond_broadcast(&priv->cond);
+
+    if (!sync) {
+        pthread_mutex_unlock(&priv->lock);
+        return 0;
+    }
+
+    while (!task->done)
+        pthread_cond_wait(&priv->cond, &priv->lock);
+    pthread_mutex_unlock(&priv->lock);
+
+    ret = task->result;
+    rga_cpu_task_free(task);
+
+    return ret;
+}
+
+/*
+ * Copy the requests into a task and submit it. For async, *release_fence_fd
+ * returns the fence signaled when the task is done.
+ */
+static int rga_cpu_submit(rga_cpu_session_t *priv, const struct rga_req *req, int task_count,
+                          int acquire_fence_fd, bool sync, int *release_fence_fd) {
+    rga_cpu_task_t *task;
+
+    task = (rga_cpu_task_t *)calloc(1, sizeof(*task));
+    if (task == NULL)
+        return -ENOMEM;
+    task->acquire_fence_fd = -1;
+    task->release_fence_fd = -1;
+    task->sync = sync;
+
+    task->req = (struct rga_req *)malloc(sizeof(*req) * task_count);
+    if (task->req == NULL) {
+        free(task);
+        return -ENOMEM;
+    }
+    memcpy(task->req, req, sizeof(*req) * task_count);
+    task->task_count = task_count;
+
+    /* the caller closes its acquire fence, see RGA_DRIVER_FEATURE_USER_CLOSE_FENCE */
+    if (acquire_fence_fd > 0) {
+        task->acquire_fence_fd = dup(acquire_fence_fd);
+        if (task->acquire_fence_fd < 0) {
+            rga_cpu_task_free(task);
+            return -errno;
+        }
+    }
+
+    if (!sync) {
+        task->release_fence_fd = eventfd(0, EFD_CLOEXEC);
+        if (task->release_fence_fd < 0) {
+            rga_cpu_task_free(task);
+            return -errno;
+        }
+
+        *release_fence_fd = dup(task->release_fence_fd);
+        if (*release_fence_fd < 0) {
+            rga_cpu_task_free(task);
+            return -errno;
+        }
+    }
+
+    return rga_cpu_task_submit(priv, task, sync);
+}
+
+static rga_cpu_job_t *rga_cpu_job_find_locked(rga_cpu_session_t *priv, uint32_t id, bool detach) {
+    rga_cpu_job_t **pos, *job;
+
+    for (pos = &priv->jobs; *pos != NULL; pos = &(*pos)->next) {
+        if ((*pos)->id == id) {
+            job = *pos;
+            if (detach)
+                *pos = job->next;
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+static void rga_cpu_job_free(rga_cpu_job_t *job) {
+    free(job->req);
+    free(job);
+}
+
+static int rga_cpu_request_create(rga_cpu_session_t *priv, uint32_t *id) {
+    rga_cpu_job_t *job;
+
+    job = (rga_cpu_job_t *)calloc(1, sizeof(*job));
+    if (job == NULL)
+        return -ENOMEM;
+
+    pthread_mutex_lock(&priv->lock);
+    job->id = priv->next_job_id++;
+    if (priv->next_job_id == 0)
+        priv->next_job_id = 1;
+    job->next = priv->jobs;
+    priv->jobs = job;
+    pthread_mutex_unlock(&priv->lock);
+
+    *id = job->id;
+
+    return 0;
+}
+
+static int rga_cpu_request_append(rga_cpu_job_t *job, const struct rga_user_request *request) {
+    struct rga_req *req;
+
+    if (request->task_num == 0)
+        return 0;
+    if (job->task_count + request->task_num > RGA_TASK_NUM_MAX) {
+        IM_LOGE("too many tasks in request[%d], %d + %d > %d\n",
+                job->id, job->task_count, request->task_num, RGA_TASK_NUM_MAX);
+        return -EINVAL;
+    }
+
+    req = (struct rga_req *)realloc(job->req, sizeof(*req) * (job->task_count + request->task_num));
+    if (req == NULL)
+        return -ENOMEM;
+
+    memcpy(req + job->task_count, (const void *)(uintptr_t)request->task_ptr,
+           sizeof(*req) * request->task_num);
+    job->req = req;
+    job->task_count += request->task_num;
+
+    return 0;
+}
+
+static int rga_cpu_request(rga_cpu_session_t *priv, struct rga_user_request *request, bool submit) {
+    rga_cpu_job_t *job;
+    int release_fence_fd = -1;
+    int ret;
+
+    pthread_mutex_lock(&priv->lock);
+    job = rga_cpu_job_find_locked(priv, request->id, submit);
+    if (job == NULL) {
+        pthread_mutex_unlock(&priv->lock);
+        IM_LOGE("cannot find request[%d]\n", request->id);
+        return -EINVAL;
+    }
+
+    ret = rga_cpu_request_append(job, request);
+    pthread_mutex_unlock(&priv->lock);
+    if (!submit)
+        return ret;
+
+    if (ret == 0 && job->task_count > 0)
+        ret = rga_cpu_submit(priv, job->req, job->task_count, (int)request->acquire_fence_fd,
+                             request->sync_mode != RGA_BLIT_ASYNC, &release_fence_fd);
+    request->release_fence_fd = release_fence_fd;
+
+    rga_cpu_job_free(job);
+
+    return ret;
+}
+
+static int rga_cpu_request_cancel(rga_cpu_session_t *priv, uint32_t id) {
+    rga_cpu_job_t *job;
+
+    pthread_mutex_lock(&priv->lock);
+    job = rga_cpu_job_find_locked(priv, id, true);
+    pthread_mutex_unlock(&priv->lock);
+
+    if (job == NULL) {
+        IM_LOGE("cannot find request[%d]\n", id);
+        return -EINVAL;
+    }
+
+    rga_cpu_job_free(job);
+
+    return 0;
+}
+
+int rga_cpu_ioctl(rga_session_t *session, unsigned long cmd, void *arg) {
+    rga_cpu_session_t *priv = (rga_cpu_session_t *)session->backend_priv;
+    struct rga_req *req;
+    int ret;
+
+    if (priv == NULL || arg == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (cmd) {
+        case RGA_BLIT_SYNC:
+        case RGA_BLIT_ASYNC:
+            req = (struct rga_req *)arg;
+            ret = rga_cpu_submit(priv, req, 1, req->in_fence_fd, cmd == RGA_BLIT_SYNC,
+                                 &req->out_fence_fd);
+            break;
+        case RGA_IOC_IMPORT_BUFFER:
+            ret = rga_cpu_import_buffer(priv, (struct rga_buffer_pool *)arg);
+            break;
+        case RGA_IOC_RELEASE_BUFFER:
+            ret = rga_cpu_release_buffer(priv, (struct rga_buffer_pool *)arg);
+            break;
+        case RGA_IOC_REQUEST_CREATE:
+            ret = rga_cpu_request_create(priv, (uint32_t *)arg);
+            break;
+        case RGA_IOC_REQUEST_CONFIG:
+            ret = rga_cpu_request(priv, (struct rga_user_request *)arg, false);
+            ((struct rga_user_request *)arg)->release_fence_fd = -1;
+            break;
+        case RGA_IOC_REQUEST_SUBMIT:
+            ret = rga_cpu_request(priv, (struct rga_user_request *)arg, true);
+            break;
+        case RGA_IOC_REQUEST_CANCEL:
+            ret = rga_cpu_request_cancel(priv, *(uint32_t *)arg);
+            break;
+        case RGA_IOC_GET_DRVIER_VERSION:
+            memcpy(arg, &session->driver_verison, sizeof(session->driver_verison));
+            ret = 0;
+            break;
+        case RGA_IOC_GET_HW_VERSION:
+            memcpy(arg, &session->core_version, sizeof(session->core_version));
+            ret = 0;
+            break;
+        default:
+            IM_LOGE("CPU backend does not support ioctl[0x%lx].\n", cmd);
+            ret = -ENOTTY;
+            break;
+    }
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * The session looks like a multi-RGA driver with a single RGA2-enhance core,
+ * so that the parameter checks accept what the CPU kernels implement.
+ */
+IM_STATUS rga_cpu_session_init(rga_session_t *session) {
+    rga_cpu_session_t *priv;
+    struct rga_version_t driver_version = { 1, 3, 0, "1.3.0" };
+    struct rga_version_t core_version = { 3, 2, 0x63318, "3.2.63318" };
+
+    priv = (rga_cpu_session_t *)calloc(1, sizeof(*priv));
+    if (priv == NULL) {
+        IM_LOGE("CPU session alloc error!\n");
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_init(&priv->lock, NULL);
+    pthread_cond_init(&priv->cond, NULL);
+    priv->next_handle = 1;
+    priv->next_job_id = 1;
+
+    session->rga_dev_fd = -1;
+    session->backend = RGA_SESSION_BACKEND_CPU;
+    session->backend_priv = priv;
+
+    session->driver_type = RGA_DRIVER_IOC_MULTI_RGA;
+    session->driver_verison = driver_version;
+    session->driver_feature = RGA_DRIVER_FEATURE_USER_CLOSE_FENCE;
+
+    memset(&session->core_version, 0x0, sizeof(session->core_version));
+    session->core_version.version[0] = core_version;
+    session->core_version.size = 1;
+
+    IM_LOGD("CPU backend, %d threads\n", rga_cpu_thread_count());
+
+    return IM_STATUS_SUCCESS;
+}
+
+void rga_cpu_session_exit(rga_session_t *session) {
+    rga_cpu_session_t *priv = (rga_cpu_session_t *)session->backend_priv;
+    rga_cpu_job_t *job;
+    rga_cpu_buffer_t *buffer;
+
+    if (priv == NULL)
+        return;
+
+    pthread_mutex_lock(&priv->lock);
+    priv->exit = true;
+    pthread_cond_broadcast(&priv->cond);
+    pthread_mutex_unlock(&priv->lock);
+    if (priv->executor_created)
+        pthread_join(priv->executor, NULL);
+
+    while ((job = priv->jobs) != NULL) {
+        priv->jobs = job->next;
+        rga_cpu_job_free(job);
+    }
+
+    while ((buffer = priv->buffers) != NULL) {
+        buffer->refcount = 1;
+        rga_cpu_buffer_put_locked(&priv->buffers, buffer);
+    }
+
+    pthread_cond_destroy(&priv->cond);
+    pthread_mutex_destroy(&priv->lock);
+    free(priv);
+
+    session->backend = RGA_SESSION_BACKEND_HW;
+    session->backend_priv = NULL;
+    session->driver_type = RGA_DRIVER_IOC_UNKONW;
+    session->driver_feature = 0;
+}
+#else
+IM_STATUS rga_cpu_session_init(rga_session_t *session) {
+    (void)session;
+
+    IM_LOGW("CPU backend is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+void rga_cpu_session_exit(rga_session_t *session) {
+    (void)session;
+}
+
+int rga_cpu_ioctl(rga_session_t *session, unsigned long cmd, void *arg) {
+    (void)session;
+    (void)cmd;
+    (void)arg;
+
+    errno = ENODEV;
+    return -1;
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
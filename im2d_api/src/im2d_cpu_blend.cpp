@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RGA_CPU_BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RGA_CPU_BLEND_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+/*
+ * Porter-Duff blend of the CPU backend, fg (src) over bg (dst), the result
+ * is stored in fg. The rounding model, in 8 bits, where a * b / 255 is
+ * always rounded to the nearest, see rga_cpu_div255():
+ *
+ *   sa = fg.a * fg_global / 255            da = bg.a * bg_global / 255
+ *   alpha_rop_flag[9] (IM_ALPHA_BLEND_PRE_MUL), straight colors:
+ *   sc = fg.c * sa / 255                   dc = bg.c * da / 255
+ *   otherwise, premultiplied colors:
+ *   sc = fg.c * fg_global / 255            dc = bg.c * bg_global / 255
+ *
+ *   out.c = min(255, sc * Fs / 255 + dc * Fd / 255)
+ *   out.a = min(255, sa * Fs / 255 + da * Fd / 255)
+ *
+ * Fs and Fd are 0, 255, sa, da, 255 - sa or 255 - da by PD_mode, and the
+ * global alphas are 255 unless feature.global_alpha_en. The output is
+ * premultiplied, it is not divided back by its alpha.
+ *
+ * The SSE2/NEON kernels compute the same 16-bit expressions as the C
+ * kernel, so all of them are bit exact.
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+typedef void (*rga_cpu_blend_fn)(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg,
+                                 int begin, int count);
+
+/* x / 255 rounded, for x in [0, 255 * 255] */
+static inline int rga_cpu_div255(int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline int rga_cpu_blend_factor(RGA_CPU_BLEND_FACTOR factor, int sa, int da) {
+    switch (factor) {
+        case RGA_CPU_BLEND_ONE:
+            return 0xff;
+        case RGA_CPU_BLEND_SRC_ALPHA:
+            return sa;
+        case RGA_CPU_BLEND_DST_ALPHA:
+            return da;
+        case RGA_CPU_BLEND_INV_SRC_ALPHA:
+            return 0xff - sa;
+        case RGA_CPU_BLEND_INV_DST_ALPHA:
+            return 0xff - da;
+        case RGA_CPU_BLEND_ZERO:
+        default:
+            return 0;
+    }
+}
+
+static void rga_cpu_blend_row_c(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg,
+                                int begin, int count) {
+    int i, c, sa, da, fs, fd, sc, dc, value;
+
+    fg += (size_t)begin * RGA_CPU_PIXEL_SIZE;
+    bg += (size_t)begin * RGA_CPU_PIXEL_SIZE;
+    for (i = begin; i < count; i++, fg += RGA_CPU_PIXEL_SIZE, bg += RGA_CPU_PIXEL_SIZE) {
+        sa = rga_cpu_div255(fg[3] * blend->src_global_alpha);
+        da = rga_cpu_div255(bg[3] * blend->dst_global_alpha);
+        fs = rga_cpu_blend_factor(blend->src_factor, sa, da);
+        fd = rga_cpu_blend_factor(blend->dst_factor, sa, da);
+
+        for (c = 0; c < 3; c++) {
+            sc = rga_cpu_div255(fg[c] * (blend->premultiply ? sa : blend->src_global_alpha));
+            dc = rga_cpu_div255(bg[c] * (blend->premultiply ? da : blend->dst_global_alpha));
+            value = rga_cpu_div255(sc * fs) + rga_cpu_div255(dc * fd);
+            fg[c] = value > 0xff ? 0xff : value;
+        }
+
+        value = rga_cpu_div255(sa * fs) + rga_cpu_div255(da * fd);
+        fg[3] = value > 0xff ? 0xff : value;
+    }
+}
+
+#ifdef RGA_CPU_BLEND_SSE2
+static inline __m128i rga_cpu_div255_sse2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* the alpha of each of the 2 pixels in all its 4 lanes */
+static inline __m128i rga_cpu_blend_alpha_sse2(__m128i x) {
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline __m128i rga_cpu_blend_factor_sse2(RGA_CPU_BLEND_FACTOR factor, __m128i sa, __m128i da) {
+    const __m128i max = _mm_set1_epi16(0xff);
+
+    switch (factor) {
+        case RGA_CPU_BLEND_ONE:
+            return max;
+        case RGA_CPU_BLEND_SRC_ALPHA:
+            return sa;
+        case RGA_CPU_BLEND_DST_ALPHA:
+            return da;
+        case RGA_CPU_BLEND_INV_SRC_ALPHA:
+            return _mm_sub_epi16(max, sa);
+        case RGA_CPU_BLEND_INV_DST_ALPHA:
+            return _mm_sub_epi16(max, da);
+        case RGA_CPU_BLEND_ZERO:
+        default:
+            return _mm_setzero_si128();
+    }
+}
+
+/* 2 pixels in 16-bit lanes, the alpha lanes follow the same expression as the colors */
+static inline __m128i rga_cpu_blend_pixel2_sse2(const rga_cpu_blend_t *blend, __m128i fg, __m128i bg) {
+    const __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i sc, dc, sa, da, fs, fd;
+
+    sc = rga_cpu_div255_sse2(_mm_mullo_epi16(fg, _mm_set1_epi16(blend->src_global_alpha)));
+    dc = rga_cpu_div255_sse2(_mm_mullo_epi16(bg, _mm_set1_epi16(blend->dst_global_alpha)));
+    sa = rga_cpu_blend_alpha_sse2(sc);
+    da = rga_cpu_blend_alpha_sse2(dc);
+
+    if (blend->premultiply) {
+        sc = _mm_or_si128(_mm_and_si128(alpha_mask, sc),
+                          _mm_andnot_si128(alpha_mask, rga_cpu_div255_sse2(_mm_mullo_epi16(fg, sa))));
+        dc = _mm_or_si128(_mm_and_si128(alpha_mask, dc),
+                          _mm_andnot_si128(alpha_mask, rga_cpu_div255_sse2(_mm_mullo_epi16(bg, da))));
+    }
+
+    fs = rga_cpu_blend_factor_sse2(blend->src_factor, sa, da);
+    fd = rga_cpu_blend_factor_sse2(blend->dst_factor, sa, da);
+
+    return _mm_add_epi16(rga_cpu_div255_sse2(_mm_mullo_epi16(sc, fs)),
+                         rga_cpu_div255_sse2(_mm_mullo_epi16(dc, fd)));
+}
+
+/* 4 pixels per loop, packus clamps the sums to 255 */
+static void rga_cpu_blend_row_sse2(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg,
+                                   int begin, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for (i = begin; i + 4 <= count; i += 4) {
+        __m128i f = _mm_loadu_si128((const __m128i *)(fg + (size_t)i * RGA_CPU_PIXEL_SIZE));
+        __m128i b = _mm_loadu_si128((const __m128i *)(bg + (size_t)i * RGA_CPU_PIXEL_SIZE));
+        __m128i lo, hi;
+
+        lo = rga_cpu_blend_pixel2_sse2(blend, _mm_unpacklo_epi8(f, zero), _mm_unpacklo_epi8(b, zero));
+        hi = rga_cpu_blend_pixel2_sse2(blend, _mm_unpackhi_epi8(f, zero), _mm_unpackhi_epi8(b, zero));
+        _mm_storeu_si128((__m128i *)(fg + (size_t)i * RGA_CPU_PIXEL_SIZE), _mm_packus_epi16(lo, hi));
+    }
+
+    rga_cpu_blend_row_c(blend, fg, bg, i, count);
+}
+#endif /* #ifdef RGA_CPU_BLEND_SSE2 */
+
+#ifdef RGA_CPU_BLEND_NEON
+static inline uint16x8_t rga_cpu_div255_neon(uint16x8_t x) {
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+
+static inline uint16x8_t rga_cpu_blend_factor_neon(RGA_CPU_BLEND_FACTOR factor, uint16x8_t sa,
+                                                   uint16x8_t da) {
+    const uint16x8_t max = vdupq_n_u16(0xff);
+
+    switch (factor) {
+        case RGA_CPU_BLEND_ONE:
+            return max;
+        case RGA_CPU_BLEND_SRC_ALPHA:
+            return sa;
+        case RGA_CPU_BLEND_DST_ALPHA:
+            return da;
+        case RGA_CPU_BLEND_INV_SRC_ALPHA:
+            return vsubq_u16(max, sa);
+        case RGA_CPU_BLEND_INV_DST_ALPHA:
+            return vsubq_u16(max, da);
+        case RGA_CPU_BLEND_ZERO:
+        default:
+            return vdupq_n_u16(0);
+    }
+}
+
+/* 8 pixels per loop, deinterleaved by vld4 */
+static void rga_cpu_blend_row_neon(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg,
+                                   int begin, int count) {
+    const uint8x8_t src_global = vdup_n_u8(blend->src_global_alpha);
+    const uint8x8_t dst_global = vdup_n_u8(blend->dst_global_alpha);
+    int i, c;
+
+    for (i = begin; i + 8 <= count; i += 8) {
+        uint8x8x4_t f = vld4_u8(fg + (size_t)i * RGA_CPU_PIXEL_SIZE);
+        uint8x8x4_t b = vld4_u8(bg + (size_t)i * RGA_CPU_PIXEL_SIZE);
+        uint16x8_t sa, da, fs, fd, sc, dc;
+        uint8x8_t sa8, da8;
+
+        sa = rga_cpu_div255_neon(vmull_u8(f.val[3], src_global));
+        da = rga_cpu_div255_neon(vmull_u8(b.val[3], dst_global));
+        sa8 = vmovn_u16(sa);
+        da8 = vmovn_u16(da);
+        fs = rga_cpu_blend_factor_neon(blend->src_factor, sa, da);
+        fd = rga_cpu_blend_factor_neon(blend->dst_factor, sa, da);
+
+        for (c = 0; c < 3; c++) {
+            sc = rga_cpu_div255_neon(vmull_u8(f.val[c], blend->premultiply ? sa8 : src_global));
+            dc = rga_cpu_div255_neon(vmull_u8(b.val[c], blend->premultiply ? da8 : dst_global));
+            f.val[c] = vqmovn_u16(vaddq_u16(rga_cpu_div255_neon(vmulq_u16(sc, fs)),
+                                            rga_cpu_div255_neon(vmulq_u16(dc, fd))));
+        }
+        f.val[3] = vqmovn_u16(vaddq_u16(rga_cpu_div255_neon(vmulq_u16(sa, fs)),
+                                        rga_cpu_div255_neon(vmulq_u16(da, fd))));
+
+        vst4_u8(fg + (size_t)i * RGA_CPU_PIXEL_SIZE, f);
+    }
+
+    rga_cpu_blend_row_c(blend, fg, bg, i, count);
+}
+#endif /* #ifdef RGA_CPU_BLEND_NEON */
+
+static rga_cpu_blend_fn g_cpu_blend_row = rga_cpu_blend_row_c;
+static pthread_once_t g_cpu_blend_once = PTHREAD_ONCE_INIT;
+
+static void rga_cpu_blend_dispatch_init(void) {
+    if (!rga_cpu_simd_enable())
+        return;
+
+#if defined(RGA_CPU_BLEND_SSE2)
+    g_cpu_blend_row = rga_cpu_blend_row_sse2;
+#elif defined(RGA_CPU_BLEND_NEON)
+    g_cpu_blend_row = rga_cpu_blend_row_neon;
+#endif
+}
+
+/* PD_mode is enum rga_alpha_blend_mode */
+void rga_cpu_blend_init(const struct rga_req *req, rga_cpu_blend_t *blend) {
+    /* Fs, Fd of each mode, in the order of enum rga_alpha_blend_mode */
+    static const RGA_CPU_BLEND_FACTOR factors[][2] = {
+        { RGA_CPU_BLEND_ZERO,          RGA_CPU_BLEND_ZERO },            /* NONE */
+        { RGA_CPU_BLEND_ONE,           RGA_CPU_BLEND_ZERO },            /* SRC */
+        { RGA_CPU_BLEND_ZERO,          RGA_CPU_BLEND_ONE },             /* DST */
+        { RGA_CPU_BLEND_ONE,           RGA_CPU_BLEND_INV_SRC_ALPHA },   /* SRC_OVER */
+        { RGA_CPU_BLEND_INV_DST_ALPHA, RGA_CPU_BLEND_ONE },             /* DST_OVER */
+        { RGA_CPU_BLEND_DST_ALPHA,     RGA_CPU_BLEND_ZERO },            /* SRC_IN */
+        { RGA_CPU_BLEND_ZERO,          RGA_CPU_BLEND_SRC_ALPHA },       /* DST_IN */
+        { RGA_CPU_BLEND_INV_DST_ALPHA, RGA_CPU_BLEND_ZERO },            /* SRC_OUT */
+        { RGA_CPU_BLEND_ZERO,          RGA_CPU_BLEND_INV_SRC_ALPHA },   /* DST_OUT */
+        { RGA_CPU_BLEND_DST_ALPHA,     RGA_CPU_BLEND_INV_SRC_ALPHA },   /* SRC_ATOP */
+        { RGA_CPU_BLEND_INV_DST_ALPHA, RGA_CPU_BLEND_SRC_ALPHA },       /* DST_ATOP */
+        { RGA_CPU_BLEND_INV_DST_ALPHA, RGA_CPU_BLEND_INV_SRC_ALPHA },   /* XOR */
+        { RGA_CPU_BLEND_ZERO,          RGA_CPU_BLEND_ZERO },            /* CLEAR */
+    };
+    bool global_alpha = req->feature.global_alpha_en;
+
+    pthread_once(&g_cpu_blend_once, rga_cpu_blend_dispatch_init);
+
+    if (req->PD_mode < sizeof(factors) / sizeof(factors[0])) {
+        blend->src_factor = factors[req->PD_mode][0];
+        blend->dst_factor = factors[req->PD_mode][1];
+    } else {
+        blend->src_factor = RGA_CPU_BLEND_ZERO;
+        blend->dst_factor = RGA_CPU_BLEND_ZERO;
+    }
+
+    blend->src_global_alpha = global_alpha ? req->fg_global_alpha : 0xff;
+    blend->dst_global_alpha = global_alpha ? req->bg_global_alpha : 0xff;
+    blend->premultiply = (req->alpha_rop_flag >> 9) & 0x1;
+}
+
+void rga_cpu_blend_row(const rga_cpu_blend_t *blend, uint8_t *fg, const uint8_t *bg, int count) {
+    g_cpu_blend_row(blend, fg, bg, 0, count);
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
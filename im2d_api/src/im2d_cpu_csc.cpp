@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define RGA_CPU_CSC_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RGA_CPU_CSC_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+/*
+ * Color space conversion of the CPU backend, with the Q10 BT.601/BT.709
+ * coefficients of the RGA2 CSC, selected by rga_req.yuv2rgb_mode the same
+ * way as the hardware, and the full_csc matrix of rga_req when it is set.
+ *
+ * All the kernels compute exactly the same integer expression, see
+ * rga_cpu_csc_t, so the SIMD and the C kernels are bit exact with each
+ * other. The SIMD kernels are SSE2 (baseline) or AVX2 (runtime detected) on
+ * x86 and NEON on ARM, see rga_cpu_simd_enable().
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+#define RGA_CPU_CSC_CHUNK   256
+
+typedef void (*rga_cpu_csc_planar_fn)(const rga_cpu_csc_t *csc, const uint8_t * const *in,
+                                      uint8_t * const *out, int begin, int count);
+
+/* coe * (in - in_offset) + out_offset */
+typedef struct rga_cpu_csc_coe {
+    int16_t coe[3][3];
+    int16_t in_offset[3];
+    int16_t out_offset[3];
+} rga_cpu_csc_coe_t;
+
+/* index: yuv2rgb_mode[1:0], 0 is the default BT.601 limit range */
+static const rga_cpu_csc_coe_t g_cpu_y2r_table[4] = {
+    { { { 1192, 0, 1634 }, { 1192, -400, -833 }, { 1192, 2066, 0 } }, { 16, 128, 128 }, { 0, 0, 0 } },
+    { { { 1192, 0, 1634 }, { 1192, -400, -833 }, { 1192, 2066, 0 } }, { 16, 128, 128 }, { 0, 0, 0 } },
+    { { { 1024, 0, 1436 }, { 1024, -352, -731 }, { 1024, 1815, 0 } }, { 0, 128, 128 }, { 0, 0, 0 } },
+    { { { 1192, 0, 1836 }, { 1192, -218, -546 }, { 1192, 2163, 0 } }, { 16, 128, 128 }, { 0, 0, 0 } },
+};
+
+/* index: yuv2rgb_mode[3:2], 0 is the default BT.601 limit range */
+static const rga_cpu_csc_coe_t g_cpu_r2y_table[4] = {
+    { { { 263, 516, 100 }, { -152, -298, 450 }, { 450, -377, -73 } }, { 0, 0, 0 }, { 16, 128, 128 } },
+    { { { 306, 601, 117 }, { -173, -339, 512 }, { 512, -429, -83 } }, { 0, 0, 0 }, { 0, 128, 128 } },
+    { { { 263, 516, 100 }, { -152, -298, 450 }, { 450, -377, -73 } }, { 0, 0, 0 }, { 16, 128, 128 } },
+    { { { 187, 629, 63 }, { -103, -347, 450 }, { 450, -409, -41 } }, { 0, 0, 0 }, { 16, 128, 128 } },
+};
+
+static void rga_cpu_csc_planar_c(const rga_cpu_csc_t *csc, const uint8_t * const *in,
+                                 uint8_t * const *out, int begin, int count) {
+    int i, c, value;
+
+    for (i = begin; i < count; i++) {
+        int in0 = in[0][i], in1 = in[1][i], in2 = in[2][i];
+
+        for (c = 0; c < 3; c++) {
+            value = (csc->coe[c][0] * in0 + csc->coe[c][1] * in1 +
+                     csc->coe[c][2] * in2 + csc->bias[c]) >> 10;
+            if (value < csc->min[c])
+                value = csc->min[c];
+            if (value > csc->max[c])
+                value = csc->max[c];
+            out[c][i] = (uint8_t)value;
+        }
+    }
+}
+
+#ifdef RGA_CPU_CSC_X86
+/*
+ * 16 pixels per loop: the inputs are interleaved as int16 pairs (in0, in1)
+ * and (in2, 0), so that pmaddwd computes the 3-tap dot product in int32.
+ * packs/packus saturate to [0, 255], the same as the clamp of the C kernel.
+ */
+static void rga_cpu_csc_planar_sse2(const rga_cpu_csc_t *csc, const uint8_t * const *in,
+                                    uint8_t * const *out, int begin, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i coe01[3], coe2[3], bias[3], min[3], max[3];
+    int i, c;
+
+    for (c = 0; c < 3; c++) {
+        coe01[c] = _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)csc->coe[c][1] << 16) |
+                                            (uint16_t)csc->coe[c][0]));
+        coe2[c] = _mm_set1_epi32((int32_t)(uint16_t)csc->coe[c][2]);
+        bias[c] = _mm_set1_epi32(csc->bias[c]);
+        min[c] = _mm_set1_epi8((char)csc->min[c]);
+        max[c] = _mm_set1_epi8((char)csc->max[c]);
+    }
+
+    for (i = begin; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in[0] + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in[1] + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(in[2] + i));
+        __m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+        __m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+        __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+        __m128i ab[4], dz[4];
+
+        ab[0] = _mm_unpacklo_epi16(a_lo, b_lo);
+        ab[1] = _mm_unpackhi_epi16(a_lo, b_lo);
+        ab[2] = _mm_unpacklo_epi16(a_hi, b_hi);
+        ab[3] = _mm_unpackhi_epi16(a_hi, b_hi);
+        dz[0] = _mm_unpacklo_epi16(d_lo, zero);
+        dz[1] = _mm_unpackhi_epi16(d_lo, zero);
+        dz[2] = _mm_unpacklo_epi16(d_hi, zero);
+        dz[3] = _mm_unpackhi_epi16(d_hi, zero);
+
+        for (c = 0; c < 3; c++) {
+            __m128i acc[4], result;
+            int q;
+
+            for (q = 0; q < 4; q++) {
+                acc[q] = _mm_add_epi32(_mm_madd_epi16(ab[q], coe01[c]), _mm_madd_epi16(dz[q], coe2[c]));
+                acc[q] = _mm_srai_epi32(_mm_add_epi32(acc[q], bias[c]), 10);
+            }
+
+            result = _mm_packus_epi16(_mm_packs_epi32(acc[0], acc[1]), _mm_packs_epi32(acc[2], acc[3]));
+            result = _mm_min_epu8(_mm_max_epu8(result, min[c]), max[c]);
+            _mm_storeu_si128((__m128i *)(out[c] + i), result);
+        }
+    }
+
+    rga_cpu_csc_planar_c(csc, in, out, i, count);
+}
+
+/*
+ * The same as SSE2 with 16 int16 per register. unpacklo/hi work within
+ * 128-bit lanes, so the results are pixels {0-3, 8-11} and {4-7, 12-15},
+ * which packs_epi32 puts back in order.
+ */
+__attribute__((target("avx2")))
+static void rga_cpu_csc_planar_avx2(const rga_cpu_csc_t *csc, const uint8_t * const *in,
+                                    uint8_t * const *out, int begin, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i coe01[3], coe2[3], bias[3];
+    __m128i min[3], max[3];
+    int i, c;
+
+    for (c = 0; c < 3; c++) {
+        coe01[c] = _mm256_set1_epi32((int32_t)(((uint32_t)(uint16_t)csc->coe[c][1] << 16) |
+                                               (uint16_t)csc->coe[c][0]));
+        coe2[c] = _mm256_set1_epi32((int32_t)(uint16_t)csc->coe[c][2]);
+        bias[c] = _mm256_set1_epi32(csc->bias[c]);
+        min[c] = _mm_set1_epi8((char)csc->min[c]);
+        max[c] = _mm_set1_epi8((char)csc->max[c]);
+    }
+
+    for (i = begin; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in[0] + i)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in[1] + i)));
+        __m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in[2] + i)));
+        __m256i ab_lo = _mm256_unpacklo_epi16(a, b), ab_hi = _mm256_unpackhi_epi16(a, b);
+        __m256i dz_lo = _mm256_unpacklo_epi16(d, zero), dz_hi = _mm256_unpackhi_epi16(d, zero);
+
+        for (c = 0; c < 3; c++) {
+            __m256i lo, hi, packed;
+            __m128i result;
+
+            lo = _mm256_add_epi32(_mm256_madd_epi16(ab_lo, coe01[c]), _mm256_madd_epi16(dz_lo, coe2[c]));
+            lo = _mm256_srai_epi32(_mm256_add_epi32(lo, bias[c]), 10);
+            hi = _mm256_add_epi32(_mm256_madd_epi16(ab_hi, coe01[c]), _mm256_madd_epi16(dz_hi, coe2[c]));
+            hi = _mm256_srai_epi32(_mm256_add_epi32(hi, bias[c]), 10);
+
+            packed = _mm256_packs_epi32(lo, hi);
+            result = _mm_packus_epi16(_mm256_castsi256_si128(packed),
+                                      _mm256_extracti128_si256(packed, 1));
+            result = _mm_min_epu8(_mm_max_epu8(result, min[c]), max[c]);
+            _mm_storeu_si128((__m128i *)(out[c] + i), result);
+        }
+    }
+
+    rga_cpu_csc_planar_c(csc, in, out, i, count);
+}
+#endif /* #ifdef RGA_CPU_CSC_X86 */
+
+#ifdef RGA_CPU_CSC_NEON
+/* 16 pixels per loop, widening multiply-accumulate in int32 */
+static void rga_cpu_csc_planar_neon(const rga_cpu_csc_t *csc, const uint8_t * const *in,
+                                    uint8_t * const *out, int begin, int count) {
+    int i, c;
+
+    for (i = begin; i + 16 <= count; i += 16) {
+        uint8x16_t a = vld1q_u8(in[0] + i);
+        uint8x16_t b = vld1q_u8(in[1] + i);
+        uint8x16_t d = vld1q_u8(in[2] + i);
+        int16x8_t a_lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+        int16x8_t a_hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+        int16x8_t b_lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(b)));
+        int16x8_t b_hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(b)));
+        int16x8_t d_lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(d)));
+        int16x8_t d_hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(d)));
+
+        for (c = 0; c < 3; c++) {
+            int16_t c0 = csc->coe[c][0], c1 = csc->coe[c][1], c2 = csc->coe[c][2];
+            int32x4_t bias = vdupq_n_s32(csc->bias[c]);
+            int32x4_t acc0, acc1, acc2, acc3;
+            int16x8_t lo, hi;
+            uint8x16_t result;
+
+            acc0 = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(bias, vget_low_s16(a_lo), c0),
+                                           vget_low_s16(b_lo), c1), vget_low_s16(d_lo), c2);
+            acc1 = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(bias, vget_high_s16(a_lo), c0),
+                                           vget_high_s16(b_lo), c1), vget_high_s16(d_lo), c2);
+            acc2 = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(bias, vget_low_s16(a_hi), c0),
+                                           vget_low_s16(b_hi), c1), vget_low_s16(d_hi), c2);
+            acc3 = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(bias, vget_high_s16(a_hi), c0),
+                                           vget_high_s16(b_hi), c1), vget_high_s16(d_hi), c2);
+
+            lo = vcombine_s16(vqmovn_s32(vshrq_n_s32(acc0, 10)), vqmovn_s32(vshrq_n_s32(acc1, 10)));
+            hi = vcombine_s16(vqmovn_s32(vshrq_n_s32(acc2, 10)), vqmovn_s32(vshrq_n_s32(acc3, 10)));
+            result = vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi));
+            result = vminq_u8(vmaxq_u8(result, vdupq_n_u8(csc->min[c])), vdupq_n_u8(csc->max[c]));
+            vst1q_u8(out[c] + i, result);
+        }
+    }
+
+    rga_cpu_csc_planar_c(csc, in, out, i, count);
+}
+#endif /* #ifdef RGA_CPU_CSC_NEON */
+
+static rga_cpu_csc_planar_fn g_cpu_csc_planar = rga_cpu_csc_planar_c;
+static pthread_once_t g_cpu_csc_once = PTHREAD_ONCE_INIT;
+
+static void rga_cpu_csc_dispatch_init(void) {
+    const char *name = "c";
+
+    if (!rga_cpu_simd_enable()) {
+        IM_LOGD("CPU csc kernel: %s\n", name);
+        return;
+    }
+
+#if defined(RGA_CPU_CSC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_cpu_csc_planar = rga_cpu_csc_planar_avx2;
+        name = "avx2";
+    } else {
+        g_cpu_csc_planar = rga_cpu_csc_planar_sse2;
+        name = "sse2";
+    }
+#elif defined(RGA_CPU_CSC_NEON)
+    g_cpu_csc_planar = rga_cpu_csc_planar_neon;
+    name = "neon";
+#endif
+
+    IM_LOGD("CPU csc kernel: %s\n", name);
+}
+
+static void rga_cpu_csc_init(rga_cpu_csc_t *csc, const rga_cpu_csc_coe_t *table) {
+    int c, k;
+
+    for (c = 0; c < 3; c++) {
+        csc->bias[c] = (table->out_offset[c] << 10) + 512;
+        for (k = 0; k < 3; k++) {
+            csc->coe[c][k] = table->coe[c][k];
+            csc->bias[c] -= table->coe[c][k] * table->in_offset[k];
+        }
+        csc->min[c] = 0;
+        csc->max[c] = 0xff;
+    }
+}
+
+void rga_cpu_csc_y2r(const struct rga_req *req, rga_cpu_csc_t *csc) {
+    rga_cpu_csc_init(csc, &g_cpu_y2r_table[req->yuv2rgb_mode & 0x3]);
+}
+
+void rga_cpu_csc_r2y(const struct rga_req *req, rga_cpu_csc_t *csc) {
+    rga_cpu_csc_init(csc, &g_cpu_r2y_table[(req->yuv2rgb_mode >> 2) & 0x3]);
+}
+
+static inline uint8_t rga_cpu_csc_range(uint16_t value) {
+    return value > 0xff ? 0xff : (uint8_t)value;
+}
+
+/*
+ * full_csc, see NormalRgaFullColorSpaceConvert(): the coefficients apply to
+ * R, G, B for rgb2yuv and to V, Y, U for yuv2yuv, with the offset in the
+ * same fixed point. The output is Y, U, V, clipped by full_csc_clip.
+ */
+void rga_cpu_csc_full(const struct rga_req *req, bool src_yuv, rga_cpu_csc_t *csc) {
+    const csc_coe_t *coe[3] = { &req->full_csc.coe_y, &req->full_csc.coe_u, &req->full_csc.coe_v };
+    int c;
+
+    for (c = 0; c < 3; c++) {
+        if (src_yuv) {
+            csc->coe[c][0] = coe[c]->g_y;
+            csc->coe[c][1] = coe[c]->b_u;
+            csc->coe[c][2] = coe[c]->r_v;
+        } else {
+            csc->coe[c][0] = coe[c]->r_v;
+            csc->coe[c][1] = coe[c]->g_y;
+            csc->coe[c][2] = coe[c]->b_u;
+        }
+        csc->bias[c] = coe[c]->off + 512;
+        csc->min[c] = 0;
+        csc->max[c] = 0xff;
+    }
+
+    if (req->feature.full_csc_clip_en) {
+        csc->min[0] = rga_cpu_csc_range(req->full_csc_clip.y.min);
+        csc->max[0] = rga_cpu_csc_range(req->full_csc_clip.y.max);
+        csc->min[1] = csc->min[2] = rga_cpu_csc_range(req->full_csc_clip.uv.min);
+        csc->max[1] = csc->max[2] = rga_cpu_csc_range(req->full_csc_clip.uv.max);
+    }
+}
+
+/* in/out: 3 planes of count pixels, out may be in */
+void rga_cpu_csc_planar(const rga_cpu_csc_t *csc, const uint8_t * const *in, uint8_t * const *out,
+                        int count) {
+    pthread_once(&g_cpu_csc_once, rga_cpu_csc_dispatch_init);
+
+    g_cpu_csc_planar(csc, in, out, 0, count);
+}
+
+/* convert a row of 4-channel pixels in place, the alpha is kept */
+void rga_cpu_csc_row(const rga_cpu_csc_t *csc, uint8_t *pixel, int count) {
+    uint8_t plane[3][RGA_CPU_CSC_CHUNK];
+    uint8_t *planes[3] = { plane[0], plane[1], plane[2] };
+    int i, k, n;
+
+    for (i = 0; i < count; i += n) {
+        uint8_t *p = pixel + (size_t)i * RGA_CPU_PIXEL_SIZE;
+
+        n = count - i < RGA_CPU_CSC_CHUNK ? count - i : RGA_CPU_CSC_CHUNK;
+
+        for (k = 0; k < n; k++) {
+            plane[0][k] = p[k * RGA_CPU_PIXEL_SIZE + 0];
+            plane[1][k] = p[k * RGA_CPU_PIXEL_SIZE + 1];
+            plane[2][k] = p[k * RGA_CPU_PIXEL_SIZE + 2];
+        }
+
+        rga_cpu_csc_planar(csc, (const uint8_t * const *)planes, planes, n);
+
+        for (k = 0; k < n; k++) {
+            p[k * RGA_CPU_PIXEL_SIZE + 0] = plane[0][k];
+            p[k * RGA_CPU_PIXEL_SIZE + 1] = plane[1][k];
+            p[k * RGA_CPU_PIXEL_SIZE + 2] = plane[2][k];
+        }
+    }
+}
+
+/*
+ * Direct kernels: YUV (SP/P/packed) <-> 24/32-bit RGB of the same size,
+ * without the 4-channel rows. The results are the same as unpack + csc +
+ * pack: the chroma is sampled by nearest for y2r, and averaged over the
+ * pixels sharing it for r2y.
+ */
+static inline bool rga_cpu_csc_is_direct_yuv(const struct rga_cpu_format *format) {
+    return format->layout == RGA_CPU_LAYOUT_YUV_PACKED ||
+           format->layout == RGA_CPU_LAYOUT_YUV_SP ||
+           format->layout == RGA_CPU_LAYOUT_YUV_P;
+}
+
+bool rga_cpu_csc_direct_supported(const rga_cpu_image_t *src, const rga_cpu_image_t *dst) {
+    if (src->width != dst->width || src->height != dst->height)
+        return false;
+
+    return (rga_cpu_csc_is_direct_yuv(src->info) && dst->info->layout == RGA_CPU_LAYOUT_RGB) ||
+           (src->info->layout == RGA_CPU_LAYOUT_RGB && rga_cpu_csc_is_direct_yuv(dst->info));
+}
+
+/* Y, Cb, Cr of the pixels [x0, x0 + count) of row y */
+static void rga_cpu_yuv_load(const rga_cpu_image_t *image, int y, int x0, int count,
+                             uint8_t * const *yuv) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    const uint8_t *line = image->plane[0] + (size_t)y * image->stride[0];
+    const uint8_t *cb, *cr;
+    int i, cx, step;
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_PACKED) {
+        for (i = 0; i < count; i++) {
+            const uint8_t *group = line + (size_t)((x0 + i) >> 1) * 4;
+
+            yuv[0][i] = group[((x0 + i) & 1) ? offset[2] : offset[0]];
+            yuv[1][i] = group[offset[1]];
+            yuv[2][i] = group[offset[3]];
+        }
+        return;
+    }
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        cb = image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1] + offset[1];
+        cr = image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1] + offset[2];
+        step = 2;
+    } else {
+        cb = image->plane[offset[1]] + (size_t)(y >> format->vsub) * image->stride[offset[1]];
+        cr = image->plane[offset[2]] + (size_t)(y >> format->vsub) * image->stride[offset[2]];
+        step = 1;
+    }
+
+    memcpy(yuv[0], line + x0, count);
+    for (i = 0; i < count; i++) {
+        cx = ((x0 + i) >> format->hsub) * step;
+        yuv[1][i] = cb[cx];
+        yuv[2][i] = cr[cx];
+    }
+}
+
+/*
+ * Store rows [y, y + rows) sharing one chroma row, the pairs of pixels
+ * sharing a chroma sample start on even x. count ends on an even x unless
+ * it is the end of the row, so that no pair is split between two calls.
+ */
+static void rga_cpu_yuv_store(const rga_cpu_image_t *image, int y, int rows, int x0, int count,
+                              uint8_t * const (*yuv)[3]) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    uint8_t *line, *cb, *cr;
+    int r, i, k, n, sum_cb, sum_cr, total, cx, step;
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_PACKED) {
+        line = image->plane[0] + (size_t)y * image->stride[0];
+
+        for (i = 0; i < count; i++) {
+            uint8_t *group = line + (size_t)((x0 + i) >> 1) * 4;
+
+            group[((x0 + i) & 1) ? offset[2] : offset[0]] = yuv[0][0][i];
+            if (!((x0 + i) & 1) && i + 1 < count) {
+                group[offset[1]] = (yuv[0][1][i] + yuv[0][1][i + 1] + 1) >> 1;
+                group[offset[3]] = (yuv[0][2][i] + yuv[0][2][i + 1] + 1) >> 1;
+            } else if (!((x0 + i) & 1) || i == 0) {
+                group[offset[1]] = yuv[0][1][i];
+                group[offset[3]] = yuv[0][2][i];
+            }
+        }
+        return;
+    }
+
+    for (r = 0; r < rows; r++)
+        memcpy(image->plane[0] + (size_t)(y + r) * image->stride[0] + x0, yuv[r][0], count);
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        cb = image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1] + offset[1];
+        cr = image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1] + offset[2];
+        step = 2;
+    } else {
+        cb = image->plane[offset[1]] + (size_t)(y >> format->vsub) * image->stride[offset[1]];
+        cr = image->plane[offset[2]] + (size_t)(y >> format->vsub) * image->stride[offset[2]];
+        step = 1;
+    }
+
+    for (i = 0; i < count; i += n) {
+        n = format->hsub && !((x0 + i) & 1) && i + 1 < count ? 2 : 1;
+        total = rows * n;
+
+        sum_cb = sum_cr = 0;
+        for (r = 0; r < rows; r++) {
+            for (k = 0; k < n; k++) {
+                sum_cb += yuv[r][1][i + k];
+                sum_cr += yuv[r][2][i + k];
+            }
+        }
+
+        cx = ((x0 + i) >> format->hsub) * step;
+        cb[cx] = (sum_cb + total / 2) / total;
+        cr[cx] = (sum_cr + total / 2) / total;
+    }
+}
+
+static void rga_cpu_rgb_load(const rga_cpu_image_t *image, int y, int x0, int count,
+                             uint8_t * const *rgb) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    const uint8_t *p = image->plane[0] + (size_t)y * image->stride[0] + (size_t)x0 * format->bpp;
+    int i;
+
+    for (i = 0; i < count; i++, p += format->bpp) {
+        rgb[0][i] = p[offset[0]];
+        rgb[1][i] = p[offset[1]];
+        rgb[2][i] = p[offset[2]];
+    }
+}
+
+static void rga_cpu_rgb_store(const rga_cpu_image_t *image, int y, int x0, int count,
+                              uint8_t * const *rgb) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    uint8_t *p = image->plane[0] + (size_t)y * image->stride[0] + (size_t)x0 * format->bpp;
+    /* the alpha, or the unused byte of a 32-bit format without alpha */
+    int alpha = offset[3] >= 0 ? offset[3] : 6 - offset[0] - offset[1] - offset[2];
+    int i;
+
+    for (i = 0; i < count; i++, p += format->bpp) {
+        p[offset[0]] = rgb[0][i];
+        p[offset[1]] = rgb[1][i];
+        p[offset[2]] = rgb[2][i];
+        if (format->bpp == 4)
+            p[alpha] = 0xff;
+    }
+}
+
+/* convert rows [row, row + rows) of the active rect, rows shares one chroma row of a YUV dst */
+void rga_cpu_csc_direct_rows(const rga_cpu_csc_t *csc, const rga_cpu_image_t *src,
+                             const rga_cpu_image_t *dst, int row, int rows) {
+    uint8_t in[3][RGA_CPU_CSC_CHUNK];
+    uint8_t out[2][3][RGA_CPU_CSC_CHUNK];
+    uint8_t *in_planes[3] = { in[0], in[1], in[2] };
+    uint8_t *out_planes[2][3] = {
+        { out[0][0], out[0][1], out[0][2] },
+        { out[1][0], out[1][1], out[1][2] },
+    };
+    bool src_yuv = rga_cpu_csc_is_direct_yuv(src->info);
+    int i, n, r;
+
+    for (i = 0; i < dst->width; i += n) {
+        /* end the chunks on even x of dst, see rga_cpu_yuv_store() */
+        n = RGA_CPU_CSC_CHUNK - ((dst->x + i) & (RGA_CPU_CSC_CHUNK - 1));
+        if (n > dst->width - i)
+            n = dst->width - i;
+
+        for (r = 0; r < rows; r++) {
+            if (src_yuv) {
+                rga_cpu_yuv_load(src, src->y + row + r, src->x + i, n, in_planes);
+                rga_cpu_csc_planar(csc, (const uint8_t * const *)in_planes, out_planes[0], n);
+                rga_cpu_rgb_store(dst, dst->y + row + r, dst->x + i, n, out_planes[0]);
+            } else {
+                rga_cpu_rgb_load(src, src->y + row + r, src->x + i, n, in_planes);
+                rga_cpu_csc_planar(csc, (const uint8_t * const *)in_planes, out_planes[r], n);
+            }
+        }
+
+        if (!src_yuv)
+            rga_cpu_yuv_store(dst, dst->y + row, rows, dst->x + i, n,
+                              (uint8_t * const (*)[3])out_planes);
+    }
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
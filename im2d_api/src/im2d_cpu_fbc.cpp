@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "im2d_cpu.h"
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+/*
+ * FBC and tile layouts of the CPU backend, the image is split into blocks
+ * of block_w x block_h pixels, stored in raster order of the blocks. The
+ * pixels of a block are stored as its rows of pixels (Y for YUV), followed
+ * by its rows of CbCr pairs for semi-planar YUV.
+ *
+ * TILE8x8/TILE4x4: the blocks are the tiles, back to back.
+ *
+ * AFBC16x16/AFBC32x8/RKFBC64x4: the blocks are superblocks of 16 subblocks
+ * of 4x4 pixels, in raster order. Each superblock has a 16-byte header:
+ *   [0, 4)     offset of the body from the start of the buffer, little endian
+ *   [4, 16)    16 6-bit subblock sizes, from the lsb, 1: uncompressed
+ * or, with a body offset of 0, a solid superblock:
+ *   [8, 16)    the color of all its pixels, the bytes of a pixel, or Y, Cb, Cr
+ * The headers come first, the body of a superblock is at a fixed slot after
+ * them. The encoder writes solid or uncompressed superblocks, subblocks
+ * with other sizes hold the compressed payload of the hardware, which is
+ * only accounted for: the decoder reports its size and fails.
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+#define RGA_CPU_FBC_HEADER_SIZE     16
+#define RGA_CPU_FBC_HEADER_ALIGN    1024
+#define RGA_CPU_FBC_SUBBLOCK        4
+#define RGA_CPU_FBC_SUBBLOCKS       16
+#define RGA_CPU_FBC_UNCOMPRESSED    1
+
+struct rga_cpu_fbc_layout {
+    int mode;                   /* IM_*_MODE */
+    const char *name;
+    int block_w;
+    int block_h;
+    bool fbc;                   /* superblocks with headers, or tiles */
+};
+
+static const rga_cpu_fbc_layout_t g_cpu_fbc_layout_table[] = {
+    { IM_AFBC16x16_MODE,    "afbc16x16",    16, 16, true },
+    { IM_AFBC32x8_MODE,     "afbc32x8",     32,  8, true },
+    { IM_RKFBC64x4_MODE,    "rkfbc64x4",    64,  4, true },
+    { IM_TILE8x8_MODE,      "tile8x8",       8,  8, false },
+    { IM_TILE4x4_MODE,      "tile4x4",       4,  4, false },
+};
+
+bool rga_cpu_fbc_is_raster(const rga_img_info_t *info) {
+    return info->rd_mode == 0 || info->rd_mode == raster_mode;
+}
+
+static const rga_cpu_fbc_layout_t *rga_cpu_fbc_get_layout(int mode) {
+    size_t i;
+
+    for (i = 0; i < sizeof(g_cpu_fbc_layout_table) / sizeof(g_cpu_fbc_layout_table[0]); i++)
+        if (g_cpu_fbc_layout_table[i].mode == mode)
+            return &g_cpu_fbc_layout_table[i];
+
+    return NULL;
+}
+
+/* bytes of the pixels of a w x h block */
+static size_t rga_cpu_fbc_pixels_size(const rga_cpu_image_t *image, int w, int h) {
+    const struct rga_cpu_format *format = image->info;
+    size_t size = (size_t)w * h * format->bpp;
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP)
+        size += (size_t)(w >> format->hsub) * 2 * (h >> format->vsub);
+
+    return size;
+}
+
+static uint8_t *rga_cpu_fbc_pack(const rga_cpu_image_t *image, int x, int y, int w, int h,
+                                 uint8_t *out) {
+    const struct rga_cpu_format *format = image->info;
+    size_t size = (size_t)w * format->bpp;
+    int r;
+
+    for (r = 0; r < h; r++, out += size)
+        memcpy(out, image->plane[0] + (size_t)(y + r) * image->stride[0] + (size_t)x * format->bpp,
+               size);
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        size = (size_t)(w >> format->hsub) * 2;
+        for (r = 0; r < h >> format->vsub; r++, out += size)
+            memcpy(out, image->plane[1] + (size_t)((y >> format->vsub) + r) * image->stride[1] +
+                        (size_t)(x >> format->hsub) * 2, size);
+    }
+
+    return out;
+}
+
+static const uint8_t *rga_cpu_fbc_unpack(const rga_cpu_image_t *image, int x, int y, int w, int h,
+                                         const uint8_t *in) {
+    const struct rga_cpu_format *format = image->info;
+    size_t size = (size_t)w * format->bpp;
+    int r;
+
+    for (r = 0; r < h; r++, in += size)
+        memcpy(image->plane[0] + (size_t)(y + r) * image->stride[0] + (size_t)x * format->bpp, in,
+               size);
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        size = (size_t)(w >> format->hsub) * 2;
+        for (r = 0; r < h >> format->vsub; r++, in += size)
+            memcpy(image->plane[1] + (size_t)((y >> format->vsub) + r) * image->stride[1] +
+                   (size_t)(x >> format->hsub) * 2, in, size);
+    }
+
+    return in;
+}
+
+/* fill the w x h pixels at (x, y) with a solid color */
+static void rga_cpu_fbc_fill(const rga_cpu_image_t *image, int x, int y, int w, int h,
+                             const uint8_t *color) {
+    const struct rga_cpu_format *format = image->info;
+    uint8_t *line;
+    int r, i;
+
+    for (r = 0; r < h; r++) {
+        line = image->plane[0] + (size_t)(y + r) * image->stride[0] + (size_t)x * format->bpp;
+        for (i = 0; i < w; i++)
+            memcpy(line + (size_t)i * format->bpp, color, format->bpp);
+    }
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        for (r = 0; r < h >> format->vsub; r++) {
+            line = image->plane[1] + (size_t)((y >> format->vsub) + r) * image->stride[1] +
+                   (size_t)(x >> format->hsub) * 2;
+            for (i = 0; i < w >> format->hsub; i++)
+                memcpy(line + (size_t)i * 2, color + 1, 2);
+        }
+    }
+}
+
+/* whether the w x h pixels at (x, y) have one color, and the 8 bytes of the color */
+static bool rga_cpu_fbc_is_solid(const rga_cpu_image_t *image, int x, int y, int w, int h,
+                                 uint8_t *color) {
+    const struct rga_cpu_format *format = image->info;
+    const uint8_t *line;
+    int r, i;
+
+    memset(color, 0x0, 8);
+    memcpy(color, image->plane[0] + (size_t)y * image->stride[0] + (size_t)x * format->bpp,
+           format->bpp);
+    for (r = 0; r < h; r++) {
+        line = image->plane[0] + (size_t)(y + r) * image->stride[0] + (size_t)x * format->bpp;
+        for (i = 0; i < w; i++)
+            if (memcmp(line + (size_t)i * format->bpp, color, format->bpp) != 0)
+                return false;
+    }
+
+    if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+        memcpy(color + 1, image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1] +
+                          (size_t)(x >> format->hsub) * 2, 2);
+        for (r = 0; r < h >> format->vsub; r++) {
+            line = image->plane[1] + (size_t)((y >> format->vsub) + r) * image->stride[1] +
+                   (size_t)(x >> format->hsub) * 2;
+            for (i = 0; i < w >> format->hsub; i++)
+                if (memcmp(line + (size_t)i * 2, color + 1, 2) != 0)
+                    return false;
+        }
+    }
+
+    return true;
+}
+
+static inline uint32_t rga_cpu_fbc_read32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void rga_cpu_fbc_write32(uint8_t *p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = value >> 24;
+}
+
+static inline int rga_cpu_fbc_subblock_size(const uint8_t *header, int index) {
+    int bit = 32 + index * 6;
+    int value = header[bit >> 3];
+
+    /* a size crosses a byte unless it starts in the lowest 2 bits */
+    if ((bit & 7) > 2)
+        value |= header[(bit >> 3) + 1] << 8;
+
+    return (value >> (bit & 7)) & 0x3f;
+}
+
+static inline void rga_cpu_fbc_block_origin(const rga_cpu_fbc_t *fbc, int bx, int by, int *x, int *y) {
+    *x = bx * fbc->layout->block_w;
+    *y = by * fbc->layout->block_h;
+}
+
+static void rga_cpu_fbc_decode_rows(void *arg, int begin, int end) {
+    rga_cpu_fbc_t *fbc = (rga_cpu_fbc_t *)arg;
+    const rga_cpu_fbc_layout_t *layout = fbc->layout;
+    int per_row = layout->block_w / RGA_CPU_FBC_SUBBLOCK;
+    const uint8_t *header, *body;
+    size_t index;
+    int by, bx, x, y, i;
+
+    for (by = fbc->block_y[0] + begin; by < fbc->block_y[0] + end; by++) {
+        for (bx = fbc->block_x[0]; bx < fbc->block_x[1]; bx++) {
+            index = (size_t)by * fbc->blocks_w + bx;
+            rga_cpu_fbc_block_origin(fbc, bx, by, &x, &y);
+
+            if (!layout->fbc) {
+                rga_cpu_fbc_unpack(&fbc->raster, x, y, layout->block_w, layout->block_h,
+                                   fbc->base + index * fbc->block_size);
+                continue;
+            }
+
+            header = fbc->base + index * RGA_CPU_FBC_HEADER_SIZE;
+            if (rga_cpu_fbc_read32(header) == 0) {
+                rga_cpu_fbc_fill(&fbc->raster, x, y, layout->block_w, layout->block_h, header + 8);
+                continue;
+            }
+
+            body = fbc->base + rga_cpu_fbc_read32(header);
+            for (i = 0; i < RGA_CPU_FBC_SUBBLOCKS; i++)
+                body = rga_cpu_fbc_unpack(&fbc->raster,
+                                          x + (i % per_row) * RGA_CPU_FBC_SUBBLOCK,
+                                          y + (i / per_row) * RGA_CPU_FBC_SUBBLOCK,
+                                          RGA_CPU_FBC_SUBBLOCK, RGA_CPU_FBC_SUBBLOCK, body);
+        }
+    }
+}
+
+static void rga_cpu_fbc_encode_rows(void *arg, int begin, int end) {
+    rga_cpu_fbc_t *fbc = (rga_cpu_fbc_t *)arg;
+    const rga_cpu_fbc_layout_t *layout = fbc->layout;
+    int per_row = layout->block_w / RGA_CPU_FBC_SUBBLOCK;
+    uint8_t *header, *body, color[8];
+    size_t index, offset;
+    int by, bx, x, y, i;
+
+    for (by = fbc->block_y[0] + begin; by < fbc->block_y[0] + end; by++) {
+        for (bx = fbc->block_x[0]; bx < fbc->block_x[1]; bx++) {
+            index = (size_t)by * fbc->blocks_w + bx;
+            rga_cpu_fbc_block_origin(fbc, bx, by, &x, &y);
+
+            if (!layout->fbc) {
+                rga_cpu_fbc_pack(&fbc->raster, x, y, layout->block_w, layout->block_h,
+                                 fbc->base + index * fbc->block_size);
+                continue;
+            }
+
+            header = fbc->base + index * RGA_CPU_FBC_HEADER_SIZE;
+            memset(header, 0x0, RGA_CPU_FBC_HEADER_SIZE);
+            if (rga_cpu_fbc_is_solid(&fbc->raster, x, y, layout->block_w, layout->block_h, color)) {
+                memcpy(header + 8, color, sizeof(color));
+                continue;
+            }
+
+            offset = fbc->header_size + index * fbc->block_size;
+            rga_cpu_fbc_write32(header, (uint32_t)offset);
+            /* 16 x 6-bit sizes of 1 */
+            for (i = 0; i < RGA_CPU_FBC_SUBBLOCKS; i++)
+                header[4 + i * 6 / 8] |= RGA_CPU_FBC_UNCOMPRESSED << (i * 6 % 8);
+
+            body = fbc->base + offset;
+            for (i = 0; i < RGA_CPU_FBC_SUBBLOCKS; i++)
+                body = rga_cpu_fbc_pack(&fbc->raster,
+                                        x + (i % per_row) * RGA_CPU_FBC_SUBBLOCK,
+                                        y + (i / per_row) * RGA_CPU_FBC_SUBBLOCK,
+                                        RGA_CPU_FBC_SUBBLOCK, RGA_CPU_FBC_SUBBLOCK, body);
+        }
+    }
+}
+
+/*
+ * Check the headers of the blocks of the rect before decoding them, and
+ * account for the bytes a FBC read of them moves.
+ */
+static int rga_cpu_fbc_check(const rga_cpu_fbc_t *fbc) {
+    size_t subblock_size = fbc->block_size / RGA_CPU_FBC_SUBBLOCKS;
+    size_t index, offset, payload = 0;
+    const uint8_t *header;
+    int by, bx, i, size, blocks = 0, solid = 0, compressed = 0;
+
+    if (!fbc->layout->fbc)
+        return 0;
+
+    for (by = fbc->block_y[0]; by < fbc->block_y[1]; by++) {
+        for (bx = fbc->block_x[0]; bx < fbc->block_x[1]; bx++) {
+            index = (size_t)by * fbc->blocks_w + bx;
+            header = fbc->base + index * RGA_CPU_FBC_HEADER_SIZE;
+            offset = rga_cpu_fbc_read32(header);
+            blocks++;
+
+            if (offset == 0) {
+                solid++;
+                continue;
+            }
+
+            for (i = 0; i < RGA_CPU_FBC_SUBBLOCKS; i++) {
+                size = rga_cpu_fbc_subblock_size(header, i);
+                if (size == RGA_CPU_FBC_UNCOMPRESSED) {
+                    payload += subblock_size;
+                } else {
+                    payload += size;
+                    compressed++;
+                }
+            }
+
+            if (fbc->size != 0 && offset + fbc->block_size > fbc->size) {
+                IM_LOGE("%s superblock[%d, %d] body offset[%zu] is out of the buffer size[%zu].\n",
+                        fbc->layout->name, bx, by, offset, fbc->size);
+                return -EINVAL;
+            }
+        }
+    }
+
+    IM_LOGD("%s: %d superblocks, %d solid, %zu header + %zu payload bytes, raster %zu bytes.\n",
+            fbc->layout->name, blocks, solid, (size_t)blocks * RGA_CPU_FBC_HEADER_SIZE, payload,
+            (size_t)blocks * fbc->block_size);
+
+    if (compressed) {
+        IM_LOGE("%s has %d compressed subblocks, the CPU backend only decodes solid and uncompressed superblocks.\n",
+                fbc->layout->name, compressed);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/*
+ * The rect [x, y, width, height] is in the pixels of the image, the rect
+ * of a 90/270 rotated dst is the one in its memory.
+ */
+int rga_cpu_fbc_init(rga_cpu_fbc_t *fbc, const rga_img_info_t *info, const rga_cpu_memory_t *memory,
+                     int x, int y, int width, int height) {
+    const rga_cpu_fbc_layout_t *layout;
+    rga_cpu_memory_t buffer;
+    rga_img_info_t whole;
+    size_t blocks, total;
+    int ret;
+
+    memset(fbc, 0x0, sizeof(*fbc));
+
+    layout = rga_cpu_fbc_get_layout(info->rd_mode);
+    if (layout == NULL) {
+        IM_LOGE("CPU backend does not support rd_mode[0x%x].\n", info->rd_mode);
+        return -EINVAL;
+    }
+    fbc->layout = layout;
+
+    if (info->vir_w % layout->block_w || info->vir_h % layout->block_h) {
+        IM_LOGE("%s virtual size[%d, %d] is not aligned to the block[%dx%d].\n",
+                layout->name, info->vir_w, info->vir_h, layout->block_w, layout->block_h);
+        return -EINVAL;
+    }
+
+    /* the raster copy, with the whole virtual image as the rect */
+    whole = *info;
+    whole.x_offset = 0;
+    whole.y_offset = 0;
+    whole.act_w = info->vir_w;
+    whole.act_h = info->vir_h;
+    whole.rd_mode = raster_mode;
+
+    /* the format of the raster copy, before it is allocated */
+    buffer.base = memory->base;
+    buffer.size = 0;
+    ret = rga_cpu_image_init(&fbc->raster, &whole, &buffer, false);
+    if (ret < 0)
+        return ret;
+
+    switch (fbc->raster.info->layout) {
+        case RGA_CPU_LAYOUT_YUV_P:
+        case RGA_CPU_LAYOUT_YUV_PACKED:
+            IM_LOGE("CPU backend does not support %s of format[0x%x].\n",
+                    layout->name, fbc->raster.format);
+            return -EINVAL;
+        default:
+            break;
+    }
+
+    fbc->base = memory->base;
+    fbc->size = memory->size;
+    fbc->blocks_w = info->vir_w / layout->block_w;
+    blocks = (size_t)fbc->blocks_w * (info->vir_h / layout->block_h);
+    fbc->block_size = rga_cpu_fbc_pixels_size(&fbc->raster, layout->block_w, layout->block_h);
+    if (layout->fbc)
+        fbc->header_size = (blocks * RGA_CPU_FBC_HEADER_SIZE + RGA_CPU_FBC_HEADER_ALIGN - 1) /
+                           RGA_CPU_FBC_HEADER_ALIGN * RGA_CPU_FBC_HEADER_ALIGN;
+    total = fbc->header_size + blocks * fbc->block_size;
+    if (fbc->size != 0 && total > fbc->size) {
+        IM_LOGE("buffer size[%zu] is smaller than the %s image[%dx%d format 0x%x] size[%zu].\n",
+                fbc->size, layout->name, info->vir_w, info->vir_h, fbc->raster.format, total);
+        return -EINVAL;
+    }
+
+    if (width <= 0 || height <= 0 || x + width > info->vir_w || y + height > info->vir_h) {
+        IM_LOGE("invalid rect[%d, %d, %d, %d] in virtual size[%d, %d].\n",
+                x, y, width, height, info->vir_w, info->vir_h);
+        return -EINVAL;
+    }
+    fbc->block_x[0] = x / layout->block_w;
+    fbc->block_x[1] = (x + width + layout->block_w - 1) / layout->block_w;
+    fbc->block_y[0] = y / layout->block_h;
+    fbc->block_y[1] = (y + height + layout->block_h - 1) / layout->block_h;
+    fbc->partial = (x | width) % layout->block_w || (y | height) % layout->block_h;
+
+    /* the raster copy has the layout of the virtual image */
+    fbc->memory.size = rga_cpu_fbc_pixels_size(&fbc->raster, info->vir_w, info->vir_h);
+    fbc->memory.base = (uint8_t *)malloc(fbc->memory.size);
+    if (fbc->memory.base == NULL) {
+        IM_LOGE("CPU %s raster buffer alloc failed!\n", layout->name);
+        return -ENOMEM;
+    }
+
+    return rga_cpu_image_init(&fbc->raster, &whole, &fbc->memory, false);
+}
+
+/* decode the blocks of the rect to the raster copy, by block rows */
+int rga_cpu_fbc_decode(rga_cpu_fbc_t *fbc) {
+    int ret;
+
+    ret = rga_cpu_fbc_check(fbc);
+    if (ret < 0)
+        return ret;
+
+    rga_cpu_parallel_for(fbc->block_y[1] - fbc->block_y[0], 0, rga_cpu_fbc_decode_rows, fbc);
+
+    return 0;
+}
+
+/* encode the blocks of the rect from the raster copy, by block rows */
+void rga_cpu_fbc_encode(rga_cpu_fbc_t *fbc) {
+    rga_cpu_parallel_for(fbc->block_y[1] - fbc->block_y[0], 0, rga_cpu_fbc_encode_rows, fbc);
+
+    if (fbc->layout->fbc)
+        rga_cpu_fbc_check(fbc);
+}
+
+void rga_cpu_fbc_exit(rga_cpu_fbc_t *fbc) {
+    free(fbc->memory.base);
+    fbc->memory.base = NULL;
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
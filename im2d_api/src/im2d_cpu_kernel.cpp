@@ -0,0 +1,1218 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <unistd.h>
+#include <pthread.h>
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#define RGA_CPU_THREAD_MAX      16
+
+static const struct rga_cpu_format g_cpu_format_table[] = {
+    { RK_FORMAT_RGBA_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  0,  1,  2,  3 } },
+    { RK_FORMAT_RGBX_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  0,  1,  2, -1 } },
+    { RK_FORMAT_BGRA_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  2,  1,  0,  3 } },
+    { RK_FORMAT_BGRX_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  2,  1,  0, -1 } },
+    { RK_FORMAT_ARGB_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  1,  2,  3,  0 } },
+    { RK_FORMAT_XRGB_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  1,  2,  3, -1 } },
+    { RK_FORMAT_ABGR_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  3,  2,  1,  0 } },
+    { RK_FORMAT_XBGR_8888,      RGA_CPU_LAYOUT_RGB,         4, 0, 0, {  3,  2,  1, -1 } },
+    { RK_FORMAT_RGB_888,        RGA_CPU_LAYOUT_RGB,         3, 0, 0, {  0,  1,  2, -1 } },
+    { RK_FORMAT_BGR_888,        RGA_CPU_LAYOUT_RGB,         3, 0, 0, {  2,  1,  0, -1 } },
+    { RK_FORMAT_RGB_565,        RGA_CPU_LAYOUT_RGB565,      2, 0, 0, { 11,  5,  0, -1 } },
+    { RK_FORMAT_BGR_565,        RGA_CPU_LAYOUT_RGB565,      2, 0, 0, {  0,  5, 11, -1 } },
+    /* 16 bit formats are named from the msb, the same as RGB_565 */
+    { RK_FORMAT_RGBA_5551,      RGA_CPU_LAYOUT_RGBA5551,    2, 0, 0, { 11,  6,  1,  0 } },
+    { RK_FORMAT_BGRA_5551,      RGA_CPU_LAYOUT_RGBA5551,    2, 0, 0, {  1,  6, 11,  0 } },
+    { RK_FORMAT_ARGB_5551,      RGA_CPU_LAYOUT_RGBA5551,    2, 0, 0, { 10,  5,  0, 15 } },
+    { RK_FORMAT_ABGR_5551,      RGA_CPU_LAYOUT_RGBA5551,    2, 0, 0, {  0,  5, 10, 15 } },
+    { RK_FORMAT_RGBA_4444,      RGA_CPU_LAYOUT_RGBA4444,    2, 0, 0, { 12,  8,  4,  0 } },
+    { RK_FORMAT_BGRA_4444,      RGA_CPU_LAYOUT_RGBA4444,    2, 0, 0, {  4,  8, 12,  0 } },
+    { RK_FORMAT_ARGB_4444,      RGA_CPU_LAYOUT_RGBA4444,    2, 0, 0, {  8,  4,  0, 12 } },
+    { RK_FORMAT_ABGR_4444,      RGA_CPU_LAYOUT_RGBA4444,    2, 0, 0, {  0,  4,  8, 12 } },
+    { RK_FORMAT_YCbCr_420_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 1, 1, {  0,  0,  1, -1 } },
+    { RK_FORMAT_YCrCb_420_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 1, 1, {  0,  1,  0, -1 } },
+    { RK_FORMAT_YCbCr_422_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 1, 0, {  0,  0,  1, -1 } },
+    { RK_FORMAT_YCrCb_422_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 1, 0, {  0,  1,  0, -1 } },
+    { RK_FORMAT_YCbCr_444_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 0, 0, {  0,  0,  1, -1 } },
+    { RK_FORMAT_YCrCb_444_SP,   RGA_CPU_LAYOUT_YUV_SP,      1, 0, 0, {  0,  1,  0, -1 } },
+    { RK_FORMAT_YCbCr_420_P,    RGA_CPU_LAYOUT_YUV_P,       1, 1, 1, {  0,  1,  2, -1 } },
+    { RK_FORMAT_YCrCb_420_P,    RGA_CPU_LAYOUT_YUV_P,       1, 1, 1, {  0,  2,  1, -1 } },
+    { RK_FORMAT_YCbCr_422_P,    RGA_CPU_LAYOUT_YUV_P,       1, 1, 0, {  0,  1,  2, -1 } },
+    { RK_FORMAT_YCrCb_422_P,    RGA_CPU_LAYOUT_YUV_P,       1, 1, 0, {  0,  2,  1, -1 } },
+    { RK_FORMAT_YUYV_422,       RGA_CPU_LAYOUT_YUV_PACKED,  2, 1, 0, {  0,  1,  2,  3 } },
+    { RK_FORMAT_YVYU_422,       RGA_CPU_LAYOUT_YUV_PACKED,  2, 1, 0, {  0,  3,  2,  1 } },
+    { RK_FORMAT_UYVY_422,       RGA_CPU_LAYOUT_YUV_PACKED,  2, 1, 0, {  1,  0,  3,  2 } },
+    { RK_FORMAT_VYUY_422,       RGA_CPU_LAYOUT_YUV_PACKED,  2, 1, 0, {  1,  2,  3,  0 } },
+    { RK_FORMAT_YCbCr_400,      RGA_CPU_LAYOUT_Y400,        1, 0, 0, {  0, -1, -1, -1 } },
+};
+
+typedef struct rga_cpu_blit {
+    const struct rga_req *req;
+
+    rga_cpu_image_t src;
+    rga_cpu_image_t dst;
+    rga_cpu_image_t bg;             /* pat, or dst itself when blending into dst */
+
+    /* rotation and mirror of src, of the view when it is rotated */
+    rga_cpu_transform_t transform;
+    /* source after 90/270 rotation, NULL: read src directly */
+    uint8_t *rotated;
+    int view_width;
+    int view_height;
+
+    rga_cpu_scale_filter_t *x_filter;
+    rga_cpu_scale_filter_t *y_filter;
+    bool flip_h;
+    bool flip_v;
+
+    bool blend;
+    rga_cpu_blend_t blender;
+    bool src_yuv;
+    bool bg_yuv;
+    bool dst_yuv;
+    rga_cpu_csc_t y2r;
+    rga_cpu_csc_t r2y;
+    rga_cpu_csc_t full;
+    /* the conversion of src to dst without blending, NULL: none */
+    const rga_cpu_csc_t *convert;
+} rga_cpu_blit_t;
+
+typedef struct rga_cpu_fill {
+    rga_cpu_image_t dst;
+    const struct rga_req *req;
+    const rga_cpu_image_t *src;
+    const uint8_t *lut;             /* color palette */
+    uint8_t pixel[RGA_CPU_PIXEL_SIZE];
+    bool dst_yuv;
+    rga_cpu_csc_t r2y;
+} rga_cpu_fill_t;
+
+/*
+ * Worker pool: the caller of rga_cpu_parallel_for() runs the job with the
+ * workers, one job at a time. A caller that finds the pool busy, e.g. a
+ * nested or concurrent job, runs its job alone instead of waiting.
+ */
+typedef struct rga_cpu_pool {
+    pthread_mutex_t busy;
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+
+    int thread_count;
+    uint32_t generation;
+    int active;
+
+    rga_cpu_work_fn fn;
+    void *arg;
+    int count;
+    int grain;
+    _Atomic(int) next;
+} rga_cpu_pool_t;
+
+static rga_cpu_pool_t g_cpu_pool;
+static pthread_once_t g_cpu_pool_once = PTHREAD_ONCE_INIT;
+
+static void rga_cpu_pool_run(rga_cpu_pool_t *pool) {
+    int begin, end;
+
+    while ((begin = atomic_fetch_add(&pool->next, pool->grain)) < pool->count) {
+        end = begin + pool->grain;
+        if (end > pool->count)
+            end = pool->count;
+
+        pool->fn(pool->arg, begin, end);
+    }
+}
+
+static void *rga_cpu_pool_worker(void *arg) {
+    rga_cpu_pool_t *pool = (rga_cpu_pool_t *)arg;
+    uint32_t generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == generation)
+            pthread_cond_wait(&pool->start_cond, &pool->lock);
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        rga_cpu_pool_run(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0)
+            pthread_cond_signal(&pool->done_cond);
+    }
+
+    return NULL;
+}
+
+static void rga_cpu_pool_init(void) {
+    rga_cpu_pool_t *pool = &g_cpu_pool;
+    pthread_t thread;
+    pthread_attr_t attr;
+    char *env;
+    long count;
+
+    pthread_mutex_init(&pool->busy, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    /* the number of threads running a job, the caller included */
+    env = getenv("ROCKCHIP_RGA_CPU_THREADS");
+    if (env != NULL)
+        count = atol(env);
+    else
+        count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        count = 1;
+    if (count > RGA_CPU_THREAD_MAX)
+        count = RGA_CPU_THREAD_MAX;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (pool->thread_count = 0; pool->thread_count < count - 1; pool->thread_count++) {
+        if (pthread_create(&thread, &attr, rga_cpu_pool_worker, pool) != 0) {
+            IM_LOGW("failed to create CPU worker %d, %s\n", pool->thread_count, strerror(errno));
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int rga_cpu_thread_count(void) {
+    pthread_once(&g_cpu_pool_once, rga_cpu_pool_init);
+
+    return g_cpu_pool.thread_count + 1;
+}
+
+/* grain 0: split the job into about 4 chunks per thread */
+void rga_cpu_parallel_for(int count, int grain, rga_cpu_work_fn fn, void *arg) {
+    rga_cpu_pool_t *pool = &g_cpu_pool;
+
+    if (count <= 0)
+        return;
+
+    pthread_once(&g_cpu_pool_once, rga_cpu_pool_init);
+
+    if (grain <= 0) {
+        grain = count / ((pool->thread_count + 1) * 4);
+        if (grain < 1)
+            grain = 1;
+    }
+
+    if (pool->thread_count == 0 || count <= grain ||
+        pthread_mutex_trylock(&pool->busy) != 0) {
+        fn(arg, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->count = count;
+    pool->grain = grain;
+    atomic_store(&pool->next, 0);
+    pool->active = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    rga_cpu_pool_run(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->busy);
+}
+
+/* ROCKCHIP_RGA_CPU_SIMD=0 selects the C kernels, e.g. to compare with the SIMD ones */
+bool rga_cpu_simd_enable(void) {
+    char *env = getenv("ROCKCHIP_RGA_CPU_SIMD");
+
+    return env == NULL || atoi(env) != 0;
+}
+
+static const struct rga_cpu_format *rga_cpu_get_format(int format) {
+    size_t i;
+
+    for (i = 0; i < sizeof(g_cpu_format_table) / sizeof(g_cpu_format_table[0]); i++)
+        if (g_cpu_format_table[i].format == format)
+            return &g_cpu_format_table[i];
+
+    return NULL;
+}
+
+bool rga_cpu_format_is_supported(int format) {
+    return rga_cpu_get_format(format) != NULL;
+}
+
+bool rga_cpu_format_is_yuv(int format) {
+    const struct rga_cpu_format *info = rga_cpu_get_format(format);
+
+    return info != NULL && info->layout >= RGA_CPU_LAYOUT_YUV_PACKED;
+}
+
+int rga_cpu_image_init(rga_cpu_image_t *image, const rga_img_info_t *info,
+                       const rga_cpu_memory_t *memory, bool swap_wh) {
+    const struct rga_cpu_format *format;
+    size_t plane_size[3] = { 0, 0, 0 };
+    size_t total;
+    int vir_w = info->vir_w;
+    int vir_h = info->vir_h;
+    int chroma_h;
+
+    memset(image, 0x0, sizeof(*image));
+
+    image->format = info->format << 8;
+    format = rga_cpu_get_format(image->format);
+    if (format == NULL) {
+        IM_LOGE("CPU backend does not support format[0x%x].\n", image->format);
+        return -EINVAL;
+    }
+    image->info = format;
+
+    if (memory == NULL || memory->base == NULL) {
+        IM_LOGE("CPU backend can only access fd, handle or virtual address buffers.\n");
+        return -EINVAL;
+    }
+
+    image->x = info->x_offset;
+    image->y = info->y_offset;
+    image->alpha_bit[0] = 0;
+    image->alpha_bit[1] = 0xff;
+    image->width = swap_wh ? info->act_h : info->act_w;
+    image->height = swap_wh ? info->act_w : info->act_h;
+    if (image->width <= 0 || image->height <= 0 ||
+        image->x + image->width > vir_w || image->y + image->height > vir_h) {
+        IM_LOGE("invalid rect[%d, %d, %d, %d] in virtual size[%d, %d].\n",
+                image->x, image->y, image->width, image->height, vir_w, vir_h);
+        return -EINVAL;
+    }
+
+    image->plane[0] = memory->base;
+    image->stride[0] = vir_w * format->bpp;
+    plane_size[0] = (size_t)image->stride[0] * vir_h;
+
+    chroma_h = (vir_h + (1 << format->vsub) - 1) >> format->vsub;
+    switch (format->layout) {
+        case RGA_CPU_LAYOUT_YUV_SP:
+            image->plane[1] = image->plane[0] + plane_size[0];
+            image->stride[1] = (vir_w >> format->hsub) * 2;
+            plane_size[1] = (size_t)image->stride[1] * chroma_h;
+            break;
+        case RGA_CPU_LAYOUT_YUV_P:
+            image->plane[1] = image->plane[0] + plane_size[0];
+            image->stride[1] = vir_w >> format->hsub;
+            plane_size[1] = (size_t)image->stride[1] * chroma_h;
+            image->plane[2] = image->plane[1] + plane_size[1];
+            image->stride[2] = image->stride[1];
+            plane_size[2] = plane_size[1];
+            break;
+        default:
+            break;
+    }
+
+    total = plane_size[0] + plane_size[1] + plane_size[2];
+    if (memory->size != 0 && total > memory->size) {
+        IM_LOGE("buffer size[%zu] is smaller than the image[%dx%d format 0x%x] size[%zu].\n",
+                memory->size, vir_w, vir_h, image->format, total);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/* row and x are relative to the active rect */
+void rga_cpu_unpack_row(const rga_cpu_image_t *image, int row, int x, int count, uint8_t *pixel) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    int y = image->y + row;
+    int x0 = image->x + x;
+    const uint8_t *line = image->plane[0] + (size_t)y * image->stride[0];
+    const uint8_t *chroma, *cb, *cr;
+    int i, cx;
+
+    switch (format->layout) {
+        case RGA_CPU_LAYOUT_RGB: {
+            const uint8_t *p = line + (size_t)x0 * format->bpp;
+
+            if (image->format == RK_FORMAT_RGBA_8888) {
+                memcpy(pixel, p, (size_t)count * RGA_CPU_PIXEL_SIZE);
+                break;
+            }
+
+            for (i = 0; i < count; i++, p += format->bpp, pixel += RGA_CPU_PIXEL_SIZE) {
+                pixel[0] = p[offset[0]];
+                pixel[1] = p[offset[1]];
+                pixel[2] = p[offset[2]];
+                pixel[3] = offset[3] >= 0 ? p[offset[3]] : 0xff;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGB565: {
+            const uint8_t *p = line + (size_t)x0 * 2;
+            int value, r, g, b;
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                value = p[0] | (p[1] << 8);
+                r = (value >> offset[0]) & 0x1f;
+                g = (value >> offset[1]) & 0x3f;
+                b = (value >> offset[2]) & 0x1f;
+                pixel[0] = (r << 3) | (r >> 2);
+                pixel[1] = (g << 2) | (g >> 4);
+                pixel[2] = (b << 3) | (b >> 2);
+                pixel[3] = 0xff;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGBA5551: {
+            const uint8_t *p = line + (size_t)x0 * 2;
+            int value, r, g, b;
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                value = p[0] | (p[1] << 8);
+                r = (value >> offset[0]) & 0x1f;
+                g = (value >> offset[1]) & 0x1f;
+                b = (value >> offset[2]) & 0x1f;
+                pixel[0] = (r << 3) | (r >> 2);
+                pixel[1] = (g << 3) | (g >> 2);
+                pixel[2] = (b << 3) | (b >> 2);
+                pixel[3] = image->alpha_bit[(value >> offset[3]) & 0x1];
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGBA4444: {
+            const uint8_t *p = line + (size_t)x0 * 2;
+            int value, c;
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                value = p[0] | (p[1] << 8);
+                for (c = 0; c < RGA_CPU_PIXEL_SIZE; c++)
+                    pixel[c] = ((value >> offset[c]) & 0xf) * 0x11;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_YUV_PACKED:
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE) {
+                const uint8_t *group = line + (size_t)((x0 + i) >> 1) * 4;
+
+                pixel[0] = group[((x0 + i) & 1) ? offset[2] : offset[0]];
+                pixel[1] = group[offset[1]];
+                pixel[2] = group[offset[3]];
+                pixel[3] = 0xff;
+            }
+            break;
+        case RGA_CPU_LAYOUT_YUV_SP:
+            chroma = image->plane[1] + (size_t)(y >> format->vsub) * image->stride[1];
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE) {
+                cx = ((x0 + i) >> format->hsub) * 2;
+                pixel[0] = line[x0 + i];
+                pixel[1] = chroma[cx + offset[1]];
+                pixel[2] = chroma[cx + offset[2]];
+                pixel[3] = 0xff;
+            }
+            break;
+        case RGA_CPU_LAYOUT_YUV_P:
+            cb = image->plane[offset[1]] + (size_t)(y >> format->vsub) * image->stride[offset[1]];
+            cr = image->plane[offset[2]] + (size_t)(y >> format->vsub) * image->stride[offset[2]];
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE) {
+                cx = (x0 + i) >> format->hsub;
+                pixel[0] = line[x0 + i];
+                pixel[1] = cb[cx];
+                pixel[2] = cr[cx];
+                pixel[3] = 0xff;
+            }
+            break;
+        case RGA_CPU_LAYOUT_Y400:
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE) {
+                pixel[0] = line[x0 + i];
+                pixel[1] = 0x80;
+                pixel[2] = 0x80;
+                pixel[3] = 0xff;
+            }
+            break;
+    }
+}
+
+/*
+ * Average the chroma of the pixels [i, i + n) of the rows that share one
+ * chroma row.
+ */
+static inline void rga_cpu_chroma_average(uint8_t * const *pixel, int rows, int i, int n,
+                                          int *cb, int *cr) {
+    int r, k, sum_cb = 0, sum_cr = 0, total = rows * n;
+
+    for (r = 0; r < rows; r++) {
+        for (k = 0; k < n; k++) {
+            sum_cb += pixel[r][(i + k) * RGA_CPU_PIXEL_SIZE + 1];
+            sum_cr += pixel[r][(i + k) * RGA_CPU_PIXEL_SIZE + 2];
+        }
+    }
+
+    *cb = (sum_cb + total / 2) / total;
+    *cr = (sum_cr + total / 2) / total;
+}
+
+static void rga_cpu_pack_chroma(const rga_cpu_image_t *image, int y, uint8_t * const *pixel,
+                                int rows, int x0, int count) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    uint8_t *chroma, *cb_line = NULL, *cr_line = NULL;
+    int i, n, cb, cr, cx;
+    int cy = y >> format->vsub;
+
+    chroma = image->plane[1] + (size_t)cy * image->stride[1];
+    if (format->layout == RGA_CPU_LAYOUT_YUV_P) {
+        cb_line = image->plane[offset[1]] + (size_t)cy * image->stride[offset[1]];
+        cr_line = image->plane[offset[2]] + (size_t)cy * image->stride[offset[2]];
+    }
+
+    for (i = 0; i < count; i += n) {
+        /* the pixels sharing one chroma sample */
+        n = 1;
+        if (format->hsub && !((x0 + i) & 1) && i + 1 < count)
+            n = 2;
+
+        rga_cpu_chroma_average(pixel, rows, i, n, &cb, &cr);
+
+        cx = (x0 + i) >> format->hsub;
+        if (format->layout == RGA_CPU_LAYOUT_YUV_SP) {
+            chroma[cx * 2 + offset[1]] = cb;
+            chroma[cx * 2 + offset[2]] = cr;
+        } else {
+            cb_line[cx] = cb;
+            cr_line[cx] = cr;
+        }
+    }
+}
+
+static void rga_cpu_pack_row(const rga_cpu_image_t *image, int y, const uint8_t *pixel,
+                             int x0, int count) {
+    const struct rga_cpu_format *format = image->info;
+    const int8_t *offset = format->offset;
+    uint8_t *line = image->plane[0] + (size_t)y * image->stride[0];
+    int i;
+
+    switch (format->layout) {
+        case RGA_CPU_LAYOUT_RGB: {
+            uint8_t *p = line + (size_t)x0 * format->bpp;
+
+            if (image->format == RK_FORMAT_RGBA_8888) {
+                memcpy(p, pixel, (size_t)count * RGA_CPU_PIXEL_SIZE);
+                break;
+            }
+
+            for (i = 0; i < count; i++, p += format->bpp, pixel += RGA_CPU_PIXEL_SIZE) {
+                p[offset[0]] = pixel[0];
+                p[offset[1]] = pixel[1];
+                p[offset[2]] = pixel[2];
+                if (format->bpp == 4)
+                    p[offset[3] >= 0 ? offset[3] : 6 - offset[0] - offset[1] - offset[2]] =
+                        offset[3] >= 0 ? pixel[3] : 0xff;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGB565: {
+            uint8_t *p = line + (size_t)x0 * 2;
+            int value;
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                value = ((pixel[0] >> 3) << offset[0]) |
+                        ((pixel[1] >> 2) << offset[1]) |
+                        ((pixel[2] >> 3) << offset[2]);
+                p[0] = value & 0xff;
+                p[1] = value >> 8;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGBA5551: {
+            uint8_t *p = line + (size_t)x0 * 2;
+            int value, a0 = image->alpha_bit[0], a1 = image->alpha_bit[1];
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                /* the alpha bit whose alpha is the nearest */
+                value = ((pixel[0] >> 3) << offset[0]) |
+                        ((pixel[1] >> 3) << offset[1]) |
+                        ((pixel[2] >> 3) << offset[2]) |
+                        ((abs(pixel[3] - a1) <= abs(pixel[3] - a0)) << offset[3]);
+                p[0] = value & 0xff;
+                p[1] = value >> 8;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_RGBA4444: {
+            uint8_t *p = line + (size_t)x0 * 2;
+            int value, c;
+
+            for (i = 0; i < count; i++, p += 2, pixel += RGA_CPU_PIXEL_SIZE) {
+                value = 0;
+                for (c = 0; c < RGA_CPU_PIXEL_SIZE; c++)
+                    value |= (pixel[c] >> 4) << offset[c];
+                p[0] = value & 0xff;
+                p[1] = value >> 8;
+            }
+            break;
+        }
+        case RGA_CPU_LAYOUT_YUV_PACKED:
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE) {
+                uint8_t *group = line + (size_t)((x0 + i) >> 1) * 4;
+
+                group[((x0 + i) & 1) ? offset[2] : offset[0]] = pixel[0];
+                /* the chroma of a pair is the average, a lone pixel sets it alone */
+                if (!((x0 + i) & 1) && i + 1 < count) {
+                    group[offset[1]] = (pixel[1] + pixel[RGA_CPU_PIXEL_SIZE + 1] + 1) >> 1;
+                    group[offset[3]] = (pixel[2] + pixel[RGA_CPU_PIXEL_SIZE + 2] + 1) >> 1;
+                } else if (!((x0 + i) & 1) || i == 0) {
+                    group[offset[1]] = pixel[1];
+                    group[offset[3]] = pixel[2];
+                }
+            }
+            break;
+        case RGA_CPU_LAYOUT_YUV_SP:
+        case RGA_CPU_LAYOUT_YUV_P:
+        case RGA_CPU_LAYOUT_Y400:
+            for (i = 0; i < count; i++, pixel += RGA_CPU_PIXEL_SIZE)
+                line[x0 + i] = pixel[0];
+            break;
+    }
+}
+
+/*
+ * Pack rows [row, row + rows) of the active rect. The rows of a subsampled
+ * chroma row should be packed in one call, so that the chroma is averaged
+ * over all of them.
+ */
+void rga_cpu_pack_rows(const rga_cpu_image_t *image, int row, uint8_t * const *pixel, int rows,
+                       int x, int count) {
+    const struct rga_cpu_format *format = image->info;
+    int y = image->y + row;
+    int x0 = image->x + x;
+    int r, n;
+
+    for (r = 0; r < rows; r++)
+        rga_cpu_pack_row(image, y + r, pixel[r], x0, count);
+
+    if (format->layout != RGA_CPU_LAYOUT_YUV_SP && format->layout != RGA_CPU_LAYOUT_YUV_P)
+        return;
+
+    for (r = 0; r < rows; r += n) {
+        n = 1;
+        if (format->vsub && r + 1 < rows && ((y + r) >> 1) == ((y + r + 1) >> 1))
+            n = 2;
+
+        rga_cpu_pack_chroma(image, y + r, pixel + r, n, x0, count);
+    }
+}
+
+/*
+ * The rows of image are processed in groups sharing one chroma row, the
+ * first group has a single row when the rect starts on an odd row.
+ */
+static inline int rga_cpu_group_count(const rga_cpu_image_t *image) {
+    int odd = image->info->vsub ? image->y & 1 : 0;
+
+    return image->info->vsub ? (image->height + odd + 1) >> 1 : image->height;
+}
+
+static inline void rga_cpu_group_rows(const rga_cpu_image_t *image, int group, int *begin, int *end) {
+    int odd = image->y & 1;
+
+    if (!image->info->vsub) {
+        *begin = group;
+        *end = group + 1;
+        return;
+    }
+
+    *begin = group * 2 - odd;
+    if (*begin < 0)
+        *begin = 0;
+    *end = group * 2 + 2 - odd;
+    if (*end > image->height)
+        *end = image->height;
+}
+
+/* the palette index of pixel x, the first pixel is in the msb unless endian_mode */
+static inline int rga_cpu_palette_index(const uint8_t *line, int x, int bits, int little_endian) {
+    int bit = x * bits;
+    int shift = little_endian ? bit & 7 : 8 - bits - (bit & 7);
+
+    return (line[bit >> 3] >> shift) & ((1 << bits) - 1);
+}
+
+static int rga_cpu_check_req(const struct rga_req *req) {
+    const char *name = NULL;
+
+    if (req->alpha_rop_flag & 0x2)
+        name = "ROP";
+    else if (req->alpha_rop_flag & 0x4)
+        name = "fading";
+    else if (req->alpha_rop_flag & (0x1 << 8))
+        name = "NN quantize";
+    else if (req->src_trans_mode)
+        name = "color key";
+    else if (req->mosaic_info.enable)
+        name = "mosaic";
+    else if (req->osd_info.enable)
+        name = "OSD";
+    else if (req->gauss_config.size)
+        name = "gauss";
+
+    if (name != NULL) {
+        IM_LOGE("CPU backend does not support %s.\n", name);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+typedef struct rga_cpu_rotate_arg {
+    const rga_cpu_image_t *src;
+    const rga_cpu_transform_t *transform;
+    uint8_t *rotated;
+} rga_cpu_rotate_arg_t;
+
+/*
+ * Rotate src into the view, by bands of RGA_CPU_TRANSFORM_TILE rows of src,
+ * a band is unpacked and then transposed into a band of view columns.
+ */
+static void rga_cpu_rotate_rows(void *arg, int begin, int end) {
+    rga_cpu_rotate_arg_t *rotate = (rga_cpu_rotate_arg_t *)arg;
+    const rga_cpu_image_t *src = rotate->src;
+    int width = src->width, height = src->height;
+    int stride = width * RGA_CPU_PIXEL_SIZE;
+    uint8_t *band;
+    int group, row, rows, column, r;
+
+    band = (uint8_t *)malloc((size_t)stride * RGA_CPU_TRANSFORM_TILE);
+    if (band == NULL) {
+        IM_LOGE("CPU rotate band buffer alloc failed!\n");
+        return;
+    }
+
+    for (group = begin; group < end; group++) {
+        row = group * RGA_CPU_TRANSFORM_TILE;
+        rows = height - row < RGA_CPU_TRANSFORM_TILE ? height - row : RGA_CPU_TRANSFORM_TILE;
+        for (r = 0; r < rows; r++)
+            rga_cpu_unpack_row(src, row + r, 0, width, band + (size_t)r * stride);
+
+        /* the view is height x width, view column x is src row x, or height - 1 - x */
+        column = rotate->transform->flip_h ? height - row - rows : row;
+        rga_cpu_transform_plane(rotate->transform, RGA_CPU_PIXEL_SIZE, band, stride,
+                                rotate->rotated + (size_t)column * RGA_CPU_PIXEL_SIZE,
+                                height * RGA_CPU_PIXEL_SIZE, rows, width, 0, width);
+    }
+
+    free(band);
+}
+
+/* rows of the source before scaling: the rotated view, or src itself */
+static const uint8_t *rga_cpu_blit_view_row(void *arg, int y, uint8_t *buffer) {
+    rga_cpu_blit_t *blit = (rga_cpu_blit_t *)arg;
+
+    if (blit->rotated != NULL)
+        return blit->rotated + (size_t)y * blit->view_width * RGA_CPU_PIXEL_SIZE;
+
+    rga_cpu_unpack_row(&blit->src, y, 0, blit->view_width, buffer);
+
+    return buffer;
+}
+
+static void rga_cpu_blit_rows(void *arg, int begin, int end) {
+    rga_cpu_blit_t *blit = (rga_cpu_blit_t *)arg;
+    rga_cpu_scaler_t scaler;
+    size_t dst_size = (size_t)blit->dst.width * RGA_CPU_PIXEL_SIZE;
+    uint8_t *buffer, *bg, *out[2];
+    int group, row, row_end, r;
+
+    buffer = (uint8_t *)malloc(dst_size * 3);
+    if (buffer == NULL ||
+        rga_cpu_scaler_init(&scaler, blit->x_filter, blit->flip_h, blit->y_filter, blit->flip_v,
+                            rga_cpu_blit_view_row, blit) < 0) {
+        IM_LOGE("CPU blit row buffer alloc failed!\n");
+        free(buffer);
+        return;
+    }
+
+    out[0] = buffer;
+    out[1] = out[0] + dst_size;
+    bg = out[1] + dst_size;
+
+    for (group = begin; group < end; group++) {
+        rga_cpu_group_rows(&blit->dst, group, &row, &row_end);
+
+        for (r = 0; r < row_end - row; r++) {
+            rga_cpu_scaler_row(&scaler, row + r, out[r]);
+
+            if (blit->blend) {
+                if (blit->src_yuv)
+                    rga_cpu_csc_row(&blit->y2r, out[r], blit->dst.width);
+
+                rga_cpu_unpack_row(&blit->bg, row + r, 0, blit->dst.width, bg);
+                if (blit->bg_yuv)
+                    rga_cpu_csc_row(&blit->y2r, bg, blit->dst.width);
+
+                rga_cpu_blend_row(&blit->blender, out[r], bg, blit->dst.width);
+
+                if (blit->dst_yuv)
+                    rga_cpu_csc_row(&blit->r2y, out[r], blit->dst.width);
+            } else if (blit->convert != NULL) {
+                rga_cpu_csc_row(blit->convert, out[r], blit->dst.width);
+            }
+        }
+
+        rga_cpu_pack_rows(&blit->dst, row, out, row_end - row, 0, blit->dst.width);
+    }
+
+    rga_cpu_scaler_exit(&scaler);
+    free(buffer);
+}
+
+/* the alpha of the alpha bit of RGBA5551, 0/0xff unless rgba5551_alpha is set */
+static void rga_cpu_image_alpha_bit(rga_cpu_image_t *image, const struct rga_req *req) {
+    if (req->rgba5551_alpha.flags) {
+        image->alpha_bit[0] = req->rgba5551_alpha.alpha0;
+        image->alpha_bit[1] = req->rgba5551_alpha.alpha1;
+    }
+}
+
+/* rotation and mirror only, see rga_cpu_transform_direct_rows() */
+static void rga_cpu_blit_transform_rows(void *arg, int begin, int end) {
+    rga_cpu_blit_t *blit = (rga_cpu_blit_t *)arg;
+    int group, row, rows;
+
+    for (group = begin; group < end; group++) {
+        row = group * RGA_CPU_TRANSFORM_TILE;
+        rows = blit->dst.height - row < RGA_CPU_TRANSFORM_TILE ?
+               blit->dst.height - row : RGA_CPU_TRANSFORM_TILE;
+        rga_cpu_transform_direct_rows(&blit->transform, &blit->src, &blit->dst, row, rows);
+    }
+}
+
+/* YUV <-> RGB without scaling, rotation or blending, see rga_cpu_csc_direct_rows() */
+static void rga_cpu_blit_direct_rows(void *arg, int begin, int end) {
+    rga_cpu_blit_t *blit = (rga_cpu_blit_t *)arg;
+    int group, row, row_end;
+
+    for (group = begin; group < end; group++) {
+        rga_cpu_group_rows(&blit->dst, group, &row, &row_end);
+        rga_cpu_csc_direct_rows(blit->convert, &blit->src, &blit->dst, row, row_end - row);
+    }
+}
+
+static int rga_cpu_blit(const struct rga_req *req, const rga_cpu_memory_t *src,
+                        const rga_cpu_memory_t *dst, const rga_cpu_memory_t *pat) {
+    rga_cpu_blit_t blit;
+    rga_cpu_rotate_arg_t rotate;
+    int mode = req->rotate_mode & 0xf;
+    int mirror = (req->rotate_mode >> 4) & 0xf;
+    int angle = 0;
+    bool flip_h = false, flip_v = false, swap;
+    int ret;
+
+    memset(&blit, 0x0, sizeof(blit));
+    blit.req = req;
+
+    if (mode == 1) {
+        if (req->sina == 0 && req->cosa > 0)
+            angle = 0;
+        else if (req->sina > 0 && req->cosa == 0)
+            angle = 90;
+        else if (req->sina == 0 && req->cosa < 0)
+            angle = 180;
+        else if (req->sina < 0 && req->cosa == 0)
+            angle = 270;
+        else {
+            IM_LOGE("CPU backend only supports rotation by 90/180/270 degrees, sina = %d, cosa = %d.\n",
+                    req->sina, req->cosa);
+            return -EINVAL;
+        }
+    } else {
+        /* 2: x mirror, 3: y mirror, 4: both */
+        flip_h = mode == 2 || mode == 4;
+        flip_v = mode == 3 || mode == 4;
+    }
+
+    if (angle == 180) {
+        flip_h = !flip_h;
+        flip_v = !flip_v;
+    }
+    /* the mirror after the rotation */
+    if (mirror == 2 || mirror == 4)
+        flip_h = !flip_h;
+    if (mirror == 3 || mirror == 4)
+        flip_v = !flip_v;
+    swap = angle == 90 || angle == 270;
+
+    /* 90: view(x, y) = src(y, h - 1 - x), 270: view(x, y) = src(w - 1 - y, x) */
+    blit.transform.transpose = swap;
+    blit.transform.flip_h = flip_h != (angle == 90);
+    blit.transform.flip_v = flip_v != (angle == 270);
+
+    ret = rga_cpu_image_init(&blit.src, &req->src, src, false);
+    if (ret < 0)
+        return ret;
+    ret = rga_cpu_image_init(&blit.dst, &req->dst, dst, swap);
+    if (ret < 0)
+        return ret;
+    rga_cpu_image_alpha_bit(&blit.src, req);
+    rga_cpu_image_alpha_bit(&blit.dst, req);
+
+    blit.blend = (req->alpha_rop_flag & 0x1) && (req->alpha_rop_flag & (0x1 << 3));
+    if (blit.blend) {
+        /* src0 + src1 => dst, or src0 + dst => dst */
+        if (req->bsfilter_flag) {
+            ret = rga_cpu_image_init(&blit.bg, &req->pat, pat, swap);
+            if (ret < 0)
+                return ret;
+            rga_cpu_image_alpha_bit(&blit.bg, req);
+            if (blit.bg.width < blit.dst.width || blit.bg.height < blit.dst.height) {
+                IM_LOGE("src1 rect[%dx%d] is smaller than dst rect[%dx%d].\n",
+                        blit.bg.width, blit.bg.height, blit.dst.width, blit.dst.height);
+                return -EINVAL;
+            }
+        } else {
+            blit.bg = blit.dst;
+        }
+
+        if (req->full_csc.flag) {
+            IM_LOGE("CPU backend does not support full csc with blending.\n");
+            return -EINVAL;
+        }
+
+        rga_cpu_blend_init(req, &blit.blender);
+    }
+
+    blit.src_yuv = rga_cpu_format_is_yuv(blit.src.format);
+    blit.dst_yuv = rga_cpu_format_is_yuv(blit.dst.format);
+    blit.bg_yuv = blit.blend && rga_cpu_format_is_yuv(blit.bg.format);
+    rga_cpu_csc_y2r(req, &blit.y2r);
+    rga_cpu_csc_r2y(req, &blit.r2y);
+    if (req->full_csc.flag) {
+        rga_cpu_csc_full(req, blit.src_yuv, &blit.full);
+        blit.convert = &blit.full;
+    } else if (blit.src_yuv && !blit.dst_yuv) {
+        blit.convert = &blit.y2r;
+    } else if (!blit.src_yuv && blit.dst_yuv) {
+        blit.convert = &blit.r2y;
+    }
+
+    if (!blit.blend && blit.convert == NULL && !req->full_csc.flag &&
+        rga_cpu_transform_direct_supported(&blit.transform, &blit.src, &blit.dst)) {
+        rga_cpu_parallel_for((blit.dst.height + RGA_CPU_TRANSFORM_TILE - 1) / RGA_CPU_TRANSFORM_TILE,
+                             0, rga_cpu_blit_transform_rows, &blit);
+        return 0;
+    }
+
+    if (!blit.blend && blit.convert != NULL && !swap && !flip_h && !flip_v &&
+        rga_cpu_csc_direct_supported(&blit.src, &blit.dst)) {
+        rga_cpu_parallel_for(rga_cpu_group_count(&blit.dst), 0, rga_cpu_blit_direct_rows, &blit);
+        return 0;
+    }
+
+    blit.view_width = swap ? blit.src.height : blit.src.width;
+    blit.view_height = swap ? blit.src.width : blit.src.height;
+    /* the mirrors of a rotation are done with it, in the rotated view */
+    blit.flip_h = swap ? false : flip_h;
+    blit.flip_v = swap ? false : flip_v;
+
+    blit.x_filter = rga_cpu_scale_filter_get(blit.view_width, blit.dst.width, req->interp.horiz);
+    blit.y_filter = rga_cpu_scale_filter_get(blit.view_height, blit.dst.height, req->interp.verti);
+    if (blit.x_filter == NULL || blit.y_filter == NULL) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    if (swap) {
+        blit.rotated = (uint8_t *)malloc((size_t)blit.view_width * blit.view_height *
+                                         RGA_CPU_PIXEL_SIZE);
+        if (blit.rotated == NULL) {
+            ret = -ENOMEM;
+            goto out;
+        }
+
+        rotate.src = &blit.src;
+        rotate.transform = &blit.transform;
+        rotate.rotated = blit.rotated;
+        rga_cpu_parallel_for((blit.src.height + RGA_CPU_TRANSFORM_TILE - 1) / RGA_CPU_TRANSFORM_TILE,
+                             0, rga_cpu_rotate_rows, &rotate);
+    }
+
+    rga_cpu_parallel_for(rga_cpu_group_count(&blit.dst), 0, rga_cpu_blit_rows, &blit);
+    ret = 0;
+
+out:
+    if (ret == -ENOMEM)
+        IM_LOGE("CPU blit buffer alloc failed!\n");
+
+    free(blit.rotated);
+    rga_cpu_scale_filter_put(blit.x_filter);
+    rga_cpu_scale_filter_put(blit.y_filter);
+
+    return ret;
+}
+
+static void rga_cpu_fill_rows(void *arg, int begin, int end) {
+    rga_cpu_fill_t *fill = (rga_cpu_fill_t *)arg;
+    int width = fill->dst.width;
+    uint8_t *buffer, *out[2];
+    int group, row, row_end, r, x;
+
+    buffer = (uint8_t *)malloc((size_t)width * RGA_CPU_PIXEL_SIZE * 2);
+    if (buffer == NULL) {
+        IM_LOGE("CPU fill row buffer alloc failed!\n");
+        return;
+    }
+    out[0] = buffer;
+    out[1] = buffer + (size_t)width * RGA_CPU_PIXEL_SIZE;
+
+    /* a solid color is the same for every row */
+    if (fill->lut == NULL)
+        for (x = 0; x < width * 2; x++)
+            memcpy(buffer + (size_t)x * RGA_CPU_PIXEL_SIZE, fill->pixel, RGA_CPU_PIXEL_SIZE);
+
+    for (group = begin; group < end; group++) {
+        rga_cpu_group_rows(&fill->dst, group, &row, &row_end);
+
+        if (fill->lut != NULL) {
+            const struct rga_req *req = fill->req;
+            int bits = 1 << req->palette_mode;
+
+            for (r = 0; r < row_end - row; r++) {
+                const uint8_t *line = fill->src->plane[0] +
+                                      (size_t)(fill->src->y + row + r) * fill->src->stride[0];
+
+                for (x = 0; x < width; x++)
+                    memcpy(out[r] + (size_t)x * RGA_CPU_PIXEL_SIZE,
+                           fill->lut + rga_cpu_palette_index(line, fill->src->x + x, bits,
+                                                             req->endian_mode) * RGA_CPU_PIXEL_SIZE,
+                           RGA_CPU_PIXEL_SIZE);
+
+                if (fill->dst_yuv)
+                    rga_cpu_csc_row(&fill->r2y, out[r], width);
+            }
+        }
+
+        rga_cpu_pack_rows(&fill->dst, row, out, row_end - row, 0, width);
+    }
+
+    free(buffer);
+}
+
+static int rga_cpu_color_fill(const struct rga_req *req, const rga_cpu_memory_t *dst) {
+    rga_cpu_fill_t fill;
+    int ret;
+
+    memset(&fill, 0x0, sizeof(fill));
+    fill.req = req;
+
+    ret = rga_cpu_image_init(&fill.dst, &req->dst, dst, false);
+    if (ret < 0)
+        return ret;
+
+    /* fg_color is R in the low byte, A in the high byte */
+    fill.pixel[0] = req->fg_color & 0xff;
+    fill.pixel[1] = (req->fg_color >> 8) & 0xff;
+    fill.pixel[2] = (req->fg_color >> 16) & 0xff;
+    fill.pixel[3] = (req->fg_color >> 24) & 0xff;
+    if (rga_cpu_format_is_yuv(fill.dst.format)) {
+        rga_cpu_csc_r2y(req, &fill.r2y);
+        rga_cpu_csc_row(&fill.r2y, fill.pixel, 1);
+    }
+
+    rga_cpu_parallel_for(rga_cpu_group_count(&fill.dst), 0, rga_cpu_fill_rows, &fill);
+
+    return 0;
+}
+
+static int rga_cpu_color_palette(const struct rga_req *req, const uint8_t *lut,
+                                 const rga_cpu_memory_t *src, const rga_cpu_memory_t *dst) {
+    rga_cpu_fill_t fill;
+    rga_cpu_image_t index;
+    int bits = 1 << req->palette_mode;
+    int ret;
+
+    memset(&fill, 0x0, sizeof(fill));
+    fill.req = req;
+    fill.lut = lut;
+
+    ret = rga_cpu_image_init(&fill.dst, &req->dst, dst, false);
+    if (ret < 0)
+        return ret;
+    fill.dst_yuv = rga_cpu_format_is_yuv(fill.dst.format);
+    if (fill.dst_yuv)
+        rga_cpu_csc_r2y(req, &fill.r2y);
+
+    if (src == NULL || src->base == NULL) {
+        IM_LOGE("CPU backend can only access fd, handle or virtual address buffers.\n");
+        return -EINVAL;
+    }
+
+    /* the index image, BPP1/2/4/8 */
+    memset(&index, 0x0, sizeof(index));
+    index.plane[0] = src->base;
+    index.stride[0] = (req->src.vir_w * bits + 7) / 8;
+    index.x = req->src.x_offset;
+    index.y = req->src.y_offset;
+    index.width = req->src.act_w;
+    index.height = req->src.act_h;
+    if (index.width < fill.dst.width || index.height < fill.dst.height ||
+        (src->size != 0 && (size_t)index.stride[0] * req->src.vir_h > src->size)) {
+        IM_LOGE("invalid color palette src[%dx%d], dst[%dx%d].\n",
+                index.width, index.height, fill.dst.width, fill.dst.height);
+        return -EINVAL;
+    }
+    fill.src = &index;
+
+    rga_cpu_parallel_for(rga_cpu_group_count(&fill.dst), 0, rga_cpu_fill_rows, &fill);
+
+    return 0;
+}
+
+/* update_palette_table_mode: load the pat channel as the color palette */
+int rga_cpu_load_palette(const struct rga_req *req, const rga_cpu_memory_t *pat, uint8_t *lut) {
+    rga_cpu_image_t image;
+    int ret, row, count, total = 0;
+
+    ret = rga_cpu_image_init(&image, &req->pat, pat, false);
+    if (ret < 0)
+        return ret;
+
+    for (row = 0; row < image.height && total < 256; row++) {
+        count = image.width;
+        if (count > 256 - total)
+            count = 256 - total;
+
+        rga_cpu_unpack_row(&image, row, 0, count, lut + total * RGA_CPU_PIXEL_SIZE);
+        total += count;
+    }
+
+    return 0;
+}
+
+static int rga_cpu_process_raster(const struct rga_req *req, const uint8_t *lut,
+                                  const rga_cpu_memory_t *src, const rga_cpu_memory_t *dst,
+                                  const rga_cpu_memory_t *pat) {
+    switch (req->render_mode) {
+        case bitblt_mode:
+            return rga_cpu_blit(req, src, dst, pat);
+        case color_fill_mode:
+            return rga_cpu_color_fill(req, dst);
+        case color_palette_mode:
+            return rga_cpu_color_palette(req, lut, src, dst);
+        default:
+            IM_LOGE("CPU backend does not support render_mode[%d].\n", req->render_mode);
+            return -EINVAL;
+    }
+}
+
+/*
+ * The FBC/tile channels are decoded to raster copies, the request runs on
+ * the copies, and the dst copy is encoded back.
+ */
+static int rga_cpu_process_fbc(const struct rga_req *req, const uint8_t *lut,
+                               const rga_cpu_memory_t *src, const rga_cpu_memory_t *dst,
+                               const rga_cpu_memory_t *pat) {
+    struct rga_req raster = *req;
+    rga_img_info_t *info[3] = { &raster.src, &raster.dst, &raster.pat };
+    const rga_cpu_memory_t *memory[3] = { src, dst, pat };
+    rga_cpu_fbc_t fbc[3];
+    bool used[3] = { false, false, false };
+    /* the dst/pat of a 90/270 rotation have act_w/act_h swapped */
+    bool swap = req->render_mode == bitblt_mode && (req->rotate_mode & 0xf) == 1 && req->cosa == 0;
+    bool blend = (req->alpha_rop_flag & 0x1) && (req->alpha_rop_flag & (0x1 << 3));
+    int i, width, height, ret = 0;
+
+    for (i = 0; i < 3 && ret == 0; i++) {
+        if (rga_cpu_fbc_is_raster(info[i]) || memory[i]->base == NULL)
+            continue;
+
+        width = swap && i > 0 ? info[i]->act_h : info[i]->act_w;
+        height = swap && i > 0 ? info[i]->act_w : info[i]->act_h;
+        used[i] = true;
+        ret = rga_cpu_fbc_init(&fbc[i], info[i], memory[i], info[i]->x_offset, info[i]->y_offset,
+                               width, height);
+        if (ret < 0)
+            break;
+
+        /* the dst is only read when blended into, or to keep the rest of its blocks */
+        if (i != 1 || (blend && !req->bsfilter_flag) || fbc[i].partial)
+            ret = rga_cpu_fbc_decode(&fbc[i]);
+
+        info[i]->rd_mode = raster_mode;
+        memory[i] = &fbc[i].memory;
+    }
+
+    if (ret == 0)
+        ret = rga_cpu_process_raster(&raster, lut, memory[0], memory[1], memory[2]);
+    if (ret == 0 && used[1])
+        rga_cpu_fbc_encode(&fbc[1]);
+
+    for (i = 0; i < 3; i++)
+        if (used[i])
+            rga_cpu_fbc_exit(&fbc[i]);
+
+    return ret;
+}
+
+int rga_cpu_process(const struct rga_req *req, const uint8_t *lut,
+                    const rga_cpu_memory_t *src, const rga_cpu_memory_t *dst,
+                    const rga_cpu_memory_t *pat) {
+    int ret;
+
+    ret = rga_cpu_check_req(req);
+    if (ret < 0)
+        return ret;
+
+    if (!rga_cpu_fbc_is_raster(&req->src) || !rga_cpu_fbc_is_raster(&req->dst) ||
+        !rga_cpu_fbc_is_raster(&req->pat))
+        return rga_cpu_process_fbc(req, lut, src, dst, pat);
+
+    return rga_cpu_process_raster(req, lut, src, dst, pat);
+}
+
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RGA_CPU_ROTATE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RGA_CPU_ROTATE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+/*
+ * Rotation and mirror of the CPU backend, on the elements of one plane:
+ * 1/2/3/4-byte pixels, or the 2-byte CbCr pairs of a semi-planar chroma
+ * plane.
+ *
+ * A transposition reads the columns of src, so it is split into tiles of
+ * RGA_CPU_TRANSFORM_TILE x RGA_CPU_TRANSFORM_TILE elements that stay in the
+ * cache, and each tile into square blocks transposed in registers. The
+ * mirrors are folded into the order the block rows are loaded and stored,
+ * so rotation + mirror is a single pass. Without a transposition a row is
+ * copied, or reversed for a horizontal mirror.
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+/* transpose a block of block x block elements, the rows of src are src_step apart */
+typedef void (*rga_cpu_transpose_fn)(const uint8_t *src, ptrdiff_t src_step,
+                                     uint8_t *dst, ptrdiff_t dst_step);
+/* dst[i] = src[count - 1 - i] for i in [begin, count) */
+typedef void (*rga_cpu_reverse_fn)(const uint8_t *src, uint8_t *dst, int begin, int count);
+
+typedef struct rga_cpu_rotate_kernel {
+    rga_cpu_transpose_fn transpose;     /* NULL: C only */
+    int block;
+    rga_cpu_reverse_fn reverse;
+} rga_cpu_rotate_kernel_t;
+
+#define RGA_CPU_TRANSPOSE_C(size)                                                       \
+    for (c = 0; c < rows; c++)                                                          \
+        for (i = 0; i < cols; i++)                                                      \
+            memcpy(dst + c * dst_step + (ptrdiff_t)i * (size),                          \
+                   src + i * src_step + (ptrdiff_t)c * (size), (size))
+
+/* dst row c, element i = src row i, element c, for cols x rows dst elements */
+static void rga_cpu_transpose_c(int size, const uint8_t *src, ptrdiff_t src_step,
+                                uint8_t *dst, ptrdiff_t dst_step, int cols, int rows) {
+    int c, i;
+
+    /* constant sizes let memcpy() become a move */
+    switch (size) {
+        case 1:
+            RGA_CPU_TRANSPOSE_C(1);
+            break;
+        case 2:
+            RGA_CPU_TRANSPOSE_C(2);
+            break;
+        case 3:
+            RGA_CPU_TRANSPOSE_C(3);
+            break;
+        case 4:
+        default:
+            RGA_CPU_TRANSPOSE_C(4);
+            break;
+    }
+}
+
+static void rga_cpu_reverse_c(int size, const uint8_t *src, uint8_t *dst, int begin, int count) {
+    int i;
+
+    for (i = begin; i < count; i++)
+        memcpy(dst + (size_t)i * size, src + (size_t)(count - 1 - i) * size, size);
+}
+
+static void rga_cpu_reverse_u8_c(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    rga_cpu_reverse_c(1, src, dst, begin, count);
+}
+
+static void rga_cpu_reverse_u16_c(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    rga_cpu_reverse_c(2, src, dst, begin, count);
+}
+
+static void rga_cpu_reverse_u24_c(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    rga_cpu_reverse_c(3, src, dst, begin, count);
+}
+
+static void rga_cpu_reverse_u32_c(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    rga_cpu_reverse_c(4, src, dst, begin, count);
+}
+
+/*
+ * The SIMD transpositions interleave row k with row k + n / 2 of an n x n
+ * block, n rows of one register each. An interleave rotates the (row,
+ * column) index of an element by one bit, so log2(n) of them transpose it.
+ */
+#ifdef RGA_CPU_ROTATE_SSE2
+static void rga_cpu_transpose_u8_sse2(const uint8_t *src, ptrdiff_t src_step,
+                                      uint8_t *dst, ptrdiff_t dst_step) {
+    __m128i r[16], t[16];
+    int i, k, round;
+
+    for (i = 0; i < 16; i++)
+        r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_step));
+
+    for (round = 0; round < 4; round++) {
+        for (k = 0; k < 8; k++) {
+            t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 16; i++)
+        _mm_storeu_si128((__m128i *)(dst + i * dst_step), r[i]);
+}
+
+static void rga_cpu_transpose_u16_sse2(const uint8_t *src, ptrdiff_t src_step,
+                                       uint8_t *dst, ptrdiff_t dst_step) {
+    __m128i r[8], t[8];
+    int i, k, round;
+
+    for (i = 0; i < 8; i++)
+        r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_step));
+
+    for (round = 0; round < 3; round++) {
+        for (k = 0; k < 4; k++) {
+            t[2 * k] = _mm_unpacklo_epi16(r[k], r[k + 4]);
+            t[2 * k + 1] = _mm_unpackhi_epi16(r[k], r[k + 4]);
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 8; i++)
+        _mm_storeu_si128((__m128i *)(dst + i * dst_step), r[i]);
+}
+
+static void rga_cpu_transpose_u32_sse2(const uint8_t *src, ptrdiff_t src_step,
+                                       uint8_t *dst, ptrdiff_t dst_step) {
+    __m128i r[4], t[4];
+    int i, k, round;
+
+    for (i = 0; i < 4; i++)
+        r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_step));
+
+    for (round = 0; round < 2; round++) {
+        for (k = 0; k < 2; k++) {
+            t[2 * k] = _mm_unpacklo_epi32(r[k], r[k + 2]);
+            t[2 * k + 1] = _mm_unpackhi_epi32(r[k], r[k + 2]);
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *)(dst + i * dst_step), r[i]);
+}
+
+static inline __m128i rga_cpu_reverse_u16x8_sse2(__m128i v) {
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+static void rga_cpu_reverse_u8_sse2(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    __m128i v;
+    int i;
+
+    for (i = begin; i + 16 <= count; i += 16) {
+        v = _mm_loadu_si128((const __m128i *)(src + count - i - 16));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), rga_cpu_reverse_u16x8_sse2(v));
+    }
+
+    rga_cpu_reverse_c(1, src, dst, i, count);
+}
+
+static void rga_cpu_reverse_u16_sse2(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    __m128i v;
+    int i;
+
+    for (i = begin; i + 8 <= count; i += 8) {
+        v = _mm_loadu_si128((const __m128i *)(src + (size_t)(count - i - 8) * 2));
+        _mm_storeu_si128((__m128i *)(dst + (size_t)i * 2), rga_cpu_reverse_u16x8_sse2(v));
+    }
+
+    rga_cpu_reverse_c(2, src, dst, i, count);
+}
+
+static void rga_cpu_reverse_u32_sse2(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    __m128i v;
+    int i;
+
+    for (i = begin; i + 4 <= count; i += 4) {
+        v = _mm_loadu_si128((const __m128i *)(src + (size_t)(count - i - 4) * 4));
+        _mm_storeu_si128((__m128i *)(dst + (size_t)i * 4),
+                         _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+
+    rga_cpu_reverse_c(4, src, dst, i, count);
+}
+#endif /* #ifdef RGA_CPU_ROTATE_SSE2 */
+
+#ifdef RGA_CPU_ROTATE_NEON
+static void rga_cpu_transpose_u8_neon(const uint8_t *src, ptrdiff_t src_step,
+                                      uint8_t *dst, ptrdiff_t dst_step) {
+    uint8x16_t r[16], t[16];
+    uint8x16x2_t z;
+    int i, k, round;
+
+    for (i = 0; i < 16; i++)
+        r[i] = vld1q_u8(src + i * src_step);
+
+    for (round = 0; round < 4; round++) {
+        for (k = 0; k < 8; k++) {
+            z = vzipq_u8(r[k], r[k + 8]);
+            t[2 * k] = z.val[0];
+            t[2 * k + 1] = z.val[1];
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 16; i++)
+        vst1q_u8(dst + i * dst_step, r[i]);
+}
+
+static void rga_cpu_transpose_u16_neon(const uint8_t *src, ptrdiff_t src_step,
+                                       uint8_t *dst, ptrdiff_t dst_step) {
+    uint16x8_t r[8], t[8];
+    uint16x8x2_t z;
+    int i, k, round;
+
+    for (i = 0; i < 8; i++)
+        r[i] = vld1q_u16((const uint16_t *)(src + i * src_step));
+
+    for (round = 0; round < 3; round++) {
+        for (k = 0; k < 4; k++) {
+            z = vzipq_u16(r[k], r[k + 4]);
+            t[2 * k] = z.val[0];
+            t[2 * k + 1] = z.val[1];
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 8; i++)
+        vst1q_u16((uint16_t *)(dst + i * dst_step), r[i]);
+}
+
+static void rga_cpu_transpose_u32_neon(const uint8_t *src, ptrdiff_t src_step,
+                                       uint8_t *dst, ptrdiff_t dst_step) {
+    uint32x4_t r[4], t[4];
+    uint32x4x2_t z;
+    int i, k, round;
+
+    for (i = 0; i < 4; i++)
+        r[i] = vld1q_u32((const uint32_t *)(src + i * src_step));
+
+    for (round = 0; round < 2; round++) {
+        for (k = 0; k < 2; k++) {
+            z = vzipq_u32(r[k], r[k + 2]);
+            t[2 * k] = z.val[0];
+            t[2 * k + 1] = z.val[1];
+        }
+        memcpy(r, t, sizeof(r));
+    }
+
+    for (i = 0; i < 4; i++)
+        vst1q_u32((uint32_t *)(dst + i * dst_step), r[i]);
+}
+
+static void rga_cpu_reverse_u8_neon(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    uint8x16_t v;
+    int i;
+
+    for (i = begin; i + 16 <= count; i += 16) {
+        v = vrev64q_u8(vld1q_u8(src + count - i - 16));
+        vst1q_u8(dst + i, vcombine_u8(vget_high_u8(v), vget_low_u8(v)));
+    }
+
+    rga_cpu_reverse_c(1, src, dst, i, count);
+}
+
+static void rga_cpu_reverse_u16_neon(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    uint16x8_t v;
+    int i;
+
+    for (i = begin; i + 8 <= count; i += 8) {
+        v = vrev64q_u16(vld1q_u16((const uint16_t *)(src + (size_t)(count - i - 8) * 2)));
+        vst1q_u16((uint16_t *)(dst + (size_t)i * 2), vcombine_u16(vget_high_u16(v), vget_low_u16(v)));
+    }
+
+    rga_cpu_reverse_c(2, src, dst, i, count);
+}
+
+static void rga_cpu_reverse_u32_neon(const uint8_t *src, uint8_t *dst, int begin, int count) {
+    uint32x4_t v;
+    int i;
+
+    for (i = begin; i + 4 <= count; i += 4) {
+        v = vrev64q_u32(vld1q_u32((const uint32_t *)(src + (size_t)(count - i - 4) * 4)));
+        vst1q_u32((uint32_t *)(dst + (size_t)i * 4), vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+    }
+
+    rga_cpu_reverse_c(4, src, dst, i, count);
+}
+#endif /* #ifdef RGA_CPU_ROTATE_NEON */
+
+/* indexed by the element size, 24-bit elements have no SIMD kernel */
+static rga_cpu_rotate_kernel_t g_cpu_rotate_kernel[5] = {
+    { NULL, 0, NULL },
+    { NULL, 0, rga_cpu_reverse_u8_c },
+    { NULL, 0, rga_cpu_reverse_u16_c },
+    { NULL, 0, rga_cpu_reverse_u24_c },
+    { NULL, 0, rga_cpu_reverse_u32_c },
+};
+static pthread_once_t g_cpu_rotate_once = PTHREAD_ONCE_INIT;
+
+static void rga_cpu_rotate_dispatch_init(void) {
+    rga_cpu_rotate_kernel_t *kernel = g_cpu_rotate_kernel;
+
+    if (!rga_cpu_simd_enable())
+        return;
+
+#if defined(RGA_CPU_ROTATE_SSE2)
+    kernel[1].transpose = rga_cpu_transpose_u8_sse2;
+    kernel[1].block = 16;
+    kernel[1].reverse = rga_cpu_reverse_u8_sse2;
+    kernel[2].transpose = rga_cpu_transpose_u16_sse2;
+    kernel[2].block = 8;
+    kernel[2].reverse = rga_cpu_reverse_u16_sse2;
+    kernel[4].transpose = rga_cpu_transpose_u32_sse2;
+    kernel[4].block = 4;
+    kernel[4].reverse = rga_cpu_reverse_u32_sse2;
+#elif defined(RGA_CPU_ROTATE_NEON)
+    kernel[1].transpose = rga_cpu_transpose_u8_neon;
+    kernel[1].block = 16;
+    kernel[1].reverse = rga_cpu_reverse_u8_neon;
+    kernel[2].transpose = rga_cpu_transpose_u16_neon;
+    kernel[2].block = 8;
+    kernel[2].reverse = rga_cpu_reverse_u16_neon;
+    kernel[4].transpose = rga_cpu_transpose_u32_neon;
+    kernel[4].block = 4;
+    kernel[4].reverse = rga_cpu_reverse_u32_neon;
+#endif
+}
+
+/*
+ * The dst block [x, x + cols) x [y, y + rows) of a transposition. Its column
+ * i comes from src row x' of x + i, which are src_step apart, and dst row y'
+ * of src column y + c is dst_step apart from that of c - 1.
+ */
+static void rga_cpu_transpose_block(const rga_cpu_rotate_kernel_t *kernel,
+                                    const rga_cpu_transform_t *transform, int size,
+                                    const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                                    int width, int height, int x, int y, int cols, int rows) {
+    int src_row = transform->flip_h ? width - 1 - x : x;
+    int src_col = transform->flip_v ? height - y - rows : y;
+    int dst_row = transform->flip_v ? y + rows - 1 : y;
+    ptrdiff_t src_step = transform->flip_h ? -(ptrdiff_t)src_stride : src_stride;
+    ptrdiff_t dst_step = transform->flip_v ? -(ptrdiff_t)dst_stride : dst_stride;
+
+    src += (ptrdiff_t)src_row * src_stride + (ptrdiff_t)src_col * size;
+    dst += (ptrdiff_t)dst_row * dst_stride + (ptrdiff_t)x * size;
+
+    if (kernel->transpose != NULL && cols == kernel->block && rows == kernel->block)
+        kernel->transpose(src, src_step, dst, dst_step);
+    else
+        rga_cpu_transpose_c(size, src, src_step, dst, dst_step, cols, rows);
+}
+
+/*
+ * dst rows [row, row + rows) of a width x height dst plane, of size-byte
+ * elements. src and dst point to the first element of the planes.
+ */
+void rga_cpu_transform_plane(const rga_cpu_transform_t *transform, int size,
+                             const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                             int width, int height, int row, int rows) {
+    const rga_cpu_rotate_kernel_t *kernel;
+    int tile_x, tile_y, tile_w, tile_h, x, y, end;
+    int block;
+
+    pthread_once(&g_cpu_rotate_once, rga_cpu_rotate_dispatch_init);
+    kernel = &g_cpu_rotate_kernel[size];
+    end = row + rows;
+
+    if (!transform->transpose) {
+        for (y = row; y < end; y++) {
+            const uint8_t *in = src + (size_t)(transform->flip_v ? height - 1 - y : y) * src_stride;
+            uint8_t *out = dst + (size_t)y * dst_stride;
+
+            if (transform->flip_h)
+                kernel->reverse(in, out, 0, width);
+            else
+                memcpy(out, in, (size_t)width * size);
+        }
+        return;
+    }
+
+    block = kernel->transpose != NULL ? kernel->block : RGA_CPU_TRANSFORM_TILE;
+    for (tile_y = row; tile_y < end; tile_y += RGA_CPU_TRANSFORM_TILE) {
+        tile_h = end - tile_y < RGA_CPU_TRANSFORM_TILE ? end - tile_y : RGA_CPU_TRANSFORM_TILE;
+
+        for (tile_x = 0; tile_x < width; tile_x += RGA_CPU_TRANSFORM_TILE) {
+            tile_w = width - tile_x < RGA_CPU_TRANSFORM_TILE ? width - tile_x : RGA_CPU_TRANSFORM_TILE;
+
+            for (y = tile_y; y < tile_y + tile_h; y += block)
+                for (x = tile_x; x < tile_x + tile_w; x += block)
+                    rga_cpu_transpose_block(kernel, transform, size, src, src_stride, dst, dst_stride,
+                                            width, height, x, y,
+                                            tile_x + tile_w - x < block ? tile_x + tile_w - x : block,
+                                            tile_y + tile_h - y < block ? tile_y + tile_h - y : block);
+        }
+    }
+}
+
+/* the planes of an image: element size, subsampling and first element of each */
+static int rga_cpu_transform_planes(const rga_cpu_image_t *image, int *size, int *hsub, int *vsub,
+                                    uint8_t **base) {
+    const struct rga_cpu_format *format = image->info;
+    int count = 1, p;
+
+    size[0] = format->bpp;
+    hsub[0] = 0;
+    vsub[0] = 0;
+
+    switch (format->layout) {
+        case RGA_CPU_LAYOUT_YUV_SP:
+            size[1] = 2;
+            count = 2;
+            break;
+        case RGA_CPU_LAYOUT_YUV_P:
+            size[1] = 1;
+            size[2] = 1;
+            count = 3;
+            break;
+        default:
+            break;
+    }
+
+    for (p = 0; p < count; p++) {
+        if (p > 0) {
+            hsub[p] = format->hsub;
+            vsub[p] = format->vsub;
+        }
+        base[p] = image->plane[p] + (size_t)(image->y >> vsub[p]) * image->stride[p] +
+                  (size_t)(image->x >> hsub[p]) * size[p];
+    }
+
+    return count;
+}
+
+static bool rga_cpu_transform_rect_aligned(const rga_cpu_image_t *image) {
+    const struct rga_cpu_format *format = image->info;
+    int h_mask = (1 << format->hsub) - 1, v_mask = (1 << format->vsub) - 1;
+
+    return !((image->x | image->width) & h_mask) && !((image->y | image->height) & v_mask);
+}
+
+/*
+ * The rotation and mirror is a plain move of the elements: same format,
+ * no scaling, and the chroma subsampling is kept by the transposition.
+ */
+bool rga_cpu_transform_direct_supported(const rga_cpu_transform_t *transform,
+                                        const rga_cpu_image_t *src, const rga_cpu_image_t *dst) {
+    const struct rga_cpu_format *format = src->info;
+
+    if (src->format != dst->format)
+        return false;
+
+    if (transform->transpose ?
+        (src->width != dst->height || src->height != dst->width) :
+        (src->width != dst->width || src->height != dst->height))
+        return false;
+
+    switch (format->layout) {
+        case RGA_CPU_LAYOUT_RGB:
+            /* the X byte is written as 0xff */
+            if (format->bpp == 4 && format->offset[3] < 0)
+                return false;
+            break;
+        case RGA_CPU_LAYOUT_YUV_PACKED:
+            /* the 2 pixels of a group can only be moved as a whole */
+            if (transform->transpose || transform->flip_h)
+                return false;
+            break;
+        case RGA_CPU_LAYOUT_YUV_SP:
+        case RGA_CPU_LAYOUT_YUV_P:
+            if (transform->transpose && format->hsub != format->vsub)
+                return false;
+            break;
+        default:
+            break;
+    }
+
+    return rga_cpu_transform_rect_aligned(src) && rga_cpu_transform_rect_aligned(dst);
+}
+
+/* dst rows [row, row + rows), row and rows are even for a vertically subsampled format */
+void rga_cpu_transform_direct_rows(const rga_cpu_transform_t *transform, const rga_cpu_image_t *src,
+                                   const rga_cpu_image_t *dst, int row, int rows) {
+    int size[3], hsub[3], vsub[3];
+    uint8_t *src_base[3], *dst_base[3];
+    int count, p;
+
+    count = rga_cpu_transform_planes(src, size, hsub, vsub, src_base);
+    rga_cpu_transform_planes(dst, size, hsub, vsub, dst_base);
+
+    for (p = 0; p < count; p++)
+        rga_cpu_transform_plane(transform, size[p], src_base[p], src->stride[p],
+                                dst_base[p], dst->stride[p],
+                                dst->width >> hsub[p], dst->height >> vsub[p],
+                                row >> vsub[p], rows >> vsub[p]);
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
@@ -0,0 +1,594 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_rga_cpu"
+#else
+#define LOG_TAG "im2d_rga_cpu"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "im2d_cpu.h"
+
+#ifdef RGA_CPU_BACKEND_ENABLE
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RGA_CPU_SCALE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RGA_CPU_SCALE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+
+/*
+ * Scaler of the CPU backend, per axis as selected by rga_req.interp:
+ *   RGA_INTERP_LINEAR:     2-tap bilinear.
+ *   RGA_INTERP_BICUBIC:    4-tap Catmull-Rom.
+ *   RGA_INTERP_AVERAGE:    area average, the src pixels covered by a dst pixel.
+ *   RGA_INTERP_DEFAULT:    average to scale down, bicubic to scale up, the same
+ *                          as the selection of the hardware.
+ * An axis without scaling is copied whatever the interpolation.
+ *
+ * The filter of an axis is a table of Q14 weights per dst pixel, cached by
+ * the (src, dst, interp) of the axis, as most of the jobs of a stream share
+ * the same sizes. Each filter sums to exactly 1.0, the taps out of the
+ * image are folded onto the edge pixels.
+ */
+#ifdef RGA_CPU_BACKEND_ENABLE
+#define RGA_CPU_SCALE_SHIFT         14
+#define RGA_CPU_SCALE_ONE           (1 << RGA_CPU_SCALE_SHIFT)
+#define RGA_CPU_SCALE_ROUND         (1 << (RGA_CPU_SCALE_SHIFT - 1))
+#define RGA_CPU_SCALE_CACHE_SIZE    8
+
+struct rga_cpu_scale_filter {
+    int src_size;
+    int dst_size;
+    int interp;
+
+    int taps;
+    int32_t *start;             /* first src pixel of each dst pixel */
+    int16_t *weight;            /* taps weights of each dst pixel */
+
+    int refcount;               /* protected by g_cpu_scale_lock */
+    bool cached;
+    uint64_t last_use;
+};
+
+typedef struct rga_cpu_scale_kernel {
+    void (*horiz)(const rga_cpu_scale_filter_t *filter, bool flip, const uint8_t *in,
+                  uint8_t *out, int begin, int count);
+    void (*verti)(const int16_t *weight, int taps, const uint8_t * const *rows,
+                  uint8_t *out, int begin, int size);
+} rga_cpu_scale_kernel_t;
+
+static pthread_mutex_t g_cpu_scale_lock = PTHREAD_MUTEX_INITIALIZER;
+static rga_cpu_scale_filter_t *g_cpu_scale_cache[RGA_CPU_SCALE_CACHE_SIZE];
+static uint64_t g_cpu_scale_clock;
+
+static inline int rga_cpu_scale_floor(double x) {
+    int i = (int)x;
+
+    return i > x ? i - 1 : i;
+}
+
+static inline int rga_cpu_scale_round(double x) {
+    return (int)(x >= 0 ? x + 0.5 : x - 0.5);
+}
+
+/* Catmull-Rom, a = -0.5 */
+static double rga_cpu_scale_cubic(double t) {
+    const double a = -0.5;
+
+    if (t < 0)
+        t = -t;
+    if (t <= 1.0)
+        return ((a + 2) * t - (a + 3)) * t * t + 1;
+    if (t < 2.0)
+        return ((a * t - 5 * a) * t + 8 * a) * t - 4 * a;
+    return 0;
+}
+
+static inline uint8_t rga_cpu_scale_clip(int value) {
+    return value < 0 ? 0 : value > 0xff ? 0xff : (uint8_t)value;
+}
+
+static int rga_cpu_scale_taps(int src_size, int dst_size, int interp) {
+    if (src_size == dst_size)
+        return 1;
+
+    switch (interp) {
+        case RGA_INTERP_LINEAR:
+            return 2;
+        case RGA_INTERP_BICUBIC:
+            return 4;
+        case RGA_INTERP_AVERAGE:
+        default:
+            /* ceil(scale) + 1 pixels overlap a dst pixel */
+            return src_size > dst_size ? (src_size + dst_size - 1) / dst_size + 1 : 2;
+    }
+}
+
+/* the weights of dst pixel i on the src pixels [*left, *left + taps) */
+static void rga_cpu_scale_weights(int src_size, int dst_size, int interp, int i,
+                                  int taps, int *left, double *weight) {
+    double scale = (double)src_size / dst_size;
+    double center = (i + 0.5) * scale - 0.5;
+    double low, high, overlap_low, overlap_high;
+    int k;
+
+    if (src_size == dst_size) {
+        *left = i;
+        weight[0] = 1.0;
+        return;
+    }
+
+    switch (interp) {
+        case RGA_INTERP_LINEAR:
+            *left = rga_cpu_scale_floor(center);
+            weight[1] = center - *left;
+            weight[0] = 1.0 - weight[1];
+            break;
+        case RGA_INTERP_BICUBIC:
+            *left = rga_cpu_scale_floor(center) - 1;
+            for (k = 0; k < taps; k++)
+                weight[k] = rga_cpu_scale_cubic(center - (*left + k));
+            break;
+        case RGA_INTERP_AVERAGE:
+        default:
+            low = i * scale;
+            high = (i + 1) * scale;
+            *left = rga_cpu_scale_floor(low);
+            for (k = 0; k < taps; k++) {
+                overlap_low = *left + k > low ? *left + k : low;
+                overlap_high = *left + k + 1 < high ? *left + k + 1 : high;
+                weight[k] = overlap_high > overlap_low ? (overlap_high - overlap_low) / scale : 0;
+            }
+            break;
+    }
+}
+
+static rga_cpu_scale_filter_t *rga_cpu_scale_filter_create(int src_size, int dst_size, int interp) {
+    rga_cpu_scale_filter_t *filter;
+    double *weight, *folded;
+    int taps, left, start, i, k, j, sum, max;
+    int16_t *q;
+
+    taps = rga_cpu_scale_taps(src_size, dst_size, interp);
+
+    filter = (rga_cpu_scale_filter_t *)malloc(sizeof(*filter) + sizeof(int32_t) * dst_size +
+                                              sizeof(int16_t) * dst_size * taps);
+    weight = (double *)malloc(sizeof(double) * taps * 2);
+    if (filter == NULL || weight == NULL) {
+        free(filter);
+        free(weight);
+        return NULL;
+    }
+    folded = weight + taps;
+
+    memset(filter, 0x0, sizeof(*filter));
+    filter->src_size = src_size;
+    filter->dst_size = dst_size;
+    filter->interp = interp;
+    filter->taps = taps > src_size ? src_size : taps;
+    filter->start = (int32_t *)(filter + 1);
+    filter->weight = (int16_t *)(filter->start + dst_size);
+
+    for (i = 0; i < dst_size; i++) {
+        rga_cpu_scale_weights(src_size, dst_size, interp, i, taps, &left, weight);
+
+        start = left;
+        if (start > src_size - filter->taps)
+            start = src_size - filter->taps;
+        if (start < 0)
+            start = 0;
+
+        for (k = 0; k < filter->taps; k++)
+            folded[k] = 0;
+        for (k = 0; k < taps; k++) {
+            j = left + k;
+            j = j < 0 ? 0 : j >= src_size ? src_size - 1 : j;
+            folded[j - start] += weight[k];
+        }
+
+        /* the rounding error goes to the largest tap */
+        q = filter->weight + (size_t)i * filter->taps;
+        sum = 0;
+        max = 0;
+        for (k = 0; k < filter->taps; k++) {
+            q[k] = (int16_t)rga_cpu_scale_round(folded[k] * RGA_CPU_SCALE_ONE);
+            sum += q[k];
+            if (q[k] > q[max])
+                max = k;
+        }
+        q[max] += RGA_CPU_SCALE_ONE - sum;
+
+        filter->start[i] = start;
+    }
+
+    free(weight);
+
+    return filter;
+}
+
+rga_cpu_scale_filter_t *rga_cpu_scale_filter_get(int src_size, int dst_size, int interp) {
+    rga_cpu_scale_filter_t *filter = NULL;
+    int i, victim = -1;
+
+    if (src_size <= 0 || dst_size <= 0)
+        return NULL;
+
+    /* only the filter matters for the key, see rga_cpu_scale_taps() */
+    if (src_size == dst_size)
+        interp = RGA_INTERP_DEFAULT;
+    else if (interp == RGA_INTERP_DEFAULT)
+        interp = src_size > dst_size ? RGA_INTERP_AVERAGE : RGA_INTERP_BICUBIC;
+
+    pthread_mutex_lock(&g_cpu_scale_lock);
+    for (i = 0; i < RGA_CPU_SCALE_CACHE_SIZE; i++) {
+        filter = g_cpu_scale_cache[i];
+        if (filter != NULL && filter->src_size == src_size &&
+            filter->dst_size == dst_size && filter->interp == interp) {
+            filter->refcount++;
+            filter->last_use = ++g_cpu_scale_clock;
+            pthread_mutex_unlock(&g_cpu_scale_lock);
+            return filter;
+        }
+    }
+    pthread_mutex_unlock(&g_cpu_scale_lock);
+
+    filter = rga_cpu_scale_filter_create(src_size, dst_size, interp);
+    if (filter == NULL) {
+        IM_LOGE("CPU scale filter alloc failed!\n");
+        return NULL;
+    }
+    filter->refcount = 1;
+
+    /* replace an empty entry, or the least recently used one not in use */
+    pthread_mutex_lock(&g_cpu_scale_lock);
+    for (i = 0; i < RGA_CPU_SCALE_CACHE_SIZE; i++) {
+        if (g_cpu_scale_cache[i] == NULL) {
+            victim = i;
+            break;
+        }
+        if (g_cpu_scale_cache[i]->refcount == 0 &&
+            (victim < 0 || g_cpu_scale_cache[i]->last_use < g_cpu_scale_cache[victim]->last_use))
+            victim = i;
+    }
+    if (victim >= 0) {
+        free(g_cpu_scale_cache[victim]);
+        g_cpu_scale_cache[victim] = filter;
+        filter->cached = true;
+        filter->last_use = ++g_cpu_scale_clock;
+    }
+    pthread_mutex_unlock(&g_cpu_scale_lock);
+
+    return filter;
+}
+
+void rga_cpu_scale_filter_put(rga_cpu_scale_filter_t *filter) {
+    bool release;
+
+    if (filter == NULL)
+        return;
+
+    pthread_mutex_lock(&g_cpu_scale_lock);
+    filter->refcount--;
+    release = !filter->cached && filter->refcount == 0;
+    pthread_mutex_unlock(&g_cpu_scale_lock);
+
+    if (release)
+        free(filter);
+}
+
+static inline bool rga_cpu_scale_filter_is_identity(const rga_cpu_scale_filter_t *filter) {
+    return filter->src_size == filter->dst_size;
+}
+
+static void rga_cpu_scale_horiz_c(const rga_cpu_scale_filter_t *filter, bool flip, const uint8_t *in,
+                                  uint8_t *out, int begin, int count) {
+    int i, k, c, d, sum;
+
+    for (i = begin; i < count; i++) {
+        const int16_t *weight;
+        const uint8_t *p;
+
+        d = flip ? filter->dst_size - 1 - i : i;
+        weight = filter->weight + (size_t)d * filter->taps;
+        p = in + (size_t)filter->start[d] * RGA_CPU_PIXEL_SIZE;
+
+        for (c = 0; c < RGA_CPU_PIXEL_SIZE; c++) {
+            sum = RGA_CPU_SCALE_ROUND;
+            for (k = 0; k < filter->taps; k++)
+                sum += weight[k] * p[k * RGA_CPU_PIXEL_SIZE + c];
+            out[(size_t)i * RGA_CPU_PIXEL_SIZE + c] = rga_cpu_scale_clip(sum >> RGA_CPU_SCALE_SHIFT);
+        }
+    }
+}
+
+static void rga_cpu_scale_verti_c(const int16_t *weight, int taps, const uint8_t * const *rows,
+                                  uint8_t *out, int begin, int size) {
+    int i, k, sum;
+
+    for (i = begin; i < size; i++) {
+        sum = RGA_CPU_SCALE_ROUND;
+        for (k = 0; k < taps; k++)
+            sum += weight[k] * rows[k][i];
+        out[i] = rga_cpu_scale_clip(sum >> RGA_CPU_SCALE_SHIFT);
+    }
+}
+
+#ifdef RGA_CPU_SCALE_SSE2
+static inline __m128i rga_cpu_scale_pair_sse2(const int16_t *weight, int k, int taps) {
+    uint32_t high = k + 1 < taps ? (uint16_t)weight[k + 1] : 0;
+
+    return _mm_set1_epi32((int32_t)((high << 16) | (uint16_t)weight[k]));
+}
+
+/*
+ * One dst pixel per loop: 2 adjacent src pixels are interleaved per channel
+ * as int16 pairs, so that pmaddwd applies 2 taps to the 4 channels.
+ */
+static void rga_cpu_scale_horiz_sse2(const rga_cpu_scale_filter_t *filter, bool flip,
+                                     const uint8_t *in, uint8_t *out, int begin, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(RGA_CPU_SCALE_ROUND);
+    int i, k, d, taps = filter->taps;
+    int32_t value;
+
+    for (i = begin; i < count; i++) {
+        const int16_t *weight;
+        const uint8_t *p;
+        __m128i acc = round, pixel;
+
+        d = flip ? filter->dst_size - 1 - i : i;
+        weight = filter->weight + (size_t)d * taps;
+        p = in + (size_t)filter->start[d] * RGA_CPU_PIXEL_SIZE;
+
+        for (k = 0; k + 1 < taps; k += 2) {
+            pixel = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p + k * RGA_CPU_PIXEL_SIZE)), zero);
+            pixel = _mm_unpacklo_epi16(pixel, _mm_srli_si128(pixel, 8));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixel, rga_cpu_scale_pair_sse2(weight, k, taps)));
+        }
+        if (k < taps) {
+            memcpy(&value, p + k * RGA_CPU_PIXEL_SIZE, sizeof(value));
+            pixel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero);
+            pixel = _mm_unpacklo_epi16(pixel, zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixel, rga_cpu_scale_pair_sse2(weight, k, taps)));
+        }
+
+        acc = _mm_srai_epi32(acc, RGA_CPU_SCALE_SHIFT);
+        acc = _mm_packs_epi32(acc, acc);
+        value = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+        memcpy(out + (size_t)i * RGA_CPU_PIXEL_SIZE, &value, sizeof(value));
+    }
+}
+
+/* 16 bytes per loop, the rows are interleaved in pairs for pmaddwd */
+static void rga_cpu_scale_verti_sse2(const int16_t *weight, int taps, const uint8_t * const *rows,
+                                     uint8_t *out, int begin, int size) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(RGA_CPU_SCALE_ROUND);
+    int i, k;
+
+    for (i = begin; i + 16 <= size; i += 16) {
+        __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        __m128i a, b, lo, hi, w;
+
+        for (k = 0; k < taps; k += 2) {
+            w = rga_cpu_scale_pair_sse2(weight, k, taps);
+            a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            b = k + 1 < taps ? _mm_loadu_si128((const __m128i *)(rows[k + 1] + i)) : zero;
+
+            lo = _mm_unpacklo_epi8(a, b);
+            hi = _mm_unpackhi_epi8(a, b);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+
+        acc0 = _mm_packs_epi32(_mm_srai_epi32(acc0, RGA_CPU_SCALE_SHIFT),
+                               _mm_srai_epi32(acc1, RGA_CPU_SCALE_SHIFT));
+        acc2 = _mm_packs_epi32(_mm_srai_epi32(acc2, RGA_CPU_SCALE_SHIFT),
+                               _mm_srai_epi32(acc3, RGA_CPU_SCALE_SHIFT));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(acc0, acc2));
+    }
+
+    rga_cpu_scale_verti_c(weight, taps, rows, out, i, size);
+}
+#endif /* #ifdef RGA_CPU_SCALE_SSE2 */
+
+#ifdef RGA_CPU_SCALE_NEON
+static void rga_cpu_scale_horiz_neon(const rga_cpu_scale_filter_t *filter, bool flip,
+                                     const uint8_t *in, uint8_t *out, int begin, int count) {
+    int i, k, d, taps = filter->taps;
+    uint32_t value;
+
+    for (i = begin; i < count; i++) {
+        const int16_t *weight;
+        const uint8_t *p;
+        int32x4_t acc = vdupq_n_s32(RGA_CPU_SCALE_ROUND);
+        int16x4_t pixel;
+        uint8x8_t result;
+
+        d = flip ? filter->dst_size - 1 - i : i;
+        weight = filter->weight + (size_t)d * taps;
+        p = in + (size_t)filter->start[d] * RGA_CPU_PIXEL_SIZE;
+
+        for (k = 0; k < taps; k++) {
+            memcpy(&value, p + k * RGA_CPU_PIXEL_SIZE, sizeof(value));
+            pixel = vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(value)))));
+            acc = vmlal_n_s16(acc, pixel, weight[k]);
+        }
+
+        pixel = vqmovn_s32(vshrq_n_s32(acc, RGA_CPU_SCALE_SHIFT));
+        result = vqmovun_s16(vcombine_s16(pixel, pixel));
+        value = vget_lane_u32(vreinterpret_u32_u8(result), 0);
+        memcpy(out + (size_t)i * RGA_CPU_PIXEL_SIZE, &value, sizeof(value));
+    }
+}
+
+static void rga_cpu_scale_verti_neon(const int16_t *weight, int taps, const uint8_t * const *rows,
+                                     uint8_t *out, int begin, int size) {
+    int i, k;
+
+    for (i = begin; i + 16 <= size; i += 16) {
+        int32x4_t acc0 = vdupq_n_s32(RGA_CPU_SCALE_ROUND), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        int16x8_t lo, hi;
+
+        for (k = 0; k < taps; k++) {
+            uint8x16_t a = vld1q_u8(rows[k] + i);
+
+            lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+            hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(lo), weight[k]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(lo), weight[k]);
+            acc2 = vmlal_n_s16(acc2, vget_low_s16(hi), weight[k]);
+            acc3 = vmlal_n_s16(acc3, vget_high_s16(hi), weight[k]);
+        }
+
+        lo = vcombine_s16(vqmovn_s32(vshrq_n_s32(acc0, RGA_CPU_SCALE_SHIFT)),
+                          vqmovn_s32(vshrq_n_s32(acc1, RGA_CPU_SCALE_SHIFT)));
+        hi = vcombine_s16(vqmovn_s32(vshrq_n_s32(acc2, RGA_CPU_SCALE_SHIFT)),
+                          vqmovn_s32(vshrq_n_s32(acc3, RGA_CPU_SCALE_SHIFT)));
+        vst1q_u8(out + i, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+    }
+
+    rga_cpu_scale_verti_c(weight, taps, rows, out, i, size);
+}
+#endif /* #ifdef RGA_CPU_SCALE_NEON */
+
+static rga_cpu_scale_kernel_t g_cpu_scale_kernel = { rga_cpu_scale_horiz_c, rga_cpu_scale_verti_c };
+static pthread_once_t g_cpu_scale_once = PTHREAD_ONCE_INIT;
+
+static void rga_cpu_scale_dispatch_init(void) {
+    if (!rga_cpu_simd_enable())
+        return;
+
+#if defined(RGA_CPU_SCALE_SSE2)
+    g_cpu_scale_kernel.horiz = rga_cpu_scale_horiz_sse2;
+    g_cpu_scale_kernel.verti = rga_cpu_scale_verti_sse2;
+#elif defined(RGA_CPU_SCALE_NEON)
+    g_cpu_scale_kernel.horiz = rga_cpu_scale_horiz_neon;
+    g_cpu_scale_kernel.verti = rga_cpu_scale_verti_neon;
+#endif
+}
+
+int rga_cpu_scaler_init(rga_cpu_scaler_t *scaler,
+                        const rga_cpu_scale_filter_t *x_filter, bool flip_h,
+                        const rga_cpu_scale_filter_t *y_filter, bool flip_v,
+                        rga_cpu_scale_source_fn source, void *arg) {
+    size_t line_size = (size_t)x_filter->src_size * RGA_CPU_PIXEL_SIZE;
+    size_t row_size = (size_t)x_filter->dst_size * RGA_CPU_PIXEL_SIZE;
+    int taps = y_filter->taps;
+    int i;
+
+    pthread_once(&g_cpu_scale_once, rga_cpu_scale_dispatch_init);
+
+    memset(scaler, 0x0, sizeof(*scaler));
+    scaler->x_filter = x_filter;
+    scaler->y_filter = y_filter;
+    scaler->flip_h = flip_h;
+    scaler->flip_v = flip_v;
+    scaler->source = source;
+    scaler->arg = arg;
+
+    scaler->buffer = (uint8_t *)malloc(line_size + row_size * taps +
+                                       (sizeof(*scaler->slot) + sizeof(*scaler->ring) * 2 +
+                                        sizeof(*scaler->index)) * taps);
+    if (scaler->buffer == NULL)
+        return -ENOMEM;
+
+    scaler->slot = (uint8_t **)scaler->buffer;
+    scaler->ring = (const uint8_t **)(scaler->slot + taps);
+    scaler->rows = scaler->ring + taps;
+    scaler->index = (int *)(scaler->rows + taps);
+    scaler->line = (uint8_t *)(scaler->index + taps);
+    for (i = 0; i < taps; i++) {
+        scaler->slot[i] = scaler->line + line_size + row_size * i;
+        scaler->ring[i] = NULL;
+        scaler->index[i] = -1;
+    }
+
+    return 0;
+}
+
+/* source row y, filtered horizontally */
+static const uint8_t *rga_cpu_scaler_fetch(rga_cpu_scaler_t *scaler, int y) {
+    const rga_cpu_scale_filter_t *x_filter = scaler->x_filter;
+    int slot = y % scaler->y_filter->taps;
+    const uint8_t *line;
+
+    if (scaler->index[slot] == y)
+        return scaler->ring[slot];
+
+    if (rga_cpu_scale_filter_is_identity(x_filter) && !scaler->flip_h) {
+        scaler->ring[slot] = scaler->source(scaler->arg, y, scaler->slot[slot]);
+    } else {
+        line = scaler->source(scaler->arg, y, scaler->line);
+        g_cpu_scale_kernel.horiz(x_filter, scaler->flip_h, line, scaler->slot[slot],
+                                 0, x_filter->dst_size);
+        scaler->ring[slot] = scaler->slot[slot];
+    }
+    scaler->index[slot] = y;
+
+    return scaler->ring[slot];
+}
+
+/* dst row y, 4-channel */
+void rga_cpu_scaler_row(rga_cpu_scaler_t *scaler, int y, uint8_t *out) {
+    const rga_cpu_scale_filter_t *y_filter = scaler->y_filter;
+    size_t size = (size_t)scaler->x_filter->dst_size * RGA_CPU_PIXEL_SIZE;
+    int taps = y_filter->taps;
+    int d, k, start;
+
+    d = scaler->flip_v ? y_filter->dst_size - 1 - y : y;
+    start = y_filter->start[d];
+
+    if (taps == 1) {
+        memcpy(out, rga_cpu_scaler_fetch(scaler, start), size);
+        return;
+    }
+
+    /* the rows [start, start + taps) fall in different slots */
+    for (k = 0; k < taps; k++)
+        scaler->rows[k] = rga_cpu_scaler_fetch(scaler, start + k);
+
+    g_cpu_scale_kernel.verti(y_filter->weight + (size_t)d * taps, taps, scaler->rows, out,
+                             0, (int)size);
+}
+
+void rga_cpu_scaler_exit(rga_cpu_scaler_t *scaler) {
+    free(scaler->buffer);
+    scaler->buffer = NULL;
+}
+#endif /* #ifdef RGA_CPU_BACKEND_ENABLE */
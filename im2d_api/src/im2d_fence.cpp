@@ -0,0 +1,507 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_fence"
+#else
+#define LOG_TAG "im2d_fence"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(RGA_SYNC_DISABLE)
+#define RGA_FENCE_REACTOR_ENABLE
+#endif
+
+#ifdef RGA_FENCE_REACTOR_ENABLE
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_impl.h"
+
+#include "core/rga_sync.h"
+
+#ifdef RGA_FENCE_REACTOR_ENABLE
+#define RGA_FENCE_POLL_EVENTS_MAX 16
+
+typedef struct rga_fence_watch {
+    int fence_fd;
+    im_fence_callback_t callback;
+    void *userdata;
+} rga_fence_watch_t;
+
+/*
+ * All watched fences share one epoll fd, registered with EPOLLONESHOT so
+ * that each fence is reported to only one poller, the reactor thread or a
+ * thread calling imfencePoll(). wake_fd is registered with a NULL watch and
+ * is only used to stop the reactor thread.
+ */
+struct rga_fence_reactor {
+    int epoll_fd;
+    int wake_fd;
+
+    atomic_int stop;
+
+    pthread_mutex_t mutex;
+    pthread_t thread;
+    bool running;
+};
+
+static struct rga_fence_reactor g_fence_reactor;
+static pthread_once_t g_fence_reactor_once = PTHREAD_ONCE_INIT;
+
+static void rga_fence_reactor_init(void) {
+    struct epoll_event event;
+
+    g_fence_reactor.wake_fd = -1;
+    g_fence_reactor.running = false;
+    atomic_store(&g_fence_reactor.stop, 0);
+    pthread_mutex_init(&g_fence_reactor.mutex, NULL);
+
+    g_fence_reactor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (g_fence_reactor.epoll_fd < 0) {
+        IM_LOGE("fence reactor epoll create failed: %s\n", strerror(errno));
+        return;
+    }
+
+    g_fence_reactor.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (g_fence_reactor.wake_fd < 0) {
+        IM_LOGE("fence reactor eventfd create failed: %s\n", strerror(errno));
+        return;
+    }
+
+    memset(&event, 0x0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(g_fence_reactor.epoll_fd, EPOLL_CTL_ADD, g_fence_reactor.wake_fd, &event) < 0) {
+        IM_LOGE("fence reactor add wake fd failed: %s\n", strerror(errno));
+        close(g_fence_reactor.wake_fd);
+        g_fence_reactor.wake_fd = -1;
+    }
+}
+
+static void rga_fence_reactor_drain_wake(void) {
+    uint64_t value;
+    ssize_t size;
+
+    size = read(g_fence_reactor.wake_fd, &value, sizeof(value));
+    (void)size;
+}
+
+static int rga_fence_reactor_get(void) {
+    pthread_once(&g_fence_reactor_once, rga_fence_reactor_init);
+
+    if (g_fence_reactor.epoll_fd < 0)
+        return IM_STATUS_FAILED;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_fence_watch(int fence_fd, im_fence_callback_t callback, void *userdata) {
+    struct epoll_event event;
+    rga_fence_watch_t *watch;
+
+    if (fence_fd < 0 || callback == NULL) {
+        IM_LOGE("illegal fence watch, fence_fd = %d, callback = %p\n", fence_fd, callback);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    if (rga_fence_reactor_get() != IM_STATUS_SUCCESS)
+        return IM_STATUS_FAILED;
+
+    /* the fence may belong to a batch deferred by this thread */
+    rga_deferred_kick();
+
+    watch = (rga_fence_watch_t *)malloc(sizeof(*watch));
+    if (watch == NULL) {
+        IM_LOGE("fence watch alloc error!\n");
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    watch->fence_fd = fence_fd;
+    watch->callback = callback;
+    watch->userdata = userdata;
+
+    memset(&event, 0x0, sizeof(event));
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = watch;
+    if (epoll_ctl(g_fence_reactor.epoll_fd, EPOLL_CTL_ADD, fence_fd, &event) < 0) {
+        IM_LOGE("watch fence[%d] failed: %s\n", fence_fd, strerror(errno));
+        free(watch);
+        return IM_STATUS_FAILED;
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+int rga_fence_poll(int timeout_ms) {
+    int i, count, done = 0;
+    struct epoll_event events[RGA_FENCE_POLL_EVENTS_MAX];
+    rga_fence_watch_t *watch;
+
+    if (rga_fence_reactor_get() != IM_STATUS_SUCCESS)
+        return IM_STATUS_FAILED;
+
+    count = epoll_wait(g_fence_reactor.epoll_fd, events, RGA_FENCE_POLL_EVENTS_MAX, timeout_ms);
+    if (count < 0) {
+        if (errno == EINTR)
+            return 0;
+
+        IM_LOGE("fence poll failed: %s\n", strerror(errno));
+        return IM_STATUS_FAILED;
+    }
+
+    for (i = 0; i < count; i++) {
+        watch = (rga_fence_watch_t *)events[i].data.ptr;
+        if (watch == NULL) {
+            /* Leave the wake event pending until the reactor thread has seen it. */
+            if (!atomic_load(&g_fence_reactor.stop))
+                rga_fence_reactor_drain_wake();
+            continue;
+        }
+
+        epoll_ctl(g_fence_reactor.epoll_fd, EPOLL_CTL_DEL, watch->fence_fd, NULL);
+
+        watch->callback(watch->fence_fd,
+                        (events[i].events & EPOLLERR) ? IM_STATUS_FAILED : IM_STATUS_SUCCESS,
+                        watch->userdata);
+
+        close(watch->fence_fd);
+        free(watch);
+
+        done++;
+    }
+
+    return done;
+}
+
+static void *rga_fence_reactor_thread(void *arg) {
+    (void)arg;
+
+    while (!atomic_load(&g_fence_reactor.stop))
+        rga_fence_poll(-1);
+
+    return NULL;
+}
+
+IM_STATUS rga_fence_reactor_start(void) {
+    int ret;
+
+    if (rga_fence_reactor_get() != IM_STATUS_SUCCESS)
+        return IM_STATUS_FAILED;
+
+    if (g_fence_reactor.wake_fd < 0)
+        return IM_STATUS_FAILED;
+
+    pthread_mutex_lock(&g_fence_reactor.mutex);
+
+    if (g_fence_reactor.running) {
+        pthread_mutex_unlock(&g_fence_reactor.mutex);
+        return IM_STATUS_SUCCESS;
+    }
+
+    atomic_store(&g_fence_reactor.stop, 0);
+
+    ret = pthread_create(&g_fence_reactor.thread, NULL, rga_fence_reactor_thread, NULL);
+    if (ret != 0) {
+        IM_LOGE("fence reactor thread create failed: %s\n", strerror(ret));
+        pthread_mutex_unlock(&g_fence_reactor.mutex);
+        return IM_STATUS_FAILED;
+    }
+
+    g_fence_reactor.running = true;
+
+    pthread_mutex_unlock(&g_fence_reactor.mutex);
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_fence_reactor_stop(void) {
+    uint64_t value = 1;
+
+    if (rga_fence_reactor_get() != IM_STATUS_SUCCESS)
+        return IM_STATUS_FAILED;
+
+    pthread_mutex_lock(&g_fence_reactor.mutex);
+
+    if (!g_fence_reactor.running) {
+        pthread_mutex_unlock(&g_fence_reactor.mutex);
+        return IM_STATUS_SUCCESS;
+    }
+
+    if (pthread_equal(pthread_self(), g_fence_reactor.thread)) {
+        IM_LOGE("cannot stop the fence reactor from a callback!\n");
+        pthread_mutex_unlock(&g_fence_reactor.mutex);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    atomic_store(&g_fence_reactor.stop, 1);
+    if (write(g_fence_reactor.wake_fd, &value, sizeof(value)) < 0)
+        IM_LOGE("fence reactor wake failed: %s\n", strerror(errno));
+
+    pthread_join(g_fence_reactor.thread, NULL);
+    g_fence_reactor.running = false;
+
+    rga_fence_reactor_drain_wake();
+    atomic_store(&g_fence_reactor.stop, 0);
+
+    pthread_mutex_unlock(&g_fence_reactor.mutex);
+
+    return IM_STATUS_SUCCESS;
+}
+#else
+IM_STATUS rga_fence_watch(int fence_fd, im_fence_callback_t callback, void *userdata) {
+    (void)fence_fd;
+    (void)callback;
+    (void)userdata;
+
+    IM_LOGW("fence reactor is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+int rga_fence_poll(int timeout_ms) {
+    (void)timeout_ms;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_fence_reactor_start(void) {
+    IM_LOGW("fence reactor is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_fence_reactor_stop(void) {
+    return IM_STATUS_SUCCESS;
+}
+#endif /* #ifdef RGA_FENCE_REACTOR_ENABLE */
+
+/*
+ * Submit helpers for the callback variants. If the release fence cannot be
+ * watched, wait for it here so that the callback is still called exactly
+ * once.
+ */
+static IM_STATUS rga_fence_watch_or_wait(int fence_fd, im_fence_callback_t callback, void *userdata) {
+    IM_STATUS status = IM_STATUS_SUCCESS;
+
+    if (fence_fd < 0) {
+        callback(-1, IM_STATUS_SUCCESS, userdata);
+        return IM_STATUS_SUCCESS;
+    }
+
+    if (rga_fence_watch(fence_fd, callback, userdata) == IM_STATUS_SUCCESS)
+        return IM_STATUS_SUCCESS;
+
+    if (rga_sync_wait(fence_fd, -1) < 0)
+        status = IM_STATUS_FAILED;
+
+    callback(fence_fd, status, userdata);
+    close(fence_fd);
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_fence_task_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                im_rect srect, im_rect drect, im_rect prect,
+                                int acquire_fence_fd, im_opt_t *opt_ptr, int usage,
+                                im_fence_callback_t callback, void *userdata) {
+    IM_STATUS ret;
+    int release_fence_fd = -1;
+
+    if (callback == NULL) {
+        IM_LOGE("callback cannot be NULL!\n");
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    usage = (usage & ~IM_SYNC) | IM_ASYNC;
+
+    ret = rga_single_task_submit(src, dst, pat, srect, drect, prect,
+                                 acquire_fence_fd, &release_fence_fd, opt_ptr, usage);
+    if (ret != IM_STATUS_SUCCESS)
+        return ret;
+
+    return rga_fence_watch_or_wait(release_fence_fd, callback, userdata);
+}
+
+IM_STATUS rga_fence_job_submit(im_job_handle_t job_handle, int acquire_fence_fd,
+                               im_fence_callback_t callback, void *userdata) {
+    IM_STATUS ret;
+    int release_fence_fd = -1;
+
+    if (callback == NULL) {
+        IM_LOGE("callback cannot be NULL!\n");
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    rga_deferred_kick();
+
+    ret = rga_job_submit(job_handle, IM_ASYNC, acquire_fence_fd, &release_fence_fd);
+    if (ret != IM_STATUS_SUCCESS)
+        return ret;
+
+    return rga_fence_watch_or_wait(release_fence_fd, callback, userdata);
+}
+
+/*
+ * A fence set collects fences in userspace and only merges them when an fd
+ * has to be handed out. Fences that are already signaled (zero-timeout
+ * poll) are dropped when added and before merging, the rest are merged
+ * pairwise in rounds (a balanced tree) so that each sync_file created
+ * holds at most twice the fences of its inputs, instead of growing by one
+ * fence per merge as with a chain.
+ */
+#define RGA_FENCE_SET_INIT_CAPACITY 8
+
+struct im_fence_set {
+    int *fds;
+    int count;
+    int capacity;
+};
+
+static bool rga_fence_is_signaled(int fence_fd) {
+    return rga_sync_wait(fence_fd, 0) == 0;
+}
+
+static void rga_fence_set_prune(im_fence_set_t *set) {
+    for (int i = 0; i < set->count;) {
+        if (rga_fence_is_signaled(set->fds[i])) {
+            close(set->fds[i]);
+            set->fds[i] = set->fds[--set->count];
+        } else {
+            i++;
+        }
+    }
+}
+
+im_fence_set_t *rga_fence_set_create(void) {
+    im_fence_set_t *set;
+
+    set = (im_fence_set_t *)malloc(sizeof(*set));
+    if (set == NULL) {
+        IM_LOGE("fence set alloc error!\n");
+        return NULL;
+    }
+
+    set->fds = NULL;
+    set->count = 0;
+    set->capacity = 0;
+
+    return set;
+}
+
+IM_STATUS rga_fence_set_add(im_fence_set_t *set, int fence_fd) {
+    int capacity;
+    int *fds;
+
+    if (set == NULL || fence_fd < 0) {
+        IM_LOGE("illegal fence set[%p] or fence_fd[%d]\n", set, fence_fd);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    if (rga_fence_is_signaled(fence_fd)) {
+        close(fence_fd);
+        return IM_STATUS_SUCCESS;
+    }
+
+    if (set->count == set->capacity)
+        rga_fence_set_prune(set);
+
+    if (set->count == set->capacity) {
+        capacity = set->capacity ? set->capacity * 2 : RGA_FENCE_SET_INIT_CAPACITY;
+
+        fds = (int *)realloc(set->fds, capacity * sizeof(*fds));
+        if (fds == NULL) {
+            IM_LOGE("fence set grow to %d failed!\n", capacity);
+            return IM_STATUS_OUT_OF_MEMORY;
+        }
+
+        set->fds = fds;
+        set->capacity = capacity;
+    }
+
+    set->fds[set->count++] = fence_fd;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_fence_set_merge(im_fence_set_t *set, int *fence_fd) {
+    int i, j, merge_fd;
+
+    if (set == NULL || fence_fd == NULL) {
+        IM_LOGE("illegal fence set[%p] or fence_fd[%p]\n", set, fence_fd);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    rga_fence_set_prune(set);
+
+    while (set->count > 1) {
+        for (i = 0, j = 0; i + 1 < set->count; i += 2) {
+            merge_fd = rga_sync_merge("rga_fence_set", set->fds[i], set->fds[i + 1]);
+            if (merge_fd < 0) {
+                /* cannot merge, resolve the first fence here instead */
+                IM_LOGW("fence merge failed, wait for fence[%d]\n", set->fds[i]);
+                rga_sync_wait(set->fds[i], -1);
+                close(set->fds[i]);
+                merge_fd = set->fds[i + 1];
+            } else {
+                close(set->fds[i]);
+                close(set->fds[i + 1]);
+            }
+
+            set->fds[j++] = merge_fd;
+        }
+
+        if (i < set->count)
+            set->fds[j++] = set->fds[i];
+
+        set->count = j;
+    }
+
+    *fence_fd = set->count ? set->fds[0] : -1;
+    set->count = 0;
+
+    return IM_STATUS_SUCCESS;
+}
+
+void rga_fence_set_release(im_fence_set_t *set) {
+    if (set == NULL)
+        return;
+
+    for (int i = 0; i < set->count; i++)
+        close(set->fds[i]);
+
+    free(set->fds);
+    free(set);
+}
@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_frame_pool"
+#else
+#define LOG_TAG "im2d_frame_pool"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__) && !defined(RGA_SYNC_DISABLE)
+#define RGA_FRAME_POOL_ENABLE
+#endif
+
+#ifdef RGA_FRAME_POOL_ENABLE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_impl.h"
+
+#include "RgaUtils.h"
+#include "utils.h"
+
+/*
+ * Frame pool: the frames are allocated and imported once when the pool is
+ * created, acquire/release only move a frame in or out of the free list.
+ *
+ * The free list is a lock-free stack of frame indexes. The head packs the
+ * index + 1 (0: empty) with a tag bumped by every update, so a head that was
+ * popped and pushed back meanwhile (ABA) does not match.
+ *
+ * The frames of a dma-heap are imported by fd. The memfd stand-in heap has
+ * no dma-buf, its frames are mapped and imported by virtual address.
+ */
+#ifdef RGA_FRAME_POOL_ENABLE
+#define RGA_FRAME_POOL_COUNT_MAX    256
+
+#define RGA_FRAME_POOL_HEAD(tag, index)     (((uint64_t)(tag) << 32) | (uint32_t)((index) + 1))
+#define RGA_FRAME_POOL_HEAD_TAG(head)       ((uint32_t)((head) >> 32))
+#define RGA_FRAME_POOL_HEAD_INDEX(head)     ((int)(uint32_t)(head) - 1)
+
+struct dma_heap_allocation_data {
+    uint64_t len;
+    uint32_t fd;
+    uint32_t fd_flags;
+    uint64_t heap_flags;
+};
+
+#define DMA_HEAP_IOC_MAGIC      'H'
+#define DMA_HEAP_IOCTL_ALLOC    _IOWR(DMA_HEAP_IOC_MAGIC, 0x0, struct dma_heap_allocation_data)
+
+typedef struct rga_frame {
+    int fd;
+    void *vir_addr;
+    rga_buffer_handle_t handle;
+
+    _Atomic(int) next;          /* index of the next free frame, -1: none */
+    _Atomic(bool) in_use;
+} rga_frame_t;
+
+struct im_frame_pool {
+    im_frame_pool_param_t param;
+    bool memfd;
+    size_t size;
+
+    _Atomic(uint64_t) free_head;
+
+    int count;
+    rga_frame_t frame[1];
+};
+
+static int rga_frame_pool_memfd_alloc(size_t size) {
+    int fd;
+
+#ifdef __NR_memfd_create
+    fd = (int)syscall(__NR_memfd_create, "rga_frame_pool", 0);
+#else
+    errno = ENOSYS;
+    fd = -1;
+#endif
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int rga_frame_pool_dma_heap_alloc(int heap_fd, size_t size) {
+    struct dma_heap_allocation_data data;
+
+    memset(&data, 0x0, sizeof(data));
+    data.len = size;
+    data.fd_flags = O_CLOEXEC | O_RDWR;
+
+    if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &data) < 0)
+        return -1;
+
+    return (int)data.fd;
+}
+
+static void rga_frame_pool_free_frames(im_frame_pool_t *pool) {
+    rga_frame_t *frame;
+
+    for (int i = 0; i < pool->count; i++) {
+        frame = &pool->frame[i];
+
+        if (frame->vir_addr != NULL)
+            munmap(frame->vir_addr, pool->size);
+        if (frame->fd >= 0)
+            close(frame->fd);
+    }
+}
+
+static void rga_frame_pool_push(im_frame_pool_t *pool, int index) {
+    uint64_t head, new_head;
+
+    head = atomic_load(&pool->free_head);
+    do {
+        atomic_store_explicit(&pool->frame[index].next, RGA_FRAME_POOL_HEAD_INDEX(head),
+                              memory_order_relaxed);
+        new_head = RGA_FRAME_POOL_HEAD(RGA_FRAME_POOL_HEAD_TAG(head) + 1, index);
+    } while (!atomic_compare_exchange_weak(&pool->free_head, &head, new_head));
+}
+
+static int rga_frame_pool_pop(im_frame_pool_t *pool) {
+    int index;
+    uint64_t head, new_head;
+
+    head = atomic_load(&pool->free_head);
+    do {
+        index = RGA_FRAME_POOL_HEAD_INDEX(head);
+        if (index < 0)
+            return -1;
+
+        new_head = RGA_FRAME_POOL_HEAD(RGA_FRAME_POOL_HEAD_TAG(head) + 1,
+                                       atomic_load_explicit(&pool->frame[index].next,
+                                                            memory_order_relaxed));
+    } while (!atomic_compare_exchange_weak(&pool->free_head, &head, new_head));
+
+    return index;
+}
+
+im_frame_pool_t *rga_frame_pool_create(const im_frame_pool_param_t *param) {
+    int ret, format, heap_fd = -1;
+    im_frame_pool_t *pool;
+    rga_frame_t *frame;
+    im_handle_param_t *handle_param = NULL;
+    rga_buffer_handle_t *handles = NULL;
+    void **vas = NULL;
+    int *fds = NULL;
+    const char *heap;
+    size_t page_size;
+
+    if (param == NULL) {
+        IM_LOGE("frame pool param is NULL!\n");
+        return NULL;
+    }
+
+    format = convert_to_rga_format(param->format);
+    if (param->width <= 0 || param->height <= 0 ||
+        param->wstride < 0 || param->hstride < 0 ||
+        (param->wstride > 0 && param->wstride < param->width) ||
+        (param->hstride > 0 && param->hstride < param->height) ||
+        param->count <= 0 || param->count > RGA_FRAME_POOL_COUNT_MAX ||
+        format == RK_FORMAT_UNKNOWN) {
+        IM_LOGE("illegal frame pool param, [w,h,ws,hs] = [%d, %d, %d, %d], format = 0x%x, count = %d\n",
+                param->width, param->height, param->wstride, param->hstride,
+                param->format, param->count);
+        return NULL;
+    }
+
+    pool = (im_frame_pool_t *)calloc(1, sizeof(*pool) + (param->count - 1) * sizeof(rga_frame_t));
+    if (pool == NULL) {
+        IM_LOGE("frame pool alloc failed, count = %d\n", param->count);
+        return NULL;
+    }
+
+    pool->param = *param;
+    if (pool->param.wstride == 0)
+        pool->param.wstride = param->width;
+    if (pool->param.hstride == 0)
+        pool->param.hstride = param->height;
+
+    heap = param->heap != NULL ? param->heap : IM_FRAME_POOL_HEAP_DEFAULT;
+    pool->memfd = strcmp(heap, IM_FRAME_POOL_HEAP_MEMFD) == 0;
+
+    /* the bpp of the YUV formats covers all the planes */
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    pool->size = (size_t)((double)pool->param.wstride * pool->param.hstride * get_bpp_from_format(format));
+    pool->size = (pool->size + page_size - 1) / page_size * page_size;
+
+    for (int i = 0; i < param->count; i++)
+        pool->frame[i].fd = -1;
+    pool->count = param->count;
+
+    if (!pool->memfd) {
+        heap_fd = open(heap, O_RDWR | O_CLOEXEC);
+        if (heap_fd < 0) {
+            IM_LOGE("open %s failed, %s\n", heap, strerror(errno));
+            goto err_free_pool;
+        }
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        frame = &pool->frame[i];
+
+        frame->fd = pool->memfd ? rga_frame_pool_memfd_alloc(pool->size) :
+                                  rga_frame_pool_dma_heap_alloc(heap_fd, pool->size);
+        if (frame->fd < 0) {
+            IM_LOGE("frame[%d] alloc %zu bytes from %s failed, %s\n",
+                    i, pool->size, heap, strerror(errno));
+            goto err_free_frames;
+        }
+
+        frame->vir_addr = mmap(NULL, pool->size, PROT_READ | PROT_WRITE, MAP_SHARED, frame->fd, 0);
+        if (frame->vir_addr == MAP_FAILED) {
+            IM_LOGE("frame[%d] mmap failed, %s\n", i, strerror(errno));
+            frame->vir_addr = NULL;
+            goto err_free_frames;
+        }
+    }
+
+    if (heap_fd >= 0) {
+        close(heap_fd);
+        heap_fd = -1;
+    }
+
+    handle_param = (im_handle_param_t *)malloc(pool->count * sizeof(*handle_param));
+    handles = (rga_buffer_handle_t *)malloc(pool->count * sizeof(*handles));
+    fds = (int *)malloc(pool->count * sizeof(*fds));
+    vas = (void **)malloc(pool->count * sizeof(*vas));
+    if (handle_param == NULL || handles == NULL || fds == NULL || vas == NULL) {
+        IM_LOGE("frame pool import alloc failed, count = %d\n", pool->count);
+        goto err_free_import;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        handle_param[i].width = pool->param.wstride;
+        handle_param[i].height = pool->param.hstride;
+        handle_param[i].format = pool->param.format;
+        fds[i] = pool->frame[i].fd;
+        vas[i] = pool->frame[i].vir_addr;
+    }
+
+    /* one ioctl for all the frames */
+    if (pool->memfd)
+        ret = rga_import_buffer_array(vas, RGA_VIRTUAL_ADDRESS, handle_param, pool->count, handles);
+    else
+        ret = rga_import_buffer_array(fds, RGA_DMA_BUFFER, handle_param, pool->count, handles);
+    if (ret != IM_STATUS_SUCCESS) {
+        IM_LOGE("frame pool import failed, %s\n", imStrError_t((IM_STATUS)ret));
+        for (int i = 0; i < pool->count; i++)
+            if (handles[i] > 0)
+                rga_release_buffer(handles[i]);
+        goto err_free_import;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        pool->frame[i].handle = handles[i];
+        atomic_store(&pool->frame[i].in_use, false);
+    }
+
+    atomic_store(&pool->free_head, RGA_FRAME_POOL_HEAD(0, -1));
+    for (int i = pool->count - 1; i >= 0; i--)
+        rga_frame_pool_push(pool, i);
+
+    free(handle_param);
+    free(handles);
+    free(fds);
+    free(vas);
+
+    return pool;
+
+err_free_import:
+    free(handle_param);
+    free(handles);
+    free(fds);
+    free(vas);
+err_free_frames:
+    rga_frame_pool_free_frames(pool);
+    if (heap_fd >= 0)
+        close(heap_fd);
+err_free_pool:
+    free(pool);
+
+    return NULL;
+}
+
+IM_STATUS rga_frame_pool_acquire(im_frame_pool_t *pool, rga_buffer_t *buffer) {
+    int index;
+    rga_frame_t *frame;
+
+    if (pool == NULL || buffer == NULL) {
+        IM_LOGE("illegal frame pool[%p] or buffer[%p]\n", pool, buffer);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    index = rga_frame_pool_pop(pool);
+    if (index < 0) {
+        IM_LOGD("frame pool[%p] is exhausted, count = %d\n", pool, pool->count);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    frame = &pool->frame[index];
+    atomic_store(&frame->in_use, true);
+
+    memset(buffer, 0x0, sizeof(*buffer));
+    buffer->handle = frame->handle;
+    buffer->vir_addr = frame->vir_addr;
+    buffer->fd = pool->memfd ? -1 : frame->fd;
+    buffer->width = pool->param.width;
+    buffer->height = pool->param.height;
+    buffer->wstride = pool->param.wstride;
+    buffer->hstride = pool->param.hstride;
+    buffer->format = pool->param.format;
+    buffer->global_alpha = 0xff;
+    buffer->color_space_mode = IM_COLOR_SPACE_DEFAULT;
+    buffer->rd_mode = IM_RASTER_MODE;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_frame_pool_release(im_frame_pool_t *pool, const rga_buffer_t *buffer) {
+    bool expected = true;
+
+    if (pool == NULL || buffer == NULL) {
+        IM_LOGE("illegal frame pool[%p] or buffer[%p]\n", pool, buffer);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->frame[i].handle != buffer->handle)
+            continue;
+
+        if (!atomic_compare_exchange_strong(&pool->frame[i].in_use, &expected, false)) {
+            IM_LOGE("frame[%d] of pool[%p] is not acquired, handle = %d\n", i, pool, buffer->handle);
+            return IM_STATUS_ILLEGAL_PARAM;
+        }
+
+        rga_frame_pool_push(pool, i);
+
+        return IM_STATUS_SUCCESS;
+    }
+
+    IM_LOGE("handle[%d] is not a frame of pool[%p]\n", buffer->handle, pool);
+    return IM_STATUS_ILLEGAL_PARAM;
+}
+
+IM_STATUS rga_frame_pool_destroy(im_frame_pool_t *pool) {
+    if (pool == NULL) {
+        IM_LOGE("frame pool is NULL!\n");
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        if (atomic_load(&pool->frame[i].in_use))
+            IM_LOGW("frame[%d] of pool[%p] is still acquired\n", i, pool);
+        if (pool->frame[i].handle > 0)
+            rga_release_buffer(pool->frame[i].handle);
+    }
+
+    rga_frame_pool_free_frames(pool);
+    free(pool);
+
+    return IM_STATUS_SUCCESS;
+}
+#else
+im_frame_pool_t *rga_frame_pool_create(const im_frame_pool_param_t *param) {
+    (void)param;
+
+    IM_LOGE("frame pool is not supported on this platform.\n");
+    return NULL;
+}
+
+IM_STATUS rga_frame_pool_acquire(im_frame_pool_t *pool, rga_buffer_t *buffer) {
+    (void)pool;
+    (void)buffer;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_frame_pool_release(im_frame_pool_t *pool, const rga_buffer_t *buffer) {
+    (void)pool;
+    (void)buffer;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_frame_pool_destroy(im_frame_pool_t *pool) {
+    (void)pool;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+#endif
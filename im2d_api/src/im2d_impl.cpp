@@ -29,6 +29,15 @@
 #include <errno.h>
 #include <math.h>
 
+#ifndef RT_THREAD
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#endif
+
 #include "im2d.h"
 #include "im2d_job.h"
 #include "im2d_log.h"
@@ -39,6 +48,7 @@
 #include "im2d_impl.h"
 
 #include "core/NormalRga.h"
+#include "core/rga_sync.h"
 #include "RgaUtils.h"
 #include "utils.h"
 
@@ -69,6 +79,11 @@ using namespace android;
 #endif
 
 RGA_THREAD_LOCAL im_context_t g_im2d_context;
+#ifdef RGA_CHECK_CACHE_ENABLE
+static RGA_THREAD_LOCAL rga_check_cache_t g_check_cache;
+static RGA_THREAD_LOCAL rga_core_mask_cache_entry_t g_core_mask_cache[RGA_CHECK_CACHE_SIZE];
+#endif
+extern RGA_THREAD_LOCAL char g_rga_err_str[IM_ERR_MSG_LEN];
 
 static IM_STATUS rga_support_info_merge_table(rga_info_table_entry *dst_table, rga_info_table_entry *merge_table) {
     if (dst_table == NULL || merge_table == NULL) {
@@ -745,6 +760,43 @@ TRY_TO_COMPATIBLE:
     return IM_STATUS_SUCCESS;
 }
 
+/*
+ * Get the hardware info of each core of the session that is in core_mask.
+ * The cores are numbered in the order the driver reports them, the RGA3
+ * cores and the RGA2 cores separately.
+ *
+ * @returns the number of cores written to cores.
+ */
+int rga_get_core_info(rga_session_t *session, uint32_t core_mask, rga_core_info_t *cores, int max_count) {
+    int count = 0;
+    int rga3_index = 0, rga2_index = 0;
+    uint32_t core;
+    struct rga_hw_versions_t version;
+
+    for (uint32_t i = 0; i < session->core_version.size && count < max_count; i++) {
+        memset(&version, 0x0, sizeof(version));
+        version.version[0] = session->core_version.version[i];
+        version.size = 1;
+
+        memset(&cores[count].info, 0x0, sizeof(cores[count].info));
+        if (rga_get_info(&version, &cores[count].info) != IM_STATUS_SUCCESS)
+            continue;
+
+        if (cores[count].info.version & IM_RGA_HW_VERSION_RGA_3)
+            core = IM_SCHEDULER_RGA3_CORE0 << rga3_index++;
+        else
+            core = IM_SCHEDULER_RGA2_CORE0 << rga2_index++;
+
+        if (!(core & core_mask & IM_SCHEDULER_MASK))
+            continue;
+
+        cores[count].core = (IM_SCHEDULER_CORE)core;
+        count++;
+    }
+
+    return count;
+}
+
 IM_STATUS rga_check_header(struct rga_version_t header_version) {
     int ret;
     int table_size = sizeof(user_header_bind_table) / sizeof(rga_version_bind_table_entry_t);
@@ -1283,18 +1335,18 @@ IM_STATUS rga_check_feature(rga_buffer_t src, rga_buffer_t pat, rga_buffer_t dst
     return IM_STATUS_NOERROR;
 }
 
-IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
-                    const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect, int mode_usage) {
+/*
+ * IM_CHECK_MODE_CHEAP only keeps the bounds (rga_check_info) and format
+ * checks, the feature/alignment/scale/blend/rotate checks are left to the
+ * driver.
+ */
+static IM_STATUS rga_check_hardware(int check_mode, rga_info_table_entry *rga_info,
+                                    const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
+                                    const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect,
+                                    int mode_usage) {
     bool pat_enable = 0;
+    bool full_check = check_mode != IM_CHECK_MODE_CHEAP;
     IM_STATUS ret = IM_STATUS_NOERROR;
-    rga_session_t *session;
-    rga_info_table_entry *rga_info;
-
-    session = get_rga_session();
-    if (IS_ERR(session))
-        return (IM_STATUS)PTR_ERR(session);
-
-    rga_info = &session->hardware_info;
 
     if (mode_usage & IM_ALPHA_BLEND_MASK) {
         if (rga_is_buffer_valid(pat))
@@ -1302,9 +1354,11 @@ IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_bu
     }
 
     /**************** feature judgment ****************/
-    ret = rga_check_feature(src, pat, dst, pat_enable, mode_usage, rga_info->feature);
-    if (ret != IM_STATUS_NOERROR)
-        return ret;
+    if (full_check) {
+        ret = rga_check_feature(src, pat, dst, pat_enable, mode_usage, rga_info->feature);
+        if (ret != IM_STATUS_NOERROR)
+            return ret;
+    }
 
     /**************** info judgment ****************/
     if (~mode_usage & IM_COLOR_FILL) {
@@ -1314,9 +1368,11 @@ IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_bu
         ret = rga_check_format("src", src, src_rect, rga_info->input_format, mode_usage);
         if (ret != IM_STATUS_NOERROR)
             return ret;
-        ret = rga_check_align("src", src, rga_info->byte_stride, true);
-        if (ret != IM_STATUS_NOERROR)
-            return ret;
+        if (full_check) {
+            ret = rga_check_align("src", src, rga_info->byte_stride, true);
+            if (ret != IM_STATUS_NOERROR)
+                return ret;
+        }
     }
     if (pat_enable) {
         /* RGA1 cannot support src1. */
@@ -1332,9 +1388,11 @@ IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_bu
         ret = rga_check_format("pat", pat, pat_rect, rga_info->input_format, mode_usage);
         if (ret != IM_STATUS_NOERROR)
             return ret;
-        ret = rga_check_align("pat", pat, rga_info->byte_stride, true);
-        if (ret != IM_STATUS_NOERROR)
-            return ret;
+        if (full_check) {
+            ret = rga_check_align("pat", pat, rga_info->byte_stride, true);
+            if (ret != IM_STATUS_NOERROR)
+                return ret;
+        }
     }
     ret = rga_check_info("dst", dst, dst_rect, rga_info->output_resolution);
     if (ret != IM_STATUS_NOERROR)
@@ -1342,6 +1400,10 @@ IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_bu
     ret = rga_check_format("dst", dst, dst_rect, rga_info->output_format, mode_usage);
     if (ret != IM_STATUS_NOERROR)
         return ret;
+
+    if (!full_check)
+        return IM_STATUS_NOERROR;
+
     ret = rga_check_align("dst", dst, rga_info->byte_stride, false);
     if (ret != IM_STATUS_NOERROR)
         return ret;
@@ -1365,46 +1427,248 @@ IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_bu
     return IM_STATUS_NOERROR;
 }
 
-IM_STATUS rga_check_external(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
-                             im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
-                             int mode_usage) {
-    int ret;
+#ifdef RGA_CHECK_CACHE_ENABLE
+static void rga_check_cache_set_image(rga_check_cache_image_t *key, const rga_buffer_t *image, const im_rect *rect) {
+    key->width = image->width;
+    key->height = image->height;
+    key->wstride = image->wstride;
+    key->hstride = image->hstride;
+    key->format = image->format;
+    key->rd_mode = image->rd_mode;
+    key->color_space_mode = image->color_space_mode;
+    key->rect = *rect;
+}
+
+static void rga_check_cache_set_key(rga_check_cache_key_t *key, int check_mode,
+                                    const rga_buffer_t *src, const rga_buffer_t *dst, const rga_buffer_t *pat,
+                                    const im_rect *src_rect, const im_rect *dst_rect, const im_rect *pat_rect,
+                                    int mode_usage) {
+    /* The key is hashed and compared as raw memory, clear the padding. */
+    memset(key, 0x0, sizeof(*key));
+
+    key->check_mode = check_mode;
+    key->usage = mode_usage;
+    key->pat_valid = rga_is_buffer_valid(*pat);
+
+    rga_check_cache_set_image(&key->src, src, src_rect);
+    rga_check_cache_set_image(&key->dst, dst, dst_rect);
+    if (key->pat_valid)
+        rga_check_cache_set_image(&key->pat, pat, pat_rect);
+}
+
+static uint32_t rga_check_cache_hash(const rga_check_cache_key_t *key) {
+    /* FNV-1a */
+    const uint8_t *data = (const uint8_t *)key;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+#endif /* #ifdef RGA_CHECK_CACHE_ENABLE */
+
+/*
+ * Only IM_STATUS_NOERROR is cached, so that a failed check always runs
+ * again and reports its own error message. Entries are tagged with the
+ * session's hardware_info generation, unique in the process, and drop out
+ * once it changes or the thread uses another session.
+ */
+IM_STATUS rga_check_mode(int check_mode,
+                         const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
+                         const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect,
+                         int mode_usage) {
+    IM_STATUS ret;
+    rga_session_t *session;
+#ifdef RGA_CHECK_CACHE_ENABLE
+    rga_check_cache_key_t key;
+    rga_check_cache_entry_t *entry;
+#endif
+
+    if (check_mode == IM_CHECK_MODE_OFF)
+        return IM_STATUS_NOERROR;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+#ifdef RGA_CHECK_CACHE_ENABLE
+    rga_check_cache_set_key(&key, check_mode, &src, &dst, &pat, &src_rect, &dst_rect, &pat_rect, mode_usage);
+    entry = &g_check_cache.entries[rga_check_cache_hash(&key) & (RGA_CHECK_CACHE_SIZE - 1)];
+    if (entry->valid &&
+        entry->generation == session->hardware_info_generation &&
+        memcmp(&entry->key, &key, sizeof(key)) == 0) {
+        g_check_cache.hit++;
+        return IM_STATUS_NOERROR;
+    }
+
+    g_check_cache.miss++;
+#endif
+
+    ret = rga_check_hardware(check_mode, &session->hardware_info,
+                             src, dst, pat, src_rect, dst_rect, pat_rect, mode_usage);
+
+#ifdef RGA_CHECK_CACHE_ENABLE
+    if (ret == IM_STATUS_NOERROR) {
+        entry->key = key;
+        entry->generation = session->hardware_info_generation;
+        entry->valid = true;
+    }
+#endif
+
+    return ret;
+}
+
+IM_STATUS rga_check_cache_get_stat(uint64_t *hit, uint64_t *miss) {
+#ifdef RGA_CHECK_CACHE_ENABLE
+    if (hit)
+        *hit = g_check_cache.hit;
+    if (miss)
+        *miss = g_check_cache.miss;
+
+    return IM_STATUS_SUCCESS;
+#else
+    if (hit)
+        *hit = 0;
+    if (miss)
+        *miss = 0;
+
+    return IM_STATUS_NOT_SUPPORTED;
+#endif
+}
+
+/* Drop the check results and core masks cached by the thread for its previous session. */
+void rga_check_cache_reset(void) {
+#ifdef RGA_CHECK_CACHE_ENABLE
+    memset(g_check_cache.entries, 0x0, sizeof(g_check_cache.entries));
+    memset(g_core_mask_cache, 0x0, sizeof(g_core_mask_cache));
+#endif
+}
+
+IM_STATUS rga_check(const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
+                    const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect, int mode_usage) {
+    return rga_check_mode(IM_CHECK_MODE_FULL, src, dst, pat, src_rect, dst_rect, pat_rect, mode_usage);
+}
+
+/* Apply the rects and convert the formats the way rga_task_generate_req() does. */
+static IM_STATUS rga_check_prepare(rga_buffer_t *src, rga_buffer_t *dst, rga_buffer_t *pat,
+                                   im_rect *src_rect, im_rect *dst_rect, im_rect *pat_rect,
+                                   int mode_usage) {
     int format;
 
     if (mode_usage & IM_CROP) {
-        dst_rect.width = src_rect.width;
-        dst_rect.height = src_rect.height;
+        dst_rect->width = src_rect->width;
+        dst_rect->height = src_rect->height;
     }
 
-    rga_apply_rect(&src, &src_rect);
-    format = convert_to_rga_format(src.format);
+    rga_apply_rect(src, src_rect);
+    format = convert_to_rga_format(src->format);
     if (format == RK_FORMAT_UNKNOWN) {
-        IM_LOGW("Invaild src format [0x%x]!\n", src.format);
+        IM_LOGW("Invaild src format [0x%x]!\n", src->format);
         return IM_STATUS_NOT_SUPPORTED;
     }
-    src.format = format;
+    src->format = format;
 
-    rga_apply_rect(&dst, &dst_rect);
-    format = convert_to_rga_format(dst.format);
+    rga_apply_rect(dst, dst_rect);
+    format = convert_to_rga_format(dst->format);
     if (format == RK_FORMAT_UNKNOWN) {
-        IM_LOGW("Invaild dst format [0x%x]!\n", dst.format);
+        IM_LOGW("Invaild dst format [0x%x]!\n", dst->format);
         return IM_STATUS_NOT_SUPPORTED;
     }
-    dst.format = format;
+    dst->format = format;
 
-    if (rga_is_buffer_valid(pat)) {
-        rga_apply_rect(&pat, &pat_rect);
-        format = convert_to_rga_format(pat.format);
+    if (rga_is_buffer_valid(*pat)) {
+        rga_apply_rect(pat, pat_rect);
+        format = convert_to_rga_format(pat->format);
         if (format == RK_FORMAT_UNKNOWN) {
-            IM_LOGW("Invaild pat format [0x%x]!\n", pat.format);
+            IM_LOGW("Invaild pat format [0x%x]!\n", pat->format);
             return IM_STATUS_NOT_SUPPORTED;
         }
-        pat.format = format;
+        pat->format = format;
     }
 
+    return IM_STATUS_NOERROR;
+}
+
+IM_STATUS rga_check_external(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                             im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
+                             int mode_usage) {
+    IM_STATUS ret;
+
+    ret = rga_check_prepare(&src, &dst, &pat, &src_rect, &dst_rect, &pat_rect, mode_usage);
+    if (ret != IM_STATUS_NOERROR)
+        return ret;
+
     return rga_check(src, dst, pat, src_rect, dst_rect, pat_rect, mode_usage);
 }
 
+/*
+ * Full check of a task against the hardware info of one core, instead of
+ * the info merged from all the cores of the session.
+ */
+IM_STATUS rga_check_core(const rga_core_info_t *core,
+                         rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                         im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
+                         int mode_usage) {
+    IM_STATUS ret;
+    rga_info_table_entry info = core->info;
+
+    ret = rga_check_prepare(&src, &dst, &pat, &src_rect, &dst_rect, &pat_rect, mode_usage);
+    if (ret != IM_STATUS_NOERROR)
+        return ret;
+
+    return rga_check_hardware(IM_CHECK_MODE_FULL, &info,
+                              src, dst, pat, src_rect, dst_rect, pat_rect, mode_usage);
+}
+
+/*
+ * The cores that can run a task, out of the candidate cores. The result is
+ * cached per thread like the check cache, with the candidate mask in the
+ * key, so a stream of identical tasks does not probe the cores again.
+ */
+uint32_t rga_check_core_mask(rga_session_t *session, const rga_core_info_t *cores, int count,
+                             rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                             im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
+                             int mode_usage) {
+    uint32_t candidate_mask = 0, core_mask = 0;
+#ifdef RGA_CHECK_CACHE_ENABLE
+    rga_check_cache_key_t key;
+    rga_core_mask_cache_entry_t *entry;
+#endif
+
+    for (int i = 0; i < count; i++)
+        candidate_mask |= cores[i].core;
+
+#ifdef RGA_CHECK_CACHE_ENABLE
+    rga_check_cache_set_key(&key, (int)candidate_mask, &src, &dst, &pat,
+                            &src_rect, &dst_rect, &pat_rect, mode_usage);
+    entry = &g_core_mask_cache[rga_check_cache_hash(&key) & (RGA_CHECK_CACHE_SIZE - 1)];
+    if (entry->valid &&
+        entry->generation == session->hardware_info_generation &&
+        memcmp(&entry->key, &key, sizeof(key)) == 0)
+        return entry->core_mask;
+#else
+    (void)session;
+#endif
+
+    for (int i = 0; i < count; i++) {
+        if (rga_check_core(&cores[i], src, dst, pat,
+                           src_rect, dst_rect, pat_rect, mode_usage) == IM_STATUS_NOERROR)
+            core_mask |= cores[i].core;
+    }
+
+#ifdef RGA_CHECK_CACHE_ENABLE
+    entry->key = key;
+    entry->generation = session->hardware_info_generation;
+    entry->core_mask = core_mask;
+    entry->valid = true;
+#endif
+
+    return core_mask;
+}
+
 IM_API IM_STATUS rga_import_buffers(struct rga_buffer_pool *buffer_pool) {
     int ret = 0;
     rga_session_t *session;
@@ -1418,7 +1682,7 @@ IM_API IM_STATUS rga_import_buffers(struct rga_buffer_pool *buffer_pool) {
         return IM_STATUS_FAILED;
     }
 
-    ret = ioctl(session->rga_dev_fd, RGA_IOC_IMPORT_BUFFER, buffer_pool);
+    ret = rga_session_ioctl(session, RGA_IOC_IMPORT_BUFFER, buffer_pool);
     if (ret < 0) {
         IM_LOGW("RGA_IOC_IMPORT_BUFFER fail! %s", strerror(errno));
         return IM_STATUS_FAILED;
@@ -1487,7 +1751,7 @@ IM_API IM_STATUS rga_release_buffers(struct rga_buffer_pool *buffer_pool) {
         return IM_STATUS_FAILED;
     }
 
-    ret = ioctl(session->rga_dev_fd, RGA_IOC_RELEASE_BUFFER, buffer_pool);
+    ret = rga_session_ioctl(session, RGA_IOC_RELEASE_BUFFER, buffer_pool);
     if (ret < 0) {
         IM_LOGW("RGA_IOC_RELEASE_BUFFER fail! %s", strerror(errno));
         return IM_STATUS_FAILED;
@@ -1511,6 +1775,144 @@ IM_API IM_STATUS rga_release_buffer(int handle) {
     return rga_release_buffers(&buffer_pool);
 }
 
+static uint64_t rga_buffer_array_get_memory(const void *memory_array, int type, int index) {
+    switch (type) {
+        case RGA_DMA_BUFFER:
+            return (uint64_t)((const int *)memory_array)[index];
+        case RGA_VIRTUAL_ADDRESS:
+            return ptr_to_u64(((void * const *)memory_array)[index]);
+        case RGA_PHYSICAL_ADDRESS:
+        default:
+            return ((const uint64_t *)memory_array)[index];
+    }
+}
+
+/*
+ * Import the buffers with one ioctl. The driver stops at the first buffer
+ * it fails to import and returns no handle at all, so the buffers are then
+ * imported again one by one to find the failed ones. Importing a buffer
+ * again returns the same handle with one more reference, the reference
+ * taken by the failed ioctl is dropped.
+ */
+IM_STATUS rga_import_buffer_array(const void *memory_array, int type,
+                                  const im_handle_param_t *param, int count,
+                                  rga_buffer_handle_t *handle) {
+    int format, valid_count = 0, first_failed = -1;
+    IM_STATUS ret = IM_STATUS_SUCCESS;
+    struct rga_buffer_pool buffer_pool;
+    struct rga_external_buffer *buffers;
+    int *index;
+
+    if (memory_array == NULL || param == NULL || handle == NULL || count <= 0) {
+        IM_LOGE("illegal import buffer array, memory = %p, param = %p, handle = %p, count = %d\n",
+                memory_array, param, handle, count);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    buffers = (struct rga_external_buffer *)calloc(count, sizeof(*buffers));
+    index = (int *)malloc(count * sizeof(*index));
+    if (buffers == NULL || index == NULL) {
+        IM_LOGE("import buffer array alloc failed, count = %d\n", count);
+        free(buffers);
+        free(index);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < count; i++) {
+        handle[i] = 0;
+
+        format = convert_to_rga_format(param[i].format);
+        if (format == RK_FORMAT_UNKNOWN) {
+            IM_LOGW("buffer[%d]: Invaild format [0x%x]!\n", i, param[i].format);
+            ret = IM_STATUS_NOT_SUPPORTED;
+            continue;
+        }
+
+        buffers[valid_count].type = type;
+        buffers[valid_count].memory = rga_buffer_array_get_memory(memory_array, type, i);
+        buffers[valid_count].memory_info.width = param[i].width;
+        buffers[valid_count].memory_info.height = param[i].height;
+        buffers[valid_count].memory_info.format = format >> 8;
+        index[valid_count] = i;
+        valid_count++;
+    }
+
+    if (valid_count == 0)
+        goto free_buffers;
+
+    buffer_pool.buffers = ptr_to_u64(buffers);
+    buffer_pool.size = valid_count;
+
+    if (rga_import_buffers(&buffer_pool) == IM_STATUS_SUCCESS) {
+        for (int i = 0; i < valid_count; i++)
+            handle[index[i]] = buffers[i].handle;
+
+        goto free_buffers;
+    }
+
+    buffer_pool.size = 1;
+    for (int i = 0; i < valid_count; i++) {
+        buffer_pool.buffers = ptr_to_u64(&buffers[i]);
+        if (rga_import_buffers(&buffer_pool) != IM_STATUS_SUCCESS) {
+            IM_LOGW("buffer[%d]: import failed, memory = 0x%lx\n",
+                    index[i], (unsigned long)buffers[i].memory);
+            if (first_failed < 0)
+                first_failed = i;
+            if (ret == IM_STATUS_SUCCESS)
+                ret = IM_STATUS_FAILED;
+            continue;
+        }
+
+        handle[index[i]] = buffers[i].handle;
+    }
+
+    /* the buffers before the failed one were imported by the batch ioctl */
+    for (int i = 0; i < first_failed; i++)
+        rga_release_buffer(handle[index[i]]);
+
+free_buffers:
+    free(buffers);
+    free(index);
+
+    return ret;
+}
+
+IM_STATUS rga_release_buffer_array(const rga_buffer_handle_t *handle, int count) {
+    IM_STATUS ret;
+    struct rga_buffer_pool buffer_pool;
+    struct rga_external_buffer *buffers;
+
+    if (handle == NULL || count <= 0) {
+        IM_LOGE("illegal release buffer array, handle = %p, count = %d\n", handle, count);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (handle[i] <= 0) {
+            IM_LOGE("buffer[%d]: illegal handle[%d]\n", i, handle[i]);
+            return IM_STATUS_ILLEGAL_PARAM;
+        }
+    }
+
+    buffers = (struct rga_external_buffer *)calloc(count, sizeof(*buffers));
+    if (buffers == NULL) {
+        IM_LOGE("release buffer array alloc failed, count = %d\n", count);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < count; i++)
+        buffers[i].handle = handle[i];
+
+    buffer_pool.buffers = ptr_to_u64(buffers);
+    buffer_pool.size = count;
+
+    ret = rga_release_buffers(&buffer_pool);
+
+    free(buffers);
+
+    return ret;
+}
+
 IM_STATUS rga_get_opt(im_opt_t *opt, void *ptr) {
     if (opt == NULL || ptr == NULL)
         return IM_STATUS_FAILED;
@@ -1538,6 +1940,15 @@ IM_STATUS rga_get_opt(im_opt_t *opt, void *ptr) {
     return IM_STATUS_SUCCESS;
 }
 
+/* The core a task is pinned to by its options, IM_SCHEDULER_DEFAULT if none. */
+int rga_get_opt_core(void *ptr) {
+    im_opt_t opt = {};
+
+    rga_get_opt(&opt, ptr);
+
+    return opt.core;
+}
+
 int generate_blit_req(struct rga_req *ioc_req, rga_info_t *src, rga_info_t *dst, rga_info_t *src1);
 int generate_fill_req(struct rga_req *ioc_req, rga_info_t *dst);
 int generate_color_palette_req(struct rga_req *ioc_req, rga_info_t *src, rga_info_t *dst, rga_info_t *lut);
@@ -1792,10 +2203,12 @@ static int rga_get_csc_mode(rga_info_table_entry *entry, int in, int out)
     return mode;
 }
 
-IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
-                          im_rect srect, im_rect drect, im_rect prect,
-                          int acquire_fence_fd, int *release_fence_fd,
-                          im_opt_t *opt_ptr, int usage) {
+static IM_STATUS rga_task_generate_req(struct rga_req *req, rga_session_t *session,
+                                       im_job_handle_t job_handle,
+                                       rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                       im_rect srect, im_rect drect, im_rect prect,
+                                       int acquire_fence_fd, int *release_fence_fd,
+                                       im_opt_t *opt_ptr, int usage) {
     int ret;
     int format;
     rga_info_t srcinfo;
@@ -1804,29 +2217,13 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buff
 
     im_opt_t opt;
 
-    struct rga_req req;
-    struct rga2_req compat_req;
-    void *ioc_req = NULL;
-
-    rga_session_t *session;
-
-    session = get_rga_session();
-    if (IS_ERR(session))
-        return (IM_STATUS)PTR_ERR(session);
-
-    get_debug_state();
-    if (is_debug_en())
-        rga_dump_info(IM_LOG_DEBUG | IM_LOG_FORCE,
-                      job_handle, &src, &dst, &pat, &srect, &drect, &prect,
-                      acquire_fence_fd, release_fence_fd, opt_ptr, usage);
-
     memset(&opt, 0x0, sizeof(opt));
     rga_get_opt(&opt, opt_ptr);
 
     memset(&srcinfo, 0, sizeof(rga_info_t));
     memset(&dstinfo, 0, sizeof(rga_info_t));
     memset(&patinfo, 0, sizeof(rga_info_t));
-    memset(&req, 0, sizeof(req));
+    memset(req, 0, sizeof(*req));
 
     if (usage & IM_COLOR_FILL) {
         ret = rga_set_buffer_info("dst", dst, &dstinfo);
@@ -1876,7 +2273,7 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buff
         rga_set_rect(&patinfo.rect, prect.x, prect.y, pat.width, pat.height, pat.wstride, pat.hstride, pat.format);
     }
 
-    ret = rga_check(src, dst, pat, srect, drect, prect, usage);
+    ret = rga_check_mode(g_im2d_context.check_mode, src, dst, pat, srect, drect, prect, usage);
     if(ret != IM_STATUS_NOERROR)
         return (IM_STATUS)ret;
 
@@ -2253,18 +2650,10 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buff
     if (rga_is_buffer_valid(pat))
         patinfo.rd_mode = pat.rd_mode;
 
-    if (usage & IM_ASYNC) {
-        if (release_fence_fd == NULL) {
-            IM_LOGW("Async mode release_fence_fd cannot be NULL!");
-            ret = IM_STATUS_ILLEGAL_PARAM;
-            goto release_resource;
-        }
-
+    if (usage & IM_ASYNC)
         dstinfo.sync_mode = RGA_BLIT_ASYNC;
-
-    } else {
+    else
         dstinfo.sync_mode = RGA_BLIT_SYNC;
-    }
 
     dstinfo.in_fence_fd = acquire_fence_fd;
     dstinfo.core = opt.core ? opt.core : g_im2d_context.core;
@@ -2275,13 +2664,13 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buff
     if (usage & IM_COLOR_FILL) {
         dstinfo.color = opt.color;
 
-        ret = generate_fill_req(&req, &dstinfo);
+        ret = generate_fill_req(req, &dstinfo);
     } else if (usage & IM_COLOR_PALETTE) {
-        ret = generate_color_palette_req(&req, &srcinfo, &dstinfo, &patinfo);
+        ret = generate_color_palette_req(req, &srcinfo, &dstinfo, &patinfo);
     } else if ((usage & IM_ALPHA_BLEND_MASK) && rga_is_buffer_valid(pat)) {
-        ret = generate_blit_req(&req, &srcinfo, &dstinfo, &patinfo);
+        ret = generate_blit_req(req, &srcinfo, &dstinfo, &patinfo);
     } else {
-        ret = generate_blit_req(&req, &srcinfo, &dstinfo, NULL);
+        ret = generate_blit_req(req, &srcinfo, &dstinfo, NULL);
     }
     if (ret < 0) {
         IM_LOGE("failed to generate task req!\n");
@@ -2294,87 +2683,1191 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buff
         goto release_resource;
     }
 
-    if (job_handle > 0) {
-        im_rga_job_t *job = NULL;
-
-        pthread_mutex_lock(&g_im2d_job_manager.mutex);
-
-        job = rga_map_find_job(&g_im2d_job_manager.job_map, job_handle);
-        if (job == NULL) {
-            IM_LOGE("cannot find job_handle[%d]\n", job_handle);
-            pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-            ret = IM_STATUS_ILLEGAL_PARAM;
-            goto release_resource;
-        } else if (job->task_count >= RGA_TASK_NUM_MAX) {
-            IM_LOGE("job[%d] add task failed! too many tasks, count = %d\n", job_handle, job->task_count);
-
-            pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-            ret = IM_STATUS_ILLEGAL_PARAM;
-            goto release_resource;
-        }
+    return IM_STATUS_SUCCESS;
 
-        job->req[job->task_count] = req;
-        job->task_count++;
+release_resource:
+    if (usage & IM_GAUSS && req->gauss_config.coe_ptr != 0)
+        free(u64_to_ptr(req->gauss_config.coe_ptr));
 
-        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-    } else {
-        switch (session->driver_type) {
-            case RGA_DRIVER_IOC_RGA1:
-            case RGA_DRIVER_IOC_RGA2:
-                memset(&compat_req, 0x0, sizeof(compat_req));
-                NormalRgaCompatModeConvertRga2(&compat_req, &req);
+    return (IM_STATUS)ret;
+}
 
-                ioc_req = &compat_req;
-                break;
-            case RGA_DRIVER_IOC_MULTI_RGA:
-                ioc_req = &req;
-                break;
+/*
+ * Hand a generated request over to the driver, or append it to the job when
+ * job_handle is valid. Only the per-execution fields (fences, sync mode) are
+ * touched here, so the same request can be committed many times.
+ */
+static IM_STATUS rga_task_commit_req(rga_session_t *session, im_job_handle_t job_handle,
+                                     struct rga_req *req,
+                                     int acquire_fence_fd, int *release_fence_fd,
+                                     int usage) {
+    int ret;
+    int sync_mode;
+    struct rga2_req compat_req;
+    void *ioc_req = NULL;
 
-            default:
-                IM_LOGW("unknow driver[0x%x]\n", session->driver_type);
-                ret = IM_STATUS_FAILED;
-                goto release_resource;
+    if (usage & IM_ASYNC) {
+        if (release_fence_fd == NULL) {
+            IM_LOGW("Async mode release_fence_fd cannot be NULL!");
+            return IM_STATUS_ILLEGAL_PARAM;
         }
 
-        do {
-            ret = ioctl(session->rga_dev_fd, dstinfo.sync_mode, ioc_req);
-        } while (ret == -1 && (errno == EINTR || errno == 512));   /* ERESTARTSYS is 512. */
-        if (ret) {
-            IM_LOGE("Failed to call RockChipRga interface, please use 'dmesg' command to view driver error log.");
+        sync_mode = RGA_BLIT_ASYNC;
+    } else {
+        sync_mode = RGA_BLIT_SYNC;
+    }
 
-            rga_dump_info(IM_LOG_ERROR | IM_LOG_FORCE,
-                        job_handle, &src, &dst, &pat, &srect, &drect, &prect,
-                        acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+    req->in_fence_fd = acquire_fence_fd;
 
-            ret = IM_STATUS_FAILED;
-            goto release_resource;
-        }
+    if (job_handle > 0) {
+        im_rga_job_t *job = NULL;
 
-        if (usage & IM_ASYNC) {
-            *release_fence_fd = req.out_fence_fd;
-
-            if (session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE &&
-                acquire_fence_fd > 0)
-                close(acquire_fence_fd);
+        job = rga_job_find(job_handle);
+        if (job == NULL) {
+            IM_LOGE("cannot find job_handle[%d]\n", job_handle);
+            return IM_STATUS_ILLEGAL_PARAM;
         }
+
+        return (IM_STATUS)rga_job_add_task(job, req);
     }
 
-    ret = IM_STATUS_SUCCESS;
+    switch (session->driver_type) {
+        case RGA_DRIVER_IOC_RGA1:
+        case RGA_DRIVER_IOC_RGA2:
+            memset(&compat_req, 0x0, sizeof(compat_req));
+            NormalRgaCompatModeConvertRga2(&compat_req, req);
+
+            ioc_req = &compat_req;
+            break;
+        case RGA_DRIVER_IOC_MULTI_RGA:
+            ioc_req = req;
+            break;
+
+        default:
+            IM_LOGW("unknow driver[0x%x]\n", session->driver_type);
+            return IM_STATUS_FAILED;
+    }
+
+    do {
+        ret = rga_session_ioctl(session, sync_mode, ioc_req);
+    } while (ret == -1 && (errno == EINTR || errno == 512));   /* ERESTARTSYS is 512. */
+    if (ret) {
+        IM_LOGE("Failed to call RockChipRga interface, please use 'dmesg' command to view driver error log.");
+        return IM_STATUS_FAILED;
+    }
+
+    if (usage & IM_ASYNC) {
+        *release_fence_fd = req->out_fence_fd;
+
+        if (session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE &&
+            acquire_fence_fd > 0)
+            close(acquire_fence_fd);
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+/*
+ * With IM_CHECK_MODE_OFF the parameters are trusted, so a failed task is
+ * validated again here to tell the user why it failed.
+ */
+static IM_STATUS rga_task_revalidate(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                     im_rect srect, im_rect drect, im_rect prect,
+                                     int usage, IM_STATUS err) {
+    IM_STATUS ret;
+
+    if (g_im2d_context.check_mode != IM_CHECK_MODE_OFF)
+        return err;
+
+    ret = rga_check_external(src, dst, pat, srect, drect, prect, usage);
+    if (ret != IM_STATUS_NOERROR) {
+        IM_LOGFE("task failed with IM_CONFIG_CHECK off, re-validated: %s", g_rga_err_str);
+        return ret;
+    }
+
+    return err;
+}
+
+IM_STATUS rga_task_submit(im_job_handle_t job_handle, rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                          im_rect srect, im_rect drect, im_rect prect,
+                          int acquire_fence_fd, int *release_fence_fd,
+                          im_opt_t *opt_ptr, int usage) {
+    int ret;
+    struct rga_req req;
+    rga_session_t *session;
+    IM_SCHEDULER_CORE core = IM_SCHEDULER_DEFAULT;
+    uint64_t bytes = 0;
+    uint64_t import_slots;
+    im_rga_job_t *job;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    if (is_debug_en())
+        rga_dump_info(IM_LOG_DEBUG | IM_LOG_FORCE,
+                      job_handle, &src, &dst, &pat, &srect, &drect, &prect,
+                      acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+
+    /* replace the fd/virtual address buffers by cached handles */
+    import_slots = rga_import_cache_get(session, &src, &dst, &pat, usage);
+
+    ret = rga_task_generate_req(&req, session, job_handle, src, dst, pat, srect, drect, prect,
+                                acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+    if (ret != IM_STATUS_SUCCESS) {
+        rga_import_cache_put(import_slots);
+        if (ret == IM_STATUS_FAILED)
+            return rga_task_revalidate(src, dst, pat, srect, drect, prect, usage, (IM_STATUS)ret);
+        return (IM_STATUS)ret;
+    }
+
+    /* the tasks of a job complete with the job, only single tasks are scheduled */
+    if (job_handle <= 0) {
+        core = rga_scheduler_select(session, src, dst, pat, srect, drect, prect, opt_ptr, usage, &bytes);
+        if (core != IM_SCHEDULER_DEFAULT)
+            req.core = core;
+    }
+
+    ret = rga_task_commit_req(session, job_handle, &req, acquire_fence_fd, release_fence_fd, usage);
+    rga_scheduler_done(core, bytes, (IM_STATUS)ret,
+                       (ret == IM_STATUS_SUCCESS && usage & IM_ASYNC) ? *release_fence_fd : -1);
+
+    /* the handles of a job task must stay valid until the job is submitted */
+    if (import_slots != 0) {
+        job = job_handle > 0 && ret == IM_STATUS_SUCCESS ? rga_job_find(job_handle) : NULL;
+        if (job != NULL)
+            rga_job_add_import_slots(job, import_slots);
+        else
+            rga_import_cache_put(import_slots);
+    }
+    if (ret == IM_STATUS_FAILED) {
+        rga_dump_info(IM_LOG_ERROR | IM_LOG_FORCE,
+                      job_handle, &src, &dst, &pat, &srect, &drect, &prect,
+                      acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+
+        ret = rga_task_revalidate(src, dst, pat, srect, drect, prect, usage, (IM_STATUS)ret);
+    }
 
-release_resource:
     if (usage & IM_GAUSS && req.gauss_config.coe_ptr != 0)
         free(u64_to_ptr(req.gauss_config.coe_ptr));
 
     return (IM_STATUS)ret;
 }
 
+/*
+ * Deferred submit: while enabled on a thread, async single-task calls are
+ * appended to an implicit job instead of being submitted one by one. Each
+ * deferred call returns its own fd of the batch fence, an eventfd created
+ * with the first call of the batch. Once the batch is submitted, the
+ * deferred worker thread polls the release fence of the job and signals
+ * the batch fence when the job is done, so the fences can be waited with
+ * imsync()/imsyncMany() or poll() from any thread. A sync call is appended
+ * to the batch and submits it synchronously.
+ *
+ * The batch is submitted when it is full, when a task comes with an
+ * acquire fence, when a call that is not deferred has to keep the order
+ * with it, when the thread waits on a fence with imsync()/imsyncMany(),
+ * on imflush(), and by the deferred worker once the time window since the
+ * first task of the batch has expired. A failed batch still signals its
+ * fence, the failure is reported by the next imflush(), which also returns
+ * one real fence for all the jobs submitted since the last imflush().
+ *
+ * The batch fences are not sync_file fences, they are only accepted as an
+ * acquire fence by the deferred calls of the same thread.
+ */
+#if !defined(RT_THREAD) && defined(RGA_THREAD_LOCAL_ENABLE)
+#define RGA_DEFERRED_SUBMIT_ENABLE
+#endif
+
+#ifdef RGA_DEFERRED_SUBMIT_ENABLE
+#define RGA_DEFERRED_RETRY_US 100
+
+static IM_STATUS rga_job_submit_session(rga_session_t *session, im_job_handle_t job_handle,
+                                        int sync_mode, int acquire_fence_fd, int *release_fence_fd);
+
+typedef struct rga_deferred_batch {
+    /* the owner thread, and the deferred worker for an expired window */
+    pthread_mutex_t lock;
+
+    uint64_t window_us;
+
+    rga_session_t *session;
+    im_job_handle_t job_handle;
+    int task_count;
+    int acquire_fence_fd;
+
+    /* handed out to the deferred calls, -1 until the first async call */
+    int fence_fd;
+
+    /* release fences and first error of the jobs submitted since the last imflush() */
+    im_fence_set_t *fences;
+    IM_STATUS error;
+
+    /* written with both locks held, 0 if the batch is empty */
+    uint64_t deadline_us;
+    struct rga_deferred_batch *next;
+} rga_deferred_batch_t;
+
+/* a batch fence to signal once the release fence of its job is */
+typedef struct rga_deferred_signal {
+    int release_fence_fd;
+    int fence_fd;
+    struct rga_deferred_signal *next;
+} rga_deferred_signal_t;
+
+/*
+ * The deferred worker is a process-wide thread started by the first
+ * IM_CONFIG_DEFERRED_SUBMIT. It sleeps until the next deadline of the
+ * batches or until a release fence it watches is signaled. It never waits
+ * for the lock of a batch while holding its own lock, the owner thread
+ * takes the batch lock first.
+ */
+static struct rga_deferred_worker {
+    pthread_mutex_t lock;
+    int wake_fd;
+
+    rga_deferred_batch_t *batches;
+    rga_deferred_signal_t *signals;
+    int signal_count;
+
+    pthread_t thread;
+    bool running;
+} g_deferred_worker;
+
+static RGA_THREAD_LOCAL rga_deferred_batch_t *g_deferred_batch;
+static pthread_key_t g_deferred_batch_key;
+static pthread_once_t g_deferred_batch_once = PTHREAD_ONCE_INIT;
+
+static uint64_t rga_deferred_get_time_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void rga_deferred_worker_wake(void) {
+    uint64_t value = 1;
+
+    if (write(g_deferred_worker.wake_fd, &value, sizeof(value)) < 0)
+        IM_LOGE("deferred worker wake failed: %s\n", strerror(errno));
+}
+
+static void rga_deferred_fence_signal(int fence_fd) {
+    uint64_t value = 1;
+
+    if (write(fence_fd, &value, sizeof(value)) < 0)
+        IM_LOGE("deferred fence[%d] signal failed: %s\n", fence_fd, strerror(errno));
+    close(fence_fd);
+}
+
+/*
+ * Submit the batch, the caller holds the batch lock, and the worker lock
+ * if worker_locked. The batch fence is signaled here if the tasks are
+ * already done or failed, else given to the worker with the job fence.
+ */
+static IM_STATUS rga_deferred_batch_submit(rga_deferred_batch_t *batch, int sync_mode, bool worker_locked) {
+    IM_STATUS ret;
+    int release_fence_fd = -1;
+    rga_deferred_signal_t *signal = NULL;
+
+    if (batch->task_count == 0)
+        return IM_STATUS_SUCCESS;
+
+    ret = rga_job_submit_session(batch->session, batch->job_handle, sync_mode,
+                                 batch->acquire_fence_fd, &release_fence_fd);
+
+    if (batch->acquire_fence_fd >= 0 &&
+        (ret != IM_STATUS_SUCCESS || batch->session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE))
+        close(batch->acquire_fence_fd);
+
+    if (ret != IM_STATUS_SUCCESS || sync_mode != IM_ASYNC)
+        release_fence_fd = -1;
+
+    if (release_fence_fd >= 0 && batch->fence_fd >= 0) {
+        signal = (rga_deferred_signal_t *)malloc(sizeof(*signal));
+        if (signal != NULL) {
+            signal->release_fence_fd = fcntl(release_fence_fd, F_DUPFD_CLOEXEC, 0);
+            if (signal->release_fence_fd < 0) {
+                free(signal);
+                signal = NULL;
+            }
+        }
+
+        /* cannot watch the job, resolve it here */
+        if (signal == NULL)
+            rga_sync_wait(release_fence_fd, -1);
+    }
+
+    if (release_fence_fd >= 0 && rga_fence_set_add(batch->fences, release_fence_fd) != IM_STATUS_SUCCESS) {
+        rga_sync_wait(release_fence_fd, -1);
+        close(release_fence_fd);
+    }
+
+    if (ret != IM_STATUS_SUCCESS && batch->error == IM_STATUS_SUCCESS)
+        batch->error = ret;
+
+    if (!worker_locked)
+        pthread_mutex_lock(&g_deferred_worker.lock);
+
+    batch->deadline_us = 0;
+    if (signal != NULL) {
+        signal->fence_fd = batch->fence_fd;
+        signal->next = g_deferred_worker.signals;
+        g_deferred_worker.signals = signal;
+        g_deferred_worker.signal_count++;
+
+        if (!worker_locked)
+            rga_deferred_worker_wake();
+    } else if (batch->fence_fd >= 0) {
+        rga_deferred_fence_signal(batch->fence_fd);
+    }
+
+    if (!worker_locked)
+        pthread_mutex_unlock(&g_deferred_worker.lock);
+
+    batch->job_handle = 0;
+    batch->task_count = 0;
+    batch->acquire_fence_fd = -1;
+    batch->fence_fd = -1;
+
+    return ret;
+}
+
+/* Submit the expired batches, returns the time to wait for the next deadline, -1 if none. */
+static int64_t rga_deferred_worker_expire(void) {
+    int64_t timeout_us = -1, wait_us;
+    uint64_t now_us = rga_deferred_get_time_us();
+    rga_deferred_batch_t *batch;
+
+    for (batch = g_deferred_worker.batches; batch != NULL; batch = batch->next) {
+        if (batch->deadline_us == 0)
+            continue;
+
+        if (batch->deadline_us > now_us) {
+            wait_us = batch->deadline_us - now_us;
+        } else if (pthread_mutex_trylock(&batch->lock) == 0) {
+            rga_deferred_batch_submit(batch, IM_ASYNC, true);
+            pthread_mutex_unlock(&batch->lock);
+            continue;
+        } else {
+            /* the owner is using it, it may submit the batch itself */
+            wait_us = RGA_DEFERRED_RETRY_US;
+        }
+
+        if (timeout_us < 0 || wait_us < timeout_us)
+            timeout_us = wait_us;
+    }
+
+    return timeout_us;
+}
+
+static void *rga_deferred_worker_thread(void *arg) {
+    int i, count, capacity = 0;
+    int64_t timeout_us;
+    uint64_t value;
+    struct pollfd *fds = NULL, *new_fds;
+    rga_deferred_signal_t **signals = NULL, **new_signals, *signal, **prev;
+
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&g_deferred_worker.lock);
+
+        timeout_us = rga_deferred_worker_expire();
+
+        if (g_deferred_worker.signal_count + 1 > capacity) {
+            capacity = g_deferred_worker.signal_count + 1;
+            new_fds = (struct pollfd *)realloc(fds, capacity * sizeof(*fds));
+            if (new_fds != NULL)
+                fds = new_fds;
+            new_signals = (rga_deferred_signal_t **)realloc(signals, capacity * sizeof(*signals));
+            if (new_signals != NULL)
+                signals = new_signals;
+            if (new_fds == NULL || new_signals == NULL) {
+                IM_LOGE("deferred worker alloc error!\n");
+                capacity = 0;
+                pthread_mutex_unlock(&g_deferred_worker.lock);
+                usleep(RGA_DEFERRED_RETRY_US);
+                continue;
+            }
+        }
+
+        fds[0].fd = g_deferred_worker.wake_fd;
+        fds[0].events = POLLIN;
+        count = 1;
+        for (signal = g_deferred_worker.signals; signal != NULL; signal = signal->next) {
+            fds[count].fd = signal->release_fence_fd;
+            fds[count].events = POLLIN;
+            signals[count] = signal;
+            count++;
+        }
+
+        pthread_mutex_unlock(&g_deferred_worker.lock);
+
+        /* rounded up, a batch is never submitted before its window expired */
+        if (poll(fds, count, timeout_us < 0 ? -1 : (int)((timeout_us + 999) / 1000)) <= 0)
+            continue;
+
+        if (fds[0].revents & POLLIN) {
+            if (read(g_deferred_worker.wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                IM_LOGE("deferred worker drain failed: %s\n", strerror(errno));
+        }
+
+        /* the signals are only removed here, the polled ones are still in the list */
+        pthread_mutex_lock(&g_deferred_worker.lock);
+        for (i = 1; i < count; i++) {
+            if (fds[i].revents == 0)
+                continue;
+
+            for (prev = &g_deferred_worker.signals; *prev != signals[i]; prev = &(*prev)->next);
+            *prev = signals[i]->next;
+            g_deferred_worker.signal_count--;
+
+            close(signals[i]->release_fence_fd);
+            rga_deferred_fence_signal(signals[i]->fence_fd);
+            free(signals[i]);
+        }
+        pthread_mutex_unlock(&g_deferred_worker.lock);
+    }
+
+    return NULL;
+}
+
+static void rga_deferred_batch_destroy(void *arg) {
+    rga_deferred_batch_t *batch = (rga_deferred_batch_t *)arg;
+    rga_deferred_batch_t **prev;
+
+    if (batch == NULL)
+        return;
+
+    pthread_mutex_lock(&batch->lock);
+    rga_deferred_batch_submit(batch, IM_ASYNC, false);
+    pthread_mutex_unlock(&batch->lock);
+
+    pthread_mutex_lock(&g_deferred_worker.lock);
+    for (prev = &g_deferred_worker.batches; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == batch) {
+            *prev = batch->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_deferred_worker.lock);
+
+    if (g_deferred_batch == batch)
+        g_deferred_batch = NULL;
+
+    rga_fence_set_release(batch->fences);
+    pthread_mutex_destroy(&batch->lock);
+    free(batch);
+}
+
+static void rga_deferred_key_init(void) {
+    int ret;
+
+    pthread_mutex_init(&g_deferred_worker.lock, NULL);
+    g_deferred_worker.batches = NULL;
+    g_deferred_worker.signals = NULL;
+    g_deferred_worker.signal_count = 0;
+    g_deferred_worker.running = false;
+
+    if (pthread_key_create(&g_deferred_batch_key, rga_deferred_batch_destroy) != 0) {
+        IM_LOGE("deferred submit key init failed!\n");
+        return;
+    }
+
+    g_deferred_worker.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (g_deferred_worker.wake_fd < 0) {
+        IM_LOGE("deferred worker eventfd create failed: %s\n", strerror(errno));
+        return;
+    }
+
+    ret = pthread_create(&g_deferred_worker.thread, NULL, rga_deferred_worker_thread, NULL);
+    if (ret != 0) {
+        IM_LOGE("deferred worker thread create failed: %s\n", strerror(ret));
+        close(g_deferred_worker.wake_fd);
+        g_deferred_worker.wake_fd = -1;
+        return;
+    }
+
+    pthread_detach(g_deferred_worker.thread);
+    g_deferred_worker.running = true;
+}
+
+IM_STATUS rga_deferred_config(uint64_t window_us) {
+    rga_session_t *session;
+    rga_deferred_batch_t *batch = g_deferred_batch;
+
+    if (window_us == 0) {
+        if (batch != NULL) {
+            pthread_setspecific(g_deferred_batch_key, NULL);
+            rga_deferred_batch_destroy(batch);
+        }
+
+        return IM_STATUS_SUCCESS;
+    }
+
+    if (batch != NULL) {
+        pthread_mutex_lock(&batch->lock);
+        batch->window_us = window_us;
+        pthread_mutex_unlock(&batch->lock);
+        return IM_STATUS_SUCCESS;
+    }
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    if (session->driver_type != RGA_DRIVER_IOC_MULTI_RGA) {
+        IM_LOGW("deferred submit requires the job interface of the multi-rga driver.\n");
+        return IM_STATUS_NOT_SUPPORTED;
+    }
+
+    pthread_once(&g_deferred_batch_once, rga_deferred_key_init);
+    if (!g_deferred_worker.running)
+        return IM_STATUS_FAILED;
+
+    batch = (rga_deferred_batch_t *)calloc(1, sizeof(*batch));
+    if (batch == NULL) {
+        IM_LOGE("deferred batch alloc error!\n");
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_init(&batch->lock, NULL);
+    batch->window_us = window_us;
+    batch->acquire_fence_fd = -1;
+    batch->fence_fd = -1;
+    batch->error = IM_STATUS_SUCCESS;
+
+    batch->fences = rga_fence_set_create();
+    if (batch->fences == NULL) {
+        pthread_mutex_destroy(&batch->lock);
+        free(batch);
+        return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_deferred_worker.lock);
+    batch->next = g_deferred_worker.batches;
+    g_deferred_worker.batches = batch;
+    pthread_mutex_unlock(&g_deferred_worker.lock);
+
+    pthread_setspecific(g_deferred_batch_key, batch);
+    g_deferred_batch = batch;
+
+    return IM_STATUS_SUCCESS;
+}
+
+/* Submit the batch of the current thread, before a task that must run after it or a wait. */
+void rga_deferred_kick(void) {
+    rga_deferred_batch_t *batch = g_deferred_batch;
+
+    if (batch == NULL)
+        return;
+
+    pthread_mutex_lock(&batch->lock);
+    rga_deferred_batch_submit(batch, IM_ASYNC, false);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/*
+ * Submit the batch of the current thread. With release_fence_fd, return one
+ * fence for all the jobs submitted since the last flush (-1 if they are all
+ * done), else wait for them.
+ */
+IM_STATUS rga_deferred_flush(int *release_fence_fd) {
+    IM_STATUS ret;
+    int fence_fd = -1;
+    rga_deferred_batch_t *batch = g_deferred_batch;
+
+    if (release_fence_fd)
+        *release_fence_fd = -1;
+
+    if (batch == NULL)
+        return IM_STATUS_SUCCESS;
+
+    pthread_mutex_lock(&batch->lock);
+
+    rga_deferred_batch_submit(batch, release_fence_fd ? IM_ASYNC : IM_SYNC, false);
+    rga_fence_set_merge(batch->fences, &fence_fd);
+
+    ret = batch->error;
+    batch->error = IM_STATUS_SUCCESS;
+
+    pthread_mutex_unlock(&batch->lock);
+
+    if (fence_fd >= 0) {
+        if (release_fence_fd) {
+            *release_fence_fd = fence_fd;
+        } else {
+            if (rga_sync_wait(fence_fd, -1) < 0 && ret == IM_STATUS_SUCCESS)
+                ret = IM_STATUS_FAILED;
+            close(fence_fd);
+        }
+    }
+
+    return ret;
+}
+
+/*
+ * The driver only takes sync_file acquire fences, a batch fence of this
+ * thread is waited for here, after submitting the batch it may belong to.
+ */
+static IM_STATUS rga_deferred_acquire_resolve(rga_deferred_batch_t *batch, int *acquire_fence_fd) {
+    rga_session_t *session;
+
+    if (*acquire_fence_fd < 0)
+        return IM_STATUS_SUCCESS;
+
+    session = get_rga_session();
+    if (IS_ERR(session) || session->backend != RGA_SESSION_BACKEND_HW ||
+        rga_sync_is_sync_file(*acquire_fence_fd))
+        return IM_STATUS_SUCCESS;
+
+    rga_deferred_batch_submit(batch, IM_ASYNC, false);
+
+    if (rga_sync_wait(*acquire_fence_fd, -1) < 0) {
+        IM_LOGE("wait acquire_fence_fd[%d] failed.\n", *acquire_fence_fd);
+        return IM_STATUS_FAILED;
+    }
+
+    if (session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE)
+        close(*acquire_fence_fd);
+    *acquire_fence_fd = -1;
+
+    return IM_STATUS_SUCCESS;
+}
+
+/* Returns false if the task is not deferred and must be submitted directly. */
+static bool rga_deferred_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                im_rect srect, im_rect drect, im_rect prect,
+                                int *acquire_fence_fd, int *release_fence_fd,
+                                im_opt_t *opt_ptr, int usage, IM_STATUS *ret) {
+    bool async = usage & IM_ASYNC;
+    rga_deferred_batch_t *batch = g_deferred_batch;
+
+    if (batch == NULL || (async && release_fence_fd == NULL))
+        return false;
+
+    pthread_mutex_lock(&batch->lock);
+
+    *ret = rga_deferred_acquire_resolve(batch, acquire_fence_fd);
+    if (*ret != IM_STATUS_SUCCESS)
+        goto out;
+
+    if (batch->task_count > 0 &&
+        (*acquire_fence_fd >= 0 || rga_deferred_get_time_us() >= batch->deadline_us))
+        rga_deferred_batch_submit(batch, IM_ASYNC, false);
+
+    if (!async && batch->task_count == 0) {
+        pthread_mutex_unlock(&batch->lock);
+        return false;
+    }
+
+    if (batch->task_count == 0) {
+        batch->session = get_rga_session();
+        batch->job_handle = rga_job_create(0);
+        if ((int)batch->job_handle <= 0) {
+            batch->job_handle = 0;
+            pthread_mutex_unlock(&batch->lock);
+            return false;
+        }
+    }
+
+    *ret = rga_task_submit(batch->job_handle, src, dst, pat, srect, drect, prect,
+                           -1, NULL, opt_ptr, usage & ~(IM_SYNC | IM_ASYNC));
+    if (*ret != IM_STATUS_SUCCESS) {
+        if (batch->task_count == 0) {
+            rga_job_cancel(batch->job_handle);
+            batch->job_handle = 0;
+        }
+
+        goto out;
+    }
+
+    if (batch->task_count == 0) {
+        batch->acquire_fence_fd = *acquire_fence_fd;
+
+        pthread_mutex_lock(&g_deferred_worker.lock);
+        batch->deadline_us = rga_deferred_get_time_us() + batch->window_us;
+        rga_deferred_worker_wake();
+        pthread_mutex_unlock(&g_deferred_worker.lock);
+    }
+    batch->task_count++;
+
+    if (!async) {
+        *ret = rga_deferred_batch_submit(batch, IM_SYNC, false);
+        goto out;
+    }
+
+    if (batch->fence_fd < 0)
+        batch->fence_fd = eventfd(0, EFD_CLOEXEC);
+
+    *release_fence_fd = batch->fence_fd >= 0 ? fcntl(batch->fence_fd, F_DUPFD_CLOEXEC, 0) : -1;
+    if (*release_fence_fd < 0) {
+        /* no fence to hand out, the task is done on return */
+        IM_LOGW("deferred fence create failed: %s, submit the batch synchronously.\n", strerror(errno));
+        *ret = rga_deferred_batch_submit(batch, IM_SYNC, false);
+        goto out;
+    }
+
+    if (batch->task_count >= RGA_TASK_NUM_MAX)
+        rga_deferred_batch_submit(batch, IM_ASYNC, false);
+
+out:
+    pthread_mutex_unlock(&batch->lock);
+
+    return true;
+}
+#else
+IM_STATUS rga_deferred_config(uint64_t window_us) {
+    if (window_us == 0)
+        return IM_STATUS_SUCCESS;
+
+    IM_LOGW("deferred submit is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+void rga_deferred_kick(void) {
+}
+
+IM_STATUS rga_deferred_flush(int *release_fence_fd) {
+    if (release_fence_fd)
+        *release_fence_fd = -1;
+
+    return IM_STATUS_SUCCESS;
+}
+#endif /* #ifdef RGA_DEFERRED_SUBMIT_ENABLE */
+
 IM_STATUS rga_single_task_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
                                  im_rect srect, im_rect drect, im_rect prect,
                                  int acquire_fence_fd, int *release_fence_fd,
                                  im_opt_t *opt_ptr, int usage) {
+    IM_STATUS ret;
+
+    if (rga_tile_is_required(src, dst, pat, srect, drect, prect, usage))
+        return rga_tile_submit(src, dst, pat, srect, drect, prect,
+                               acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+
+    if (rga_stripe_submit(src, dst, pat, srect, drect, prect,
+                          acquire_fence_fd, release_fence_fd, opt_ptr, usage, &ret))
+        return ret;
+
+#ifdef RGA_DEFERRED_SUBMIT_ENABLE
+    if (rga_deferred_submit(src, dst, pat, srect, drect, prect,
+                            &acquire_fence_fd, release_fence_fd, opt_ptr, usage, &ret))
+        return ret;
+#endif
+
     return rga_task_submit(0, src, dst, pat, srect, drect, prect, acquire_fence_fd, release_fence_fd, opt_ptr, usage);
 }
 
+/*
+ * Fallback for drivers without the job interface, the tasks are submitted
+ * one by one and their release fences are merged.
+ */
+static IM_STATUS rga_task_array_submit_single(rga_session_t *session,
+                                              rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                              int count, rga_task_rect_get_t get_rect, void *data,
+                                              int acquire_fence_fd, int *release_fence_fd,
+                                              im_opt_t *opt_ptr, int usage) {
+    IM_STATUS ret = IM_STATUS_SUCCESS;
+    im_fence_set_t *fence_set = NULL;
+    im_rect srect, drect, prect;
+    int fence_fd;
+
+    /* every task would need its own acquire fence, wait for it once here */
+    if (acquire_fence_fd >= 0) {
+        if (rga_sync_wait(acquire_fence_fd, -1) < 0) {
+            IM_LOGE("wait acquire_fence_fd[%d] failed.\n", acquire_fence_fd);
+            return IM_STATUS_FAILED;
+        }
+
+        if (session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE)
+            close(acquire_fence_fd);
+    }
+
+    if (usage & IM_ASYNC) {
+        fence_set = rga_fence_set_create();
+        if (fence_set == NULL)
+            return IM_STATUS_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < count; i++) {
+        get_rect(data, i, &srect, &drect, &prect);
+
+        fence_fd = -1;
+        ret = rga_task_submit(0, src, dst, pat, srect, drect, prect,
+                              -1, &fence_fd, opt_ptr, usage);
+        if (ret != IM_STATUS_SUCCESS)
+            goto out;
+
+        if (fence_set != NULL && fence_fd >= 0) {
+            ret = rga_fence_set_add(fence_set, fence_fd);
+            if (ret != IM_STATUS_SUCCESS) {
+                close(fence_fd);
+                goto out;
+            }
+        }
+    }
+
+    if (fence_set != NULL)
+        ret = rga_fence_set_merge(fence_set, release_fence_fd);
+    else if (release_fence_fd)
+        *release_fence_fd = -1;
+
+out:
+    rga_fence_set_release(fence_set);
+
+    return ret;
+}
+
+/*
+ * Submit count tasks that share the images and options and only differ in
+ * their rects, get_rect() returns the rects of the task at an index.
+ *
+ * The tasks are packed into jobs of up to RGA_TASK_NUM_MAX tasks, the first
+ * job waits on acquire_fence_fd and each following job on the fence of the
+ * previous one, so the whole array costs one submission per
+ * RGA_TASK_NUM_MAX tasks and returns a single release fence.
+ */
+IM_STATUS rga_task_array_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                int count, rga_task_rect_get_t get_rect, void *data,
+                                int acquire_fence_fd, int *release_fence_fd,
+                                im_opt_t *opt_ptr, int usage) {
+    IM_STATUS ret = IM_STATUS_SUCCESS;
+    int sync_mode, task_usage;
+    int job_count, fence_fd, out_fence_fd;
+    bool fence_owned = false;
+    im_job_handle_t job_handle;
+    im_rect srect, drect, prect;
+    rga_session_t *session;
+
+    if (get_rect == NULL || count <= 0) {
+        IM_LOGE("illegal task array, count = %d\n", count);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    if ((usage & IM_ASYNC) && release_fence_fd == NULL) {
+        IM_LOGW("Async mode release_fence_fd cannot be NULL!");
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    /* keep the order with the tasks deferred before */
+    rga_deferred_kick();
+
+    if (session->driver_type != RGA_DRIVER_IOC_MULTI_RGA)
+        return rga_task_array_submit_single(session, src, dst, pat, count, get_rect, data,
+                                            acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+
+    sync_mode = (usage & IM_ASYNC) ? IM_ASYNC : IM_SYNC;
+    task_usage = usage & ~(IM_SYNC | IM_ASYNC);
+
+    /* the user's acquire fence follows the usual rules, the chained ones are ours */
+    fence_fd = acquire_fence_fd;
+
+    for (int start = 0; start < count; start += job_count) {
+        job_count = count - start;
+        if (job_count > RGA_TASK_NUM_MAX)
+            job_count = RGA_TASK_NUM_MAX;
+
+        job_handle = rga_job_create(0);
+        if ((int)job_handle <= 0) {
+            ret = job_handle ? (IM_STATUS)(int)job_handle : IM_STATUS_FAILED;
+            break;
+        }
+
+        for (int i = start; i < start + job_count; i++) {
+            get_rect(data, i, &srect, &drect, &prect);
+
+            ret = rga_task_submit(job_handle, src, dst, pat, srect, drect, prect,
+                                  -1, NULL, opt_ptr, task_usage);
+            if (ret != IM_STATUS_SUCCESS)
+                break;
+        }
+
+        if (ret != IM_STATUS_SUCCESS) {
+            rga_job_cancel(job_handle);
+            break;
+        }
+
+        out_fence_fd = -1;
+        ret = rga_job_submit(job_handle, sync_mode, fence_fd, &out_fence_fd);
+
+        if (fence_owned && fence_fd >= 0 &&
+            (ret != IM_STATUS_SUCCESS || session->driver_feature & RGA_DRIVER_FEATURE_USER_CLOSE_FENCE))
+            close(fence_fd);
+        fence_fd = -1;
+
+        if (ret != IM_STATUS_SUCCESS)
+            break;
+
+        if (sync_mode == IM_ASYNC)
+            fence_fd = out_fence_fd;
+        fence_owned = true;
+    }
+
+    if (ret != IM_STATUS_SUCCESS) {
+        if (fence_owned && fence_fd >= 0)
+            close(fence_fd);
+        fence_fd = -1;
+    }
+
+    if (release_fence_fd)
+        *release_fence_fd = fence_fd;
+
+    return ret;
+}
+
+typedef struct rga_rect_array {
+    const im_rect *rects;
+    bool rect_is_src;
+} rga_rect_array_t;
+
+static void rga_rect_array_get_rect(void *data, int index, im_rect *srect, im_rect *drect, im_rect *prect) {
+    rga_rect_array_t *array = (rga_rect_array_t *)data;
+
+    *drect = array->rects[index];
+    if (array->rect_is_src)
+        *srect = array->rects[index];
+    else
+        memset(srect, 0x0, sizeof(*srect));
+    memset(prect, 0x0, sizeof(*prect));
+}
+
+/*
+ * Apply the same operation to every rect of rect_array. The rect is used as
+ * drect, and also as srect when rect_is_src is set (in-place operations such
+ * as mosaic).
+ */
+IM_STATUS rga_rect_array_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                const im_rect *rect_array, int array_size, bool rect_is_src,
+                                int *release_fence_fd, im_opt_t *opt_ptr, int usage) {
+    rga_rect_array_t array;
+
+    if (rect_array == NULL || array_size <= 0) {
+        IM_LOGE("illegal rect array[%p], array_size = %d\n", rect_array, array_size);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    array.rects = rect_array;
+    array.rect_is_src = rect_is_src;
+
+    return rga_task_array_submit(src, dst, pat, array_size, rga_rect_array_get_rect, &array,
+                                 -1, release_fence_fd, opt_ptr, usage);
+}
+
+static int rga_plan_buffer_type(const rga_buffer_t *buf) {
+    /* Same priority as rga_set_buffer_info(). */
+    if (buf->handle > 0)
+        return RGA_PLAN_BUFFER_HANDLE;
+    else if (buf->phy_addr != NULL)
+        return RGA_PLAN_BUFFER_PHY_ADDR;
+    else if (buf->fd > 0)
+        return RGA_PLAN_BUFFER_FD;
+    else if (buf->vir_addr != NULL)
+        return RGA_PLAN_BUFFER_VIR_ADDR;
+
+    return RGA_PLAN_BUFFER_NONE;
+}
+
+static const char *rga_plan_buffer_type_str(int type) {
+    switch (type) {
+        case RGA_PLAN_BUFFER_HANDLE:
+            return "handle";
+        case RGA_PLAN_BUFFER_PHY_ADDR:
+            return "phy_addr";
+        case RGA_PLAN_BUFFER_FD:
+            return "fd";
+        case RGA_PLAN_BUFFER_VIR_ADDR:
+            return "vir_addr";
+        case RGA_PLAN_BUFFER_NONE:
+        default:
+            return "none";
+    }
+}
+
+static IM_STATUS rga_plan_check_buffer(const char *name, const rga_buffer_t *tmpl, const rga_buffer_t *buf) {
+    if (rga_plan_buffer_type(tmpl) != rga_plan_buffer_type(buf)) {
+        IM_LOGE("plan %s buffer type mismatch, the plan was created with %s, but got %s.\n",
+                name,
+                rga_plan_buffer_type_str(rga_plan_buffer_type(tmpl)),
+                rga_plan_buffer_type_str(rga_plan_buffer_type(buf)));
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    if (tmpl->width != buf->width || tmpl->height != buf->height ||
+        tmpl->wstride != buf->wstride || tmpl->hstride != buf->hstride ||
+        tmpl->format != buf->format) {
+        IM_LOGE("plan %s image mismatch, the plan was created with [w,h,ws,hs,fmt] = [%d, %d, %d, %d, %s], "
+                "but got [%d, %d, %d, %d, %s].\n",
+                name,
+                tmpl->width, tmpl->height, tmpl->wstride, tmpl->hstride, translate_format_str(tmpl->format),
+                buf->width, buf->height, buf->wstride, buf->hstride, translate_format_str(buf->format));
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+/*
+ * Only the address of the channel changes between executions, so patch it
+ * the same way generate_*_req() fill it for the RGA2/multi-RGA driver:
+ * yrgb_addr carries the fd/handle, uv_addr/v_addr carry the address.
+ */
+static void rga_plan_patch_buffer(rga_img_info_t *info, const rga_buffer_t *buf) {
+    uint64_t uv_offset = info->v_addr - info->uv_addr;
+    uintptr_t addr = 0;
+
+    if (buf->handle > 0) {
+        info->yrgb_addr = buf->handle;
+    } else if (buf->phy_addr != NULL) {
+        info->yrgb_addr = 0;
+        addr = (uintptr_t)buf->phy_addr;
+    } else if (buf->fd > 0) {
+        info->yrgb_addr = buf->fd;
+    } else {
+        info->yrgb_addr = 0;
+        addr = (uintptr_t)buf->vir_addr;
+    }
+
+    info->uv_addr = addr;
+    info->v_addr = addr + uv_offset;
+}
+
+im_plan_t *rga_plan_create(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                           im_rect srect, im_rect drect, im_rect prect,
+                           im_opt_t *opt_ptr, int usage) {
+    int ret;
+    im_plan_t *plan;
+    rga_session_t *session;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return NULL;
+
+    plan = (im_plan_t *)calloc(1, sizeof(*plan));
+    if (plan == NULL) {
+        IM_LOGE("rga plan alloc error!\n");
+        return NULL;
+    }
+
+    plan->src = src;
+    plan->dst = dst;
+    plan->pat = pat;
+    plan->srect = srect;
+    plan->drect = drect;
+    plan->prect = prect;
+    plan->usage = usage;
+    rga_get_opt(&plan->opt, opt_ptr);
+
+    plan->has_src = !(usage & IM_COLOR_FILL);
+    plan->has_pat = ((usage & IM_COLOR_PALETTE) || (usage & IM_ALPHA_BLEND_MASK)) &&
+                    rga_is_buffer_valid(pat);
+
+    if (is_debug_en())
+        rga_dump_info(IM_LOG_DEBUG | IM_LOG_FORCE,
+                      0, &src, &dst, &pat, &srect, &drect, &prect,
+                      -1, NULL, opt_ptr, usage);
+
+    ret = rga_task_generate_req(&plan->req, session, 0, src, dst, pat, srect, drect, prect,
+                                -1, NULL, opt_ptr, usage);
+    if (ret != IM_STATUS_SUCCESS) {
+        free(plan);
+        return NULL;
+    }
+
+    /*
+     * The legacy RGA1 driver encodes the address differently per driver
+     * revision, so only the RGA2/multi-RGA encoding is patched in place.
+     */
+    plan->patchable = session->driver_type == RGA_DRIVER_IOC_RGA2 ||
+                      session->driver_type == RGA_DRIVER_IOC_MULTI_RGA;
+
+    return plan;
+}
+
+IM_STATUS rga_plan_execute(im_job_handle_t job_handle, im_plan_t *plan,
+                           rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                           int acquire_fence_fd, int *release_fence_fd) {
+    int ret;
+    struct rga_req req;
+    rga_session_t *session;
+
+    if (plan == NULL) {
+        IM_LOGE("plan cannot be NULL!\n");
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    if (plan->has_src) {
+        ret = rga_plan_check_buffer("src", &plan->src, &src);
+        if (ret != IM_STATUS_SUCCESS)
+            return (IM_STATUS)ret;
+    }
+
+    ret = rga_plan_check_buffer("dst", &plan->dst, &dst);
+    if (ret != IM_STATUS_SUCCESS)
+        return (IM_STATUS)ret;
+
+    if (plan->has_pat) {
+        ret = rga_plan_check_buffer("src1/pat", &plan->pat, &pat);
+        if (ret != IM_STATUS_SUCCESS)
+            return (IM_STATUS)ret;
+    }
+
+    /* keep the order with the tasks deferred before */
+    if (job_handle <= 0)
+        rga_deferred_kick();
+
+    if (!plan->patchable)
+        return rga_task_submit(job_handle, src, dst, pat,
+                               plan->srect, plan->drect, plan->prect,
+                               acquire_fence_fd, release_fence_fd,
+                               &plan->opt, plan->usage);
+
+    if (is_debug_en())
+        rga_dump_info(IM_LOG_DEBUG | IM_LOG_FORCE,
+                      job_handle, &src, &dst, &pat, &plan->srect, &plan->drect, &plan->prect,
+                      acquire_fence_fd, release_fence_fd, &plan->opt, plan->usage);
+
+    memcpy(&req, &plan->req, sizeof(req));
+
+    if (plan->has_src)
+        rga_plan_patch_buffer(&req.src, &src);
+    rga_plan_patch_buffer(&req.dst, &dst);
+    if (plan->has_pat)
+        rga_plan_patch_buffer(&req.pat, &pat);
+
+    ret = rga_task_commit_req(session, job_handle, &req, acquire_fence_fd, release_fence_fd, plan->usage);
+    if (ret == IM_STATUS_FAILED) {
+        rga_dump_info(IM_LOG_ERROR | IM_LOG_FORCE,
+                      job_handle, &src, &dst, &pat, &plan->srect, &plan->drect, &plan->prect,
+                      acquire_fence_fd, release_fence_fd, &plan->opt, plan->usage);
+
+        ret = rga_task_revalidate(src, dst, pat, plan->srect, plan->drect, plan->prect,
+                                  plan->usage, (IM_STATUS)ret);
+    }
+
+    return (IM_STATUS)ret;
+}
+
+void rga_plan_release(im_plan_t *plan) {
+    if (plan == NULL)
+        return;
+
+    if (plan->usage & IM_GAUSS && plan->req.gauss_config.coe_ptr != 0)
+        free(u64_to_ptr(plan->req.gauss_config.coe_ptr));
+
+    free(plan);
+}
+
 im_job_handle_t rga_job_create(uint32_t flags) {
     int ret;
     im_job_handle_t job_handle;
@@ -2385,16 +3878,14 @@ im_job_handle_t rga_job_create(uint32_t flags) {
     if (IS_ERR(session))
         return (IM_STATUS)PTR_ERR(session);
 
-    if (ioctl(session->rga_dev_fd, RGA_IOC_REQUEST_CREATE, &flags) < 0) {
+    if (rga_session_ioctl(session, RGA_IOC_REQUEST_CREATE, &flags) < 0) {
         IM_LOGE(" %s(%d) request create fail: %s\n",__FUNCTION__, __LINE__,strerror(errno));
         return 0;
     }
 
     job_handle = flags;
 
-    pthread_mutex_lock(&g_im2d_job_manager.mutex);
-
-    job = rga_map_find_job(&g_im2d_job_manager.job_map, job_handle);
+    job = rga_job_find(job_handle);
     if (job != NULL) {
         IM_LOGE("job_map error! handle[%d] already exists[%d]!\n",
                 job_handle, job->task_count);
@@ -2402,25 +3893,16 @@ im_job_handle_t rga_job_create(uint32_t flags) {
         goto error_cancel_job;
     }
 
-    job = (im_rga_job_t *)malloc(sizeof(*job));
+    job = rga_job_alloc(job_handle);
     if (job == NULL) {
         IM_LOGE("rga job alloc error!\n");
-        ret = 0;
+        ret = IM_STATUS_OUT_OF_MEMORY;
         goto error_cancel_job;
     }
 
-    memset(job, 0x0, sizeof(*job));
-
-    job->id = job_handle;
-    rga_map_insert_job(&g_im2d_job_manager.job_map, job_handle, job);
-    g_im2d_job_manager.job_count++;
-
-    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-
     return job_handle;
 
 error_cancel_job:
-    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
     rga_job_cancel(job_handle);
 
     return ret;
@@ -2434,19 +3916,13 @@ IM_STATUS rga_job_cancel(im_job_handle_t job_handle) {
     if (IS_ERR(session))
         return (IM_STATUS)PTR_ERR(session);
 
-    pthread_mutex_lock(&g_im2d_job_manager.mutex);
-
-    job = rga_map_find_job(&g_im2d_job_manager.job_map, job_handle);
+    job = rga_job_find(job_handle);
     if (job != NULL) {
-        rga_map_delete_job(&g_im2d_job_manager.job_map, job_handle);
-        free(job);
+        rga_job_detach(job);
+        rga_job_free(job);
     }
 
-    g_im2d_job_manager.job_count--;
-
-    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-
-    if (ioctl(session->rga_dev_fd, RGA_IOC_REQUEST_CANCEL, &job_handle) < 0) {
+    if (rga_session_ioctl(session, RGA_IOC_REQUEST_CANCEL, &job_handle) < 0) {
         IM_LOGE(" %s(%d) request cancel fail: %s\n",__FUNCTION__, __LINE__,strerror(errno));
         return IM_STATUS_FAILED;
     }
@@ -2454,15 +3930,11 @@ IM_STATUS rga_job_cancel(im_job_handle_t job_handle) {
     return IM_STATUS_SUCCESS;
 }
 
-IM_STATUS rga_job_submit(im_job_handle_t job_handle, int sync_mode, int acquire_fence_fd, int *release_fence_fd) {
+static IM_STATUS rga_job_submit_session(rga_session_t *session, im_job_handle_t job_handle,
+                                        int sync_mode, int acquire_fence_fd, int *release_fence_fd) {
     int ret;
     im_rga_job_t *job = NULL;
     struct rga_user_request submit_request;
-    rga_session_t *session;
-
-    session = get_rga_session();
-    if (IS_ERR(session))
-        return (IM_STATUS)PTR_ERR(session);
 
     memset(&submit_request, 0x0, sizeof(submit_request));
 
@@ -2478,27 +3950,20 @@ IM_STATUS rga_job_submit(im_job_handle_t job_handle, int sync_mode, int acquire_
             return IM_STATUS_ILLEGAL_PARAM;
     }
 
-    pthread_mutex_lock(&g_im2d_job_manager.mutex);
-
-    job = rga_map_find_job(&g_im2d_job_manager.job_map, job_handle);
+    job = rga_job_find(job_handle);
     if (job == NULL) {
         IM_LOGE("%s job_handle[%d] is illegal!\n", __func__, job_handle);
-
-        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
         return IM_STATUS_ILLEGAL_PARAM;
     }
 
-    rga_map_delete_job(&g_im2d_job_manager.job_map, job_handle);
-    g_im2d_job_manager.job_count--;
-
-    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+    rga_job_detach(job);
 
     submit_request.task_ptr = ptr_to_u64(job->req);
     submit_request.task_num = job->task_count;
-    submit_request.id = job->id;
+    submit_request.id = job_handle;
     submit_request.acquire_fence_fd = acquire_fence_fd;
 
-    ret = ioctl(session->rga_dev_fd, RGA_IOC_REQUEST_SUBMIT, &submit_request);
+    ret = rga_session_ioctl(session, RGA_IOC_REQUEST_SUBMIT, &submit_request);
     if (ret < 0) {
         IM_LOGE(" %s(%d) request submit fail: %s\n",__FUNCTION__, __LINE__,strerror(errno));
         ret = IM_STATUS_FAILED;
@@ -2511,11 +3976,21 @@ IM_STATUS rga_job_submit(im_job_handle_t job_handle, int sync_mode, int acquire_
         *release_fence_fd = submit_request.release_fence_fd;
 
 free_job:
-    free(job);
+    rga_job_free(job);
 
     return (IM_STATUS)ret;
 }
 
+IM_STATUS rga_job_submit(im_job_handle_t job_handle, int sync_mode, int acquire_fence_fd, int *release_fence_fd) {
+    rga_session_t *session;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    return rga_job_submit_session(session, job_handle, sync_mode, acquire_fence_fd, release_fence_fd);
+}
+
 IM_STATUS rga_job_config(im_job_handle_t job_handle, int sync_mode, int acquire_fence_fd, int *release_fence_fd) {
     int ret;
     im_rga_job_t *job = NULL;
@@ -2540,13 +4015,9 @@ IM_STATUS rga_job_config(im_job_handle_t job_handle, int sync_mode, int acquire_
             return IM_STATUS_ILLEGAL_PARAM;
     }
 
-    pthread_mutex_lock(&g_im2d_job_manager.mutex);
-
-    job = rga_map_find_job(&g_im2d_job_manager.job_map, job_handle);
+    job = rga_job_find(job_handle);
     if (job == NULL) {
         IM_LOGE("%s job_handle[%d] is illegal!\n", __func__, job_handle);
-
-        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
         return IM_STATUS_ILLEGAL_PARAM;
     }
 
@@ -2555,9 +4026,7 @@ IM_STATUS rga_job_config(im_job_handle_t job_handle, int sync_mode, int acquire_
     config_request.id = job->id;
     config_request.acquire_fence_fd = acquire_fence_fd;
 
-    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
-
-    ret = ioctl(session->rga_dev_fd, RGA_IOC_REQUEST_CONFIG, &config_request);
+    ret = rga_session_ioctl(session, RGA_IOC_REQUEST_CONFIG, &config_request);
     if (ret < 0) {
         IM_LOGE(" %s(%d) request config fail: %s",__FUNCTION__, __LINE__,strerror(errno));
         return IM_STATUS_FAILED;
@@ -4498,7 +5967,7 @@ int generate_color_palette_req(struct rga_req *ioc_req, rga_info_t *src, rga_inf
         rgaReg.fading.g = 0xff;
         rgaReg.render_mode = update_palette_table_mode;
 
-        if(ioctl(session->rga_dev_fd, RGA_BLIT_SYNC, &rgaReg) != 0) {
+        if(rga_session_ioctl(session, RGA_BLIT_SYNC, &rgaReg) != 0) {
             printf("update palette table mode ioctl err\n");
             return -1;
         }
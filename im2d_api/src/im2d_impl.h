@@ -25,6 +25,7 @@
 #include "drmrga.h"
 #include "im2d.h"
 #include "im2d_hardware.h"
+#include "im2d_context.h"
 
 #define ALIGN(val, align) (((val) + ((align) - 1)) & ~((align) - 1))
 #define DOWN_ALIGN(val, align) ((val) & ~((align) - 1))
@@ -60,11 +61,100 @@ typedef struct rga_version_check_ops {
     IM_STATUS (*below_minimun_range)(struct rga_version_t current, struct rga_version_t minimum, const rga_version_bind_table_entry_t *least_version_table);
 } rga_version_check_ops_t;
 
-typedef struct im_context {
+typedef enum {
+    RGA_PLAN_BUFFER_NONE = 0,
+    RGA_PLAN_BUFFER_HANDLE,
+    RGA_PLAN_BUFFER_PHY_ADDR,
+    RGA_PLAN_BUFFER_FD,
+    RGA_PLAN_BUFFER_VIR_ADDR,
+} RGA_PLAN_BUFFER_TYPE;
+
+struct im_plan {
+    /* templates, only the address of each channel may change per execution */
+    rga_buffer_t src;
+    rga_buffer_t dst;
+    rga_buffer_t pat;
+    im_rect srect;
+    im_rect drect;
+    im_rect prect;
+    im_opt_t opt;
+    int usage;
+
+    bool has_src;
+    bool has_pat;
+    bool patchable;
+
+    struct rga_req req;
+};
+
+/*
+ * The check cache is per thread, so it is not used when thread-local storage
+ * is not available.
+ */
+#ifdef RGA_THREAD_LOCAL_ENABLE
+#define RGA_CHECK_CACHE_ENABLE
+#endif
+#define RGA_CHECK_CACHE_SIZE 16     /* must be a power of 2 */
+
+typedef struct rga_check_cache_image {
+    int width;
+    int height;
+    int wstride;
+    int hstride;
+    int format;
+    int rd_mode;
+    int color_space_mode;
+    im_rect rect;
+} rga_check_cache_image_t;
+
+typedef struct rga_check_cache_key {
+    int check_mode;
+    int usage;
+    int pat_valid;
+
+    rga_check_cache_image_t src;
+    rga_check_cache_image_t dst;
+    rga_check_cache_image_t pat;
+} rga_check_cache_key_t;
+
+typedef struct rga_check_cache_entry {
+    bool valid;
+    uint32_t generation;
+    rga_check_cache_key_t key;
+} rga_check_cache_entry_t;
+
+typedef struct rga_check_cache {
+    rga_check_cache_entry_t entries[RGA_CHECK_CACHE_SIZE];
+
+    uint64_t hit;
+    uint64_t miss;
+} rga_check_cache_t;
+
+/* The cores of a candidate mask that passed the check of a task. */
+typedef struct rga_core_mask_cache_entry {
+    bool valid;
+    uint32_t generation;
+    rga_check_cache_key_t key;
+    uint32_t core_mask;
+} rga_core_mask_cache_entry_t;
+
+/* Returns the rects of the task at index, see rga_task_array_submit(). */
+typedef void (*rga_task_rect_get_t)(void *data, int index,
+                                    im_rect *srect, im_rect *drect, im_rect *prect);
+
+struct im_context {
     int priority;
     IM_SCHEDULER_CORE core;
     int check_mode;
-} im_context_t;
+    uint32_t stripe_core;       /* IM_SCHEDULER_CORE mask to split large tasks across */
+    uint32_t adaptive_core;     /* IM_SCHEDULER_CORE mask the scheduler selects from */
+    bool tile_inexact;          /* tile even when the seams may differ from an untiled operation */
+};
+
+typedef struct rga_core_info {
+    IM_SCHEDULER_CORE core;
+    rga_info_table_entry info;
+} rga_core_info_t;
 
 int rga_version_compare(struct rga_version_t version1, struct rga_version_t version2);
 int rga_version_table_get_current_index(struct rga_version_t version, const rga_version_bind_table_entry_t *table, int table_size);
@@ -85,9 +175,24 @@ static inline void rga_apply_rect(rga_buffer_t *image, im_rect *rect) {
 }
 
 IM_STATUS rga_get_info(struct rga_hw_versions_t * version, rga_info_table_entry *return_table);
+int rga_get_core_info(rga_session_t *session, uint32_t core_mask, rga_core_info_t *cores, int max_count);
 
 IM_STATUS rga_check_header(struct rga_version_t header_version);
 IM_STATUS rga_check_driver(struct rga_version_t driver_version);
+IM_STATUS rga_check_mode(int check_mode,
+                         const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
+                         const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect,
+                         int mode_usage);
+IM_STATUS rga_check_cache_get_stat(uint64_t *hit, uint64_t *miss);
+void rga_check_cache_reset(void);
+IM_STATUS rga_check_core(const rga_core_info_t *core,
+                         rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                         im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
+                         int mode_usage);
+uint32_t rga_check_core_mask(rga_session_t *session, const rga_core_info_t *cores, int count,
+                             rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                             im_rect src_rect, im_rect dst_rect, im_rect pat_rect,
+                             int mode_usage);
 IM_STATUS rga_check_external(const rga_buffer_t src, const rga_buffer_t dst, const rga_buffer_t pat,
                              const im_rect src_rect, const im_rect dst_rect, const im_rect pat_rect,
                              int mode_usage);
@@ -97,8 +202,17 @@ IM_API IM_STATUS rga_release_buffers(struct rga_buffer_pool *buffer_pool);
 IM_API rga_buffer_handle_t rga_import_buffer(uint64_t memory, int type, uint32_t size);
 IM_API rga_buffer_handle_t rga_import_buffer_param(uint64_t memory, int type, im_handle_param_t *param);
 IM_API IM_STATUS rga_release_buffer(int handle);
+IM_STATUS rga_import_buffer_array(const void *memory_array, int type,
+                                  const im_handle_param_t *param, int count,
+                                  rga_buffer_handle_t *handle);
+IM_STATUS rga_release_buffer_array(const rga_buffer_handle_t *handle, int count);
+im_frame_pool_t *rga_frame_pool_create(const im_frame_pool_param_t *param);
+IM_STATUS rga_frame_pool_acquire(im_frame_pool_t *pool, rga_buffer_t *buffer);
+IM_STATUS rga_frame_pool_release(im_frame_pool_t *pool, const rga_buffer_t *buffer);
+IM_STATUS rga_frame_pool_destroy(im_frame_pool_t *pool);
 
 IM_STATUS rga_get_opt(im_opt_t *opt, void *ptr);
+int rga_get_opt_core(void *ptr);
 
 IM_STATUS rga_single_task_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
                                  im_rect srect, im_rect drect, im_rect prect,
@@ -109,6 +223,69 @@ IM_STATUS rga_task_submit(im_job_handle_t job_handle,
                           im_rect srect, im_rect drect, im_rect prect,
                           int acquire_fence_fd, int *release_fence_fd,
                           im_opt_t *opt_ptr, int usage);
+IM_STATUS rga_deferred_config(uint64_t window_us);
+void rga_deferred_kick(void);
+IM_STATUS rga_deferred_flush(int *release_fence_fd);
+IM_STATUS rga_task_array_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                int count, rga_task_rect_get_t get_rect, void *data,
+                                int acquire_fence_fd, int *release_fence_fd,
+                                im_opt_t *opt_ptr, int usage);
+IM_STATUS rga_rect_array_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                const im_rect *rect_array, int array_size, bool rect_is_src,
+                                int *release_fence_fd, im_opt_t *opt_ptr, int usage);
+
+bool rga_tile_is_required(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                          im_rect srect, im_rect drect, im_rect prect, int usage);
+IM_STATUS rga_tile_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                          im_rect srect, im_rect drect, im_rect prect,
+                          int acquire_fence_fd, int *release_fence_fd,
+                          im_opt_t *opt_ptr, int usage);
+IM_SCHEDULER_CORE rga_scheduler_select(rga_session_t *session,
+                                       rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                       im_rect srect, im_rect drect, im_rect prect,
+                                       im_opt_t *opt_ptr, int usage, uint64_t *bytes);
+void rga_scheduler_done(IM_SCHEDULER_CORE core_id, uint64_t bytes, IM_STATUS status, int release_fence_fd);
+IM_STATUS rga_scheduler_config(im_context_t *context, uint32_t core_mask);
+IM_STATUS rga_scheduler_get_stat(im_scheduler_stat_t *stats, int *count);
+uint64_t rga_import_cache_get(rga_session_t *session,
+                              rga_buffer_t *src, rga_buffer_t *dst, rga_buffer_t *pat,
+                              int usage);
+void rga_import_cache_put(uint64_t mask);
+IM_STATUS rga_import_cache_config(uint64_t value);
+IM_STATUS rga_import_cache_release(int type, uint64_t memory);
+IM_STATUS rga_import_cache_get_stat(uint64_t *hit, uint64_t *miss);
+IM_STATUS rga_context_config(im_context_t *context, IM_CONFIG_NAME name, uint64_t value);
+im_context_t *rga_context_create(void);
+IM_STATUS rga_context_release(im_context_t *context);
+IM_STATUS rga_context_push(const im_context_t *context);
+IM_STATUS rga_context_pop(void);
+bool rga_stripe_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                       im_rect srect, im_rect drect, im_rect prect,
+                       int acquire_fence_fd, int *release_fence_fd,
+                       im_opt_t *opt_ptr, int usage, IM_STATUS *ret);
+
+im_plan_t *rga_plan_create(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                           im_rect srect, im_rect drect, im_rect prect,
+                           im_opt_t *opt_ptr, int usage);
+IM_STATUS rga_plan_execute(im_job_handle_t job_handle, im_plan_t *plan,
+                           rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                           int acquire_fence_fd, int *release_fence_fd);
+void rga_plan_release(im_plan_t *plan);
+
+IM_STATUS rga_fence_watch(int fence_fd, im_fence_callback_t callback, void *userdata);
+int rga_fence_poll(int timeout_ms);
+IM_STATUS rga_fence_reactor_start(void);
+IM_STATUS rga_fence_reactor_stop(void);
+IM_STATUS rga_fence_task_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                im_rect srect, im_rect drect, im_rect prect,
+                                int acquire_fence_fd, im_opt_t *opt_ptr, int usage,
+                                im_fence_callback_t callback, void *userdata);
+IM_STATUS rga_fence_job_submit(im_job_handle_t job_handle, int acquire_fence_fd,
+                               im_fence_callback_t callback, void *userdata);
+im_fence_set_t *rga_fence_set_create(void);
+IM_STATUS rga_fence_set_add(im_fence_set_t *set, int fence_fd);
+IM_STATUS rga_fence_set_merge(im_fence_set_t *set, int *fence_fd);
+void rga_fence_set_release(im_fence_set_t *set);
 
 im_job_handle_t rga_job_create(uint32_t flags);
 IM_STATUS rga_job_cancel(im_job_handle_t job_handle);
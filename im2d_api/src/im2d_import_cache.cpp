@@ -0,0 +1,501 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_import_cache"
+#else
+#define LOG_TAG "im2d_import_cache"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__) && !defined(RGA_SYNC_DISABLE)
+#define RGA_IMPORT_CACHE_ENABLE
+#endif
+
+#ifdef RGA_IMPORT_CACHE_ENABLE
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_context.h"
+#include "im2d_impl.h"
+
+#include "RgaUtils.h"
+#include "utils.h"
+
+/*
+ * Import cache: the fd (and optionally virtual address) buffers of the
+ * tasks are imported on first use and then passed to the driver as handles,
+ * so the driver does not map the buffer again for every task.
+ *
+ * A dma-buf is identified by the st_dev/st_ino of its fd, which stays valid
+ * after the fd is closed or reused, since the imported handle keeps the
+ * dma-buf alive. A virtual address is identified by va/size only, the user
+ * must call releasebuffer_cache_virtualaddr() before freeing the memory.
+ *
+ * Each entry is referenced while a task using it is not yet submitted (a
+ * single task until the ioctl returns, a job task until the job is
+ * submitted or canceled), only unreferenced entries are evicted, in LRU
+ * order. The referenced entries are tracked by a mask of cache slots, so
+ * the size of the cache is limited to the bits of the mask.
+ *
+ * The cache is shared by all the threads, the tasks of a thread using a
+ * private session are not cached since the handles belong to the global
+ * session.
+ */
+#define RGA_IMPORT_CACHE_SIZE_MAX   64      /* bits of the slot mask */
+
+#ifdef RGA_IMPORT_CACHE_ENABLE
+typedef struct rga_import_cache_entry {
+    bool valid;
+    int type;                   /* RGA_DMA_BUFFER or RGA_VIRTUAL_ADDRESS */
+    uint64_t key[2];            /* st_dev/st_ino, or va/size */
+    rga_buffer_handle_t handle;
+    rga_session_t *session;
+
+    int refcount;
+    bool released;              /* not looked up anymore, released once unreferenced */
+    uint64_t last_use;
+} rga_import_cache_entry_t;
+
+typedef struct rga_import_cache {
+    pthread_mutex_t mutex;
+    _Atomic(int) capacity;      /* 0: disabled */
+    bool virtual_addr;
+    uint64_t clock;
+
+    uint64_t hit;
+    uint64_t miss;
+
+    rga_import_cache_entry_t entry[RGA_IMPORT_CACHE_SIZE_MAX];
+} rga_import_cache_t;
+
+static rga_import_cache_t g_import_cache = {
+    PTHREAD_MUTEX_INITIALIZER, ATOMIC_VAR_INIT(0), false, 0, 0, 0, {}
+};
+
+static int rga_import_cache_ioctl(rga_session_t *session, unsigned long cmd,
+                                  struct rga_external_buffer *buffer) {
+    struct rga_buffer_pool buffer_pool;
+
+    buffer_pool.buffers = ptr_to_u64(buffer);
+    buffer_pool.size = 1;
+
+    return rga_session_ioctl(session, cmd, &buffer_pool);
+}
+
+static rga_buffer_handle_t rga_import_cache_import(rga_session_t *session,
+                                                   int type, uint64_t memory, uint32_t size) {
+    struct rga_external_buffer buffer;
+
+    memset(&buffer, 0x0, sizeof(buffer));
+    buffer.type = type;
+    buffer.memory = memory;
+    buffer.memory_info.size = size;
+
+    if (rga_import_cache_ioctl(session, RGA_IOC_IMPORT_BUFFER, &buffer) < 0) {
+        IM_LOGD("import cache: RGA_IOC_IMPORT_BUFFER fail! %s", strerror(errno));
+        return 0;
+    }
+
+    return buffer.handle;
+}
+
+static void rga_import_cache_release_handle(rga_session_t *session, rga_buffer_handle_t handle) {
+    struct rga_external_buffer buffer;
+
+    memset(&buffer, 0x0, sizeof(buffer));
+    buffer.handle = handle;
+
+    if (rga_import_cache_ioctl(session, RGA_IOC_RELEASE_BUFFER, &buffer) < 0)
+        IM_LOGW("import cache: RGA_IOC_RELEASE_BUFFER fail! %s", strerror(errno));
+}
+
+/* must be called with the mutex held */
+static void rga_import_cache_entry_release(rga_import_cache_entry_t *entry) {
+    entry->released = true;
+    if (entry->refcount > 0)
+        return;
+
+    rga_import_cache_release_handle(entry->session, entry->handle);
+    entry->valid = false;
+}
+
+/* must be called with the mutex held */
+static int rga_import_cache_find(int type, const uint64_t key[2]) {
+    rga_import_cache_entry_t *entry;
+
+    for (int i = 0; i < RGA_IMPORT_CACHE_SIZE_MAX; i++) {
+        entry = &g_import_cache.entry[i];
+        if (entry->valid && entry->type == type && !entry->released &&
+            entry->key[0] == key[0] && entry->key[1] == key[1])
+            return i;
+    }
+
+    return -1;
+}
+
+/* must be called with the mutex held, returns a free slot or evicts the LRU entry */
+static int rga_import_cache_get_slot(void) {
+    int capacity = atomic_load(&g_import_cache.capacity);
+    int victim = -1;
+    rga_import_cache_entry_t *entry;
+
+    for (int i = 0; i < capacity; i++) {
+        entry = &g_import_cache.entry[i];
+        if (!entry->valid)
+            return i;
+
+        if (entry->refcount == 0 && !entry->released &&
+            (victim < 0 || entry->last_use < g_import_cache.entry[victim].last_use))
+            victim = i;
+    }
+
+    if (victim >= 0)
+        rga_import_cache_entry_release(&g_import_cache.entry[victim]);
+
+    return victim;
+}
+
+/*
+ * Returns 1 and the key if the buffer can be cached, 0 if it is already a
+ * handle, or -1 if it cannot be cached.
+ */
+static int rga_import_cache_get_key(const rga_buffer_t *buf, bool virtual_addr,
+                                    int *type, uint64_t key[2]) {
+    struct stat st;
+
+    /* Same priority as rga_set_buffer_info(). */
+    if (buf->handle > 0)
+        return 0;
+
+    if (buf->phy_addr != NULL)
+        return -1;
+
+    if (buf->fd > 0) {
+        if (fstat(buf->fd, &st) < 0)
+            return -1;
+
+        *type = RGA_DMA_BUFFER;
+        key[0] = (uint64_t)st.st_dev;
+        key[1] = (uint64_t)st.st_ino;
+
+        return 1;
+    }
+
+    if (buf->vir_addr != NULL && virtual_addr) {
+        *type = RGA_VIRTUAL_ADDRESS;
+        key[0] = ptr_to_u64(buf->vir_addr);
+        key[1] = (uint64_t)((double)buf->wstride * buf->hstride *
+                            get_bpp_from_format(convert_to_rga_format(buf->format)));
+
+        return key[1] > 0 ? 1 : -1;
+    }
+
+    return -1;
+}
+
+static uint32_t rga_import_cache_get_size(const rga_buffer_t *buf, int type, const uint64_t key[2]) {
+    off_t size;
+
+    if (type == RGA_VIRTUAL_ADDRESS)
+        return (uint32_t)key[1];
+
+    /* the size of a dma-buf */
+    size = lseek(buf->fd, 0, SEEK_END);
+    lseek(buf->fd, 0, SEEK_SET);
+
+    return size > 0 ? (uint32_t)size : 0;
+}
+
+/* Returns the slot of the buffer with a reference held, or -1. */
+static int rga_import_cache_acquire(rga_session_t *session, const rga_buffer_t *buf,
+                                    int type, const uint64_t key[2]) {
+    int slot;
+    uint32_t size;
+    rga_buffer_handle_t handle;
+    rga_import_cache_entry_t *entry;
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    slot = rga_import_cache_find(type, key);
+    if (slot >= 0) {
+        entry = &g_import_cache.entry[slot];
+        entry->refcount++;
+        entry->last_use = ++g_import_cache.clock;
+        g_import_cache.hit++;
+    } else {
+        g_import_cache.miss++;
+    }
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    if (slot >= 0)
+        return slot;
+
+    /* import without the lock, the ioctl maps the buffer */
+    size = rga_import_cache_get_size(buf, type, key);
+    if (size == 0)
+        return -1;
+
+    handle = rga_import_cache_import(session, type,
+                                     type == RGA_DMA_BUFFER ? (uint64_t)buf->fd : key[0], size);
+    if (handle <= 0)
+        return -1;
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    slot = rga_import_cache_find(type, key);
+    if (slot < 0) {
+        slot = rga_import_cache_get_slot();
+        if (slot >= 0) {
+            entry = &g_import_cache.entry[slot];
+            entry->valid = true;
+            entry->type = type;
+            entry->key[0] = key[0];
+            entry->key[1] = key[1];
+            entry->handle = handle;
+            entry->session = session;
+            entry->released = false;
+            entry->refcount = 0;
+
+            handle = 0;
+        }
+    }
+
+    if (slot >= 0) {
+        entry = &g_import_cache.entry[slot];
+        entry->refcount++;
+        entry->last_use = ++g_import_cache.clock;
+    }
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    /* inserted by another thread meanwhile, or all the entries are in use */
+    if (handle > 0)
+        rga_import_cache_release_handle(session, handle);
+
+    return slot;
+}
+
+uint64_t rga_import_cache_get(rga_session_t *session,
+                              rga_buffer_t *src, rga_buffer_t *dst, rga_buffer_t *pat,
+                              int usage) {
+    int ret, count = 0;
+    int type[3], slot[3];
+    uint64_t key[3][2];
+    rga_buffer_t *buf[3];
+    uint64_t mask = 0, bit;
+    bool virtual_addr;
+
+    if (atomic_load(&g_import_cache.capacity) == 0)
+        return 0;
+
+    if (session->is_private || session->driver_type != RGA_DRIVER_IOC_MULTI_RGA)
+        return 0;
+
+    /* the same buffers as rga_task_generate_req() */
+    if (!(usage & IM_COLOR_FILL))
+        buf[count++] = src;
+    buf[count++] = dst;
+    if (((usage & IM_COLOR_PALETTE) || (usage & IM_ALPHA_BLEND_MASK)) &&
+        rga_is_buffer_valid(*pat))
+        buf[count++] = pat;
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    virtual_addr = g_import_cache.virtual_addr;
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    /* the driver takes either handles only or no handle at all */
+    for (int i = 0; i < count; i++) {
+        ret = rga_import_cache_get_key(buf[i], virtual_addr, &type[i], key[i]);
+        if (ret < 0)
+            return 0;
+        else if (ret == 0)
+            buf[i] = NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (buf[i] == NULL)
+            continue;
+
+        slot[i] = rga_import_cache_acquire(session, buf[i], type[i], key[i]);
+        if (slot[i] < 0) {
+            rga_import_cache_put(mask);
+            return 0;
+        }
+
+        bit = (uint64_t)1 << slot[i];
+        if (mask & bit)
+            rga_import_cache_put(bit);
+        mask |= bit;
+    }
+
+    /* the referenced entries are not modified */
+    for (int i = 0; i < count; i++) {
+        if (buf[i] != NULL)
+            buf[i]->handle = g_import_cache.entry[slot[i]].handle;
+    }
+
+    return mask;
+}
+
+void rga_import_cache_put(uint64_t mask) {
+    rga_import_cache_entry_t *entry;
+
+    if (mask == 0)
+        return;
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    for (int i = 0; i < RGA_IMPORT_CACHE_SIZE_MAX; i++) {
+        if (!(mask & ((uint64_t)1 << i)))
+            continue;
+
+        entry = &g_import_cache.entry[i];
+        entry->refcount--;
+        if (entry->refcount == 0 && entry->released)
+            rga_import_cache_entry_release(entry);
+    }
+    pthread_mutex_unlock(&g_import_cache.mutex);
+}
+
+IM_STATUS rga_import_cache_config(uint64_t value) {
+    int capacity = (int)(value & IM_IMPORT_CACHE_SIZE_MASK);
+    rga_import_cache_entry_t *entry;
+
+    if (capacity > RGA_IMPORT_CACHE_SIZE_MAX ||
+        (value & ~(uint64_t)(IM_IMPORT_CACHE_SIZE_MASK | IM_IMPORT_CACHE_VIRTUAL_ADDR))) {
+        IM_LOGE("IM2D: It's not legal import cache config[0x%lx], the size should be in the range of 0~%d.",
+                (unsigned long)value, RGA_IMPORT_CACHE_SIZE_MAX);
+        return IM_STATUS_ILLEGAL_PARAM;
+    }
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    /* drop everything, the referenced entries go once unreferenced */
+    for (int i = 0; i < RGA_IMPORT_CACHE_SIZE_MAX; i++) {
+        entry = &g_import_cache.entry[i];
+        if (entry->valid && !entry->released)
+            rga_import_cache_entry_release(entry);
+    }
+
+    g_import_cache.virtual_addr = !!(value & IM_IMPORT_CACHE_VIRTUAL_ADDR);
+    atomic_store(&g_import_cache.capacity, capacity);
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_import_cache_release(int type, uint64_t memory) {
+    struct stat st;
+    uint64_t key[2];
+    rga_import_cache_entry_t *entry;
+
+    if (type == RGA_DMA_BUFFER) {
+        if (fstat((int)memory, &st) < 0) {
+            IM_LOGE("import cache: invalid fd[%d], %s\n", (int)memory, strerror(errno));
+            return IM_STATUS_INVALID_PARAM;
+        }
+
+        key[0] = (uint64_t)st.st_dev;
+        key[1] = (uint64_t)st.st_ino;
+    } else {
+        key[0] = memory;
+        key[1] = 0;
+    }
+
+    pthread_mutex_lock(&g_import_cache.mutex);
+    for (int i = 0; i < RGA_IMPORT_CACHE_SIZE_MAX; i++) {
+        entry = &g_import_cache.entry[i];
+        if (!entry->valid || entry->type != type || entry->released || entry->key[0] != key[0])
+            continue;
+
+        /* any size for a virtual address */
+        if (type == RGA_DMA_BUFFER && entry->key[1] != key[1])
+            continue;
+
+        rga_import_cache_entry_release(entry);
+    }
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_import_cache_get_stat(uint64_t *hit, uint64_t *miss) {
+    pthread_mutex_lock(&g_import_cache.mutex);
+    if (hit != NULL)
+        *hit = g_import_cache.hit;
+    if (miss != NULL)
+        *miss = g_import_cache.miss;
+    pthread_mutex_unlock(&g_import_cache.mutex);
+
+    return IM_STATUS_SUCCESS;
+}
+#else
+uint64_t rga_import_cache_get(rga_session_t *session,
+                              rga_buffer_t *src, rga_buffer_t *dst, rga_buffer_t *pat,
+                              int usage) {
+    (void)session;
+    (void)src;
+    (void)dst;
+    (void)pat;
+    (void)usage;
+
+    return 0;
+}
+
+void rga_import_cache_put(uint64_t mask) {
+    (void)mask;
+}
+
+IM_STATUS rga_import_cache_config(uint64_t value) {
+    if (value == 0)
+        return IM_STATUS_SUCCESS;
+
+    IM_LOGE("import cache is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_import_cache_release(int type, uint64_t memory) {
+    (void)type;
+    (void)memory;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_import_cache_get_stat(uint64_t *hit, uint64_t *miss) {
+    if (hit != NULL)
+        *hit = 0;
+    if (miss != NULL)
+        *miss = 0;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+#endif
@@ -25,14 +25,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
+#ifndef __cplusplus
+# include <stdatomic.h>
+#else
+# include <atomic>
+# define _Atomic(X) std::atomic< X >
+using namespace std;
+#endif
+
 #include "im2d_type.h"
 #include "im2d_job.h"
 #include "im2d_log.h"
 #include "im2d_context.h"
-
-struct im2d_job_manager g_im2d_job_manager;
+#include "im2d_impl.h"
 
 #if !IM2D_JOB_USE_MAP
 static void rga_map_insert_head(rga_job_map_t *job_map, rga_map_node_data_t data) {
@@ -169,22 +177,325 @@ im_rga_job_t *rga_map_find_job(rga_job_map_t *job_map, im_job_handle_t handle) {
     return NULL;
 }
 
+/*
+ * Live jobs are published in an open-addressing table keyed by the job
+ * handle. The kernel hands out handles sequentially, so a handle normally
+ * lands in its home slot and lookups are a single atomic load. A slot goes
+ * EMPTY -> handle -> DELETED -> handle ..., never back to EMPTY, so a lookup
+ * can stop at the first EMPTY slot.
+ *
+ * Lookup and task append do not take any lock, a job is expected to be
+ * built by one thread at a time. The mutex only protects the idle job pool
+ * and the overflow map used when the table is full.
+ */
+#define RGA_JOB_SLOT_EMPTY      0
+#define RGA_JOB_SLOT_DELETED    (-1)
+#define RGA_JOB_TABLE_MASK      (RGA_JOB_TABLE_SIZE - 1)
+
+typedef struct rga_job_slot {
+    atomic_int handle;
+    _Atomic(im_rga_job_t *) job;
+} rga_job_slot_t;
+
+struct im2d_job_manager {
+    rga_job_slot_t table[RGA_JOB_TABLE_SIZE];
+    atomic_int job_count;
+
+#ifdef RGA_JOB_STATIC_POOL
+    im_rga_job_t pool[RGA_JOB_POOL_SIZE];
+    atomic_int pool_used[RGA_JOB_POOL_SIZE];
+#else
+    im_rga_job_t *pool_head;
+    int pool_count;
+
+    rga_job_map_t overflow_map;
+    atomic_int overflow_count;
+#endif
+
+    pthread_mutex_t mutex;
+};
+
+static struct im2d_job_manager g_im2d_job_manager;
+
+static int rga_job_table_insert(im_job_handle_t handle, im_rga_job_t *job) {
+    int i, index, cur;
+    rga_job_slot_t *slot;
+
+    for (i = 0; i < RGA_JOB_TABLE_SIZE; i++) {
+        index = (int)((handle + i) & RGA_JOB_TABLE_MASK);
+        slot = &g_im2d_job_manager.table[index];
+
+        cur = atomic_load_explicit(&slot->handle, memory_order_acquire);
+        if (cur != RGA_JOB_SLOT_EMPTY && cur != RGA_JOB_SLOT_DELETED)
+            continue;
+
+        if (atomic_compare_exchange_strong(&slot->handle, &cur, (int)handle)) {
+            atomic_store_explicit(&slot->job, job, memory_order_release);
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+static im_rga_job_t *rga_job_table_find(im_job_handle_t handle) {
+    int i, cur;
+    rga_job_slot_t *slot;
+
+    for (i = 0; i < RGA_JOB_TABLE_SIZE; i++) {
+        slot = &g_im2d_job_manager.table[(handle + i) & RGA_JOB_TABLE_MASK];
+
+        cur = atomic_load_explicit(&slot->handle, memory_order_acquire);
+        if (cur == RGA_JOB_SLOT_EMPTY)
+            break;
+        if (cur == (int)handle)
+            return atomic_load_explicit(&slot->job, memory_order_acquire);
+    }
+
+    return NULL;
+}
+
+static void rga_job_table_delete(int index) {
+    rga_job_slot_t *slot = &g_im2d_job_manager.table[index];
+
+    atomic_store_explicit(&slot->job, (im_rga_job_t *)NULL, memory_order_relaxed);
+    atomic_store_explicit(&slot->handle, RGA_JOB_SLOT_DELETED, memory_order_release);
+}
+
+static void rga_job_reset(im_rga_job_t *job, im_job_handle_t handle) {
+    job->id = handle;
+    job->task_count = 0;
+    job->table_index = -1;
+    job->import_slots = 0;
+
+    /* A recycled job keeps the task array it has grown. */
+    if (job->req == NULL) {
+        job->req = job->inline_req;
+        job->task_capacity = RGA_JOB_INLINE_TASK_NUM;
+    }
+}
+
+static im_rga_job_t *rga_job_pool_get(void) {
+    im_rga_job_t *job = NULL;
+
+#ifdef RGA_JOB_STATIC_POOL
+    int expected;
+
+    for (int i = 0; i < RGA_JOB_POOL_SIZE; i++) {
+        expected = 0;
+        if (atomic_compare_exchange_strong(&g_im2d_job_manager.pool_used[i], &expected, 1))
+            return &g_im2d_job_manager.pool[i];
+    }
+
+    IM_LOGE("rga job pool is exhausted, pool size = %d\n", RGA_JOB_POOL_SIZE);
+#else
+    pthread_mutex_lock(&g_im2d_job_manager.mutex);
+    if (g_im2d_job_manager.pool_head != NULL) {
+        job = g_im2d_job_manager.pool_head;
+        g_im2d_job_manager.pool_head = job->pool_next;
+        g_im2d_job_manager.pool_count--;
+    }
+    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+
+    if (job == NULL) {
+        job = (im_rga_job_t *)malloc(sizeof(*job));
+        if (job == NULL)
+            return NULL;
+
+        job->req = NULL;
+    }
+
+    job->pool_next = NULL;
+#endif
+
+    return job;
+}
+
+static void rga_job_pool_put(im_rga_job_t *job) {
+#ifdef RGA_JOB_STATIC_POOL
+    atomic_store(&g_im2d_job_manager.pool_used[job - g_im2d_job_manager.pool], 0);
+#else
+    pthread_mutex_lock(&g_im2d_job_manager.mutex);
+    if (g_im2d_job_manager.pool_count < RGA_JOB_POOL_SIZE) {
+        job->pool_next = g_im2d_job_manager.pool_head;
+        g_im2d_job_manager.pool_head = job;
+        g_im2d_job_manager.pool_count++;
+
+        job = NULL;
+    }
+    pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+
+    if (job != NULL) {
+        if (job->req != job->inline_req)
+            free(job->req);
+        free(job);
+    }
+#endif
+}
+
+im_rga_job_t *rga_job_alloc(im_job_handle_t handle) {
+    im_rga_job_t *job;
+
+    if (handle <= 0) {
+        IM_LOGE("illegal job handle[%d]\n", handle);
+        return NULL;
+    }
+
+    job = rga_job_pool_get();
+    if (job == NULL)
+        return NULL;
+
+    rga_job_reset(job, handle);
+
+    job->table_index = rga_job_table_insert(handle, job);
+    if (job->table_index < 0) {
+#ifdef RGA_JOB_STATIC_POOL
+        IM_LOGE("rga job table is full, table size = %d\n", RGA_JOB_TABLE_SIZE);
+        rga_job_pool_put(job);
+        return NULL;
+#else
+        pthread_mutex_lock(&g_im2d_job_manager.mutex);
+        rga_map_insert_job(&g_im2d_job_manager.overflow_map, handle, job);
+        atomic_fetch_add(&g_im2d_job_manager.overflow_count, 1);
+        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+#endif
+    }
+
+    atomic_fetch_add(&g_im2d_job_manager.job_count, 1);
+
+    return job;
+}
+
+im_rga_job_t *rga_job_find(im_job_handle_t handle) {
+    im_rga_job_t *job;
+
+    if (handle <= 0)
+        return NULL;
+
+    job = rga_job_table_find(handle);
+
+#ifndef RGA_JOB_STATIC_POOL
+    if (job == NULL && atomic_load(&g_im2d_job_manager.overflow_count) > 0) {
+        pthread_mutex_lock(&g_im2d_job_manager.mutex);
+        job = rga_map_find_job(&g_im2d_job_manager.overflow_map, handle);
+        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+    }
+#endif
+
+    return job;
+}
+
+/* Remove the job from the lookup, the job itself stays valid until rga_job_free(). */
+void rga_job_detach(im_rga_job_t *job) {
+    if (job->table_index >= 0) {
+        rga_job_table_delete(job->table_index);
+        job->table_index = -1;
+    } else {
+#ifndef RGA_JOB_STATIC_POOL
+        pthread_mutex_lock(&g_im2d_job_manager.mutex);
+        rga_map_delete_job(&g_im2d_job_manager.overflow_map, job->id);
+        atomic_fetch_sub(&g_im2d_job_manager.overflow_count, 1);
+        pthread_mutex_unlock(&g_im2d_job_manager.mutex);
+#endif
+    }
+
+    atomic_fetch_sub(&g_im2d_job_manager.job_count, 1);
+}
+
+void rga_job_free(im_rga_job_t *job) {
+    if (job == NULL)
+        return;
+
+    job->id = 0;
+    job->task_count = 0;
+
+    rga_import_cache_put(job->import_slots);
+    job->import_slots = 0;
+
+    rga_job_pool_put(job);
+}
+
+/* The job keeps one reference per slot until it is freed. */
+void rga_job_add_import_slots(im_rga_job_t *job, uint64_t slots) {
+    rga_import_cache_put(slots & job->import_slots);
+    job->import_slots |= slots;
+}
+
+int rga_job_add_task(im_rga_job_t *job, const struct rga_req *req) {
+    if (job->task_count >= job->task_capacity) {
+#ifdef RGA_JOB_STATIC_POOL
+        IM_LOGE("job[%d] add task failed! too many tasks, count = %d\n", job->id, job->task_count);
+        return IM_STATUS_ILLEGAL_PARAM;
+#else
+        int capacity;
+        struct rga_req *task_array;
+
+        if (job->task_capacity >= RGA_TASK_NUM_MAX) {
+            IM_LOGE("job[%d] add task failed! too many tasks, count = %d\n", job->id, job->task_count);
+            return IM_STATUS_ILLEGAL_PARAM;
+        }
+
+        capacity = job->task_capacity + RGA_JOB_TASK_CHUNK;
+        if (capacity > RGA_TASK_NUM_MAX)
+            capacity = RGA_TASK_NUM_MAX;
+
+        if (job->req == job->inline_req) {
+            task_array = (struct rga_req *)malloc(capacity * sizeof(struct rga_req));
+            if (task_array != NULL)
+                memcpy(task_array, job->inline_req, job->task_count * sizeof(struct rga_req));
+        } else {
+            task_array = (struct rga_req *)realloc(job->req, capacity * sizeof(struct rga_req));
+        }
+
+        if (task_array == NULL) {
+            IM_LOGE("job[%d] add task failed! alloc task array[%d] failed\n", job->id, capacity);
+            return IM_STATUS_OUT_OF_MEMORY;
+        }
+
+        job->req = task_array;
+        job->task_capacity = capacity;
+#endif
+    }
+
+    job->req[job->task_count] = *req;
+    job->task_count++;
+
+    return IM_STATUS_SUCCESS;
+}
+
+int rga_job_get_count(void) {
+    return atomic_load(&g_im2d_job_manager.job_count);
+}
+
 __attribute__((constructor)) static void rga_job_manager_init() {
     if (pthread_mutex_init(&g_im2d_job_manager.mutex, NULL) != 0) {
         IM_LOGE("im2d job manager init mutex_lock failed!\n");
         return;
     }
 
-#if !IM2D_JOB_USE_MAP
-    rga_map_list_init(&g_im2d_job_manager.job_map);
+#if !IM2D_JOB_USE_MAP && !defined(RGA_JOB_STATIC_POOL)
+    rga_map_list_init(&g_im2d_job_manager.overflow_map);
 #endif
-
-    g_im2d_job_manager.job_count = 0;
 }
 
 __attribute__((destructor)) static void rga_job_manager_destroy() {
-    pthread_mutex_destroy(&g_im2d_job_manager.mutex);
+#ifndef RGA_JOB_STATIC_POOL
+    im_rga_job_t *job;
+
+    while (g_im2d_job_manager.pool_head != NULL) {
+        job = g_im2d_job_manager.pool_head;
+        g_im2d_job_manager.pool_head = job->pool_next;
+
+        if (job->req != job->inline_req)
+            free(job->req);
+        free(job);
+    }
+    g_im2d_job_manager.pool_count = 0;
+
 #if !IM2D_JOB_USE_MAP
-    rga_map_list_deatroy(&g_im2d_job_manager.job_map);
+    rga_map_list_deatroy(&g_im2d_job_manager.overflow_map);
 #endif
+#endif
+
+    pthread_mutex_destroy(&g_im2d_job_manager.mutex);
 }
@@ -31,12 +31,62 @@
 #define IM2D_JOB_USE_MAP false
 #endif
 
-typedef struct im_rga_job {
-    struct rga_req req[RGA_TASK_NUM_MAX];
+/*
+ * Jobs are recycled through a pool instead of being allocated per
+ * imbeginJob(). The task array starts with a small inline capacity and grows
+ * in chunks up to RGA_TASK_NUM_MAX.
+ *
+ * RGA_JOB_STATIC_POOL (default for RT-Thread) uses a fixed array of jobs with
+ * a fixed capacity of RGA_TASK_NUM_MAX tasks, without any malloc.
+ *
+ * RGA_JOB_TABLE_SIZE is the number of live jobs that can be looked up without
+ * a lock, it must be a power of 2.
+ */
+#ifdef RT_THREAD
+#define RGA_JOB_STATIC_POOL
+#endif
+
+#ifdef RGA_JOB_STATIC_POOL
+/*
+ * The max number of live jobs, from imbeginJob() (or the internal array,
+ * deferred, tile and stripe submits) to imendJob()/imcancelJob(). One more
+ * imbeginJob() fails with IM_STATUS_OUT_OF_MEMORY. Each job costs
+ * RGA_TASK_NUM_MAX * sizeof(struct rga_req) bytes of .bss, 256 * 504 bytes
+ * (126 KiB) on a 64 bit build, about 504 KiB for the default of 4.
+ */
+#ifndef RGA_JOB_POOL_SIZE
+#define RGA_JOB_POOL_SIZE           4
+#endif
+/* the array submit, deferred batches and tiles fill jobs up to RGA_TASK_NUM_MAX */
+#define RGA_JOB_INLINE_TASK_NUM     RGA_TASK_NUM_MAX
+#ifndef RGA_JOB_TABLE_SIZE
+#define RGA_JOB_TABLE_SIZE          16
+#endif
+#else
+#define RGA_JOB_POOL_SIZE           8       /* idle jobs kept for reuse */
+#define RGA_JOB_INLINE_TASK_NUM     4
+#define RGA_JOB_TASK_CHUNK          32
+#define RGA_JOB_TABLE_SIZE          256
+#endif
+
+typedef struct im_rga_job im_rga_job_t;
+
+struct im_rga_job {
+    struct rga_req *req;
     int task_count;
+    int task_capacity;
 
     int id;
-} im_rga_job_t;
+    int table_index;            /* -1: in the overflow map */
+
+    uint64_t import_slots;      /* import cache slots referenced by the tasks */
+
+#ifndef RGA_JOB_STATIC_POOL
+    im_rga_job_t *pool_next;
+#endif
+
+    struct rga_req inline_req[RGA_JOB_INLINE_TASK_NUM];
+};
 
 #if IM2D_JOB_USE_MAP
 #include <map>
@@ -65,17 +115,20 @@ typedef struct rga_map_list {
 typedef rga_map_list_t rga_job_map_t;
 #endif
 
-struct im2d_job_manager {
-    rga_job_map_t job_map;
-    int job_count;
-
-    pthread_mutex_t mutex;
-};
-
 void rga_map_insert_job(rga_job_map_t *job_map, im_job_handle_t handle, im_rga_job_t *job);
 void rga_map_delete_job(rga_job_map_t *job_map, im_job_handle_t handle);
 im_rga_job_t *rga_map_find_job(rga_job_map_t *job_map, im_job_handle_t handle);
 
-extern struct im2d_job_manager g_im2d_job_manager;
+/*
+ * Job lookup and task append are lock-free, the same job must not be
+ * modified by several threads at the same time.
+ */
+im_rga_job_t *rga_job_alloc(im_job_handle_t handle);
+im_rga_job_t *rga_job_find(im_job_handle_t handle);
+void rga_job_detach(im_rga_job_t *job);
+void rga_job_free(im_rga_job_t *job);
+void rga_job_add_import_slots(im_rga_job_t *job, uint64_t slots);
+int rga_job_add_task(im_rga_job_t *job, const struct rga_req *req);
+int rga_job_get_count(void);
 
 #endif /* #ifndef _RGA_IM2D_JOB_H_ */
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_scheduler"
+#else
+#define LOG_TAG "im2d_scheduler"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__linux__) && !defined(RGA_SYNC_DISABLE)
+#define RGA_SCHEDULER_ENABLE
+#endif
+
+#ifdef RGA_SCHEDULER_ENABLE
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_context.h"
+#include "im2d_impl.h"
+
+#include "RgaUtils.h"
+#include "utils.h"
+
+extern RGA_THREAD_LOCAL im_context_t g_im2d_context;
+
+/*
+ * Adaptive scheduler: single tasks that are not pinned to a core are given
+ * to the least loaded core that can run them. The load of a core is the
+ * estimated number of bytes moved by its tasks in flight, divided by the
+ * performance of the core in the hardware info table.
+ *
+ * A task is in flight until its release fence is signaled, the fences are
+ * polled (without waiting) each time a core is selected, so no thread is
+ * needed. A sync task is in flight until the ioctl returns.
+ *
+ * The load is shared by all the threads of the process, the cores to choose
+ * from are set per thread by IM_CONFIG_ADAPTIVE_SCHEDULER.
+ */
+#define RGA_SCHEDULER_CORE_NUM      4       /* bits of IM_SCHEDULER_MASK */
+
+#ifdef RGA_SCHEDULER_ENABLE
+#define RGA_SCHEDULER_PENDING_MAX   32      /* release fences tracked per core */
+
+typedef struct rga_scheduler_pending {
+    int fence_fd;
+    uint64_t bytes;
+} rga_scheduler_pending_t;
+
+typedef struct rga_scheduler_core {
+    uint64_t task_count;
+    uint64_t bytes;
+    uint64_t unsupported_count;
+
+    uint64_t inflight_bytes;
+    int inflight_count;
+
+    /* oldest first */
+    int pending_count;
+    rga_scheduler_pending_t pending[RGA_SCHEDULER_PENDING_MAX];
+} rga_scheduler_core_t;
+
+typedef struct rga_scheduler {
+    pthread_mutex_t mutex;
+    rga_scheduler_core_t core[RGA_SCHEDULER_CORE_NUM];
+} rga_scheduler_t;
+
+static rga_scheduler_t g_scheduler = { PTHREAD_MUTEX_INITIALIZER, {} };
+
+static int rga_scheduler_get_index(uint32_t core) {
+    return __builtin_ctz(core);
+}
+
+static void rga_scheduler_retire(rga_scheduler_core_t *core, int index) {
+    close(core->pending[index].fence_fd);
+
+    core->inflight_bytes -= core->pending[index].bytes;
+    core->inflight_count--;
+
+    core->pending_count--;
+    memmove(&core->pending[index], &core->pending[index + 1],
+            (core->pending_count - index) * sizeof(core->pending[0]));
+}
+
+/* Retire the tasks whose release fence is signaled, the caller holds the lock. */
+static void rga_scheduler_update_locked(void) {
+    struct pollfd pfds[RGA_SCHEDULER_PENDING_MAX];
+    rga_scheduler_core_t *core;
+    int count;
+
+    for (int i = 0; i < RGA_SCHEDULER_CORE_NUM; i++) {
+        core = &g_scheduler.core[i];
+        if (core->pending_count <= 0)
+            continue;
+
+        count = core->pending_count;
+        for (int j = 0; j < count; j++) {
+            pfds[j].fd = core->pending[j].fence_fd;
+            pfds[j].events = POLLIN;
+            pfds[j].revents = 0;
+        }
+
+        if (poll(pfds, count, 0) <= 0)
+            continue;
+
+        /* a fence in error is not going to signal, retire it as well */
+        for (int j = count - 1; j >= 0; j--) {
+            if (pfds[j].revents != 0)
+                rga_scheduler_retire(core, j);
+        }
+    }
+}
+
+static uint64_t rga_scheduler_get_image_bytes(const rga_buffer_t *image, const im_rect *rect) {
+    int width = image->width, height = image->height;
+
+    if (rect->width > 0 && rect->height > 0) {
+        width = rect->width;
+        height = rect->height;
+    }
+
+    return (uint64_t)((double)width * height * get_bpp_from_format(convert_to_rga_format(image->format)));
+}
+
+/* The bytes read and written by the task. */
+static uint64_t rga_scheduler_get_task_bytes(const rga_buffer_t *src, const rga_buffer_t *dst,
+                                             const rga_buffer_t *pat,
+                                             const im_rect *srect, const im_rect *drect,
+                                             const im_rect *prect, int usage) {
+    uint64_t bytes;
+
+    bytes = rga_scheduler_get_image_bytes(dst, drect);
+
+    if (~usage & IM_COLOR_FILL)
+        bytes += rga_scheduler_get_image_bytes(src, srect);
+
+    if (usage & IM_ALPHA_BLEND_MASK) {
+        if (rga_is_buffer_valid(*pat))
+            bytes += rga_scheduler_get_image_bytes(pat, prect);
+        else
+            bytes += rga_scheduler_get_image_bytes(dst, drect);
+    }
+
+    return bytes;
+}
+
+/*
+ * Select the core of a single task and count it in flight.
+ *
+ * @returns the selected core, or IM_SCHEDULER_DEFAULT to leave the choice to
+ *          the driver, in which case rga_scheduler_done() is not needed.
+ */
+IM_SCHEDULER_CORE rga_scheduler_select(rga_session_t *session,
+                                       rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                       im_rect srect, im_rect drect, im_rect prect,
+                                       im_opt_t *opt_ptr, int usage, uint64_t *bytes) {
+    rga_core_info_t cores[RGA_SCHEDULER_CORE_NUM];
+    int core_count, selected = -1;
+    uint32_t core_mask;
+    uint64_t load, selected_load = 0;
+    rga_scheduler_core_t *core;
+
+    if (g_im2d_context.adaptive_core == 0 ||
+        session->driver_type != RGA_DRIVER_IOC_MULTI_RGA)
+        return IM_SCHEDULER_DEFAULT;
+
+    /* pinned by the caller */
+    if (g_im2d_context.core != IM_SCHEDULER_DEFAULT)
+        return IM_SCHEDULER_DEFAULT;
+
+    if (rga_get_opt_core(opt_ptr) != IM_SCHEDULER_DEFAULT)
+        return IM_SCHEDULER_DEFAULT;
+
+    core_count = rga_get_core_info(session, g_im2d_context.adaptive_core, cores, RGA_SCHEDULER_CORE_NUM);
+    if (core_count == 0)
+        return IM_SCHEDULER_DEFAULT;
+
+    core_mask = rga_check_core_mask(session, cores, core_count, src, dst, pat, srect, drect, prect, usage);
+
+    *bytes = rga_scheduler_get_task_bytes(&src, &dst, &pat, &srect, &drect, &prect, usage);
+
+    pthread_mutex_lock(&g_scheduler.mutex);
+
+    rga_scheduler_update_locked();
+
+    for (int i = 0; i < core_count; i++) {
+        core = &g_scheduler.core[rga_scheduler_get_index(cores[i].core)];
+
+        if (!(cores[i].core & core_mask)) {
+            core->unsupported_count++;
+            continue;
+        }
+
+        load = core->inflight_bytes / (cores[i].info.performance > 0 ? cores[i].info.performance : 1);
+        if (selected < 0 || load < selected_load) {
+            selected = i;
+            selected_load = load;
+        }
+    }
+
+    if (selected >= 0) {
+        core = &g_scheduler.core[rga_scheduler_get_index(cores[selected].core)];
+        core->task_count++;
+        core->bytes += *bytes;
+        core->inflight_bytes += *bytes;
+        core->inflight_count++;
+    }
+
+    pthread_mutex_unlock(&g_scheduler.mutex);
+
+    if (selected < 0) {
+        IM_LOGD("none of the cores[0x%x] can run the task, left to the driver.\n",
+                g_im2d_context.adaptive_core);
+        return IM_SCHEDULER_DEFAULT;
+    }
+
+    IM_LOGD("select core[0x%x], load = %llu bytes\n",
+            cores[selected].core, (unsigned long long)selected_load);
+
+    return cores[selected].core;
+}
+
+/*
+ * The task given to core was submitted with status. An async task stays in
+ * flight until release_fence_fd is signaled, the fence is not consumed.
+ */
+void rga_scheduler_done(IM_SCHEDULER_CORE core_id, uint64_t bytes, IM_STATUS status, int release_fence_fd) {
+    rga_scheduler_core_t *core;
+    int fence_fd = -1;
+
+    if (core_id == IM_SCHEDULER_DEFAULT)
+        return;
+
+    if (status == IM_STATUS_SUCCESS && release_fence_fd >= 0)
+        fence_fd = fcntl(release_fence_fd, F_DUPFD_CLOEXEC, 0);
+
+    core = &g_scheduler.core[rga_scheduler_get_index(core_id)];
+
+    pthread_mutex_lock(&g_scheduler.mutex);
+
+    if (status != IM_STATUS_SUCCESS) {
+        core->task_count--;
+        core->bytes -= bytes;
+    }
+
+    if (fence_fd >= 0) {
+        /* the oldest task is most likely done */
+        if (core->pending_count == RGA_SCHEDULER_PENDING_MAX)
+            rga_scheduler_retire(core, 0);
+
+        core->pending[core->pending_count].fence_fd = fence_fd;
+        core->pending[core->pending_count].bytes = bytes;
+        core->pending_count++;
+    } else {
+        core->inflight_bytes -= bytes;
+        core->inflight_count--;
+    }
+
+    pthread_mutex_unlock(&g_scheduler.mutex);
+}
+
+IM_STATUS rga_scheduler_config(im_context_t *context, uint32_t core_mask) {
+    context->adaptive_core = core_mask;
+
+    return IM_STATUS_SUCCESS;
+}
+
+IM_STATUS rga_scheduler_get_stat(im_scheduler_stat_t *stats, int *count) {
+    rga_scheduler_core_t *core;
+    int stat_count;
+
+    if (stats == NULL || count == NULL || *count <= 0) {
+        IM_LOGE("illegal stats[%p], count[%p]\n", stats, count);
+        return IM_STATUS_INVALID_PARAM;
+    }
+
+    stat_count = *count < RGA_SCHEDULER_CORE_NUM ? *count : RGA_SCHEDULER_CORE_NUM;
+
+    pthread_mutex_lock(&g_scheduler.mutex);
+
+    rga_scheduler_update_locked();
+
+    for (int i = 0; i < stat_count; i++) {
+        core = &g_scheduler.core[i];
+
+        stats[i].core = (IM_SCHEDULER_CORE)(1 << i);
+        stats[i].task_count = core->task_count;
+        stats[i].bytes = core->bytes;
+        stats[i].unsupported_count = core->unsupported_count;
+        stats[i].inflight_bytes = core->inflight_bytes;
+        stats[i].inflight_count = core->inflight_count;
+    }
+
+    pthread_mutex_unlock(&g_scheduler.mutex);
+
+    *count = stat_count;
+
+    return IM_STATUS_SUCCESS;
+}
+#else
+IM_SCHEDULER_CORE rga_scheduler_select(rga_session_t *session,
+                                       rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                       im_rect srect, im_rect drect, im_rect prect,
+                                       im_opt_t *opt_ptr, int usage, uint64_t *bytes) {
+    (void)session;
+    (void)opt_ptr;
+    (void)usage;
+    (void)bytes;
+
+    return IM_SCHEDULER_DEFAULT;
+}
+
+void rga_scheduler_done(IM_SCHEDULER_CORE core_id, uint64_t bytes, IM_STATUS status, int release_fence_fd) {
+    (void)core_id;
+    (void)bytes;
+    (void)status;
+    (void)release_fence_fd;
+}
+
+IM_STATUS rga_scheduler_config(im_context_t *context, uint32_t core_mask) {
+    (void)context;
+    (void)core_mask;
+
+    IM_LOGE("adaptive scheduler is not supported on this platform.\n");
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+IM_STATUS rga_scheduler_get_stat(im_scheduler_stat_t *stats, int *count) {
+    (void)stats;
+    (void)count;
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+#endif /* #ifdef RGA_SCHEDULER_ENABLE */
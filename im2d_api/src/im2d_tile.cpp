@@ -0,0 +1,724 @@
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ * Authors:
+ *  Cerf Yu <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#define LOG_TAG "im2d_tile"
+#else
+#define LOG_TAG "im2d_tile"
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "im2d.h"
+#include "im2d_log.h"
+#include "im2d_context.h"
+#include "im2d_impl.h"
+
+#include "utils.h"
+
+extern RGA_THREAD_LOCAL im_context_t g_im2d_context;
+
+/*
+ * Operations larger than the hardware input/output resolution are split into
+ * tiles that fit, and all the tiles are submitted as one job.
+ *
+ * The tile boundaries are put on the lattice of the scale ratio, where both
+ * the src and the dst coordinates are integers. Each tile then has exactly
+ * the ratio of the whole operation and starts with the same phase, so copy,
+ * cvtcolor, rotate/flip, blend and bilinear/average downscaling produce the
+ * same pixels as an untiled operation. The hardware clamps the filter taps at
+ * the edge of each task's src rect, and rga_req has no phase field to let a
+ * task read a source overlap without changing its ratio, so bicubic and
+ * upscaling may differ in the pixels whose taps straddle a seam. When the
+ * lattice is too coarse for the limits, the tiles are split proportionally
+ * and the phase changes at the seams. Both cases fail with
+ * IM_STATUS_NOT_SUPPORTED unless the thread accepts them with
+ * IM_CONFIG_TILE_INEXACT, then they are reported as warnings.
+ */
+#define RGA_TILE_AXIS_MAX           64
+#define RGA_TILE_GEOMETRY_MAX       UINT16_MAX      /* rga_img_info_t vir_w/vir_h/x_offset/y_offset */
+
+#define RGA_TILE_USAGE_MASK         (IM_HAL_TRANSFORM_MASK | IM_ALPHA_BLEND_MASK | IM_SYNC | IM_ASYNC)
+
+typedef struct rga_tile_axis {
+    int count;
+    bool exact;
+
+    /* boundaries of the tiles, in increasing order on both sides */
+    int dst[RGA_TILE_AXIS_MAX + 1];
+    int src[RGA_TILE_AXIS_MAX + 1];
+} rga_tile_axis_t;
+
+typedef struct rga_tile_plan {
+    im_rect srect;
+    im_rect drect;
+    im_rect prect;
+    bool pat_enable;
+
+    bool swap;              /* dst x runs along src y (ROT_90/ROT_270) */
+    bool reverse_x;         /* dst x runs against its src axis */
+    bool reverse_y;
+
+    rga_tile_axis_t x;      /* along the dst x axis */
+    rga_tile_axis_t y;      /* along the dst y axis */
+} rga_tile_plan_t;
+
+static int rga_tile_gcd(int a, int b) {
+    int t;
+
+    while (b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/*
+ * The smallest step (a lattice unit) where both the src and the dst
+ * coordinates are integers and aligned.
+ *
+ * @returns the number of whole units in the axis.
+ */
+static int rga_tile_get_lattice(int src_len, int dst_len, int src_align, int dst_align,
+                                int *unit_src, int *unit_dst) {
+    int g, k;
+
+    g = rga_tile_gcd(src_len, dst_len);
+    for (k = 1; ((src_len / g) * k) % src_align || ((dst_len / g) * k) % dst_align; k++);
+
+    *unit_src = (src_len / g) * k;
+    *unit_dst = (dst_len / g) * k;
+
+    return g / k;
+}
+
+static void rga_tile_normalize_rect(im_rect *rect, const rga_buffer_t *image) {
+    if (rect->width <= 0 || rect->height <= 0) {
+        rect->x = 0;
+        rect->y = 0;
+        rect->width = image->width;
+        rect->height = image->height;
+    }
+}
+
+static int rga_tile_format_align(const rga_buffer_t *image) {
+    return is_yuv_format(convert_to_rga_format(image->format)) ? 2 : 1;
+}
+
+static bool rga_tile_is_proportional_valid(const rga_tile_axis_t *axis, int count,
+                                           int src_max, int dst_max) {
+    int src_len, dst_len;
+
+    for (int i = 0; i < count; i++) {
+        src_len = axis->src[i + 1] - axis->src[i];
+        dst_len = axis->dst[i + 1] - axis->dst[i];
+
+        if (src_len < 2 || dst_len < 2 || src_len > src_max || dst_len > dst_max)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Split src_len onto dst_len so that every tile fits src_max/dst_max, the
+ * boundaries are multiples of src_align/dst_align.
+ */
+static IM_STATUS rga_tile_split_axis(rga_tile_axis_t *axis, int src_len, int dst_len,
+                                     int src_max, int dst_max, int src_align, int dst_align) {
+    int unit_src, unit_dst, units, unit_count, count;
+
+    if (src_len <= src_max && dst_len <= dst_max) {
+        axis->count = 1;
+        axis->exact = true;
+        axis->src[0] = 0;
+        axis->src[1] = src_len;
+        axis->dst[0] = 0;
+        axis->dst[1] = dst_len;
+
+        return IM_STATUS_SUCCESS;
+    }
+
+    unit_count = rga_tile_get_lattice(src_len, dst_len, src_align, dst_align, &unit_src, &unit_dst);
+
+    units = src_max / unit_src;
+    if (dst_max / unit_dst < units)
+        units = dst_max / unit_dst;
+
+    if (units > 0) {
+        /* balance the lattice units between the tiles, the rest goes to the last one */
+        count = (unit_count + units - 1) / units;
+        if (count > RGA_TILE_AXIS_MAX)
+            return IM_STATUS_NOT_SUPPORTED;
+
+        for (int i = 0; i < count; i++) {
+            axis->src[i] = (int)((int64_t)unit_count * i / count) * unit_src;
+            axis->dst[i] = (int)((int64_t)unit_count * i / count) * unit_dst;
+        }
+        axis->src[count] = src_len;
+        axis->dst[count] = dst_len;
+
+        /* the rest of an odd lattice may push the last tile over the limits */
+        if (axis->src[count] - axis->src[count - 1] <= src_max &&
+            axis->dst[count] - axis->dst[count - 1] <= dst_max) {
+            axis->count = count;
+            axis->exact = true;
+
+            return IM_STATUS_SUCCESS;
+        }
+    }
+
+    count = (dst_len + dst_max - 1) / dst_max;
+    if ((src_len + src_max - 1) / src_max > count)
+        count = (src_len + src_max - 1) / src_max;
+
+    for (; count <= RGA_TILE_AXIS_MAX; count++) {
+        for (int i = 0; i < count; i++) {
+            axis->dst[i] = (int)((int64_t)dst_len * i / count) / dst_align * dst_align;
+            axis->src[i] = (int)((int64_t)axis->dst[i] * src_len / dst_len) / src_align * src_align;
+        }
+        axis->src[count] = src_len;
+        axis->dst[count] = dst_len;
+
+        if (rga_tile_is_proportional_valid(axis, count, src_max, dst_max)) {
+            axis->count = count;
+            axis->exact = false;
+
+            return IM_STATUS_SUCCESS;
+        }
+    }
+
+    return IM_STATUS_NOT_SUPPORTED;
+}
+
+/*
+ * Whether the seams of an axis produce the same pixels as an untiled
+ * operation, see above.
+ */
+static bool rga_tile_axis_is_seamless(const rga_tile_axis_t *axis, int src_len, int dst_len,
+                                      bool cubic) {
+    if (axis->count == 1)
+        return true;
+
+    if (!axis->exact)
+        return false;
+
+    if (src_len == dst_len)
+        return true;
+
+    return src_len > dst_len && !cubic;
+}
+
+static bool rga_tile_interp_is_cubic(const im_opt_t *opt) {
+    int interp;
+
+    if (opt == NULL)
+        return false;
+
+    interp = opt->interp;
+    if (interp & (IM_INTERP_HORIZ_FLAG | IM_INTERP_VERTI_FLAG))
+        return ((interp >> IM_INTERP_HORIZ_SHIFT) & IM_INTERP_MASK) == IM_INTERP_CUBIC ||
+               ((interp >> IM_INTERP_VERTI_SHIFT) & IM_INTERP_MASK) == IM_INTERP_CUBIC;
+
+    return (interp & IM_INTERP_MASK) == IM_INTERP_CUBIC;
+}
+
+static IM_STATUS rga_tile_set_transform(rga_tile_plan_t *plan, int usage) {
+    int rotate = usage & IM_HAL_TRANSFORM_ROT_MASK;
+    int flip = usage & IM_HAL_TRANSFORM_FLIP_MASK;
+
+    plan->swap = false;
+    plan->reverse_x = false;
+    plan->reverse_y = false;
+
+    /* the order of a rotation combined with a flip is up to the hardware */
+    if (rotate && flip)
+        return IM_STATUS_NOT_SUPPORTED;
+
+    switch (rotate) {
+        case IM_HAL_TRANSFORM_ROT_90:
+            plan->swap = true;
+            plan->reverse_x = true;
+            break;
+        case IM_HAL_TRANSFORM_ROT_180:
+            plan->reverse_x = true;
+            plan->reverse_y = true;
+            break;
+        case IM_HAL_TRANSFORM_ROT_270:
+            plan->swap = true;
+            plan->reverse_y = true;
+            break;
+        case 0:
+            break;
+        default:
+            return IM_STATUS_NOT_SUPPORTED;
+    }
+
+    switch (flip) {
+        case IM_HAL_TRANSFORM_FLIP_H:
+            plan->reverse_x = true;
+            break;
+        case IM_HAL_TRANSFORM_FLIP_V:
+            plan->reverse_y = true;
+            break;
+        case IM_HAL_TRANSFORM_FLIP_H_V:
+            plan->reverse_x = true;
+            plan->reverse_y = true;
+            break;
+        case 0:
+            break;
+        default:
+            return IM_STATUS_NOT_SUPPORTED;
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+static bool rga_tile_is_geometry_valid(const char *name, const rga_buffer_t *image) {
+    if (image->wstride > RGA_TILE_GEOMETRY_MAX || image->hstride > RGA_TILE_GEOMETRY_MAX) {
+        IM_LOGE("%s wstride/hstride [%d, %d] is beyond the %d limit of the request, cannot be tiled.\n",
+                name, image->wstride, image->hstride, RGA_TILE_GEOMETRY_MAX);
+        return false;
+    }
+
+    return true;
+}
+
+static void rga_tile_get_rect(void *data, int index, im_rect *srect, im_rect *drect, im_rect *prect) {
+    rga_tile_plan_t *plan = (rga_tile_plan_t *)data;
+    int ix = index % plan->x.count;
+    int iy = index / plan->x.count;
+    int dx0, dx1, dy0, dy1;
+    int sx0, sx1, sy0, sy1;
+
+    dx0 = plan->x.dst[ix];
+    dx1 = plan->x.dst[ix + 1];
+    if (plan->reverse_x) {
+        dx0 = plan->drect.width - plan->x.dst[ix + 1];
+        dx1 = plan->drect.width - plan->x.dst[ix];
+    }
+
+    dy0 = plan->y.dst[iy];
+    dy1 = plan->y.dst[iy + 1];
+    if (plan->reverse_y) {
+        dy0 = plan->drect.height - plan->y.dst[iy + 1];
+        dy1 = plan->drect.height - plan->y.dst[iy];
+    }
+
+    /* the src range of each dst axis, on the src axis it runs along */
+    sx0 = plan->x.src[ix];
+    sx1 = plan->x.src[ix + 1];
+    sy0 = plan->y.src[iy];
+    sy1 = plan->y.src[iy + 1];
+
+    if (plan->swap) {
+        srect->x = plan->srect.x + sy0;
+        srect->y = plan->srect.y + sx0;
+        srect->width = sy1 - sy0;
+        srect->height = sx1 - sx0;
+    } else {
+        srect->x = plan->srect.x + sx0;
+        srect->y = plan->srect.y + sy0;
+        srect->width = sx1 - sx0;
+        srect->height = sy1 - sy0;
+    }
+
+    drect->x = plan->drect.x + dx0;
+    drect->y = plan->drect.y + dy0;
+    drect->width = dx1 - dx0;
+    drect->height = dy1 - dy0;
+
+    if (plan->pat_enable) {
+        prect->x = plan->prect.x + dx0;
+        prect->y = plan->prect.y + dy0;
+        prect->width = dx1 - dx0;
+        prect->height = dy1 - dy0;
+    } else {
+        memset(prect, 0x0, sizeof(*prect));
+    }
+}
+
+/*
+ * Only copy/resize/cvtcolor/rotate/flip/blend of raster images are tiled,
+ * anything else keeps failing in the usual checks.
+ */
+bool rga_tile_is_required(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                          im_rect srect, im_rect drect, im_rect prect, int usage) {
+    rga_session_t *session;
+    rga_info_resolution_t *input, *output;
+
+    if (usage & ~RGA_TILE_USAGE_MASK)
+        return false;
+
+    if (!rga_is_buffer_valid(src) || !rga_is_buffer_valid(dst))
+        return false;
+
+    if ((src.rd_mode && src.rd_mode != IM_RASTER_MODE) ||
+        (dst.rd_mode && dst.rd_mode != IM_RASTER_MODE))
+        return false;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return false;
+
+    input = &session->hardware_info.input_resolution;
+    output = &session->hardware_info.output_resolution;
+    if (input->width <= 0 || output->width <= 0)
+        return false;
+
+    rga_tile_normalize_rect(&srect, &src);
+    rga_tile_normalize_rect(&drect, &dst);
+
+    if (srect.width > input->width || srect.height > input->height ||
+        drect.width > output->width || drect.height > output->height)
+        return true;
+
+    if ((usage & IM_ALPHA_BLEND_MASK) && rga_is_buffer_valid(pat)) {
+        rga_tile_normalize_rect(&prect, &pat);
+        if (prect.width > input->width || prect.height > input->height)
+            return true;
+    }
+
+    return false;
+}
+
+IM_STATUS rga_tile_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                          im_rect srect, im_rect drect, im_rect prect,
+                          int acquire_fence_fd, int *release_fence_fd,
+                          im_opt_t *opt_ptr, int usage) {
+    IM_STATUS ret;
+    rga_session_t *session;
+    rga_info_resolution_t *input, *output;
+    rga_tile_plan_t plan;
+    int src_max_x, src_max_y, dst_max_x, dst_max_y;
+    int src_align, dst_align;
+    bool cubic;
+
+    session = get_rga_session();
+    if (IS_ERR(session))
+        return (IM_STATUS)PTR_ERR(session);
+
+    input = &session->hardware_info.input_resolution;
+    output = &session->hardware_info.output_resolution;
+
+    memset(&plan, 0x0, sizeof(plan));
+
+    ret = rga_tile_set_transform(&plan, usage);
+    if (ret != IM_STATUS_SUCCESS) {
+        IM_LOGE("cannot tile rotate combined with flip, usage = 0x%x\n", usage);
+        return ret;
+    }
+
+    plan.pat_enable = (usage & IM_ALPHA_BLEND_MASK) && rga_is_buffer_valid(pat);
+
+    if (!rga_tile_is_geometry_valid("src", &src) ||
+        !rga_tile_is_geometry_valid("dst", &dst) ||
+        (plan.pat_enable && !rga_tile_is_geometry_valid("pat", &pat)))
+        return IM_STATUS_NOT_SUPPORTED;
+
+    rga_tile_normalize_rect(&srect, &src);
+    rga_tile_normalize_rect(&drect, &dst);
+    plan.srect = srect;
+    plan.drect = drect;
+
+    dst_max_x = output->width;
+    dst_max_y = output->height;
+    dst_align = rga_tile_format_align(&dst);
+
+    if (plan.pat_enable) {
+        rga_tile_normalize_rect(&prect, &pat);
+        if (prect.width != drect.width || prect.height != drect.height) {
+            IM_LOGE("cannot tile pat rect[w,h] = [%d, %d] that differs from dst rect[w,h] = [%d, %d]\n",
+                    prect.width, prect.height, drect.width, drect.height);
+            return IM_STATUS_NOT_SUPPORTED;
+        }
+        plan.prect = prect;
+
+        /* the pat tiles follow the dst tiles */
+        if (input->width < dst_max_x)
+            dst_max_x = input->width;
+        if (input->height < dst_max_y)
+            dst_max_y = input->height;
+        if (rga_tile_format_align(&pat) > dst_align)
+            dst_align = rga_tile_format_align(&pat);
+    }
+
+    src_max_x = plan.swap ? input->height : input->width;
+    src_max_y = plan.swap ? input->width : input->height;
+    src_align = rga_tile_format_align(&src);
+
+    ret = rga_tile_split_axis(&plan.x, plan.swap ? srect.height : srect.width, drect.width,
+                              src_max_x, dst_max_x, src_align, dst_align);
+    if (ret == IM_STATUS_SUCCESS)
+        ret = rga_tile_split_axis(&plan.y, plan.swap ? srect.width : srect.height, drect.height,
+                                  src_max_y, dst_max_y, src_align, dst_align);
+    if (ret != IM_STATUS_SUCCESS) {
+        IM_LOGE("cannot tile src rect[w,h] = [%d, %d] to dst rect[w,h] = [%d, %d] within %d tiles per axis\n",
+                srect.width, srect.height, drect.width, drect.height, RGA_TILE_AXIS_MAX);
+        return ret;
+    }
+
+    cubic = rga_tile_interp_is_cubic(opt_ptr);
+    if (!rga_tile_axis_is_seamless(&plan.x, plan.swap ? srect.height : srect.width, drect.width, cubic) ||
+        !rga_tile_axis_is_seamless(&plan.y, plan.swap ? srect.width : srect.height, drect.height, cubic)) {
+        if (!g_im2d_context.tile_inexact) {
+            IM_LOGE("cannot tile src rect[w,h] = [%d, %d] to dst rect[w,h] = [%d, %d] without seams, %s, "
+                    "enable IM_CONFIG_TILE_INEXACT to accept them.\n",
+                    srect.width, srect.height, drect.width, drect.height,
+                    plan.x.exact && plan.y.exact ? "the filter taps are clamped at the seams" :
+                                                   "the tiles are not on the scale lattice");
+            return IM_STATUS_NOT_SUPPORTED;
+        }
+
+        IM_LOGW("the tile seams of src rect[w,h] = [%d, %d] to dst rect[w,h] = [%d, %d] may differ from an untiled operation, %s.\n",
+                srect.width, srect.height, drect.width, drect.height,
+                plan.x.exact && plan.y.exact ? "the filter taps are clamped at the seams" :
+                                               "the tiles are not on the scale lattice");
+    }
+
+    IM_LOGD("tile src rect[w,h] = [%d, %d] to dst rect[w,h] = [%d, %d] in %dx%d tiles\n",
+            srect.width, srect.height, drect.width, drect.height, plan.x.count, plan.y.count);
+
+    return rga_task_array_submit(src, dst, pat, plan.x.count * plan.y.count, rga_tile_get_rect, &plan,
+                                 acquire_fence_fd, release_fence_fd, opt_ptr, usage);
+}
+
+/*
+ * Stripe split: a large task is divided into horizontal stripes of the dst,
+ * each stripe is a task pinned to one of the cores of the stripe_core mask,
+ * and all of them are submitted as one job, so the cores run in parallel and
+ * the job release fence covers the whole frame.
+ *
+ * The stripes are sized by the performance of each core in the hardware info
+ * table and put on the scale lattice, so the result is the same as an
+ * unsplit task. A core that cannot run its stripe (format, feature, scale or
+ * resolution) is left out.
+ */
+#define RGA_STRIPE_CORE_MAX         4
+#define RGA_STRIPE_HEIGHT_MIN       64      /* thinner stripes do not pay for the extra task */
+
+static bool rga_stripe_split(rga_tile_axis_t *axis, int src_len, int dst_len,
+                             int src_align, int dst_align,
+                             const rga_core_info_t *cores, int count) {
+    int unit_src, unit_dst, unit_count, units;
+    int weight_sum = 0, weight = 0;
+
+    if (count > RGA_TILE_AXIS_MAX)
+        return false;
+
+    unit_count = rga_tile_get_lattice(src_len, dst_len, src_align, dst_align, &unit_src, &unit_dst);
+
+    for (int i = 0; i < count; i++)
+        weight_sum += cores[i].info.performance > 0 ? cores[i].info.performance : 1;
+
+    axis->src[0] = 0;
+    axis->dst[0] = 0;
+    for (int i = 0; i < count; i++) {
+        weight += cores[i].info.performance > 0 ? cores[i].info.performance : 1;
+        units = (int)((int64_t)unit_count * weight / weight_sum);
+
+        axis->src[i + 1] = units * unit_src;
+        axis->dst[i + 1] = units * unit_dst;
+    }
+    axis->src[count] = src_len;
+    axis->dst[count] = dst_len;
+
+    for (int i = 0; i < count; i++) {
+        if (axis->dst[i + 1] - axis->dst[i] < RGA_STRIPE_HEIGHT_MIN ||
+            axis->src[i + 1] - axis->src[i] < 2)
+            return false;
+    }
+
+    axis->count = count;
+    axis->exact = true;
+
+    return true;
+}
+
+static void rga_stripe_remove_core(rga_core_info_t *cores, int *count, int index) {
+    for (int i = index; i < *count - 1; i++)
+        cores[i] = cores[i + 1];
+    (*count)--;
+}
+
+static int rga_stripe_get_slowest_core(const rga_core_info_t *cores, int count) {
+    int index = 0;
+
+    for (int i = 1; i < count; i++)
+        if (cores[i].info.performance < cores[index].info.performance)
+            index = i;
+
+    return index;
+}
+
+/*
+ * Split the task between the cores and submit the stripes as one job.
+ *
+ * @returns true if the task was split and submitted, ret is the result.
+ *          false if the cores cannot share it.
+ */
+static bool rga_stripe_plan_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                                   im_rect srect, im_rect drect, im_rect prect,
+                                   int acquire_fence_fd, int *release_fence_fd,
+                                   im_opt_t *opt_ptr, int usage,
+                                   rga_core_info_t *cores, int core_count, IM_STATUS *ret) {
+    rga_tile_plan_t plan = {};
+    im_opt_t opt = {};
+    int failed_index;
+    im_rect stripe_srect, stripe_drect, stripe_prect;
+    im_job_handle_t job_handle;
+    int sync_mode, task_usage;
+    int src_align, dst_align;
+
+    if (rga_tile_set_transform(&plan, usage) != IM_STATUS_SUCCESS)
+        return false;
+
+    rga_tile_normalize_rect(&srect, &src);
+    rga_tile_normalize_rect(&drect, &dst);
+    plan.srect = srect;
+    plan.drect = drect;
+
+    dst_align = rga_tile_format_align(&dst);
+    src_align = rga_tile_format_align(&src);
+
+    plan.pat_enable = (usage & IM_ALPHA_BLEND_MASK) && rga_is_buffer_valid(pat);
+    if (plan.pat_enable) {
+        rga_tile_normalize_rect(&prect, &pat);
+        if (prect.width != drect.width || prect.height != drect.height)
+            return false;
+        plan.prect = prect;
+
+        if (rga_tile_format_align(&pat) > dst_align)
+            dst_align = rga_tile_format_align(&pat);
+    }
+
+    plan.x.count = 1;
+    plan.x.exact = true;
+    plan.x.src[1] = plan.swap ? srect.height : srect.width;
+    plan.x.dst[1] = drect.width;
+
+    while (core_count >= 2) {
+        if (!rga_stripe_split(&plan.y, plan.swap ? srect.width : srect.height, drect.height,
+                              src_align, dst_align, cores, core_count)) {
+            rga_stripe_remove_core(cores, &core_count, rga_stripe_get_slowest_core(cores, core_count));
+            continue;
+        }
+
+        failed_index = -1;
+        for (int i = 0; i < core_count; i++) {
+            rga_tile_get_rect(&plan, i, &stripe_srect, &stripe_drect, &stripe_prect);
+            if (rga_check_core(&cores[i], src, dst, pat,
+                               stripe_srect, stripe_drect, stripe_prect, usage) != IM_STATUS_NOERROR) {
+                failed_index = i;
+                break;
+            }
+        }
+
+        if (failed_index < 0)
+            break;
+
+        IM_LOGD("core[0x%x] cannot run its stripe, left out of the split.\n", cores[failed_index].core);
+        rga_stripe_remove_core(cores, &core_count, failed_index);
+    }
+
+    if (core_count < 2)
+        return false;
+
+    /* keep the order with the tasks deferred before */
+    rga_deferred_kick();
+
+    job_handle = rga_job_create(0);
+    if ((int)job_handle <= 0) {
+        *ret = job_handle ? (IM_STATUS)(int)job_handle : IM_STATUS_FAILED;
+        return true;
+    }
+
+    rga_get_opt(&opt, opt_ptr);
+    task_usage = usage & ~(IM_SYNC | IM_ASYNC);
+    sync_mode = (usage & IM_ASYNC) ? IM_ASYNC : IM_SYNC;
+
+    for (int i = 0; i < core_count; i++) {
+        rga_tile_get_rect(&plan, i, &stripe_srect, &stripe_drect, &stripe_prect);
+        opt.core = cores[i].core;
+
+        IM_LOGD("stripe[%d] dst rect[x,y,w,h] = [%d, %d, %d, %d] on core[0x%x]\n", i,
+                stripe_drect.x, stripe_drect.y, stripe_drect.width, stripe_drect.height, opt.core);
+
+        *ret = rga_task_submit(job_handle, src, dst, pat, stripe_srect, stripe_drect, stripe_prect,
+                               -1, NULL, &opt, task_usage);
+        if (*ret != IM_STATUS_SUCCESS) {
+            rga_job_cancel(job_handle);
+            return true;
+        }
+    }
+
+    *ret = rga_job_submit(job_handle, sync_mode, acquire_fence_fd, release_fence_fd);
+
+    return true;
+}
+
+/*
+ * @returns true if the task was split and submitted, ret is the result.
+ *          false if the task is to be submitted as usual.
+ */
+bool rga_stripe_submit(rga_buffer_t src, rga_buffer_t dst, rga_buffer_t pat,
+                       im_rect srect, im_rect drect, im_rect prect,
+                       int acquire_fence_fd, int *release_fence_fd,
+                       im_opt_t *opt_ptr, int usage, IM_STATUS *ret) {
+    rga_session_t *session;
+    rga_core_info_t cores[RGA_STRIPE_CORE_MAX];
+    int core_count;
+
+    if (g_im2d_context.stripe_core == 0)
+        return false;
+
+    if (usage & ~RGA_TILE_USAGE_MASK)
+        return false;
+
+    if (!rga_is_buffer_valid(src) || !rga_is_buffer_valid(dst))
+        return false;
+
+    if ((src.rd_mode && src.rd_mode != IM_RASTER_MODE) ||
+        (dst.rd_mode && dst.rd_mode != IM_RASTER_MODE))
+        return false;
+
+    if ((usage & IM_ASYNC) && release_fence_fd == NULL)
+        return false;
+
+    session = get_rga_session();
+    if (IS_ERR(session) || session->driver_type != RGA_DRIVER_IOC_MULTI_RGA)
+        return false;
+
+    /* the caller pinned the task to a core */
+    if (rga_get_opt_core(opt_ptr) != IM_SCHEDULER_DEFAULT)
+        return false;
+
+    core_count = rga_get_core_info(session, g_im2d_context.stripe_core, cores, RGA_STRIPE_CORE_MAX);
+    if (core_count < 2)
+        return false;
+
+    return rga_stripe_plan_submit(src, dst, pat, srect, drect, prect,
+                                  acquire_fence_fd, release_fence_fd, opt_ptr, usage,
+                                  cores, core_count, ret);
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_allocator_frame_pool_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Check the frame pool on the memfd stand-in heap: acquire/return, the
+ * exhaustion of the pool, the rejected returns, and acquire/return from
+ * several threads at once. Run it with ROCKCHIP_RGA_BACKEND=cpu without a
+ * device.
+ */
+#define CHECK_WIDTH         640
+#define CHECK_HEIGHT        480
+#define CHECK_FORMAT        RK_FORMAT_RGBA_8888
+#define CHECK_FRAME_NUM     4
+#define CHECK_THREAD_NUM    8
+#define CHECK_THREAD_LOOP   20000
+
+static int g_failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s: check '%s' failed at line %d\n", LOG_TAG, #cond, __LINE__); \
+            __atomic_fetch_add(&g_failed, 1, __ATOMIC_RELAXED); \
+        } \
+    } while (0)
+
+typedef struct {
+    im_frame_pool_t *pool;
+    void *owners[CHECK_FRAME_NUM];
+    void *addrs[CHECK_FRAME_NUM];
+    int exhausted;
+} check_thread_arg_t;
+
+static int check_frame_index(check_thread_arg_t *arg, void *addr) {
+    for (int i = 0; i < CHECK_FRAME_NUM; i++) {
+        if (arg->addrs[i] == addr)
+            return i;
+    }
+
+    return -1;
+}
+
+/* no frame is held by two threads at once */
+static void *check_thread_func(void *data) {
+    check_thread_arg_t *arg = (check_thread_arg_t *)data;
+    rga_buffer_t frame;
+    void *expected;
+    int index, ret;
+
+    for (int i = 0; i < CHECK_THREAD_LOOP; i++) {
+        ret = imframePoolAcquire(arg->pool, &frame);
+        if (ret == IM_STATUS_OUT_OF_MEMORY) {
+            __atomic_fetch_add(&arg->exhausted, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        CHECK(ret == IM_STATUS_SUCCESS);
+        if (ret != IM_STATUS_SUCCESS)
+            continue;
+
+        index = check_frame_index(arg, frame.vir_addr);
+        CHECK(index >= 0);
+        if (index < 0)
+            continue;
+
+        expected = NULL;
+        CHECK(__atomic_compare_exchange_n(&arg->owners[index], &expected, (void *)&frame, false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+        /* hold the frame while the other threads run */
+        sched_yield();
+        expected = (void *)&frame;
+        CHECK(__atomic_compare_exchange_n(&arg->owners[index], &expected, NULL, false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+        CHECK(imframePoolReturn(arg->pool, &frame) == IM_STATUS_SUCCESS);
+    }
+
+    return NULL;
+}
+
+int main() {
+    im_frame_pool_param_t param;
+    im_frame_pool_t *pool;
+    rga_buffer_t frames[CHECK_FRAME_NUM], extra, foreign;
+    check_thread_arg_t thread_arg;
+    pthread_t tid[CHECK_THREAD_NUM];
+    char *foreign_buf;
+    uint32_t pixel;
+    int ret;
+
+    memset(&param, 0, sizeof(param));
+    param.width = CHECK_WIDTH;
+    param.height = CHECK_HEIGHT;
+    param.format = CHECK_FORMAT;
+    param.count = CHECK_FRAME_NUM;
+    param.heap = IM_FRAME_POOL_HEAP_MEMFD;
+
+    pool = imframePoolCreate(&param);
+    if (pool == NULL) {
+        printf("%s: imframePoolCreate failed, %s\n", LOG_TAG, imStrError());
+        return -1;
+    }
+
+    /* every frame once, with its own handle and mapping */
+    for (int i = 0; i < CHECK_FRAME_NUM; i++) {
+        CHECK(imframePoolAcquire(pool, &frames[i]) == IM_STATUS_SUCCESS);
+        CHECK(frames[i].handle > 0);
+        CHECK(frames[i].vir_addr != NULL);
+        CHECK(frames[i].fd == -1);
+        CHECK(frames[i].width == CHECK_WIDTH && frames[i].height == CHECK_HEIGHT);
+        CHECK(frames[i].format == CHECK_FORMAT);
+        for (int j = 0; j < i; j++) {
+            CHECK(frames[i].handle != frames[j].handle);
+            CHECK(frames[i].vir_addr != frames[j].vir_addr);
+        }
+    }
+    printf("%-36s %s\n", "acquire all frames", g_failed ? "FAILED" : "ok");
+
+    ret = imframePoolAcquire(pool, &extra);
+    CHECK(ret == IM_STATUS_OUT_OF_MEMORY);
+    printf("%-36s %s\n", "acquire from an exhausted pool", imStrError((IM_STATUS)ret));
+
+    /* the frames are imported, tasks run on their handles */
+    CHECK(imfill(frames[0], {0, 0, CHECK_WIDTH, CHECK_HEIGHT}, 0x11223344) == IM_STATUS_SUCCESS);
+    CHECK(imcopy(frames[0], frames[1]) == IM_STATUS_SUCCESS);
+    memcpy(&pixel, (char *)frames[1].vir_addr + (CHECK_WIDTH * CHECK_HEIGHT - 1) * 4, sizeof(pixel));
+    CHECK(memcmp(frames[0].vir_addr, frames[1].vir_addr, CHECK_WIDTH * CHECK_HEIGHT * 4) == 0);
+    printf("%-36s 0x%08x\n", "fill + copy between frames", pixel);
+
+    /* a returned frame is the next one acquired */
+    CHECK(imframePoolReturn(pool, &frames[2]) == IM_STATUS_SUCCESS);
+    CHECK(imframePoolAcquire(pool, &extra) == IM_STATUS_SUCCESS);
+    CHECK(extra.handle == frames[2].handle && extra.vir_addr == frames[2].vir_addr);
+    CHECK(imframePoolAcquire(pool, &extra) == IM_STATUS_OUT_OF_MEMORY);
+    printf("%-36s %s\n", "return and acquire again", g_failed ? "FAILED" : "ok");
+
+    /* double and foreign returns are rejected */
+    CHECK(imframePoolReturn(pool, &frames[3]) == IM_STATUS_SUCCESS);
+    ret = imframePoolReturn(pool, &frames[3]);
+    CHECK(ret == IM_STATUS_ILLEGAL_PARAM);
+    printf("%-36s %s\n", "return a frame twice", imStrError((IM_STATUS)ret));
+
+    foreign_buf = (char *)malloc(CHECK_WIDTH * CHECK_HEIGHT * 4);
+    foreign = wrapbuffer_virtualaddr(foreign_buf, CHECK_WIDTH, CHECK_HEIGHT, CHECK_FORMAT);
+    ret = imframePoolReturn(pool, &foreign);
+    CHECK(ret == IM_STATUS_ILLEGAL_PARAM);
+    printf("%-36s %s\n", "return a foreign buffer", imStrError((IM_STATUS)ret));
+    free(foreign_buf);
+
+    for (int i = 0; i < CHECK_FRAME_NUM - 1; i++)
+        CHECK(imframePoolReturn(pool, &frames[i]) == IM_STATUS_SUCCESS);
+
+    /* more threads than frames */
+    memset(&thread_arg, 0, sizeof(thread_arg));
+    thread_arg.pool = pool;
+    for (int i = 0; i < CHECK_FRAME_NUM; i++)
+        thread_arg.addrs[i] = frames[i].vir_addr;
+
+    for (int i = 0; i < CHECK_THREAD_NUM; i++)
+        pthread_create(&tid[i], NULL, check_thread_func, &thread_arg);
+    for (int i = 0; i < CHECK_THREAD_NUM; i++)
+        pthread_join(tid[i], NULL);
+
+    /* all the frames are back */
+    for (int i = 0; i < CHECK_FRAME_NUM; i++)
+        CHECK(imframePoolAcquire(pool, &frames[i]) == IM_STATUS_SUCCESS);
+    CHECK(imframePoolAcquire(pool, &extra) == IM_STATUS_OUT_OF_MEMORY);
+    for (int i = 0; i < CHECK_FRAME_NUM; i++) {
+        CHECK(check_frame_index(&thread_arg, frames[i].vir_addr) >= 0);
+        for (int j = 0; j < i; j++)
+            CHECK(frames[i].vir_addr != frames[j].vir_addr);
+        CHECK(imframePoolReturn(pool, &frames[i]) == IM_STATUS_SUCCESS);
+    }
+    printf("%-36s %s, %d exhausted acquires\n", "acquire/return from 8 threads",
+           g_failed ? "FAILED" : "ok", thread_arg.exhausted);
+
+    CHECK(imframePoolRelease(pool) == IM_STATUS_SUCCESS);
+
+    printf("%s: %s\n", LOG_TAG, g_failed ? "FAILED" : "passed");
+
+    return g_failed ? -1 : 0;
+}
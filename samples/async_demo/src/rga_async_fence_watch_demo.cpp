@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_async_fence_watch_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Check that the callback of every fence given to imfenceWatch(),
+ * improcessCallback() and imendJobCallback() is called exactly once, by
+ * imfencePoll() or by the reactor thread. Pipes and eventfds stand in for
+ * the release fences, run it with ROCKCHIP_RGA_BACKEND=cpu without a device.
+ *
+ * On glibc, epoll_ctl is wrapped to refuse the fences on demand, so the
+ * callback variants have to wait for the fence themselves.
+ */
+#define CHECK_FENCE_NUM     16
+#define CHECK_WIDTH         64
+#define CHECK_HEIGHT        64
+#define CHECK_FORMAT        RK_FORMAT_RGBA_8888
+#define CHECK_TIMEOUT_MS    1000
+
+static int g_calls[CHECK_FENCE_NUM];
+static int g_failed_status;
+static int g_failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s: check '%s' failed at line %d\n", LOG_TAG, #cond, __LINE__); \
+            g_failed++; \
+        } \
+    } while (0)
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+typedef int (*check_epoll_ctl_func)(int epfd, int op, int fd, struct epoll_event *event);
+
+static bool g_refuse_watch;
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    static check_epoll_ctl_func real_epoll_ctl;
+
+    if (real_epoll_ctl == NULL)
+        real_epoll_ctl = (check_epoll_ctl_func)dlsym(RTLD_NEXT, "epoll_ctl");
+
+    if (g_refuse_watch && op == EPOLL_CTL_ADD) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return real_epoll_ctl(epfd, op, fd, event);
+}
+#endif
+
+static void check_callback(int fence_fd, IM_STATUS status, void *userdata) {
+    int index = (int)(intptr_t)userdata;
+
+    (void)fence_fd;
+    if (status != IM_STATUS_SUCCESS)
+        g_failed_status++;
+    __atomic_fetch_add(&g_calls[index], 1, __ATOMIC_SEQ_CST);
+}
+
+static void check_reset(void) {
+    memset(g_calls, 0, sizeof(g_calls));
+    g_failed_status = 0;
+}
+
+static int check_called(int count) {
+    int called = 0;
+
+    for (int i = 0; i < count; i++)
+        called += __atomic_load_n(&g_calls[i], __ATOMIC_SEQ_CST) ? 1 : 0;
+
+    return called;
+}
+
+static bool check_once(int count) {
+    for (int i = 0; i < count; i++) {
+        if (__atomic_load_n(&g_calls[i], __ATOMIC_SEQ_CST) != 1)
+            return false;
+    }
+
+    return true;
+}
+
+/* poll until count callbacks have been called, the calls of imfencePoll() are returned */
+static int check_poll_all(int count) {
+    int64_t start = get_cur_us();
+    int polled = 0, ret;
+
+    while (check_called(count) < count && get_cur_us() - start < CHECK_TIMEOUT_MS * 1000) {
+        ret = imfencePoll(10);
+        if (ret < 0)
+            return ret;
+        polled += ret;
+    }
+
+    return polled;
+}
+
+/* half of the pipes are signaled before the first poll, the rest before the second one */
+static void check_pipe_poll(void) {
+    int fds[CHECK_FENCE_NUM][2];
+    char value = 1;
+
+    check_reset();
+
+    for (int i = 0; i < CHECK_FENCE_NUM; i++) {
+        CHECK(pipe2(fds[i], O_CLOEXEC) == 0);
+        CHECK(imfenceWatch(fds[i][0], check_callback, (void *)(intptr_t)i) == IM_STATUS_SUCCESS);
+    }
+
+    CHECK(imfencePoll(0) == 0);
+
+    for (int i = 0; i < CHECK_FENCE_NUM; i += 2)
+        CHECK(write(fds[i][1], &value, 1) == 1);
+    CHECK(check_poll_all(CHECK_FENCE_NUM / 2) >= 0);
+    for (int i = 0; i < CHECK_FENCE_NUM; i++)
+        CHECK(g_calls[i] == (i % 2 == 0 ? 1 : 0));
+
+    for (int i = 1; i < CHECK_FENCE_NUM; i += 2)
+        CHECK(write(fds[i][1], &value, 1) == 1);
+    CHECK(check_poll_all(CHECK_FENCE_NUM) == CHECK_FENCE_NUM / 2);
+
+    /* a signaled fence is reported once, the watched fd is closed after its callback */
+    CHECK(imfencePoll(0) == 0);
+    CHECK(check_once(CHECK_FENCE_NUM));
+    CHECK(g_failed_status == 0);
+    for (int i = 0; i < CHECK_FENCE_NUM; i++)
+        close(fds[i][1]);
+
+    printf("%-40s %s\n", "pipe fences, imfencePoll()", check_once(CHECK_FENCE_NUM) ? "once" : "FAILED");
+}
+
+/* eventfds signaled while the reactor thread is running */
+static void check_eventfd_reactor(void) {
+    int fds[CHECK_FENCE_NUM];
+    int64_t start;
+
+    check_reset();
+
+    CHECK(imfenceReactorStart() == IM_STATUS_SUCCESS);
+
+    for (int i = 0; i < CHECK_FENCE_NUM; i++) {
+        fds[i] = eventfd(0, EFD_CLOEXEC);
+        CHECK(fds[i] >= 0);
+        CHECK(imfenceWatch(fds[i], check_callback, (void *)(intptr_t)i) == IM_STATUS_SUCCESS);
+    }
+
+    for (int i = 0; i < CHECK_FENCE_NUM; i++)
+        CHECK(eventfd_write(fds[i], 1) == 0);
+
+    start = get_cur_us();
+    while (check_called(CHECK_FENCE_NUM) < CHECK_FENCE_NUM && get_cur_us() - start < CHECK_TIMEOUT_MS * 1000)
+        usleep(1000);
+
+    CHECK(imfenceReactorStop() == IM_STATUS_SUCCESS);
+
+    /* nothing is left for a poller after the reactor has called them */
+    CHECK(imfencePoll(0) == 0);
+    CHECK(check_once(CHECK_FENCE_NUM));
+
+    printf("%-40s %s\n", "eventfd fences, reactor thread", check_once(CHECK_FENCE_NUM) ? "once" : "FAILED");
+}
+
+/* an fd that cannot be polled is refused, and stays owned by the caller */
+static void check_unwatchable(void) {
+    char path[] = "/tmp/rga_fence_watch_XXXXXX";
+    int fd;
+
+    check_reset();
+
+    fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+
+    CHECK(imfenceWatch(fd, check_callback, (void *)(intptr_t)0) != IM_STATUS_SUCCESS);
+    CHECK(imfencePoll(0) == 0);
+    CHECK(g_calls[0] == 0);
+    CHECK(fcntl(fd, F_GETFD) >= 0);
+    close(fd);
+
+    printf("%-40s %s\n", "regular file, imfenceWatch()", g_calls[0] == 0 ? "refused" : "FAILED");
+}
+
+/* the release fences of the callback variants, watched or waited for */
+static void check_submit(char *src_buf, char *dst_buf, bool refuse) {
+    rga_buffer_t src, dst, pat;
+    im_rect srect, drect, prect;
+    im_job_handle_t job;
+    int count = CHECK_FENCE_NUM / 2, ret;
+    bool once;
+
+    check_reset();
+
+    memset(&pat, 0, sizeof(pat));
+    memset(&srect, 0, sizeof(srect));
+    memset(&drect, 0, sizeof(drect));
+    memset(&prect, 0, sizeof(prect));
+
+    src = wrapbuffer_virtualaddr(src_buf, CHECK_WIDTH, CHECK_HEIGHT, CHECK_FORMAT);
+    dst = wrapbuffer_virtualaddr(dst_buf, CHECK_WIDTH, CHECK_HEIGHT, CHECK_FORMAT);
+
+#ifdef __GLIBC__
+    g_refuse_watch = refuse;
+#endif
+
+    for (int i = 0; i < count; i++) {
+        ret = improcessCallback(src, dst, pat, srect, drect, prect, -1, NULL, 0,
+                                check_callback, (void *)(intptr_t)i);
+        CHECK(ret == IM_STATUS_SUCCESS);
+    }
+
+    for (int i = count; i < CHECK_FENCE_NUM; i++) {
+        job = imbeginJob();
+        CHECK((int)job > 0);
+        CHECK(imcopyTask(job, src, dst) == IM_STATUS_SUCCESS);
+        CHECK(imendJobCallback(job, -1, check_callback, (void *)(intptr_t)i) == IM_STATUS_SUCCESS);
+    }
+
+#ifdef __GLIBC__
+    g_refuse_watch = false;
+
+    /* the caller has waited, the callbacks were called before the submit returned */
+    if (refuse)
+        CHECK(check_called(CHECK_FENCE_NUM) == CHECK_FENCE_NUM);
+#endif
+
+    CHECK(check_poll_all(CHECK_FENCE_NUM) >= 0);
+    CHECK(imfencePoll(0) == 0);
+    CHECK(g_failed_status == 0);
+
+    once = check_once(CHECK_FENCE_NUM);
+    CHECK(once);
+
+    printf("%-40s %s\n", refuse ? "callback submit, watch refused" : "callback submit, watched",
+           once ? "once" : "FAILED");
+}
+
+int main() {
+    int buf_size = CHECK_WIDTH * CHECK_HEIGHT * get_bpp_from_format(CHECK_FORMAT);
+    char *src_buf, *dst_buf;
+
+    src_buf = (char *)malloc(buf_size);
+    dst_buf = (char *)malloc(buf_size);
+    draw_rgba(src_buf, CHECK_WIDTH, CHECK_HEIGHT);
+
+    check_pipe_poll();
+    check_eventfd_reactor();
+    check_unwatchable();
+    check_submit(src_buf, dst_buf, false);
+#ifdef __GLIBC__
+    check_submit(src_buf, dst_buf, true);
+#endif
+
+    free(src_buf);
+    free(dst_buf);
+
+    printf("%s: %s\n", LOG_TAG, g_failed ? "FAILED" : "passed");
+
+    return g_failed ? -1 : 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_blend_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * imblend() throughput in MPixel/s for each Porter-Duff mode and bg format,
+ * the fg has the format of the bg, or RGBA8888 over a YUV bg. The 16 bit
+ * formats are the ARGB ones, RGBA5551/RGBA4444 cannot be a blend src. Run
+ * it with ROCKCHIP_RGA_BACKEND=cpu to measure the CPU blend kernels.
+ */
+#define BENCH_WIDTH         1280
+#define BENCH_HEIGHT        720
+#define BENCH_LOOP          10
+
+static const struct {
+    int mode;
+    const char *name;
+} bench_modes[] = {
+    { IM_ALPHA_BLEND_SRC,       "SRC"      },
+    { IM_ALPHA_BLEND_DST,       "DST"      },
+    { IM_ALPHA_BLEND_SRC_OVER,  "SRC_OVER" },
+    { IM_ALPHA_BLEND_DST_OVER,  "DST_OVER" },
+    { IM_ALPHA_BLEND_SRC_IN,    "SRC_IN"   },
+    { IM_ALPHA_BLEND_DST_IN,    "DST_IN"   },
+    { IM_ALPHA_BLEND_SRC_OUT,   "SRC_OUT"  },
+    { IM_ALPHA_BLEND_DST_OUT,   "DST_OUT"  },
+    { IM_ALPHA_BLEND_SRC_ATOP,  "SRC_ATOP" },
+    { IM_ALPHA_BLEND_DST_ATOP,  "DST_ATOP" },
+    { IM_ALPHA_BLEND_XOR,       "XOR"      },
+    { IM_ALPHA_BLEND_SRC_OVER | IM_ALPHA_BLEND_PRE_MUL, "SRC_OVER premultiplied" },
+};
+
+static const struct {
+    int fg_format;
+    int bg_format;
+    const char *name;
+} bench_formats[] = {
+    { RK_FORMAT_RGBA_8888,  RK_FORMAT_RGBA_8888,        "RGBA8888" },
+    { RK_FORMAT_BGRA_8888,  RK_FORMAT_BGRA_8888,        "BGRA8888" },
+    { RK_FORMAT_ARGB_5551,  RK_FORMAT_ARGB_5551,        "ARGB5551" },
+    { RK_FORMAT_ARGB_4444,  RK_FORMAT_ARGB_4444,        "ARGB4444" },
+    { RK_FORMAT_RGBA_8888,  RK_FORMAT_YCbCr_420_SP,     "NV12"     },
+};
+
+#define BENCH_FORMAT_NUM (sizeof(bench_formats) / sizeof(bench_formats[0]))
+
+static double bench_run(char *fg_buf, char *bg_buf, int format_index, int mode, int global_alpha) {
+    rga_buffer_t fg, bg;
+    int64_t start;
+    int ret;
+
+    fg = wrapbuffer_virtualaddr(fg_buf, BENCH_WIDTH, BENCH_HEIGHT, bench_formats[format_index].fg_format);
+    bg = wrapbuffer_virtualaddr(bg_buf, BENCH_WIDTH, BENCH_HEIGHT, bench_formats[format_index].bg_format);
+    fg.global_alpha = global_alpha;
+
+    start = get_cur_us();
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        ret = imblend(fg, bg, mode);
+        if (ret != IM_STATUS_SUCCESS)
+            return -1;
+    }
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * BENCH_LOOP / (get_cur_us() - start);
+}
+
+static void bench_print_row(char *fg_buf, char *bg_buf, const char *name, int mode, int global_alpha) {
+    double mpix;
+
+    printf("%-24s", name);
+    for (size_t f = 0; f < BENCH_FORMAT_NUM; f++) {
+        mpix = bench_run(fg_buf, bg_buf, f, mode, global_alpha);
+        if (mpix < 0)
+            printf("%10s", "-");
+        else
+            printf("%10.1f", mpix);
+    }
+    printf("\n");
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * 4;
+    char *fg_buf, *bg_buf;
+
+    fg_buf = (char *)malloc(buf_size);
+    bg_buf = (char *)malloc(buf_size);
+    draw_rgba(fg_buf, BENCH_WIDTH, BENCH_HEIGHT);
+    memset(bg_buf, 0x80, buf_size);
+
+    /* warm up */
+    bench_run(fg_buf, bg_buf, 0, IM_ALPHA_BLEND_SRC_OVER, 0xff);
+
+    printf("%s: %dx%d, %d loops, MPix/s, '-': not supported\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("%-24s", "mode");
+    for (size_t f = 0; f < BENCH_FORMAT_NUM; f++)
+        printf("%10s", bench_formats[f].name);
+    printf("\n");
+
+    for (size_t m = 0; m < sizeof(bench_modes) / sizeof(bench_modes[0]); m++)
+        bench_print_row(fg_buf, bg_buf, bench_modes[m].name, bench_modes[m].mode, 0xff);
+
+    bench_print_row(fg_buf, bg_buf, "SRC_OVER global alpha", IM_ALPHA_BLEND_SRC_OVER, 0x80);
+
+    free(fg_buf);
+    free(bg_buf);
+
+    return 0;
+}
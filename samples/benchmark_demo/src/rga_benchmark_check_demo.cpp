@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_check_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Per-call cost of each IM_CONFIG_CHECK level. The dst rect moves on every
+ * call so that the parameter check cache misses, the "cached" rows keep it
+ * fixed. Run it with ROCKCHIP_RGA_BACKEND=cpu to replace the driver ioctl
+ * with the CPU backend.
+ */
+#define BENCH_SRC_WIDTH     16
+#define BENCH_SRC_HEIGHT    16
+#define BENCH_DST_WIDTH     1040
+#define BENCH_DST_HEIGHT    16
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_LOOP          50000
+
+static const struct {
+    IM_CHECK_MODE mode;
+    const char *name;
+} bench_modes[] = {
+    { IM_CHECK_MODE_FULL,   "full"  },
+    { IM_CHECK_MODE_CHEAP,  "cheap" },
+    { IM_CHECK_MODE_OFF,    "off"   },
+};
+
+static int bench_run(rga_buffer_t src, rga_buffer_t dst, bool move, double *us) {
+    int ret;
+    im_rect srect = {0, 0, BENCH_SRC_WIDTH, BENCH_SRC_HEIGHT};
+    im_rect drect = {0, 0, BENCH_SRC_WIDTH, BENCH_SRC_HEIGHT};
+    im_rect prect = {};
+    rga_buffer_t pat = {};
+    int64_t start;
+
+    start = get_cur_us();
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        if (move)
+            drect.x = i % (BENCH_DST_WIDTH - BENCH_SRC_WIDTH);
+
+        ret = improcess(src, dst, pat, srect, drect, prect, IM_SYNC);
+        if (ret != IM_STATUS_SUCCESS) {
+            printf("%s: improcess failed, %s\n", LOG_TAG, imStrError((IM_STATUS)ret));
+            return ret;
+        }
+    }
+    *us = (double)(get_cur_us() - start) / BENCH_LOOP;
+
+    return IM_STATUS_SUCCESS;
+}
+
+int main() {
+    int ret = IM_STATUS_SUCCESS;
+    int src_buf_size, dst_buf_size;
+    char *src_buf, *dst_buf;
+    rga_buffer_t src, dst;
+    uint64_t hit, miss;
+    double us;
+
+    src_buf_size = BENCH_SRC_WIDTH * BENCH_SRC_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    dst_buf_size = BENCH_DST_WIDTH * BENCH_DST_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+
+    src_buf = (char *)malloc(src_buf_size);
+    dst_buf = (char *)malloc(dst_buf_size);
+    draw_rgba(src_buf, BENCH_SRC_WIDTH, BENCH_SRC_HEIGHT);
+    memset(dst_buf, 0x80, dst_buf_size);
+
+    src = wrapbuffer_virtualaddr(src_buf, BENCH_SRC_WIDTH, BENCH_SRC_HEIGHT, BENCH_FORMAT);
+    dst = wrapbuffer_virtualaddr(dst_buf, BENCH_DST_WIDTH, BENCH_DST_HEIGHT, BENCH_FORMAT);
+
+    printf("%s: %dx%d copy into a %dx%d image, %d calls\n", LOG_TAG,
+           BENCH_SRC_WIDTH, BENCH_SRC_HEIGHT, BENCH_DST_WIDTH, BENCH_DST_HEIGHT, BENCH_LOOP);
+    printf("mode     rect      us/call   cache hit   cache miss\n");
+
+    for (size_t i = 0; i < sizeof(bench_modes) / sizeof(bench_modes[0]); i++) {
+        imconfig(IM_CONFIG_CHECK, bench_modes[i].mode);
+
+        for (int move = 1; move >= 0; move--) {
+            uint64_t last_hit, last_miss;
+
+            imcheckCacheStat(&last_hit, &last_miss);
+            ret = bench_run(src, dst, move, &us);
+            if (ret != IM_STATUS_SUCCESS)
+                goto release_buffer;
+            imcheckCacheStat(&hit, &miss);
+
+            printf("%-8s %-8s %8.2f %11llu %12llu\n", bench_modes[i].name, move ? "moving" : "cached", us,
+                   (unsigned long long)(hit - last_hit), (unsigned long long)(miss - last_miss));
+        }
+    }
+
+release_buffer:
+    imconfig(IM_CONFIG_CHECK, IM_CHECK_MODE_DEFAULT);
+
+    free(src_buf);
+    free(dst_buf);
+
+    return ret == IM_STATUS_SUCCESS ? 0 : -1;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_cvtcolor_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * YUV <-> RGB conversion throughput in MPixel/s for each format pair.
+ * Run it with ROCKCHIP_RGA_BACKEND=cpu to measure the CPU kernels.
+ */
+#define BENCH_WIDTH         1280
+#define BENCH_HEIGHT        720
+#define BENCH_LOOP          50
+
+static const struct {
+    int format;
+    const char *name;
+} yuv_formats[] = {
+    { RK_FORMAT_YCbCr_420_SP,   "NV12" },
+    { RK_FORMAT_YCrCb_420_SP,   "NV21" },
+    { RK_FORMAT_YCbCr_422_SP,   "NV16" },
+    { RK_FORMAT_YCbCr_420_P,    "I420" },
+    { RK_FORMAT_YUYV_422,       "YUYV" },
+    { RK_FORMAT_UYVY_422,       "UYVY" },
+}, rgb_formats[] = {
+    { RK_FORMAT_RGBA_8888,      "RGBA" },
+    { RK_FORMAT_RGB_888,        "RGB"  },
+    { RK_FORMAT_BGR_888,        "BGR"  },
+};
+
+static double bench_run(char *src_buf, int src_format, char *dst_buf, int dst_format) {
+    rga_buffer_t src, dst;
+    int64_t start;
+    int ret;
+
+    src = wrapbuffer_virtualaddr(src_buf, BENCH_WIDTH, BENCH_HEIGHT, src_format);
+    dst = wrapbuffer_virtualaddr(dst_buf, BENCH_WIDTH, BENCH_HEIGHT, dst_format);
+
+    start = get_cur_us();
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        ret = imcvtcolor(src, dst, src_format, dst_format);
+        if (ret != IM_STATUS_SUCCESS) {
+            printf("%s: imcvtcolor failed, %s\n", LOG_TAG, imStrError((IM_STATUS)ret));
+            return 0;
+        }
+    }
+
+    return (double)BENCH_WIDTH * BENCH_HEIGHT * BENCH_LOOP / (get_cur_us() - start);
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * 4;
+    char *yuv_buf, *rgb_buf;
+
+    yuv_buf = (char *)malloc(buf_size);
+    rgb_buf = (char *)malloc(buf_size);
+    draw_rgba(rgb_buf, BENCH_WIDTH, BENCH_HEIGHT);
+    memset(yuv_buf, 0x80, buf_size);
+
+    printf("%s: %dx%d, %d loops, BT.601 limited range\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("yuv    rgb    yuv->rgb MPix/s   rgb->yuv MPix/s\n");
+
+    for (size_t y = 0; y < sizeof(yuv_formats) / sizeof(yuv_formats[0]); y++) {
+        for (size_t r = 0; r < sizeof(rgb_formats) / sizeof(rgb_formats[0]); r++) {
+            double to_rgb, to_yuv;
+
+            to_yuv = bench_run(rgb_buf, rgb_formats[r].format, yuv_buf, yuv_formats[y].format);
+            to_rgb = bench_run(yuv_buf, yuv_formats[y].format, rgb_buf, rgb_formats[r].format);
+
+            printf("%-6s %-6s %15.1f %17.1f\n", yuv_formats[y].name, rgb_formats[r].name, to_rgb, to_yuv);
+        }
+    }
+
+    free(yuv_buf);
+    free(rgb_buf);
+
+    return 0;
+}
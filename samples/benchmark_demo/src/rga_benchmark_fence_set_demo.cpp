@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_fence_set_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/sync_file.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Merge N release fences into one, with a pairwise SYNC_IOC_MERGE chain
+ * against an im_fence_set, when the fences are still pending and when they
+ * are already signaled. Run it with ROCKCHIP_RGA_BACKEND=cpu to replace the
+ * driver ioctl with the CPU backend, whose eventfd fences cannot be merged.
+ *
+ * On glibc the merges are counted by wrapping ioctl.
+ */
+#define BENCH_WIDTH         256
+#define BENCH_HEIGHT        256
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_FENCE_MAX     64
+#define BENCH_LOOP          100
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+typedef int (*bench_ioctl_func)(int fd, unsigned long request, ...);
+
+static uint64_t g_merge_count;
+
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+    static bench_ioctl_func real_ioctl;
+    va_list args;
+    void *arg;
+
+    if (real_ioctl == NULL)
+        real_ioctl = (bench_ioctl_func)dlsym(RTLD_NEXT, "ioctl");
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    if (request == SYNC_IOC_MERGE)
+        __atomic_fetch_add(&g_merge_count, 1, __ATOMIC_RELAXED);
+    return real_ioctl(fd, request, arg);
+}
+
+static uint64_t bench_merge_count(void) {
+    return __atomic_load_n(&g_merge_count, __ATOMIC_RELAXED);
+}
+#else
+static uint64_t bench_merge_count(void) {
+    return 0;
+}
+#endif
+
+/* The pairwise chain the array APIs used to build. */
+static int bench_chain_merge(int *fences, int count) {
+    struct sync_merge_data data;
+    int merged = fences[0];
+
+    for (int i = 1; i < count; i++) {
+        memset(&data, 0, sizeof(data));
+        strncpy(data.name, "bench_chain", sizeof(data.name) - 1);
+        data.fd2 = fences[i];
+
+        if (ioctl(merged, SYNC_IOC_MERGE, &data) < 0) {
+            /* cannot merge, resolve it here */
+            imsync(merged);
+            merged = fences[i];
+            continue;
+        }
+
+        close(merged);
+        close(fences[i]);
+        merged = data.fence;
+    }
+
+    return merged;
+}
+
+static int bench_set_merge(int *fences, int count) {
+    im_fence_set_t *set;
+    int merged = -1;
+
+    set = imfenceSetCreate();
+    if (set == NULL)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+        imfenceSetAdd(set, fences[i]);
+    imfenceSetMerge(set, &merged);
+    imfenceSetRelease(set);
+
+    return merged;
+}
+
+static int bench_submit(rga_buffer_t dst, int *fences, int count) {
+    int ret;
+    im_rect rect;
+
+    for (int i = 0; i < count; i++) {
+        rect.x = (i % 8) * (BENCH_WIDTH / 8);
+        rect.y = (i / 8 % 8) * (BENCH_HEIGHT / 8);
+        rect.width = BENCH_WIDTH / 8;
+        rect.height = BENCH_HEIGHT / 8;
+
+        fences[i] = -1;
+        ret = imfill(dst, rect, 0xff0000ff + i, 0, &fences[i]);
+        if (ret != IM_STATUS_SUCCESS || fences[i] < 0) {
+            printf("%s: imfill failed, %s\n", LOG_TAG, imStrError((IM_STATUS)ret));
+            for (int j = 0; j < i; j++)
+                imsync(fences[j]);
+            return IM_STATUS_FAILED;
+        }
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+
+int main() {
+    static const int fence_counts[] = { 4, 16, 64 };
+    int ret = IM_STATUS_SUCCESS;
+    int buf_size;
+    char *dst_buf;
+    rga_buffer_t dst;
+    int fences[BENCH_FENCE_MAX];
+    int merged;
+    uint64_t merge_count;
+    int64_t start, cost;
+
+    buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    dst_buf = (char *)malloc(buf_size);
+    memset(dst_buf, 0x80, buf_size);
+
+    dst = wrapbuffer_virtualaddr(dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    printf("%s: fences of async imfill on %dx%d, %d loops\n", LOG_TAG,
+           BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("fences   state      method   merge us   merges   result fences\n");
+
+    for (size_t n = 0; n < sizeof(fence_counts) / sizeof(fence_counts[0]); n++) {
+        for (int signaled = 0; signaled <= 1; signaled++) {
+            for (int use_set = 0; use_set <= 1; use_set++) {
+                int result_count = 0;
+
+                cost = 0;
+                merge_count = 0;
+
+                for (int i = 0; i < BENCH_LOOP; i++) {
+                    ret = bench_submit(dst, fences, fence_counts[n]);
+                    if (ret != IM_STATUS_SUCCESS)
+                        goto release_buffer;
+
+                    if (signaled)
+                        imsyncMany(fences, fence_counts[n], IM_SYNC_WAIT_ALL, 0, -1, NULL);
+
+                    merge_count -= bench_merge_count();
+                    start = get_cur_us();
+
+                    if (use_set)
+                        merged = bench_set_merge(fences, fence_counts[n]);
+                    else
+                        merged = bench_chain_merge(fences, fence_counts[n]);
+
+                    cost += get_cur_us() - start;
+                    merge_count += bench_merge_count();
+
+                    if (merged >= 0) {
+                        result_count++;
+                        imsync(merged);
+                    }
+                }
+
+                printf("%6d   %-9s  %-6s %10.2f %8.2f %15.2f\n", fence_counts[n],
+                       signaled ? "signaled" : "pending", use_set ? "set" : "chain",
+                       (double)cost / BENCH_LOOP, (double)merge_count / BENCH_LOOP,
+                       (double)result_count / BENCH_LOOP);
+            }
+        }
+    }
+
+release_buffer:
+    free(dst_buf);
+
+    return ret == IM_STATUS_SUCCESS ? 0 : -1;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_job_pool_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Cost, heap allocations and peak RSS of imbeginJob/imfillTask/imendJob
+ * for jobs of 2~256 tasks. Run it with ROCKCHIP_RGA_BACKEND=cpu to replace
+ * the driver ioctl with the CPU backend.
+ *
+ * On glibc the allocations are counted by wrapping malloc/calloc/realloc,
+ * that also catches the ones made inside librga. They are split into the
+ * job build (imbeginJob + tasks) and the submit (imendJob), the latter
+ * includes the ones of the driver or CPU backend.
+ */
+#define BENCH_WIDTH         64
+#define BENCH_HEIGHT        64
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_LOOP          2000
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t nmemb, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t g_alloc_count;
+
+extern "C" void *malloc(size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&g_alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t bench_alloc_count(void) {
+    return __atomic_load_n(&g_alloc_count, __ATOMIC_RELAXED);
+}
+#else
+static uint64_t bench_alloc_count(void) {
+    return 0;
+}
+#endif
+
+static long bench_peak_rss_kb(void) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+int main() {
+    static const int task_counts[] = { 2, 4, 16, 64, 256 };
+    int ret = IM_STATUS_SUCCESS;
+    int buf_size;
+    char *dst_buf;
+    rga_buffer_t dst;
+    im_job_handle_t job;
+    im_rect rect;
+    uint64_t build_alloc, submit_alloc, last_alloc;
+    int64_t start, cost;
+
+    buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    dst_buf = (char *)malloc(buf_size);
+    memset(dst_buf, 0x80, buf_size);
+
+    dst = wrapbuffer_virtualaddr(dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    printf("%s: imfillTask 8x8 on %dx%d, %d jobs per row\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("tasks     us/job   build allocs/job   submit allocs/job   peak RSS(KB)\n");
+
+    for (size_t n = 0; n < sizeof(task_counts) / sizeof(task_counts[0]); n++) {
+        build_alloc = 0;
+        submit_alloc = 0;
+        start = get_cur_us();
+
+        for (int i = 0; i < BENCH_LOOP; i++) {
+            last_alloc = bench_alloc_count();
+
+            job = imbeginJob();
+            if ((int)job <= 0) {
+                printf("%s: imbeginJob failed, %s\n", LOG_TAG, imStrError());
+                ret = IM_STATUS_FAILED;
+                goto release_buffer;
+            }
+
+            for (int t = 0; t < task_counts[n]; t++) {
+                rect.x = (t % 8) * 8;
+                rect.y = (t / 8 % 8) * 8;
+                rect.width = 8;
+                rect.height = 8;
+
+                ret = imfillTask(job, dst, rect, 0xff0000ff + t);
+                if (ret != IM_STATUS_SUCCESS) {
+                    printf("%s: imfillTask failed, %s\n", LOG_TAG, imStrError((IM_STATUS)ret));
+                    imcancelJob(job);
+                    goto release_buffer;
+                }
+            }
+
+            build_alloc += bench_alloc_count() - last_alloc;
+            last_alloc = bench_alloc_count();
+
+            ret = imendJob(job);
+            submit_alloc += bench_alloc_count() - last_alloc;
+            if (ret != IM_STATUS_SUCCESS) {
+                printf("%s: imendJob failed, %s\n", LOG_TAG, imStrError((IM_STATUS)ret));
+                goto release_buffer;
+            }
+        }
+
+        cost = get_cur_us() - start;
+
+        printf("%5d %10.2f %18.2f %19.2f %14ld\n", task_counts[n], (double)cost / BENCH_LOOP,
+               (double)build_alloc / BENCH_LOOP, (double)submit_alloc / BENCH_LOOP,
+               bench_peak_rss_kb());
+    }
+
+release_buffer:
+    free(dst_buf);
+
+    return ret == IM_STATUS_SUCCESS ? 0 : -1;
+}
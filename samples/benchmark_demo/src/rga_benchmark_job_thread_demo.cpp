@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_job_thread_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Job build/submit throughput with 1~8 threads, each thread builds its own
+ * jobs of BENCH_TASK_NUM fill tasks. Run it with ROCKCHIP_RGA_BACKEND=cpu to
+ * replace the driver ioctl with the CPU backend.
+ */
+#define BENCH_WIDTH         16
+#define BENCH_HEIGHT        16
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_TASK_NUM      4
+#define BENCH_LOOP          5000
+#define BENCH_THREAD_MAX    8
+
+typedef struct {
+    char *dst_buf;
+    int failed;
+} bench_thread_t;
+
+static void *bench_thread_func(void *arg) {
+    bench_thread_t *thread = (bench_thread_t *)arg;
+    im_job_handle_t job;
+    rga_buffer_t dst;
+    im_rect rect;
+
+    dst = wrapbuffer_virtualaddr(thread->dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        job = imbeginJob();
+        if ((int)job <= 0) {
+            thread->failed++;
+            continue;
+        }
+
+        for (int t = 0; t < BENCH_TASK_NUM; t++) {
+            rect.x = (t % 2) * (BENCH_WIDTH / 2);
+            rect.y = (t / 2) * (BENCH_HEIGHT / 2);
+            rect.width = BENCH_WIDTH / 2;
+            rect.height = BENCH_HEIGHT / 2;
+
+            imfillTask(job, dst, rect, 0xff0000ff + t);
+        }
+
+        if (imendJob(job) != IM_STATUS_SUCCESS)
+            thread->failed++;
+    }
+
+    return NULL;
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    bench_thread_t threads[BENCH_THREAD_MAX];
+    pthread_t tid[BENCH_THREAD_MAX];
+    int64_t start, cost;
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        threads[i].dst_buf = (char *)malloc(buf_size);
+        threads[i].failed = 0;
+        memset(threads[i].dst_buf, 0x80, buf_size);
+    }
+
+    printf("%s: jobs of %d imfillTask on %dx%d, %d jobs per thread\n", LOG_TAG,
+           BENCH_TASK_NUM, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("threads       jobs/s       us/job\n");
+
+    for (int count = 1; count <= BENCH_THREAD_MAX; count *= 2) {
+        start = get_cur_us();
+        for (int i = 0; i < count; i++)
+            pthread_create(&tid[i], NULL, bench_thread_func, &threads[i]);
+        for (int i = 0; i < count; i++)
+            pthread_join(tid[i], NULL);
+        cost = get_cur_us() - start;
+
+        printf("%7d %12.0f %12.2f\n", count,
+               (double)count * BENCH_LOOP * 1000000 / cost,
+               (double)cost / ((double)count * BENCH_LOOP));
+    }
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        if (threads[i].failed)
+            printf("%s: thread[%d] %d jobs failed\n", LOG_TAG, i, threads[i].failed);
+        free(threads[i].dst_buf);
+    }
+
+    return 0;
+}
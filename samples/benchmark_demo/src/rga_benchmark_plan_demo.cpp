@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_plan_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Per-call cost in ns of the submit path of improcess() against a prepared
+ * plan executed with improcessPlan(), both alternating between two frames
+ * like a video pipeline. The ops are as small as the checks accept, so
+ * little time goes to the pixels.
+ *
+ * On glibc the blit ioctl is replaced by a stub that returns at once and
+ * counts the calls, so on the hardware only the user space is timed. Run it
+ * with ROCKCHIP_RGA_BACKEND=cpu without a device, then the CPU backend
+ * processes the pixels of the tiny ops instead of the ioctl.
+ */
+#define BENCH_FRAME_NUM     2
+#define BENCH_BUF_SIZE      (8 * 8 * 4)
+#define BENCH_LOOP          100000
+
+/* see core/hardware/rga_ioctl.h */
+#define BENCH_RGA_BLIT_SYNC     0x5017
+
+static const struct {
+    const char *name;
+    int src_width, src_height, src_format;
+    int dst_width, dst_height, dst_format;
+} bench_ops[] = {
+    { "copy 2x2 RGBA",              2, 2, RK_FORMAT_RGBA_8888, 2, 2, RK_FORMAT_RGBA_8888    },
+    { "csc 4x2 RGBA -> NV12",       4, 2, RK_FORMAT_RGBA_8888, 4, 2, RK_FORMAT_YCbCr_420_SP },
+    { "resize+csc 8x8 -> 4x4 NV12", 8, 8, RK_FORMAT_RGBA_8888, 4, 4, RK_FORMAT_YCbCr_420_SP },
+};
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+typedef int (*bench_ioctl_func)(int fd, unsigned long request, ...);
+
+static uint64_t g_stub_count;
+
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+    static bench_ioctl_func real_ioctl;
+    va_list args;
+    void *arg;
+
+    if (real_ioctl == NULL)
+        real_ioctl = (bench_ioctl_func)dlsym(RTLD_NEXT, "ioctl");
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    if (request == BENCH_RGA_BLIT_SYNC) {
+        g_stub_count++;
+        return 0;
+    }
+    return real_ioctl(fd, request, arg);
+}
+#endif
+
+static int bench_run(int op, int64_t *process_ns, int64_t *plan_ns) {
+    int ret = IM_STATUS_SUCCESS;
+    char *src_buf[BENCH_FRAME_NUM], *dst_buf[BENCH_FRAME_NUM];
+    rga_buffer_t src[BENCH_FRAME_NUM], dst[BENCH_FRAME_NUM], pat;
+    im_rect srect, drect, prect;
+    im_opt_t opt = {};
+    im_plan_t *plan;
+    int64_t start;
+
+    memset(&pat, 0, sizeof(pat));
+    memset(&srect, 0, sizeof(srect));
+    memset(&drect, 0, sizeof(drect));
+    memset(&prect, 0, sizeof(prect));
+
+    for (int i = 0; i < BENCH_FRAME_NUM; i++) {
+        src_buf[i] = (char *)malloc(BENCH_BUF_SIZE);
+        dst_buf[i] = (char *)malloc(BENCH_BUF_SIZE);
+        memset(src_buf[i], 0x80, BENCH_BUF_SIZE);
+
+        src[i] = wrapbuffer_virtualaddr(src_buf[i], bench_ops[op].src_width, bench_ops[op].src_height,
+                                        bench_ops[op].src_format);
+        dst[i] = wrapbuffer_virtualaddr(dst_buf[i], bench_ops[op].dst_width, bench_ops[op].dst_height,
+                                        bench_ops[op].dst_format);
+    }
+
+    /* the same parameters on every frame */
+    start = get_cur_us();
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        ret = improcess(src[i % BENCH_FRAME_NUM], dst[i % BENCH_FRAME_NUM], pat,
+                        srect, drect, prect, -1, NULL, &opt, IM_SYNC);
+        if (ret != IM_STATUS_SUCCESS) {
+            printf("%s: %s improcess failed, %s\n", LOG_TAG, bench_ops[op].name, imStrError((IM_STATUS)ret));
+            goto release_buffer;
+        }
+    }
+    *process_ns = (get_cur_us() - start) * 1000;
+
+    plan = imcreatePlan(src[0], dst[0], pat, srect, drect, prect, &opt, IM_SYNC);
+    if (plan == NULL) {
+        printf("%s: %s imcreatePlan failed, %s\n", LOG_TAG, bench_ops[op].name, imStrError());
+        ret = IM_STATUS_FAILED;
+        goto release_buffer;
+    }
+
+    start = get_cur_us();
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        ret = improcessPlan(plan, src[i % BENCH_FRAME_NUM], dst[i % BENCH_FRAME_NUM], pat, -1, NULL);
+        if (ret != IM_STATUS_SUCCESS) {
+            printf("%s: %s improcessPlan failed, %s\n", LOG_TAG, bench_ops[op].name, imStrError((IM_STATUS)ret));
+            break;
+        }
+    }
+    *plan_ns = (get_cur_us() - start) * 1000;
+
+    imreleasePlan(plan);
+
+release_buffer:
+    for (int i = 0; i < BENCH_FRAME_NUM; i++) {
+        free(src_buf[i]);
+        free(dst_buf[i]);
+    }
+
+    return ret;
+}
+
+int main() {
+    int ret = IM_STATUS_SUCCESS;
+    int64_t process_ns, plan_ns;
+
+    printf("%s: %d calls per op\n", LOG_TAG, BENCH_LOOP);
+    printf("op                           improcess ns/call  improcessPlan ns/call  speedup\n");
+
+    for (size_t op = 0; op < sizeof(bench_ops) / sizeof(bench_ops[0]); op++) {
+        ret = bench_run(op, &process_ns, &plan_ns);
+        if (ret != IM_STATUS_SUCCESS)
+            break;
+
+        printf("%-28s %18.1f %22.1f %7.2fx\n", bench_ops[op].name,
+               (double)process_ns / BENCH_LOOP, (double)plan_ns / BENCH_LOOP,
+               (double)process_ns / plan_ns);
+    }
+
+#ifdef __GLIBC__
+    printf("stubbed blit ioctls: %llu\n", (unsigned long long)g_stub_count);
+#endif
+
+    return ret == IM_STATUS_SUCCESS ? 0 : -1;
+}
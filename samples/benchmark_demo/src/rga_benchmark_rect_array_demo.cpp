@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_rect_array_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Wall time and submissions of drawing N boxes asynchronously, with one
+ * imrectangle() per box against one imrectangleArray() call. Run it with
+ * ROCKCHIP_RGA_BACKEND=cpu to replace the driver ioctl with the CPU backend.
+ *
+ * On glibc the submissions are counted by wrapping ioctl (the driver) and
+ * eventfd (the release fence of an async CPU backend submission).
+ */
+#define BENCH_WIDTH         640
+#define BENCH_HEIGHT        480
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_BOX_SIZE      32
+#define BENCH_THICKNESS     2
+#define BENCH_BOX_MAX       100
+#define BENCH_LOOP          200
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+typedef int (*bench_ioctl_func)(int fd, unsigned long request, ...);
+typedef int (*bench_eventfd_func)(unsigned int initval, int flags);
+
+static uint64_t g_ioctl_count;
+static uint64_t g_eventfd_count;
+
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+    static bench_ioctl_func real_ioctl;
+    va_list args;
+    void *arg;
+
+    if (real_ioctl == NULL)
+        real_ioctl = (bench_ioctl_func)dlsym(RTLD_NEXT, "ioctl");
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    __atomic_fetch_add(&g_ioctl_count, 1, __ATOMIC_RELAXED);
+    return real_ioctl(fd, request, arg);
+}
+
+extern "C" int eventfd(unsigned int initval, int flags) {
+    static bench_eventfd_func real_eventfd;
+
+    if (real_eventfd == NULL)
+        real_eventfd = (bench_eventfd_func)dlsym(RTLD_NEXT, "eventfd");
+
+    __atomic_fetch_add(&g_eventfd_count, 1, __ATOMIC_RELAXED);
+    return real_eventfd(initval, flags);
+}
+#endif
+
+typedef struct {
+    double us;
+    double ioctls;
+    double eventfds;
+} bench_result_t;
+
+static void bench_count(uint64_t *ioctls, uint64_t *eventfds) {
+#ifdef __GLIBC__
+    *ioctls = __atomic_load_n(&g_ioctl_count, __ATOMIC_RELAXED);
+    *eventfds = __atomic_load_n(&g_eventfd_count, __ATOMIC_RELAXED);
+#else
+    *ioctls = 0;
+    *eventfds = 0;
+#endif
+}
+
+static int bench_run(rga_buffer_t dst, im_rect *boxes, int box_count, bool array,
+                     bench_result_t *result) {
+    int ret = IM_STATUS_SUCCESS;
+    int fences[BENCH_BOX_MAX];
+    int fence_count;
+    uint64_t ioctls, eventfds, last_ioctls, last_eventfds;
+    int64_t start;
+
+    bench_count(&last_ioctls, &last_eventfds);
+    start = get_cur_us();
+
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        fence_count = 0;
+
+        if (array) {
+            fences[0] = -1;
+            ret = imrectangleArray(dst, boxes, box_count, 0xff00ff00, BENCH_THICKNESS, 0, &fences[0]);
+            if (ret == IM_STATUS_SUCCESS)
+                fence_count = 1;
+        } else {
+            for (int b = 0; b < box_count; b++) {
+                fences[b] = -1;
+                ret = imrectangle(dst, boxes[b], 0xff00ff00, BENCH_THICKNESS, 0, &fences[b]);
+                if (ret != IM_STATUS_SUCCESS)
+                    break;
+                fence_count++;
+            }
+        }
+
+        for (int f = 0; f < fence_count; f++) {
+            if (fences[f] >= 0)
+                imsync(fences[f]);
+        }
+
+        if (ret != IM_STATUS_SUCCESS) {
+            printf("%s: %s failed, %s\n", LOG_TAG, array ? "imrectangleArray" : "imrectangle",
+                   imStrError((IM_STATUS)ret));
+            return ret;
+        }
+    }
+
+    result->us = (double)(get_cur_us() - start) / BENCH_LOOP;
+    bench_count(&ioctls, &eventfds);
+    result->ioctls = (double)(ioctls - last_ioctls) / BENCH_LOOP;
+    result->eventfds = (double)(eventfds - last_eventfds) / BENCH_LOOP;
+
+    return IM_STATUS_SUCCESS;
+}
+
+int main() {
+    static const int box_counts[] = { 1, 10, 50, 100 };
+    int ret = IM_STATUS_SUCCESS;
+    int buf_size;
+    char *dst_buf;
+    rga_buffer_t dst;
+    im_rect boxes[BENCH_BOX_MAX];
+    bench_result_t single, array;
+
+    buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    dst_buf = (char *)malloc(buf_size);
+    memset(dst_buf, 0x80, buf_size);
+
+    dst = wrapbuffer_virtualaddr(dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    for (int i = 0; i < BENCH_BOX_MAX; i++) {
+        boxes[i].x = (i % 10) * (BENCH_WIDTH / 10);
+        boxes[i].y = (i / 10) * (BENCH_HEIGHT / 10);
+        boxes[i].width = BENCH_BOX_SIZE;
+        boxes[i].height = BENCH_BOX_SIZE;
+    }
+
+    printf("%s: %dx%d boxes on %dx%d, async, %d loops\n", LOG_TAG,
+           BENCH_BOX_SIZE, BENCH_BOX_SIZE, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("boxes   api               us/call   ioctls/call   eventfds/call\n");
+
+    for (size_t n = 0; n < sizeof(box_counts) / sizeof(box_counts[0]); n++) {
+        ret = bench_run(dst, boxes, box_counts[n], false, &single);
+        if (ret != IM_STATUS_SUCCESS)
+            break;
+        ret = bench_run(dst, boxes, box_counts[n], true, &array);
+        if (ret != IM_STATUS_SUCCESS)
+            break;
+
+        printf("%5d   %-16s %8.2f %13.2f %15.2f\n", box_counts[n], "imrectangle",
+               single.us, single.ioctls, single.eventfds);
+        printf("%5d   %-16s %8.2f %13.2f %15.2f\n", box_counts[n], "imrectangleArray",
+               array.us, array.ioctls, array.eventfds);
+    }
+
+    free(dst_buf);
+
+    return ret == IM_STATUS_SUCCESS ? 0 : -1;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_resize_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Resize throughput for the scale ratios the hardware supports (1/16~16,
+ * see querystring(RGA_SCALE_LIMIT)), per format and interpolation. The
+ * larger of src/dst is BENCH_WIDTH x BENCH_HEIGHT, the MPixel/s counts
+ * the dst pixels. Run it with ROCKCHIP_RGA_BACKEND=cpu to measure the CPU
+ * scaler.
+ */
+#define BENCH_WIDTH         1920
+#define BENCH_HEIGHT        1088
+#define BENCH_LOOP          10
+
+static const int bench_ratios[] = { -16, -8, -4, -2, 2, 4, 8, 16 };    /* < 0: down scale */
+
+static const struct {
+    int format;
+    const char *name;
+} bench_formats[] = {
+    { RK_FORMAT_RGBA_8888,      "RGBA" },
+    { RK_FORMAT_YCbCr_420_SP,   "NV12" },
+};
+
+static const struct {
+    int interp;
+    const char *name;
+} bench_interps[] = {
+    { IM_INTERP_LINEAR,                             "linear"       },
+    { IM_INTERP_CUBIC,                              "cubic"        },
+    { IM_INTERP(IM_INTERP_CUBIC, IM_INTERP_LINEAR), "cubic/linear" },
+};
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * 4;
+    int small_width, small_height;
+    char *large_buf, *small_buf;
+    rga_buffer_t src, dst;
+    int64_t start;
+    double us;
+    int ret;
+
+    large_buf = (char *)malloc(buf_size);
+    small_buf = (char *)malloc(buf_size);
+    draw_rgba(large_buf, BENCH_WIDTH, BENCH_HEIGHT);
+    draw_rgba(small_buf, BENCH_WIDTH, BENCH_HEIGHT);
+
+    printf("%s: larger side %dx%d, %d loops\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("%s\n", querystring(RGA_SCALE_LIMIT));
+    printf("format  interp         ratio     ms/frame  dst MPix/s\n");
+
+    for (size_t f = 0; f < sizeof(bench_formats) / sizeof(bench_formats[0]); f++) {
+        for (size_t i = 0; i < sizeof(bench_interps) / sizeof(bench_interps[0]); i++) {
+            for (size_t r = 0; r < sizeof(bench_ratios) / sizeof(bench_ratios[0]); r++) {
+                int ratio = bench_ratios[r] < 0 ? -bench_ratios[r] : bench_ratios[r];
+                char ratio_str[16];
+
+                small_width = BENCH_WIDTH / ratio;
+                small_height = (BENCH_HEIGHT / ratio) & ~1;
+
+                if (bench_ratios[r] < 0) {
+                    src = wrapbuffer_virtualaddr(large_buf, BENCH_WIDTH, BENCH_HEIGHT, bench_formats[f].format);
+                    dst = wrapbuffer_virtualaddr(small_buf, small_width, small_height, bench_formats[f].format);
+                    snprintf(ratio_str, sizeof(ratio_str), "1/%d", ratio);
+                } else {
+                    src = wrapbuffer_virtualaddr(small_buf, small_width, small_height, bench_formats[f].format);
+                    dst = wrapbuffer_virtualaddr(large_buf, BENCH_WIDTH, BENCH_HEIGHT, bench_formats[f].format);
+                    snprintf(ratio_str, sizeof(ratio_str), "%d", ratio);
+                }
+
+                ret = IM_STATUS_SUCCESS;
+                start = get_cur_us();
+                for (int l = 0; l < BENCH_LOOP && ret == IM_STATUS_SUCCESS; l++)
+                    ret = imresize(src, dst, 0, 0, bench_interps[i].interp);
+
+                if (ret != IM_STATUS_SUCCESS) {
+                    printf("%-7s %-14s %5s     %s\n", bench_formats[f].name, bench_interps[i].name,
+                           ratio_str, imStrError((IM_STATUS)ret));
+                    continue;
+                }
+
+                us = (double)(get_cur_us() - start) / BENCH_LOOP;
+                printf("%-7s %-14s %5s %12.2f %11.1f\n", bench_formats[f].name, bench_interps[i].name,
+                       ratio_str, us / 1000, (double)dst.width * dst.height / us);
+            }
+        }
+    }
+
+    free(large_buf);
+    free(small_buf);
+
+    return 0;
+}
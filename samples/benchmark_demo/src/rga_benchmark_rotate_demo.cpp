@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_rotate_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Rotate/flip cost per frame of librga against a naive reference, the
+ * per-pixel scatter the CPU backend used before its blocked kernels: every
+ * src pixel is written to its place in dst, which touches a new cache line
+ * per pixel under rotation. The librga output is compared with the
+ * reference. Run it with ROCKCHIP_RGA_BACKEND=cpu to measure the CPU
+ * kernels.
+ */
+#define BENCH_WIDTH         1920
+#define BENCH_HEIGHT        1088
+#define BENCH_LOOP          10
+
+static const struct {
+    int usage;
+    const char *name;
+} bench_transforms[] = {
+    { IM_HAL_TRANSFORM_ROT_90,                          "rot90"       },
+    { IM_HAL_TRANSFORM_ROT_180,                         "rot180"      },
+    { IM_HAL_TRANSFORM_ROT_270,                         "rot270"      },
+    { IM_HAL_TRANSFORM_FLIP_H,                          "flipH"       },
+    { IM_HAL_TRANSFORM_FLIP_V,                          "flipV"       },
+    { IM_HAL_TRANSFORM_ROT_90 | IM_HAL_TRANSFORM_FLIP_H, "rot90+flipH" },
+};
+
+static const struct {
+    int format;
+    const char *name;
+} bench_formats[] = {
+    { RK_FORMAT_RGBA_8888,      "RGBA8888" },
+    { RK_FORMAT_RGB_888,        "RGB888"   },
+    { RK_FORMAT_RGB_565,        "RGB565"   },
+    { RK_FORMAT_YCbCr_420_SP,   "NV12"     },
+};
+
+/* scatter each element of src to dst, the mirror is applied after the rotation */
+static void bench_naive_plane(const uint8_t *src, int width, int height, int src_stride,
+                              uint8_t *dst, int dst_stride, int size, int usage) {
+    bool swap = usage & (IM_HAL_TRANSFORM_ROT_90 | IM_HAL_TRANSFORM_ROT_270);
+    int dst_width = swap ? height : width;
+    int dst_height = swap ? width : height;
+    int dx, dy;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (usage & IM_HAL_TRANSFORM_ROT_90) {
+                dx = height - 1 - y;
+                dy = x;
+            } else if (usage & IM_HAL_TRANSFORM_ROT_180) {
+                dx = width - 1 - x;
+                dy = height - 1 - y;
+            } else if (usage & IM_HAL_TRANSFORM_ROT_270) {
+                dx = y;
+                dy = width - 1 - x;
+            } else {
+                dx = x;
+                dy = y;
+            }
+
+            if (usage & IM_HAL_TRANSFORM_FLIP_H)
+                dx = dst_width - 1 - dx;
+            if (usage & IM_HAL_TRANSFORM_FLIP_V)
+                dy = dst_height - 1 - dy;
+
+            memcpy(dst + (size_t)dy * dst_stride + (size_t)dx * size,
+                   src + (size_t)y * src_stride + (size_t)x * size, size);
+        }
+    }
+}
+
+static void bench_naive(const char *src, char *dst, int format, int usage) {
+    bool swap = usage & (IM_HAL_TRANSFORM_ROT_90 | IM_HAL_TRANSFORM_ROT_270);
+    int dst_width = swap ? BENCH_HEIGHT : BENCH_WIDTH;
+    int size;
+
+    if (format == RK_FORMAT_YCbCr_420_SP) {
+        /* Y, then the CbCr pairs as 16 bit elements */
+        bench_naive_plane((const uint8_t *)src, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH,
+                          (uint8_t *)dst, dst_width, 1, usage);
+        bench_naive_plane((const uint8_t *)src + BENCH_WIDTH * BENCH_HEIGHT,
+                          BENCH_WIDTH / 2, BENCH_HEIGHT / 2, BENCH_WIDTH,
+                          (uint8_t *)dst + BENCH_WIDTH * BENCH_HEIGHT, dst_width, 2, usage);
+        return;
+    }
+
+    size = (int)get_bpp_from_format(format);
+    bench_naive_plane((const uint8_t *)src, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH * size,
+                      (uint8_t *)dst, dst_width * size, size, usage);
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * 4;
+    char *src_buf, *naive_buf, *dst_buf;
+    rga_buffer_t src, dst, pat;
+    im_rect srect, drect, prect;
+    int64_t start;
+    double naive_us, rga_us;
+    int frame_size;
+    bool swap;
+    int ret;
+
+    src_buf = (char *)malloc(buf_size);
+    naive_buf = (char *)malloc(buf_size);
+    dst_buf = (char *)malloc(buf_size);
+    draw_rgba(src_buf, BENCH_WIDTH, BENCH_HEIGHT);
+
+    memset(&pat, 0, sizeof(pat));
+    memset(&srect, 0, sizeof(srect));
+    memset(&drect, 0, sizeof(drect));
+    memset(&prect, 0, sizeof(prect));
+
+    printf("%s: %dx%d, %d loops\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("format    transform     naive ms  librga ms  speedup  output\n");
+
+    for (size_t f = 0; f < sizeof(bench_formats) / sizeof(bench_formats[0]); f++) {
+        frame_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(bench_formats[f].format);
+
+        for (size_t t = 0; t < sizeof(bench_transforms) / sizeof(bench_transforms[0]); t++) {
+            swap = bench_transforms[t].usage & (IM_HAL_TRANSFORM_ROT_90 | IM_HAL_TRANSFORM_ROT_270);
+
+            src = wrapbuffer_virtualaddr(src_buf, BENCH_WIDTH, BENCH_HEIGHT, bench_formats[f].format);
+            dst = wrapbuffer_virtualaddr(dst_buf, swap ? BENCH_HEIGHT : BENCH_WIDTH,
+                                         swap ? BENCH_WIDTH : BENCH_HEIGHT, bench_formats[f].format);
+
+            start = get_cur_us();
+            for (int l = 0; l < BENCH_LOOP; l++)
+                bench_naive(src_buf, naive_buf, bench_formats[f].format, bench_transforms[t].usage);
+            naive_us = (double)(get_cur_us() - start) / BENCH_LOOP;
+
+            ret = IM_STATUS_SUCCESS;
+            start = get_cur_us();
+            for (int l = 0; l < BENCH_LOOP && ret == IM_STATUS_SUCCESS; l++)
+                ret = improcess(src, dst, pat, srect, drect, prect, bench_transforms[t].usage);
+            rga_us = (double)(get_cur_us() - start) / BENCH_LOOP;
+
+            if (ret != IM_STATUS_SUCCESS) {
+                printf("%-9s %-12s %9.2f  %s\n", bench_formats[f].name, bench_transforms[t].name,
+                       naive_us / 1000, imStrError((IM_STATUS)ret));
+                continue;
+            }
+
+            printf("%-9s %-12s %9.2f %10.2f %7.2fx  %s\n", bench_formats[f].name, bench_transforms[t].name,
+                   naive_us / 1000, rga_us / 1000, naive_us / rga_us,
+                   memcmp(naive_buf, dst_buf, frame_size) == 0 ? "same" : "differs");
+        }
+    }
+
+    free(src_buf);
+    free(naive_buf);
+    free(dst_buf);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_submit_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Single-task submission throughput with 1~8 threads. The image is tiny so
+ * the time is spent on the submit path, run it with ROCKCHIP_RGA_BACKEND=cpu
+ * to replace the driver ioctl with the CPU backend.
+ */
+#define BENCH_WIDTH         16
+#define BENCH_HEIGHT        16
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_LOOP          20000
+#define BENCH_THREAD_MAX    8
+
+typedef struct {
+    char *src_buf;
+    char *dst_buf;
+    int failed;
+} bench_thread_t;
+
+static void *bench_thread_func(void *arg) {
+    bench_thread_t *thread = (bench_thread_t *)arg;
+    rga_buffer_t src, dst;
+
+    src = wrapbuffer_virtualaddr(thread->src_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+    dst = wrapbuffer_virtualaddr(thread->dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        if (imcopy(src, dst) != IM_STATUS_SUCCESS)
+            thread->failed++;
+    }
+
+    return NULL;
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    bench_thread_t threads[BENCH_THREAD_MAX];
+    pthread_t tid[BENCH_THREAD_MAX];
+    int64_t start, cost;
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        threads[i].src_buf = (char *)malloc(buf_size);
+        threads[i].dst_buf = (char *)malloc(buf_size);
+        threads[i].failed = 0;
+        draw_rgba(threads[i].src_buf, BENCH_WIDTH, BENCH_HEIGHT);
+    }
+
+    printf("%s: imcopy %dx%d, %d calls per thread\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("threads      calls/s      us/call\n");
+
+    for (int count = 1; count <= BENCH_THREAD_MAX; count *= 2) {
+        start = get_cur_us();
+        for (int i = 0; i < count; i++)
+            pthread_create(&tid[i], NULL, bench_thread_func, &threads[i]);
+        for (int i = 0; i < count; i++)
+            pthread_join(tid[i], NULL);
+        cost = get_cur_us() - start;
+
+        printf("%7d %12.0f %12.2f\n", count,
+               (double)count * BENCH_LOOP * 1000000 / cost,
+               (double)cost / ((double)count * BENCH_LOOP));
+    }
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        if (threads[i].failed)
+            printf("%s: thread[%d] %d calls failed\n", LOG_TAG, i, threads[i].failed);
+        free(threads[i].src_buf);
+        free(threads[i].dst_buf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_benchmark_thread_session_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+
+#include "utils.h"
+
+/*
+ * Single-task submission throughput with 1~8 threads, sharing the global
+ * session or each with its own session (IM_CONFIG_THREAD_SESSION). Run it
+ * with ROCKCHIP_RGA_BACKEND=cpu to replace the driver ioctl with the CPU
+ * backend.
+ *
+ * On glibc every session initializes its own rwlock, pthread_rwlock_init
+ * is wrapped to check that each thread really got a private session.
+ */
+#define BENCH_WIDTH         16
+#define BENCH_HEIGHT        16
+#define BENCH_FORMAT        RK_FORMAT_RGBA_8888
+#define BENCH_LOOP          20000
+#define BENCH_THREAD_MAX    8
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+typedef int (*bench_rwlock_init_func)(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr);
+
+static __thread int g_rwlock_init_count;
+
+extern "C" int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr) {
+    static bench_rwlock_init_func real_rwlock_init;
+
+    if (real_rwlock_init == NULL)
+        real_rwlock_init = (bench_rwlock_init_func)dlsym(RTLD_NEXT, "pthread_rwlock_init");
+
+    g_rwlock_init_count++;
+    return real_rwlock_init(rwlock, attr);
+}
+
+static int bench_thread_session_enable(void) {
+    int last_count = g_rwlock_init_count;
+    int ret;
+
+    ret = imconfig(IM_CONFIG_THREAD_SESSION, true);
+    if (ret != IM_STATUS_SUCCESS)
+        return ret;
+
+    if (g_rwlock_init_count == last_count) {
+        printf("%s: IM_CONFIG_THREAD_SESSION did not create a private session\n", LOG_TAG);
+        abort();
+    }
+
+    return IM_STATUS_SUCCESS;
+}
+#else
+static int bench_thread_session_enable(void) {
+    return imconfig(IM_CONFIG_THREAD_SESSION, true);
+}
+#endif
+
+typedef struct {
+    char *src_buf;
+    char *dst_buf;
+    bool thread_session;
+    int failed;
+} bench_thread_t;
+
+static void *bench_thread_func(void *arg) {
+    bench_thread_t *thread = (bench_thread_t *)arg;
+    rga_buffer_t src, dst;
+
+    if (thread->thread_session &&
+        bench_thread_session_enable() != IM_STATUS_SUCCESS) {
+        thread->failed = BENCH_LOOP;
+        return NULL;
+    }
+
+    src = wrapbuffer_virtualaddr(thread->src_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+    dst = wrapbuffer_virtualaddr(thread->dst_buf, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FORMAT);
+
+    for (int i = 0; i < BENCH_LOOP; i++) {
+        if (imcopy(src, dst) != IM_STATUS_SUCCESS)
+            thread->failed++;
+    }
+
+    if (thread->thread_session)
+        imconfig(IM_CONFIG_THREAD_SESSION, false);
+
+    return NULL;
+}
+
+static double bench_run(bench_thread_t *threads, int count, bool thread_session) {
+    pthread_t tid[BENCH_THREAD_MAX];
+    int64_t start, cost;
+
+    start = get_cur_us();
+    for (int i = 0; i < count; i++) {
+        threads[i].thread_session = thread_session;
+        pthread_create(&tid[i], NULL, bench_thread_func, &threads[i]);
+    }
+    for (int i = 0; i < count; i++)
+        pthread_join(tid[i], NULL);
+    cost = get_cur_us() - start;
+
+    return (double)count * BENCH_LOOP * 1000000 / cost;
+}
+
+int main() {
+    int buf_size = BENCH_WIDTH * BENCH_HEIGHT * get_bpp_from_format(BENCH_FORMAT);
+    bench_thread_t threads[BENCH_THREAD_MAX];
+    double shared, private_session;
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        threads[i].src_buf = (char *)malloc(buf_size);
+        threads[i].dst_buf = (char *)malloc(buf_size);
+        threads[i].failed = 0;
+        draw_rgba(threads[i].src_buf, BENCH_WIDTH, BENCH_HEIGHT);
+    }
+
+    printf("%s: imcopy %dx%d, %d calls per thread\n", LOG_TAG, BENCH_WIDTH, BENCH_HEIGHT, BENCH_LOOP);
+    printf("threads   shared calls/s   thread session calls/s\n");
+
+    for (int count = 1; count <= BENCH_THREAD_MAX; count *= 2) {
+        shared = bench_run(threads, count, false);
+        private_session = bench_run(threads, count, true);
+
+        printf("%7d %16.0f %24.0f\n", count, shared, private_session);
+    }
+
+    for (int i = 0; i < BENCH_THREAD_MAX; i++) {
+        if (threads[i].failed)
+            printf("%s: thread[%d] %d calls failed\n", LOG_TAG, i, threads[i].failed);
+        free(threads[i].src_buf);
+        free(threads[i].dst_buf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2022  Rockchip Electronics Co., Ltd.
+ * Authors:
+ *     YuQiaowei <cerf.yu@rock-chips.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "rga_config_stripe_core_demo"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "RgaUtils.h"
+#include "im2d.hpp"
+#include "utils.h"
+
+/*
+ * Check which core each stripe of IM_CONFIG_STRIPE_SPLIT is sent to. On
+ * glibc, open/ioctl are wrapped to fake a multi-RGA driver with the cores of
+ * an RK3588 (RGA3 core0/core1 and an RGA2-enhance core), that records the
+ * core and the dst rows of every task instead of running it, so no device
+ * is needed.
+ */
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+#include "rga_ioctl.h"
+
+#define CHECK_WIDTH         1920
+#define CHECK_HEIGHT        1088
+#define CHECK_TASK_MAX      16
+
+typedef struct {
+    int core;
+    int y;
+    int height;
+} check_task_t;
+
+static int g_fake_fd = -1;
+static uint32_t g_next_job;
+static check_task_t g_tasks[CHECK_TASK_MAX];
+static int g_task_count;
+static int g_submit_count;
+static int g_failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s: check '%s' failed at line %d\n", LOG_TAG, #cond, __LINE__); \
+            g_failed++; \
+        } \
+    } while (0)
+
+typedef int (*check_open_func)(const char *path, int flags, ...);
+typedef int (*check_ioctl_func)(int fd, unsigned long request, ...);
+
+static int check_fake_open(const char *name, const char *path, int flags, mode_t mode) {
+    check_open_func real_open;
+
+    if (strcmp(path, "/dev/rga") == 0) {
+        g_fake_fd = eventfd(0, EFD_CLOEXEC);
+        return g_fake_fd;
+    }
+
+    real_open = (check_open_func)dlsym(RTLD_NEXT, name);
+    return real_open(path, flags, mode);
+}
+
+extern "C" int open(const char *path, int flags, ...) {
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = va_arg(args, mode_t);
+    va_end(args);
+
+    return check_fake_open("open", path, flags, mode);
+}
+
+extern "C" int open64(const char *path, int flags, ...) {
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = va_arg(args, mode_t);
+    va_end(args);
+
+    return check_fake_open("open64", path, flags, mode);
+}
+
+static void check_record(const struct rga_req *req, int count) {
+    for (int i = 0; i < count && g_task_count < CHECK_TASK_MAX; i++) {
+        g_tasks[g_task_count].core = req[i].core;
+        g_tasks[g_task_count].y = req[i].dst.y_offset;
+        g_tasks[g_task_count].height = req[i].dst.act_h;
+        g_task_count++;
+    }
+    g_submit_count++;
+}
+
+static int check_fake_ioctl(unsigned long request, void *arg) {
+    struct rga_hw_versions_t *versions;
+    struct rga_user_request *user_request;
+    static const struct rga_version_t driver_version = { 1, 3, 0, "1.3.0" };
+    static const struct rga_version_t rga3_version = { 3, 0, 0x76831, "3.0.76831" };
+    static const struct rga_version_t rga2_version = { 3, 2, 0x63318, "3.2.63318" };
+
+    switch (request) {
+        case RGA_IOC_GET_DRVIER_VERSION:
+            memcpy(arg, &driver_version, sizeof(driver_version));
+            return 0;
+        case RGA_IOC_GET_HW_VERSION:
+            versions = (struct rga_hw_versions_t *)arg;
+            memset(versions, 0x0, sizeof(*versions));
+            versions->version[0] = rga3_version;
+            versions->version[1] = rga3_version;
+            versions->version[2] = rga2_version;
+            versions->size = 3;
+            return 0;
+        case RGA_IOC_REQUEST_CREATE:
+            *(uint32_t *)arg = ++g_next_job;
+            return 0;
+        case RGA_IOC_REQUEST_SUBMIT:
+        case RGA_IOC_REQUEST_CONFIG:
+            user_request = (struct rga_user_request *)arg;
+            check_record((const struct rga_req *)(uintptr_t)user_request->task_ptr, user_request->task_num);
+            user_request->release_fence_fd = -1;
+            return 0;
+        case RGA_IOC_REQUEST_CANCEL:
+            return 0;
+        case RGA_BLIT_SYNC:
+            check_record((const struct rga_req *)arg, 1);
+            return 0;
+        default:
+            errno = ENOTTY;
+            return -1;
+    }
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+    static check_ioctl_func real_ioctl;
+    va_list args;
+    void *arg;
+
+    if (real_ioctl == NULL)
+        real_ioctl = (check_ioctl_func)dlsym(RTLD_NEXT, "ioctl");
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    if (fd >= 0 && fd == g_fake_fd)
+        return check_fake_ioctl(request, arg);
+    return real_ioctl(fd, request, arg);
+}
+
+static const char *check_core_name(int core) {
+    switch (core) {
+        case IM_SCHEDULER_RGA3_CORE0:
+            return "rga3_core0";
+        case IM_SCHEDULER_RGA3_CORE1:
+            return "rga3_core1";
+        case IM_SCHEDULER_RGA2_CORE0:
+            return "rga2_core0";
+        default:
+            return "default";
+    }
+}
+
+/* run the task with the stripe core mask, the recorded tasks are checked against expect_count */
+static void check_run(const char *name, uint64_t mask, int format, int src_height, int dst_height,
+                      int pinned_core, int expect_count) {
+    rga_buffer_t src, dst, pat;
+    im_rect srect, drect, prect;
+    im_opt_t opt = {};
+    uint32_t cores = 0;
+    int next_y = 0;
+    int ret;
+
+    memset(&pat, 0, sizeof(pat));
+    memset(&srect, 0, sizeof(srect));
+    memset(&drect, 0, sizeof(drect));
+    memset(&prect, 0, sizeof(prect));
+
+    /* the fake driver does not touch the memory */
+    src = wrapbuffer_physicaladdr((void *)0x10000000, CHECK_WIDTH, src_height, format);
+    dst = wrapbuffer_physicaladdr((void *)0x20000000, CHECK_WIDTH, dst_height, format);
+    opt.core = (IM_SCHEDULER_CORE)pinned_core;
+
+    g_task_count = 0;
+    g_submit_count = 0;
+
+    CHECK(imconfig(IM_CONFIG_STRIPE_SPLIT, mask) == IM_STATUS_SUCCESS);
+    ret = improcess(src, dst, pat, srect, drect, prect, -1, NULL, &opt, IM_SYNC);
+    CHECK(ret == IM_STATUS_SUCCESS);
+    CHECK(imconfig(IM_CONFIG_STRIPE_SPLIT, 0) == IM_STATUS_SUCCESS);
+
+    /* one submit, the stripes cover the dst rows in order, each on its own core of the mask */
+    CHECK(g_submit_count == 1);
+    CHECK(g_task_count == expect_count);
+    for (int i = 0; i < g_task_count; i++) {
+        if (expect_count > 1) {
+            CHECK(g_tasks[i].core & mask);
+            CHECK(!(g_tasks[i].core & cores));
+            cores |= g_tasks[i].core;
+        } else {
+            CHECK(g_tasks[i].core == pinned_core);
+        }
+        CHECK(g_tasks[i].y == next_y);
+        next_y += g_tasks[i].height;
+    }
+    CHECK(next_y == dst_height);
+
+    printf("%-34s", name);
+    for (int i = 0; i < g_task_count; i++)
+        printf(" %s[%d,+%d]", check_core_name(g_tasks[i].core), g_tasks[i].y, g_tasks[i].height);
+    printf("\n");
+}
+
+int main() {
+    const uint64_t all = IM_SCHEDULER_RGA3_CORE0 | IM_SCHEDULER_RGA3_CORE1 | IM_SCHEDULER_RGA2_CORE0;
+    const uint64_t rga3 = IM_SCHEDULER_RGA3_CORE0 | IM_SCHEDULER_RGA3_CORE1;
+
+    printf("%s: %dx%d, core[dst y,+rows] of each task\n", LOG_TAG, CHECK_WIDTH, CHECK_HEIGHT);
+
+    check_run("RGBA copy, all cores", all, RK_FORMAT_RGBA_8888, CHECK_HEIGHT, CHECK_HEIGHT, 0, 3);
+    check_run("RGBA copy, RGA3 cores", rga3, RK_FORMAT_RGBA_8888, CHECK_HEIGHT, CHECK_HEIGHT, 0, 2);
+    check_run("NV12 1/2 downscale, all cores", all, RK_FORMAT_YCbCr_420_SP,
+              CHECK_HEIGHT * 2, CHECK_HEIGHT, 0, 3);
+    check_run("RGBA copy, pinned to rga2_core0", all, RK_FORMAT_RGBA_8888, CHECK_HEIGHT, CHECK_HEIGHT,
+              IM_SCHEDULER_RGA2_CORE0, 1);
+    /* stripes thinner than 64 rows are not split off */
+    check_run("RGBA copy, 128 rows", all, RK_FORMAT_RGBA_8888, 128, 128, 0, 2);
+    check_run("RGBA copy, 96 rows", all, RK_FORMAT_RGBA_8888, 96, 96, 0, 1);
+
+    printf("%s: %s\n", LOG_TAG, g_failed ? "FAILED" : "passed");
+
+    return g_failed ? -1 : 0;
+}
+#else
+int main() {
+    printf("%s: the fake driver needs glibc, skipped\n", LOG_TAG);
+
+    return 0;
+}
+#endif
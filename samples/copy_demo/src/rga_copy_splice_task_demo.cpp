@@ -116,7 +116,7 @@ int main() {
      * 1). Create a job handle.
      */
     job_handle = imbeginJob();
-    if (job_handle <= 0) {
+    if ((int)job_handle <= 0) {
         printf("job begin failed![%d], %s\n", job_handle, imStrError());
         goto release_buffer;
     }